@@ -110,6 +110,7 @@ extern PFN_vkQueueWaitIdle vkQueueWaitIdle;
 extern PFN_vkDeviceWaitIdle vkDeviceWaitIdle;
 extern PFN_vkCreateFramebuffer vkCreateFramebuffer;
 extern PFN_vkCreatePipelineCache vkCreatePipelineCache;
+extern PFN_vkGetPipelineCacheData vkGetPipelineCacheData;
 extern PFN_vkCreatePipelineLayout vkCreatePipelineLayout;
 extern PFN_vkCreateGraphicsPipelines vkCreateGraphicsPipelines;
 extern PFN_vkCreateComputePipelines vkCreateComputePipelines;
@@ -148,6 +149,7 @@ extern PFN_vkGetQueryPoolResults vkGetQueryPoolResults;
 extern PFN_vkCmdBeginQuery vkCmdBeginQuery;
 extern PFN_vkCmdEndQuery vkCmdEndQuery;
 extern PFN_vkCmdResetQueryPool vkCmdResetQueryPool;
+extern PFN_vkCmdWriteTimestamp vkCmdWriteTimestamp;
 extern PFN_vkCmdCopyQueryPoolResults vkCmdCopyQueryPoolResults;
 
 extern PFN_vkCreateAndroidSurfaceKHR vkCreateAndroidSurfaceKHR;
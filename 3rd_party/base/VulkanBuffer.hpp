@@ -14,6 +14,7 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
+#include "VulkanMemoryAllocator.hpp"
 
 namespace vks
 {	
@@ -25,7 +26,8 @@ namespace vks
 	{
 		VkDevice device;
 		VkBuffer buffer = VK_NULL_HANDLE;
-		VkDeviceMemory memory = VK_NULL_HANDLE;
+		/** @brief Memory block and offset the buffer is bound to (the block is shared with other resources) */
+		vks::Allocation allocation;
 		VkDescriptorBufferInfo descriptor;
 		VkDeviceSize size = 0;
 		VkDeviceSize alignment = 0;
@@ -38,29 +40,32 @@ namespace vks
 
 		/** 
 		* Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+		*
+		* @note Host visible memory blocks are persistently mapped by the allocator, so this only computes the pointer
 		* 
 		* @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete buffer range.
 		* @param offset (Optional) Byte offset from beginning
 		* 
-		* @return VkResult of the buffer mapping call
+		* @return VK_ERROR_MEMORY_MAP_FAILED if the buffer is not host visible
 		*/
 		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
 		{
-			return vkMapMemory(device, memory, offset, size, 0, &mapped);
+			if (allocation.mapped == nullptr)
+			{
+				return VK_ERROR_MEMORY_MAP_FAILED;
+			}
+			mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+			return VK_SUCCESS;
 		}
 
 		/**
 		* Unmap a mapped memory range
 		*
-		* @note Does not return a result as vkUnmapMemory can't fail
+		* @note The memory block stays mapped as it's shared with other allocations
 		*/
 		void unmap()
 		{
-			if (mapped)
-			{
-				vkUnmapMemory(device, memory);
-				mapped = nullptr;
-			}
+			mapped = nullptr;
 		}
 
 		/** 
@@ -72,7 +77,7 @@ namespace vks
 		*/
 		VkResult bind(VkDeviceSize offset = 0)
 		{
-			return vkBindBufferMemory(device, buffer, memory, offset);
+			return vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset + offset);
 		}
 
 		/**
@@ -114,12 +119,7 @@ namespace vks
 		*/
 		VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
 		{
-			VkMappedMemoryRange mappedRange = {};
-			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-			mappedRange.memory = memory;
-			mappedRange.offset = offset;
-			mappedRange.size = size;
-			return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
+			return allocation.flush(size, offset);
 		}
 
 		/**
@@ -134,12 +134,7 @@ namespace vks
 		*/
 		VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
 		{
-			VkMappedMemoryRange mappedRange = {};
-			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-			mappedRange.memory = memory;
-			mappedRange.offset = offset;
-			mappedRange.size = size;
-			return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
+			return allocation.invalidate(size, offset);
 		}
 
 		/** 
@@ -150,11 +145,10 @@ namespace vks
 			if (buffer)
 			{
 				vkDestroyBuffer(device, buffer, nullptr);
+				buffer = VK_NULL_HANDLE;
 			}
-			if (memory)
-			{
-				vkFreeMemory(device, memory, nullptr);
-			}
+			mapped = nullptr;
+			allocation.free();
 		}
 
 	};
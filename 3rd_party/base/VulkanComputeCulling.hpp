@@ -0,0 +1,375 @@
+/*
+* GPU frustum and level of detail culling with a compute shader writing indirect draw commands
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanUploadQueue.hpp"
+#include "VulkanFrameRingBuffer.hpp"
+#include "VulkanIndirectDraw.hpp"
+#include "frustum.hpp"
+
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/**
+	* @brief Culls objects against the view frustum on the GPU and selects a level of detail for each visible one
+	*
+	* Uses the binding layout of data/shaders/computecullandlod/cull.comp:
+	* 0: objects (vec4 position + scale, std140), 1: indirect draw commands, 2: uniform block with matrices, camera position
+	* and frustum planes, 3: visible object and per level of detail counters (atomics), 4: level of detail ranges
+	*
+	* There is one draw command per object with the object index as first instance, so the object buffer can be bound as
+	* instance rate vertex buffer. The shader sets the instance count of culled objects to zero and fills in the index
+	* range of the selected level for visible ones. Counters are copied to a host visible buffer with a region per frame.
+	*
+	* With compact set, visible objects append their command to the next free slot instead (first instance is still the object index),
+	* so no empty commands are processed: the visible object counter is the draw count of vkCmdDrawIndexedIndirectCountKHR
+	* (if drawIndirectCount is set), otherwise the commands are cleared before the culling pass and all slots are drawn.
+	*
+	* The culling dispatch is recorded into the graphics command buffer ahead of the render pass (graphics queues always support compute).
+	*/
+	class ComputeCulling
+	{
+	public:
+		/** @brief Index range and maximum camera distance of one level of detail, same layout as in the shader */
+		struct LodLevel {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float distance;
+			/** @brief Vertex offset of the level's draws (vertex base of its model part) */
+			int32_t vertexOffset = 0;
+		};
+
+		/** @brief Results of a culling pass */
+		struct Statistics {
+			uint32_t objectCount = 0;
+			uint32_t visibleCount = 0;
+			uint32_t culledCount = 0;
+			std::vector<uint32_t> lodCounts;
+		};
+
+		/** @brief Object positions and scales, also usable as instance rate vertex buffer */
+		vks::Buffer objectBuffer;
+		vks::IndirectDrawBuffer indirectDraws;
+
+		/** @brief Bounding sphere radius of the objects at scale 1, scaled by each object's scale (set before prepare) */
+		float boundingRadius = 1.0f;
+		/** @brief Write the commands of visible objects to consecutive slots (set before prepare) */
+		bool compact = false;
+		/** @brief VK_KHR_draw_indirect_count is enabled on the device, compacted commands are drawn with the visible count as draw count (set before prepare) */
+		bool drawIndirectCount = false;
+
+		/**
+		* Create buffers, descriptors and the compute pipeline
+		*
+		* @param shaderStage Compute shader stage of the culling shader (cull.comp)
+		* @param objects Position (xyz) and scale (w) of the objects, tested with a bounding sphere of radius boundingRadius * scale
+		* @param lods Levels of detail from the most to the least detailed, the last one is used beyond all distances
+		* @param frameCount Number of frames that can be recorded and in flight at the same time
+		*
+		* @note Requires the drawIndirectFirstInstance feature (objects are selected via the first instance of each command)
+		*/
+		void prepare(vks::VulkanDevice *device, VkQueue queue, VkPipelineCache pipelineCache, VkPipelineShaderStageCreateInfo shaderStage,
+			const std::vector<glm::vec4> &objects, const std::vector<LodLevel> &lods, uint32_t frameCount)
+		{
+			assert(!objects.empty() && !lods.empty() && (frameCount > 0));
+			if (!device->enabledFeatures.drawIndirectFirstInstance) {
+				throw std::runtime_error("GPU culling requires the drawIndirectFirstInstance feature");
+			}
+			this->device = device;
+			this->frameCount = frameCount;
+			objectCount = static_cast<uint32_t>(objects.size());
+			lodCount = static_cast<uint32_t>(lods.size());
+
+			// The shader has no bounds check, so the object and command counts are padded to whole work groups
+			// Padding objects are placed far outside of any (bounded) frustum and never drawn
+			const uint32_t paddedCount = (objectCount + workGroupSize - 1) / workGroupSize * workGroupSize;
+			std::vector<glm::vec4> paddedObjects(objects);
+			paddedObjects.resize(paddedCount, glm::vec4(glm::vec3(1.0e30f), 0.0f));
+
+			indirectDraws.clear();
+			for (uint32_t i = 0; i < paddedCount; i++) {
+				indirectDraws.add(lods[0].indexCount, lods[0].firstIndex, lods[0].vertexOffset, 1, i);
+			}
+			indirectDraws.upload(device, queue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &objectBuffer, paddedObjects.size() * sizeof(glm::vec4)));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &lodBuffer, lods.size() * sizeof(LodLevel)));
+			vks::UploadQueue *uploadQueue = vks::UploadQueue::getShared(device, queue);
+			uploadQueue->uploadBuffer(objectBuffer.buffer, paddedObjects.data(), objectBuffer.size, 0,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+			uploadQueue->uploadBuffer(lodBuffer.buffer, lods.data(), lodBuffer.size, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			uploadQueue->flush();
+
+			// Visible object count followed by one counter per level, the visible count is also the draw count of compacted commands
+			statisticsSize = (1 + lodCount) * sizeof(uint32_t);
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &statisticsBuffer, statisticsSize));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &readbackBuffer, statisticsSize * frameCount));
+			VK_CHECK_RESULT(readbackBuffer.map());
+			memset(readbackBuffer.mapped, 0, statisticsSize * frameCount);
+
+			uniformRing.prepare(device, sizeof(UniformData), frameCount);
+
+			cmdDrawIndexedIndirectCount = nullptr;
+			if (compact && drawIndirectCount) {
+				cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+			}
+
+			prepareDescriptors();
+			preparePipeline(pipelineCache, shaderStage);
+		}
+
+		/** @brief Release all resources */
+		void destroy()
+		{
+			if (!device) {
+				return;
+			}
+			vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+			objectBuffer.destroy();
+			indirectDraws.destroy();
+			lodBuffer.destroy();
+			statisticsBuffer.destroy();
+			readbackBuffer.destroy();
+			uniformRing.destroy();
+			device = nullptr;
+		}
+
+		/**
+		* Set the camera used for culling and level of detail selection of a frame
+		*
+		* @note The data of the previous use of this frame index must no longer be in use by the device
+		*/
+		void update(uint32_t frameIndex, const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &cameraPosition)
+		{
+			UniformData uniformData;
+			uniformData.projection = projection;
+			uniformData.modelview = view;
+			uniformData.cameraPos = glm::vec4(cameraPosition, 1.0f);
+			vks::Frustum frustum;
+			frustum.update(projection * view);
+			for (size_t i = 0; i < frustum.planes.size(); i++) {
+				uniformData.frustumPlanes[i] = frustum.planes[i];
+			}
+			uniformRing.beginFrame(frameIndex);
+			uniformRing.push(&uniformData, sizeof(uniformData));
+			VK_CHECK_RESULT(uniformRing.flush());
+		}
+
+		/**
+		* Record the culling pass, must be recorded outside of a render pass before draw
+		*
+		* @param frameIndex Frame index passed to update, selects the uniform data and the statistics region
+		*/
+		void record(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+		{
+			assert(frameIndex < frameCount);
+
+			// Draw commands and counters of the previous frame must have been consumed before they are overwritten
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdFillBuffer(commandBuffer, statisticsBuffer.buffer, 0, statisticsSize, 0);
+			bufferBarrier(commandBuffer, statisticsBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			if (compact && !cmdDrawIndexedIndirectCount) {
+				// All slots are drawn, the ones behind the visible objects have to be empty commands
+				vkCmdFillBuffer(commandBuffer, indirectDraws.buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+				bufferBarrier(commandBuffer, indirectDraws.buffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			}
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			// The uniform data is the only allocation in the frame's region
+			const uint32_t uniformOffset = static_cast<uint32_t>(uniformRing.getFrameOffset(frameIndex));
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 1, &uniformOffset);
+			vkCmdDispatch(commandBuffer, indirectDraws.size() / workGroupSize, 1, 1);
+
+			// Commands are consumed by the draw, the counters by the copy to the host visible buffer (and the draw count by the draw)
+			bufferBarrier(commandBuffer, indirectDraws.buffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+			bufferBarrier(commandBuffer, statisticsBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+
+			VkBufferCopy copyRegion{ 0, frameIndex * statisticsSize, statisticsSize };
+			vkCmdCopyBuffer(commandBuffer, statisticsBuffer.buffer, readbackBuffer.buffer, 1, &copyRegion);
+			bufferBarrier(commandBuffer, readbackBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+		}
+
+		/**
+		* Draw the objects with the commands written by the culling pass (pipeline, vertex, index and instance buffers have to be bound)
+		*/
+		void draw(VkCommandBuffer commandBuffer) const
+		{
+			if (cmdDrawIndexedIndirectCount) {
+				cmdDrawIndexedIndirectCount(commandBuffer, indirectDraws.buffer.buffer, 0, statisticsBuffer.buffer, 0, objectCount, sizeof(VkDrawIndexedIndirectCommand));
+				return;
+			}
+			// Commands of padding objects are skipped
+			indirectDraws.draw(commandBuffer, 0, objectCount);
+		}
+
+		/** @brief True if compacted commands are drawn with the visible object count as draw count */
+		bool isDrawCount() const
+		{
+			return cmdDrawIndexedIndirectCount != nullptr;
+		}
+
+		/**
+		* Results of the last culling pass recorded for a frame index
+		*
+		* @note Only valid once the device has finished that frame (e.g. after waiting on its fence)
+		*/
+		Statistics getStatistics(uint32_t frameIndex)
+		{
+			assert(frameIndex < frameCount);
+			readbackBuffer.allocation.invalidate(statisticsSize, frameIndex * statisticsSize);
+			const uint32_t *counters = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(readbackBuffer.mapped) + frameIndex * statisticsSize);
+			Statistics statistics;
+			statistics.objectCount = objectCount;
+			statistics.visibleCount = std::min(counters[0], objectCount);
+			statistics.culledCount = objectCount - statistics.visibleCount;
+			statistics.lodCounts.assign(counters + 1, counters + 1 + lodCount);
+			return statistics;
+		}
+
+		uint32_t getObjectCount() const
+		{
+			return objectCount;
+		}
+
+	private:
+		static const uint32_t workGroupSize = 16;
+
+		/** @brief Uniform block of the culling shader */
+		struct UniformData {
+			glm::mat4 projection;
+			glm::mat4 modelview;
+			glm::vec4 cameraPos;
+			glm::vec4 frustumPlanes[6];
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		uint32_t frameCount = 0;
+		uint32_t objectCount = 0;
+		uint32_t lodCount = 0;
+		VkDeviceSize statisticsSize = 0;
+		PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
+		vks::Buffer lodBuffer;
+		vks::Buffer statisticsBuffer;
+		vks::Buffer readbackBuffer;
+		vks::FrameRingBuffer uniformRing;
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+
+		static void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+			VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+		{
+			VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.buffer = buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+
+		void prepareDescriptors()
+		{
+			using namespace vks::initializers;
+
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
+				descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolCI = descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4)
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = pipelineLayoutCreateInfo(&descriptorSetLayout);
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+			VkDescriptorSetAllocateInfo allocInfo = descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+
+			VkDescriptorBufferInfo objectDescriptor = { objectBuffer.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo drawDescriptor = { indirectDraws.buffer.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo uniformDescriptor = uniformRing.getDescriptor(sizeof(UniformData));
+			VkDescriptorBufferInfo statisticsDescriptor = { statisticsBuffer.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo lodDescriptor = { lodBuffer.buffer, 0, VK_WHOLE_SIZE };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &objectDescriptor),
+				writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &drawDescriptor),
+				writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2, &uniformDescriptor),
+				writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &statisticsDescriptor),
+				writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &lodDescriptor)
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		void preparePipeline(VkPipelineCache pipelineCache, VkPipelineShaderStageCreateInfo shaderStage)
+		{
+			// Highest level index, bounding radius and compaction are specialization constants of the shader
+			struct SpecializationData {
+				int32_t maxLodLevel;
+				float boundingRadius;
+				VkBool32 compact;
+			} specializationData;
+			specializationData.maxLodLevel = static_cast<int32_t>(lodCount) - 1;
+			specializationData.boundingRadius = boundingRadius;
+			specializationData.compact = compact ? VK_TRUE : VK_FALSE;
+			const VkSpecializationMapEntry mapEntries[] = {
+				vks::initializers::specializationMapEntry(0, offsetof(SpecializationData, maxLodLevel), sizeof(int32_t)),
+				vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, boundingRadius), sizeof(float)),
+				vks::initializers::specializationMapEntry(2, offsetof(SpecializationData, compact), sizeof(VkBool32))
+			};
+			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(3, mapEntries, sizeof(specializationData), &specializationData);
+			shaderStage.pSpecializationInfo = &specializationInfo;
+
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout);
+			computePipelineCI.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &pipeline));
+		}
+	};
+}
@@ -13,12 +13,17 @@
 #include <exception>
 #include <assert.h>
 #include <algorithm>
+#include <memory>
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
 #include "VulkanBuffer.hpp"
+#include "VulkanMemoryAllocator.hpp"
 
 namespace vks
 {	
+	class UploadQueue;
+	class JobSystem;
+
 	struct VulkanDevice
 	{
 		/** @brief Physical device representation */
@@ -41,6 +46,15 @@ namespace vks
 		/** @brief Default command pool for the graphics queue family index */
 		VkCommandPool commandPool = VK_NULL_HANDLE;
 
+		/** @brief Sub-allocator that buffer and image memory is taken from (created along with the logical device) */
+		vks::MemoryAllocator *memoryAllocator = nullptr;
+
+		/** @brief Upload queue shared by the asset loaders (see vks::UploadQueue::getShared) */
+		std::shared_ptr<vks::UploadQueue> uploadQueue;
+
+		/** @brief (Optional) Job system the asset loaders use for CPU side processing, not owned by the device */
+		vks::JobSystem *jobSystem = nullptr;
+
 		/** @brief Set to true when the debug marker extension is detected */
 		bool enableDebugMarkers = false;
 
@@ -102,6 +116,10 @@ namespace vks
 		*/
 		~VulkanDevice()
 		{
+			// Pending uploads need to finish before their staging memory is released
+			uploadQueue.reset();
+			// All resources must have returned their allocations at this point
+			delete memoryAllocator;
 			if (commandPool)
 			{
 				vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
@@ -317,6 +335,7 @@ namespace vks
 			{
 				// Create a default command pool for graphics command buffers
 				commandPool = createCommandPool(queueFamilyIndices.graphics);
+				memoryAllocator = new vks::MemoryAllocator(logicalDevice, memoryProperties, properties.limits);
 			}
 
 			this->enabledFeatures = enabledFeatures;
@@ -331,47 +350,38 @@ namespace vks
 		* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
 		* @param size Size of the buffer in byes
 		* @param buffer Pointer to the buffer handle acquired by the function
-		* @param memory Pointer to the memory handle acquired by the function
+		* @param allocation Pointer to the memory allocation acquired by the function (sub-allocated from a shared memory block)
 		* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+		* @param strategy (Optional) Sub-allocation strategy, use linear for short lived buffers like staging buffers (Defaults to free list)
 		*
 		* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 		*/
-		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr)
+		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, vks::Allocation *allocation, void *data = nullptr, vks::AllocationStrategy strategy = vks::ALLOCATION_STRATEGY_FREE_LIST)
 		{
 			// Create the buffer handle
 			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
 
-			// Create the memory backing up the buffer handle
+			// Sub-allocate the memory backing up the buffer handle
 			VkMemoryRequirements memReqs;
-			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 			vkGetBufferMemoryRequirements(logicalDevice, *buffer, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			// Find a memory type index that fits the properties of the buffer
-			memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-			VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, memory));
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryPropertyFlags, allocation, vks::ALLOCATION_RESOURCE_LINEAR, strategy));
 			
-			// If a pointer to the buffer data has been passed, map the buffer and copy over the data
+			// If a pointer to the buffer data has been passed, copy over the data (host visible blocks are persistently mapped)
 			if (data != nullptr)
 			{
-				void *mapped;
-				VK_CHECK_RESULT(vkMapMemory(logicalDevice, *memory, 0, size, 0, &mapped));
-				memcpy(mapped, data, size);
+				assert(allocation->mapped);
+				memcpy(allocation->mapped, data, size);
 				// If host coherency hasn't been requested, do a manual flush to make writes visible
 				if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
 				{
-					VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-					mappedRange.memory = *memory;
-					mappedRange.offset = 0;
-					mappedRange.size = size;
-					vkFlushMappedMemoryRanges(logicalDevice, 1, &mappedRange);
+					allocation->flush(size);
 				}
-				vkUnmapMemory(logicalDevice, *memory);
 			}
 
 			// Attach the memory to the buffer object
-			VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, *buffer, *memory, 0));
+			VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, *buffer, allocation->memory, allocation->offset));
 
 			return VK_SUCCESS;
 		}
@@ -384,10 +394,11 @@ namespace vks
 		* @param buffer Pointer to a vk::Vulkan buffer object
 		* @param size Size of the buffer in byes
 		* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+		* @param strategy (Optional) Sub-allocation strategy, use linear for short lived buffers like staging buffers (Defaults to free list)
 		*
 		* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 		*/
-		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr)
+		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr, vks::AllocationStrategy strategy = vks::ALLOCATION_STRATEGY_FREE_LIST)
 		{
 			buffer->device = logicalDevice;
 
@@ -395,17 +406,13 @@ namespace vks
 			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-			// Create the memory backing up the buffer handle
+			// Sub-allocate the memory backing up the buffer handle
 			VkMemoryRequirements memReqs;
-			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 			vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			// Find a memory type index that fits the properties of the buffer
-			memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-			VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryPropertyFlags, &buffer->allocation, vks::ALLOCATION_RESOURCE_LINEAR, strategy));
 
 			buffer->alignment = memReqs.alignment;
-			buffer->size = memAlloc.allocationSize;
+			buffer->size = memReqs.size;
 			buffer->usageFlags = usageFlags;
 			buffer->memoryPropertyFlags = memoryPropertyFlags;
 
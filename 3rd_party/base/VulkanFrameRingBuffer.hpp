@@ -0,0 +1,194 @@
+/*
+* Persistently mapped per-frame ring allocator for uniform and storage data
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+	/**
+	* @brief One large host visible buffer split into a region per frame in flight, each region is bump-allocated
+	*
+	* Data is written straight into the persistently mapped memory and bound via dynamic offsets, so there is no map/unmap
+	* or copy per update. The region of a frame must only be reset (beginFrame) once the GPU has finished the last
+	* submission that read from it, e.g. after the fence of that frame has been waited on.
+	* For non-coherent memory, all allocations of a frame are made visible with a single flush of the used range.
+	*/
+	class FrameRingBuffer
+	{
+	public:
+		/** @brief Sub-allocation handed out for the current frame */
+		struct Allocation {
+			/** @brief Host pointer to write the data to */
+			void* data = nullptr;
+			/** @brief Byte offset from the start of the buffer, to be passed as dynamic offset */
+			uint32_t offset = 0;
+			VkDeviceSize size = 0;
+
+			template<typename T>
+			T* as() const
+			{
+				return static_cast<T*>(data);
+			}
+		};
+
+		vks::Buffer buffer;
+
+		/**
+		* Create the buffer
+		*
+		* @param device Device to create the buffer on
+		* @param sizePerFrame Bytes available to each frame (rounded up to the allocation alignment)
+		* @param frameCount Number of regions, usually the number of frames in flight or swap chain images
+		* @param usage (Optional) Usage flags of the buffer (Defaults to uniform buffer)
+		*/
+		void prepare(vks::VulkanDevice *device, VkDeviceSize sizePerFrame, uint32_t frameCount, VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		{
+			assert(frameCount > 0);
+			destroy();
+			this->frameCount = frameCount;
+
+			const VkPhysicalDeviceLimits &limits = device->properties.limits;
+			alignment = 16;
+			if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+				alignment = std::max(alignment, limits.minUniformBufferOffsetAlignment);
+			}
+			if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+				alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+			}
+			// Regions start on atom boundaries so flushing one frame never touches the range of another
+			frameSize = alignUp(sizePerFrame, std::max(alignment, std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1)));
+
+			VK_CHECK_RESULT(device->createBuffer(usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &buffer, frameSize * frameCount));
+			VK_CHECK_RESULT(buffer.map());
+			coherent = (device->memoryProperties.memoryTypes[buffer.allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+			beginFrame(0);
+		}
+
+		/** @brief Release the buffer */
+		void destroy()
+		{
+			buffer.unmap();
+			buffer.destroy();
+			frameCount = 0;
+			frameSize = 0;
+		}
+
+		/**
+		* Reset the bump pointer to the start of the region of a frame
+		*
+		* @note The GPU must no longer read the data that was allocated for this frame index before
+		*/
+		void beginFrame(uint32_t frameIndex)
+		{
+			assert(frameIndex < frameCount);
+			frameBegin = frameIndex * frameSize;
+			head = frameBegin;
+		}
+
+		/**
+		* Allocate a range of the current frame's region
+		*
+		* @param size Size of the allocation in bytes
+		* @param alignment (Optional) Alignment of the allocation, 0 uses the minimum offset alignment of the buffer usage
+		*
+		* @return Host pointer and buffer offset of the allocation
+		*/
+		Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0)
+		{
+			const VkDeviceSize offset = alignUp(head, std::max(alignment, this->alignment));
+			if (offset + size > frameBegin + frameSize) {
+				throw std::runtime_error("Frame ring buffer region of " + std::to_string(frameSize) + " bytes exhausted");
+			}
+			head = offset + size;
+			Allocation allocation;
+			allocation.data = static_cast<uint8_t*>(buffer.mapped) + offset;
+			allocation.offset = static_cast<uint32_t>(offset);
+			allocation.size = size;
+			return allocation;
+		}
+
+		/** @brief Allocate and fill a range of the current frame's region */
+		Allocation push(const void *data, VkDeviceSize size, VkDeviceSize alignment = 0)
+		{
+			Allocation allocation = allocate(size, alignment);
+			memcpy(allocation.data, data, size);
+			return allocation;
+		}
+
+		/**
+		* Make all allocations of the current frame visible to the device (one range covering the used part of the region)
+		*
+		* @note No-op for host coherent memory
+		*/
+		VkResult flush()
+		{
+			if (coherent || (head == frameBegin)) {
+				return VK_SUCCESS;
+			}
+			return buffer.flush(head - frameBegin, frameBegin);
+		}
+
+		/** @brief Byte offset of a frame's region from the start of the buffer */
+		VkDeviceSize getFrameOffset(uint32_t frameIndex) const
+		{
+			return frameIndex * frameSize;
+		}
+
+		/** @brief Bytes allocated in the current frame, including alignment padding */
+		VkDeviceSize getUsedSize() const
+		{
+			return head - frameBegin;
+		}
+
+		VkDeviceSize getFrameSize() const
+		{
+			return frameSize;
+		}
+
+		VkDeviceSize getAlignment() const
+		{
+			return alignment;
+		}
+
+		/**
+		* Descriptor for binding the buffer as dynamic uniform or storage buffer
+		*
+		* @param range Size of the data a single dynamic offset points to
+		*/
+		VkDescriptorBufferInfo getDescriptor(VkDeviceSize range) const
+		{
+			VkDescriptorBufferInfo descriptor{};
+			descriptor.buffer = buffer.buffer;
+			descriptor.offset = 0;
+			descriptor.range = range;
+			return descriptor;
+		}
+
+	private:
+		uint32_t frameCount = 0;
+		VkDeviceSize frameSize = 0;
+		VkDeviceSize alignment = 16;
+		VkDeviceSize frameBegin = 0;
+		VkDeviceSize head = 0;
+		bool coherent = true;
+
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	};
+}
@@ -0,0 +1,295 @@
+/*
+* GPU profiler using timestamp and pipeline statistics queries
+*
+* Named, nestable scopes are written into command buffers, results are read back without stalling
+* once the GPU has finished the command buffer (i.e. a few frames later)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <array>
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	class GpuProfiler
+	{
+	public:
+		/** @brief Pipeline statistics gathered for scopes that request them */
+		static const uint32_t statisticsCount = 5;
+		static const VkQueryPipelineStatisticFlags statisticsFlags =
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+		/** @brief Names of the pipeline statistics in the order they are returned (flag bit order) */
+		static const char* statisticName(uint32_t index)
+		{
+			static const char* names[statisticsCount] = { "IA vertices", "IA primitives", "VS invocations", "Clipping primitives", "FS invocations" };
+			return names[index];
+		}
+
+		/** @brief Timing of one scope */
+		struct ScopeResult {
+			std::string name;
+			/** @brief Nesting depth (0 = top level scope) */
+			uint32_t depth = 0;
+			/** @brief GPU time of the last frame that was read back (ms) */
+			double time = 0.0;
+			/** @brief Exponential moving average of the GPU time (ms), for display */
+			double averageTime = 0.0;
+			bool hasStatistics = false;
+			std::array<uint64_t, statisticsCount> statistics{};
+		};
+
+	private:
+		struct Scope {
+			std::string name;
+			uint32_t depth;
+			uint32_t beginQuery;
+			uint32_t endQuery;
+			// Index of the pipeline statistics query (UINT32_MAX if none)
+			uint32_t statisticsQuery;
+		};
+
+		// Query range and recorded scopes of one command buffer
+		// Command buffers are recorded once and resubmitted, so each one (e.g. per swap chain image) gets its own region of the query pools
+		struct Region {
+			std::vector<Scope> scopes;
+			std::vector<uint32_t> openScopes;
+			uint32_t queryCount = 0;
+			uint32_t statisticsQueryCount = 0;
+			bool statisticsActive = false;
+			// The command buffer has been submitted since it was recorded, its queries will become available
+			bool submitted = false;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkQueryPool timestampPool = VK_NULL_HANDLE;
+		VkQueryPool statisticsPool = VK_NULL_HANDLE;
+		uint32_t maxScopes = 0;
+		uint64_t timestampMask = 0;
+		double timestampPeriod = 1.0;
+		std::vector<Region> regions;
+		std::unordered_map<VkCommandBuffer, uint32_t> commandBufferRegions;
+		// Results of the last collected frame in recording order (also used for display)
+		std::vector<ScopeResult> results;
+
+		Region* getRegion(VkCommandBuffer commandBuffer)
+		{
+			auto it = commandBufferRegions.find(commandBuffer);
+			return (it != commandBufferRegions.end()) ? &regions[it->second] : nullptr;
+		}
+
+	public:
+		/** @brief Weight of the latest frame in the moving average shown in the UI */
+		double smoothing = 0.05;
+
+		/**
+		* Create the query pools
+		*
+		* @param device Vulkan device to create the query pools on
+		* @param regionCount Number of command buffers that are profiled independently (e.g. number of swap chain images)
+		* @param maxScopes Maximum number of scopes per command buffer
+		* @param pipelineStatistics Also create a pipeline statistics query pool (requires the pipelineStatisticsQuery feature to be enabled)
+		*
+		* @note Can be called again (e.g. after a swap chain resize) once the device is idle
+		*/
+		void prepare(vks::VulkanDevice *device, uint32_t regionCount, uint32_t maxScopes = 64, bool pipelineStatistics = false)
+		{
+			destroy();
+			this->device = device;
+			this->maxScopes = maxScopes;
+
+			// Timestamps are not supported on the graphics queue if no bits are valid
+			const uint32_t validBits = device->queueFamilyProperties[device->queueFamilyIndices.graphics].timestampValidBits;
+			if (validBits == 0) {
+				return;
+			}
+			timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+			timestampPeriod = device->properties.limits.timestampPeriod;
+
+			VkQueryPoolCreateInfo queryPoolCI{};
+			queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolCI.queryCount = regionCount * maxScopes * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolCI, nullptr, &timestampPool));
+
+			if (pipelineStatistics) {
+				queryPoolCI.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+				queryPoolCI.queryCount = regionCount * maxScopes;
+				queryPoolCI.pipelineStatistics = statisticsFlags;
+				VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolCI, nullptr, &statisticsPool));
+			}
+
+			regions.resize(regionCount);
+		}
+
+		void destroy()
+		{
+			if (timestampPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device->logicalDevice, timestampPool, nullptr);
+				timestampPool = VK_NULL_HANDLE;
+			}
+			if (statisticsPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device->logicalDevice, statisticsPool, nullptr);
+				statisticsPool = VK_NULL_HANDLE;
+			}
+			regions.clear();
+			commandBufferRegions.clear();
+			results.clear();
+		}
+
+		/** @brief Returns true if timestamps are supported and the profiler has been prepared */
+		bool isActive() const
+		{
+			return timestampPool != VK_NULL_HANDLE;
+		}
+
+		/**
+		* Start profiling a command buffer, must be called right after vkBeginCommandBuffer (outside of a render pass)
+		*
+		* @param commandBuffer Command buffer that scopes will be recorded into
+		* @param region Query region of the command buffer (e.g. swap chain image index)
+		*/
+		void beginCommandBuffer(VkCommandBuffer commandBuffer, uint32_t region)
+		{
+			if (!isActive() || (region >= regions.size())) {
+				return;
+			}
+			Region &r = regions[region];
+			r.scopes.clear();
+			r.openScopes.clear();
+			r.queryCount = 0;
+			r.statisticsQueryCount = 0;
+			r.statisticsActive = false;
+			r.submitted = false;
+			commandBufferRegions[commandBuffer] = region;
+			vkCmdResetQueryPool(commandBuffer, timestampPool, region * maxScopes * 2, maxScopes * 2);
+			if (statisticsPool != VK_NULL_HANDLE) {
+				vkCmdResetQueryPool(commandBuffer, statisticsPool, region * maxScopes, maxScopes);
+			}
+		}
+
+		/**
+		* Begin a named scope, scopes can be nested
+		*
+		* @param statistics Also gather pipeline statistics for this scope (ignored if the pool was not created or another statistics scope is open)
+		*
+		* @note A scope started inside a render pass subpass must be ended in the same subpass
+		* @note Scopes in command buffers that were not passed to beginCommandBuffer (e.g. secondary command buffers) are ignored
+		*/
+		void beginScope(VkCommandBuffer commandBuffer, const std::string &name, bool statistics = false)
+		{
+			Region *r = getRegion(commandBuffer);
+			if (!r || (r->scopes.size() >= maxScopes)) {
+				return;
+			}
+			const uint32_t region = static_cast<uint32_t>(r - regions.data());
+			Scope scope;
+			scope.name = name;
+			scope.depth = static_cast<uint32_t>(r->openScopes.size());
+			scope.beginQuery = region * maxScopes * 2 + r->queryCount++;
+			scope.endQuery = region * maxScopes * 2 + r->queryCount++;
+			scope.statisticsQuery = UINT32_MAX;
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, scope.beginQuery);
+			// Only one pipeline statistics query may be active at a time
+			if (statistics && (statisticsPool != VK_NULL_HANDLE) && !r->statisticsActive) {
+				scope.statisticsQuery = region * maxScopes + r->statisticsQueryCount++;
+				vkCmdBeginQuery(commandBuffer, statisticsPool, scope.statisticsQuery, 0);
+				r->statisticsActive = true;
+			}
+			r->openScopes.push_back(static_cast<uint32_t>(r->scopes.size()));
+			r->scopes.push_back(scope);
+		}
+
+		/** @brief End the innermost open scope */
+		void endScope(VkCommandBuffer commandBuffer)
+		{
+			Region *r = getRegion(commandBuffer);
+			if (!r || r->openScopes.empty()) {
+				return;
+			}
+			const Scope &scope = r->scopes[r->openScopes.back()];
+			r->openScopes.pop_back();
+			if (scope.statisticsQuery != UINT32_MAX) {
+				vkCmdEndQuery(commandBuffer, statisticsPool, scope.statisticsQuery);
+				r->statisticsActive = false;
+			}
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, scope.endQuery);
+		}
+
+		/** @brief Mark the command buffer of a region as submitted, its results are read by the next collect call for that region */
+		void submitted(uint32_t region)
+		{
+			if (region < regions.size()) {
+				regions[region].submitted = true;
+			}
+		}
+
+		/**
+		* Read back the results of a region without waiting, call once the last submission of its command buffer has finished
+		*
+		* @return True if new results are available (see getResults)
+		*/
+		bool collect(uint32_t region)
+		{
+			if (!isActive() || (region >= regions.size())) {
+				return false;
+			}
+			Region &r = regions[region];
+			if (!r.submitted || r.scopes.empty() || !r.openScopes.empty()) {
+				return false;
+			}
+			r.submitted = false;
+
+			std::vector<uint64_t> timestamps(r.queryCount);
+			if (vkGetQueryPoolResults(device->logicalDevice, timestampPool, region * maxScopes * 2, r.queryCount, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+				return false;
+			}
+			std::vector<uint64_t> statistics(r.statisticsQueryCount * statisticsCount);
+			if ((r.statisticsQueryCount > 0) && (vkGetQueryPoolResults(device->logicalDevice, statisticsPool, region * maxScopes, r.statisticsQueryCount, statistics.size() * sizeof(uint64_t), statistics.data(), statisticsCount * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)) {
+				return false;
+			}
+
+			// Keep the moving averages of scopes that were also present in the previous results
+			std::vector<ScopeResult> newResults(r.scopes.size());
+			for (size_t i = 0; i < r.scopes.size(); i++) {
+				const Scope &scope = r.scopes[i];
+				ScopeResult &result = newResults[i];
+				result.name = scope.name;
+				result.depth = scope.depth;
+				const uint32_t first = scope.beginQuery - region * maxScopes * 2;
+				const uint64_t ticks = (timestamps[first + 1] - timestamps[first]) & timestampMask;
+				result.time = (double)ticks * timestampPeriod / 1000000.0;
+				result.averageTime = result.time;
+				if ((i < results.size()) && (results[i].name == result.name) && (results[i].depth == result.depth)) {
+					result.averageTime = results[i].averageTime + (result.time - results[i].averageTime) * smoothing;
+				}
+				if (scope.statisticsQuery != UINT32_MAX) {
+					result.hasStatistics = true;
+					const uint32_t index = scope.statisticsQuery - region * maxScopes;
+					for (uint32_t s = 0; s < statisticsCount; s++) {
+						result.statistics[s] = statistics[index * statisticsCount + s];
+					}
+				}
+			}
+			results.swap(newResults);
+			return true;
+		}
+
+		/** @brief Results of the last collected frame in recording order */
+		const std::vector<ScopeResult>& getResults() const
+		{
+			return results;
+		}
+	};
+}
@@ -6,7 +6,7 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
-#include <glm/glm.hpp>
+#include <vector>
 #include <glm/glm.hpp>
 #include <gli/gli.hpp>
 
@@ -43,6 +43,8 @@ namespace vks
 		size_t vertexBufferSize = 0;
 		size_t indexBufferSize = 0;
 		uint32_t indexCount = 0;
+		/** @brief 16 bit indices for patches of up to 256 x 256 vertices */
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
 
 		HeightMap(vks::VulkanDevice *device, VkQueue copyQueue)
 		{
@@ -96,7 +98,7 @@ namespace vks
 
 			// Generate vertices
 
-			Vertex * vertices = new Vertex[patchsize * patchsize * 4];
+			Vertex * vertices = new Vertex[patchsize * patchsize];
 
 			const float wx = 2.0f;
 			const float wy = 2.0f;
@@ -188,7 +190,16 @@ namespace vks
 
 			assert(indexBufferSize > 0);
 
-			vertexBufferSize = (patchsize * patchsize * 4) * sizeof(Vertex);
+			indexType = (patchsize * patchsize <= 65536) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+			void *indexData = indices;
+			std::vector<uint16_t> indices16;
+			if (indexType == VK_INDEX_TYPE_UINT16) {
+				indices16.assign(indices, indices + indexCount);
+				indexData = indices16.data();
+				indexBufferSize = indexCount * sizeof(uint16_t);
+			}
+
+			vertexBufferSize = (patchsize * patchsize) * sizeof(Vertex);
 
 			// Generate Vulkan buffers
 
@@ -207,7 +218,7 @@ namespace vks
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 				&indexStaging,
 				indexBufferSize,
-				indices);
+				indexData);
 
 			// Device local (target) buffer
 			device->createBuffer(
@@ -245,10 +256,10 @@ namespace vks
 
 			device->flushCommandBuffer(copyCmd, copyQueue, true);
 
-			vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+			vertexStaging.destroy();
+			indexStaging.destroy();
+			delete[] vertices;
+			delete[] indices;
 		}
 	};
 }
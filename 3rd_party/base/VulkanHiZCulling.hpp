@@ -0,0 +1,601 @@
+/*
+* Two pass GPU occlusion culling against a hierarchical depth (Hi-Z) pyramid, writing indirect draw commands
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanUploadQueue.hpp"
+#include "VulkanFrameRingBuffer.hpp"
+#include "VulkanIndirectDraw.hpp"
+#include "frustum.hpp"
+
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/**
+	* @brief Culls objects against the view frustum and a depth pyramid on the GPU
+	*
+	* Each frame is split into an early and a late pass (data/shaders/hizcull):
+	* - recordEarly: frustum test, objects hidden in the pyramid of the previous frame are deferred, the others are drawn by drawEarly
+	* - recordLate (after the early draws): builds the pyramid from the depth attachment (depthreduce.comp) and tests the
+	*   deferred objects against it, objects that became visible (disoccluded) are drawn by drawLate
+	* The pyramid built in the late pass is the occluder of the next frame's early pass, so nothing is drawn twice and
+	* objects revealed by camera or scene motion are only delayed to the late pass, never missing from the image.
+	*
+	* Every object has one draw command in both indirect buffers, the shaders only set the instance count.
+	* The depth attachment must be created with VK_IMAGE_USAGE_SAMPLED_BIT (see VulkanExampleBase::depthStencilUsage)
+	* and be in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL when the late pass is recorded.
+	*/
+	class HiZCulling
+	{
+	public:
+		/** @brief Results of a frame's culling passes */
+		struct Statistics {
+			uint32_t objectCount = 0;
+			uint32_t frustumCulledCount = 0;
+			/** @brief Drawn in the early pass */
+			uint32_t earlyVisibleCount = 0;
+			/** @brief Occluded in the previous frame's pyramid but visible in the current one, drawn in the late pass */
+			uint32_t lateVisibleCount = 0;
+			/** @brief Inside the frustum but hidden in both passes */
+			uint32_t occludedCount = 0;
+
+			uint32_t visibleCount() const
+			{
+				return earlyVisibleCount + lateVisibleCount;
+			}
+		};
+
+		vks::IndirectDrawBuffer earlyDraws;
+		vks::IndirectDrawBuffer lateDraws;
+
+		/** @brief Test against the depth pyramid, if disabled objects are only frustum culled and everything is drawn in the early pass */
+		bool occlusionCulling = true;
+
+		/**
+		* Create buffers and compute pipelines
+		*
+		* @param cullStage Compute shader stage of the culling shader (hizcull/cull.comp)
+		* @param reduceStage Compute shader stage of the pyramid reduction shader (hizcull/depthreduce.comp)
+		* @param objects Bounding spheres (center xyz, radius w) of the objects in world space
+		* @param draws Draw command of each object, the instance count is written by the culling passes
+		* @param frameCount Number of frames that can be recorded and in flight at the same time
+		*
+		* @note Call setDepthAttachment before recording the first frame
+		*/
+		void prepare(vks::VulkanDevice *device, VkQueue queue, VkPipelineCache pipelineCache, VkPipelineShaderStageCreateInfo cullStage,
+			VkPipelineShaderStageCreateInfo reduceStage, const std::vector<glm::vec4> &objects, const std::vector<VkDrawIndexedIndirectCommand> &draws, uint32_t frameCount)
+		{
+			assert(!objects.empty() && (objects.size() == draws.size()) && (frameCount > 0));
+			this->device = device;
+			this->queue = queue;
+			this->frameCount = frameCount;
+			objectCount = static_cast<uint32_t>(objects.size());
+
+			earlyDraws.commands = draws;
+			lateDraws.commands = draws;
+			earlyDraws.upload(device, queue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+			lateDraws.upload(device, queue, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &objectBuffer, objects.size() * sizeof(glm::vec4)));
+			vks::UploadQueue *uploadQueue = vks::UploadQueue::getShared(device, queue);
+			uploadQueue->uploadBuffer(objectBuffer.buffer, objects.data(), objectBuffer.size, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			uploadQueue->flush();
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &stateBuffer, objects.size() * sizeof(uint32_t)));
+
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &statisticsBuffer, statisticsSize));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &readbackBuffer, statisticsSize * frameCount));
+			VK_CHECK_RESULT(readbackBuffer.map());
+			memset(readbackBuffer.mapped, 0, statisticsSize * frameCount);
+
+			uniformRing.prepare(device, sizeof(UniformData), frameCount);
+
+			VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+			samplerCI.magFilter = VK_FILTER_NEAREST;
+			samplerCI.minFilter = VK_FILTER_NEAREST;
+			samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.maxLod = VK_LOD_CLAMP_NONE;
+			samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+
+			prepareCullPipeline(pipelineCache, cullStage);
+			prepareReducePipeline(pipelineCache, reduceStage);
+		}
+
+		/**
+		* (Re)create the depth pyramid for a depth attachment, e.g. after the window has been resized
+		*
+		* @param image Depth stencil image the frame is rendered with
+		* @param format Format of the image, must support sampling
+		*
+		* @note The device must be idle (the previous pyramid is destroyed)
+		*/
+		void setDepthAttachment(VkImage image, VkFormat format, uint32_t width, uint32_t height)
+		{
+			assert(device);
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+			if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+				throw std::runtime_error("Depth format does not support sampling, which is required for the depth pyramid");
+			}
+			destroyPyramid();
+			depthImage = image;
+			depthExtent = { width, height };
+			// Stencil aspect has to be included in layout transitions of depth + stencil formats
+			depthAspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			if (format >= VK_FORMAT_D16_UNORM_S8_UINT) {
+				depthAspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+			}
+
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCI.image = image;
+			viewCI.format = format;
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &depthView));
+
+			// The first level is the largest power of two not above the attachment size, so each further level halves exactly
+			pyramidExtent = { previousPowerOfTwo(width), previousPowerOfTwo(height) };
+			pyramidLevels = 1;
+			while ((std::max(pyramidExtent.width, pyramidExtent.height) >> pyramidLevels) > 0) {
+				pyramidLevels++;
+			}
+
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = VK_FORMAT_R32_SFLOAT;
+			imageCI.extent = { pyramidExtent.width, pyramidExtent.height, 1 };
+			imageCI.mipLevels = pyramidLevels;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &pyramidImage));
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device->logicalDevice, pyramidImage, &memReqs);
+			VK_CHECK_RESULT(device->memoryAllocator->allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pyramidAllocation, vks::ALLOCATION_RESOURCE_OPTIMAL));
+			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, pyramidImage, pyramidAllocation.memory, pyramidAllocation.offset));
+
+			viewCI.image = pyramidImage;
+			viewCI.format = VK_FORMAT_R32_SFLOAT;
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &pyramidView));
+			pyramidLevelViews.resize(pyramidLevels);
+			for (uint32_t i = 0; i < pyramidLevels; i++) {
+				viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &pyramidLevelViews[i]));
+			}
+
+			// All levels stay in the general layout, they are written as storage images and read with texelFetch
+			VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			vks::tools::setImageLayout(commandBuffer, pyramidImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1 }, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			device->flushCommandBuffer(commandBuffer, queue);
+
+			prepareDescriptors();
+			pyramidValid = false;
+		}
+
+		/** @brief Release all resources */
+		void destroy()
+		{
+			if (!device) {
+				return;
+			}
+			destroyPyramid();
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+			vkDestroyPipeline(device->logicalDevice, cullPipeline, nullptr);
+			vkDestroyPipelineLayout(device->logicalDevice, cullPipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device->logicalDevice, cullSetLayout, nullptr);
+			vkDestroyPipeline(device->logicalDevice, reducePipeline, nullptr);
+			vkDestroyPipelineLayout(device->logicalDevice, reducePipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device->logicalDevice, reduceSetLayout, nullptr);
+			objectBuffer.destroy();
+			stateBuffer.destroy();
+			earlyDraws.destroy();
+			lateDraws.destroy();
+			statisticsBuffer.destroy();
+			readbackBuffer.destroy();
+			uniformRing.destroy();
+			device = nullptr;
+		}
+
+		/**
+		* Set the camera of a frame, must be the camera the frame is rendered with (the pyramid is built from its depth)
+		*
+		* @note The data of the previous use of this frame index must no longer be in use by the device
+		*/
+		void update(uint32_t frameIndex, const glm::mat4 &projection, const glm::mat4 &view)
+		{
+			frameOcclusion = occlusionCulling;
+			frameViewProjection = projection * view;
+
+			UniformData uniformData;
+			uniformData.viewProjection = frameViewProjection;
+			uniformData.previousViewProjection = pyramidViewProjection;
+			vks::Frustum frustum;
+			frustum.update(frameViewProjection);
+			for (size_t i = 0; i < frustum.planes.size(); i++) {
+				uniformData.frustumPlanes[i] = frustum.planes[i];
+			}
+			uniformData.pyramidSize = glm::vec2((float)pyramidExtent.width, (float)pyramidExtent.height);
+			uniformData.pyramidLevels = pyramidLevels;
+			uniformData.objectCount = objectCount;
+			uniformData.previousPyramidValid = pyramidValid ? 1 : 0;
+			uniformData.occlusionEnabled = frameOcclusion ? 1 : 0;
+			uniformRing.beginFrame(frameIndex);
+			uniformRing.push(&uniformData, sizeof(uniformData));
+			VK_CHECK_RESULT(uniformRing.flush());
+		}
+
+		/**
+		* Record the early culling pass, must be recorded outside of a render pass before drawEarly
+		*/
+		void recordEarly(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+		{
+			assert((frameIndex < frameCount) && (pyramidImage != VK_NULL_HANDLE));
+
+			// Draw commands, object states, counters and the pyramid of the previous frame must have been consumed and written before they are used again
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdFillBuffer(commandBuffer, statisticsBuffer.buffer, 0, statisticsSize, 0);
+			bufferBarrier(commandBuffer, statisticsBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+			dispatchCull(commandBuffer, frameIndex, 0);
+
+			bufferBarrier(commandBuffer, earlyDraws.buffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+		}
+
+		/** @brief Draw the objects that passed the early pass (pipeline, vertex and index buffers have to be bound) */
+		void drawEarly(VkCommandBuffer commandBuffer) const
+		{
+			earlyDraws.draw(commandBuffer, 0, objectCount);
+		}
+
+		/**
+		* Record the pyramid reduction and the late culling pass, must be recorded outside of a render pass after the early objects
+		* have been drawn and before drawLate. Also copies the frame's statistics for getStatistics.
+		*
+		* @note The depth attachment has to be in the depth stencil attachment layout and is returned to it
+		*/
+		void recordLate(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+		{
+			assert(frameIndex < frameCount);
+
+			if (frameOcclusion) {
+				depthBarrier(commandBuffer, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+				// The early pass read the pyramid that is overwritten now
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+				// Each level is reduced from the previous one (the first from the depth attachment)
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline);
+				VkExtent2D inputExtent = depthExtent;
+				for (uint32_t i = 0; i < pyramidLevels; i++) {
+					const VkExtent2D outputExtent = { std::max(pyramidExtent.width >> i, 1u), std::max(pyramidExtent.height >> i, 1u) };
+					const int32_t sizes[4] = { (int32_t)inputExtent.width, (int32_t)inputExtent.height, (int32_t)outputExtent.width, (int32_t)outputExtent.height };
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipelineLayout, 0, 1, &reduceDescriptorSets[i], 0, nullptr);
+					vkCmdPushConstants(commandBuffer, reducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), sizes);
+					vkCmdDispatch(commandBuffer, (outputExtent.width + reduceGroupSize - 1) / reduceGroupSize, (outputExtent.height + reduceGroupSize - 1) / reduceGroupSize, 1);
+					vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+					inputExtent = outputExtent;
+				}
+
+				depthBarrier(commandBuffer, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+					VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+				pyramidViewProjection = frameViewProjection;
+				pyramidValid = true;
+
+				dispatchCull(commandBuffer, frameIndex, 1);
+				bufferBarrier(commandBuffer, lateDraws.buffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+			} else {
+				// The pyramid is not updated while occlusion culling is disabled
+				pyramidValid = false;
+			}
+
+			bufferBarrier(commandBuffer, statisticsBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			VkBufferCopy copyRegion{ 0, frameIndex * statisticsSize, statisticsSize };
+			vkCmdCopyBuffer(commandBuffer, statisticsBuffer.buffer, readbackBuffer.buffer, 1, &copyRegion);
+			bufferBarrier(commandBuffer, readbackBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+		}
+
+		/** @brief Draw the objects that were disoccluded in the late pass, nothing is drawn if occlusion culling was disabled for the frame */
+		void drawLate(VkCommandBuffer commandBuffer) const
+		{
+			if (frameOcclusion) {
+				lateDraws.draw(commandBuffer, 0, objectCount);
+			}
+		}
+
+		/** @brief True if the current frame (last update) uses the late pass */
+		bool isOcclusionFrame() const
+		{
+			return frameOcclusion;
+		}
+
+		/**
+		* Results of the last culling passes recorded for a frame index
+		*
+		* @note Only valid once the device has finished that frame (e.g. after waiting on its fence)
+		*/
+		Statistics getStatistics(uint32_t frameIndex)
+		{
+			assert(frameIndex < frameCount);
+			readbackBuffer.allocation.invalidate(statisticsSize, frameIndex * statisticsSize);
+			const uint32_t *counters = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(readbackBuffer.mapped) + frameIndex * statisticsSize);
+			Statistics statistics;
+			statistics.objectCount = objectCount;
+			statistics.frustumCulledCount = counters[0];
+			statistics.earlyVisibleCount = counters[1];
+			statistics.lateVisibleCount = counters[2];
+			statistics.occludedCount = counters[3];
+			return statistics;
+		}
+
+		uint32_t getObjectCount() const
+		{
+			return objectCount;
+		}
+
+	private:
+		static const uint32_t cullGroupSize = 64;
+		static const uint32_t reduceGroupSize = 8;
+		/** @brief Frustum culled, early visible, late visible and occluded counters */
+		static const VkDeviceSize statisticsSize = 4 * sizeof(uint32_t);
+
+		/** @brief Uniform block of the culling shader */
+		struct UniformData {
+			glm::mat4 viewProjection;
+			glm::mat4 previousViewProjection;
+			glm::vec4 frustumPlanes[6];
+			glm::vec2 pyramidSize;
+			uint32_t pyramidLevels;
+			uint32_t objectCount;
+			uint32_t previousPyramidValid;
+			uint32_t occlusionEnabled;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		uint32_t frameCount = 0;
+		uint32_t objectCount = 0;
+
+		vks::Buffer objectBuffer;
+		vks::Buffer stateBuffer;
+		vks::Buffer statisticsBuffer;
+		vks::Buffer readbackBuffer;
+		vks::FrameRingBuffer uniformRing;
+
+		VkImage depthImage = VK_NULL_HANDLE;
+		VkImageView depthView = VK_NULL_HANDLE;
+		VkImageAspectFlags depthAspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		VkExtent2D depthExtent = { 0, 0 };
+
+		VkImage pyramidImage = VK_NULL_HANDLE;
+		vks::Allocation pyramidAllocation;
+		VkImageView pyramidView = VK_NULL_HANDLE;
+		std::vector<VkImageView> pyramidLevelViews;
+		VkExtent2D pyramidExtent = { 1, 1 };
+		uint32_t pyramidLevels = 1;
+		VkSampler sampler = VK_NULL_HANDLE;
+		/** @brief Camera the pyramid was built with and whether it holds the depth of the last frame */
+		glm::mat4 pyramidViewProjection = glm::mat4(1.0f);
+		bool pyramidValid = false;
+
+		glm::mat4 frameViewProjection = glm::mat4(1.0f);
+		bool frameOcclusion = false;
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline cullPipeline = VK_NULL_HANDLE;
+		VkDescriptorSetLayout reduceSetLayout = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> reduceDescriptorSets;
+		VkPipelineLayout reducePipelineLayout = VK_NULL_HANDLE;
+		VkPipeline reducePipeline = VK_NULL_HANDLE;
+
+		static uint32_t previousPowerOfTwo(uint32_t value)
+		{
+			uint32_t result = 1;
+			while ((result << 1) <= value) {
+				result <<= 1;
+			}
+			return result;
+		}
+
+		static void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+			VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+		{
+			VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.buffer = buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+
+		void depthBarrier(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+			VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+		{
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.image = depthImage;
+			barrier.subresourceRange = { depthAspectMask, 0, 1, 0, 1 };
+			vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		void dispatchCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t pass)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+			// The uniform data is the only allocation in the frame's region
+			const uint32_t uniformOffset = static_cast<uint32_t>(uniformRing.getFrameOffset(frameIndex));
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSet, 1, &uniformOffset);
+			vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &pass);
+			vkCmdDispatch(commandBuffer, (objectCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+		}
+
+		void destroyPyramid()
+		{
+			if (descriptorPool != VK_NULL_HANDLE) {
+				vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+				descriptorPool = VK_NULL_HANDLE;
+			}
+			for (VkImageView view : pyramidLevelViews) {
+				vkDestroyImageView(device->logicalDevice, view, nullptr);
+			}
+			pyramidLevelViews.clear();
+			vkDestroyImageView(device->logicalDevice, pyramidView, nullptr);
+			vkDestroyImage(device->logicalDevice, pyramidImage, nullptr);
+			if (pyramidImage != VK_NULL_HANDLE) {
+				pyramidAllocation.free();
+			}
+			vkDestroyImageView(device->logicalDevice, depthView, nullptr);
+			pyramidView = VK_NULL_HANDLE;
+			pyramidImage = VK_NULL_HANDLE;
+			depthView = VK_NULL_HANDLE;
+		}
+
+		void prepareCullPipeline(VkPipelineCache pipelineCache, const VkPipelineShaderStageCreateInfo &shaderStage)
+		{
+			using namespace vks::initializers;
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 6)
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &cullSetLayout));
+			// Pass index
+			VkPushConstantRange pushConstant = pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = pipelineLayoutCreateInfo(&cullSetLayout);
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstant;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &cullPipelineLayout));
+
+			VkComputePipelineCreateInfo computePipelineCI = computePipelineCreateInfo(cullPipelineLayout);
+			computePipelineCI.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &cullPipeline));
+		}
+
+		void prepareReducePipeline(VkPipelineCache pipelineCache, const VkPipelineShaderStageCreateInfo &shaderStage)
+		{
+			using namespace vks::initializers;
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &reduceSetLayout));
+			// Input and output sizes
+			VkPushConstantRange pushConstant = pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 4 * sizeof(int32_t), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = pipelineLayoutCreateInfo(&reduceSetLayout);
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstant;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &reducePipelineLayout));
+
+			VkComputePipelineCreateInfo computePipelineCI = computePipelineCreateInfo(reducePipelineLayout);
+			computePipelineCI.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &reducePipeline));
+		}
+
+		// Descriptors reference the pyramid views, so they are recreated along with the pyramid
+		void prepareDescriptors()
+		{
+			using namespace vks::initializers;
+
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
+				descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
+				descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + pyramidLevels),
+				descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, pyramidLevels)
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolCI = descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1 + pyramidLevels);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+			VkDescriptorSetAllocateInfo allocInfo = descriptorSetAllocateInfo(descriptorPool, &cullSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &cullDescriptorSet));
+
+			VkDescriptorBufferInfo objectDescriptor = { objectBuffer.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo earlyDrawDescriptor = { earlyDraws.buffer.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo lateDrawDescriptor = { lateDraws.buffer.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo uniformDescriptor = uniformRing.getDescriptor(sizeof(UniformData));
+			VkDescriptorBufferInfo statisticsDescriptor = { statisticsBuffer.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo stateDescriptor = { stateBuffer.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorImageInfo pyramidDescriptor = descriptorImageInfo(sampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &objectDescriptor),
+				writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &earlyDrawDescriptor),
+				writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &lateDrawDescriptor),
+				writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 3, &uniformDescriptor),
+				writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &statisticsDescriptor),
+				writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &stateDescriptor),
+				writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &pyramidDescriptor)
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			// One set per level: the depth attachment or the previous level as input, the level as output
+			std::vector<VkDescriptorSetLayout> reduceSetLayouts(pyramidLevels, reduceSetLayout);
+			reduceDescriptorSets.resize(pyramidLevels);
+			allocInfo = descriptorSetAllocateInfo(descriptorPool, reduceSetLayouts.data(), pyramidLevels);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, reduceDescriptorSets.data()));
+			for (uint32_t i = 0; i < pyramidLevels; i++) {
+				VkDescriptorImageInfo inputDescriptor = (i == 0) ?
+					descriptorImageInfo(sampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) :
+					descriptorImageInfo(sampler, pyramidLevelViews[i - 1], VK_IMAGE_LAYOUT_GENERAL);
+				VkDescriptorImageInfo outputDescriptor = descriptorImageInfo(VK_NULL_HANDLE, pyramidLevelViews[i], VK_IMAGE_LAYOUT_GENERAL);
+				VkWriteDescriptorSet levelWrites[2] = {
+					writeDescriptorSet(reduceDescriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &inputDescriptor),
+					writeDescriptorSet(reduceDescriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &outputDescriptor)
+				};
+				vkUpdateDescriptorSets(device->logicalDevice, 2, levelWrites, 0, nullptr);
+			}
+		}
+	};
+}
@@ -0,0 +1,133 @@
+/*
+* Indirect draw command buffers for submitting many indexed draws with a single command
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanUploadQueue.hpp"
+
+namespace vks
+{
+	/**
+	* @brief List of indexed draw commands stored in a device local indirect buffer
+	*
+	* With the multiDrawIndirect feature enabled all commands are submitted with a single vkCmdDrawIndexedIndirect,
+	* so recording cost no longer depends on the number of draws. Without it, one indirect draw per command is recorded.
+	*
+	* Per-draw data (matrices, materials) can be indexed by setting firstInstance to the draw index: the value offsets
+	* gl_InstanceIndex and instance rate vertex bindings. A non-zero firstInstance requires the drawIndirectFirstInstance feature.
+	*/
+	class IndirectDrawBuffer
+	{
+	public:
+		/** @brief Commands as filled on the host, uploaded by upload() */
+		std::vector<VkDrawIndexedIndirectCommand> commands;
+		vks::Buffer buffer;
+
+		/**
+		* Append an indexed draw command
+		*
+		* @return Index of the draw (e.g. to be used as firstInstance of a later command)
+		*/
+		uint32_t add(uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset = 0, uint32_t instanceCount = 1, uint32_t firstInstance = 0)
+		{
+			VkDrawIndexedIndirectCommand command{};
+			command.indexCount = indexCount;
+			command.instanceCount = instanceCount;
+			command.firstIndex = firstIndex;
+			command.vertexOffset = vertexOffset;
+			command.firstInstance = firstInstance;
+			commands.push_back(command);
+			return static_cast<uint32_t>(commands.size() - 1);
+		}
+
+		void clear()
+		{
+			commands.clear();
+		}
+
+		uint32_t size() const
+		{
+			return static_cast<uint32_t>(commands.size());
+		}
+
+		/**
+		* Copy the commands to the device local indirect buffer (the buffer is (re)created if it is too small)
+		*
+		* @param device Device to create the buffer on
+		* @param queue Queue used for the upload
+		* @param usage (Optional) Additional usage flags, e.g. storage buffer for commands written by compute shaders
+		*
+		* @note The buffer must not be in use by the device when the commands are uploaded again
+		*/
+		void upload(vks::VulkanDevice *device, VkQueue queue, VkBufferUsageFlags usage = 0)
+		{
+			assert(!commands.empty());
+			this->device = device;
+			const VkDeviceSize bufferSize = commands.size() * sizeof(VkDrawIndexedIndirectCommand);
+			if ((buffer.buffer == VK_NULL_HANDLE) || (buffer.size < bufferSize) || ((bufferUsage & usage) != usage)) {
+				buffer.destroy();
+				bufferUsage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage;
+				VK_CHECK_RESULT(device->createBuffer(bufferUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, bufferSize));
+			}
+			vks::UploadQueue *uploadQueue = vks::UploadQueue::getShared(device, queue);
+			uploadQueue->uploadBuffer(buffer.buffer, commands.data(), bufferSize, 0, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+			uploadQueue->flush();
+			uploadedCount = static_cast<uint32_t>(commands.size());
+		}
+
+		/** @brief True if all commands are submitted with one call (multiDrawIndirect enabled) */
+		bool isMultiDraw() const
+		{
+			return (device != nullptr) && device->enabledFeatures.multiDrawIndirect;
+		}
+
+		/**
+		* Record the uploaded draw commands (pipeline, vertex and index buffers have to be bound)
+		*
+		* @param firstDraw (Optional) Index of the first command to draw
+		* @param drawCount (Optional) Number of commands to draw, defaults to all uploaded commands
+		*/
+		void draw(VkCommandBuffer commandBuffer, uint32_t firstDraw = 0, uint32_t drawCount = UINT32_MAX) const
+		{
+			assert(buffer.buffer != VK_NULL_HANDLE);
+			drawCount = std::min(drawCount, uploadedCount - std::min(firstDraw, uploadedCount));
+			const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+			if (isMultiDraw()) {
+				// The draw count of a single call is limited by the implementation
+				const uint32_t maxDrawCount = std::max(device->properties.limits.maxDrawIndirectCount, 1u);
+				for (uint32_t first = firstDraw; first < firstDraw + drawCount; first += maxDrawCount) {
+					const uint32_t count = std::min(maxDrawCount, firstDraw + drawCount - first);
+					vkCmdDrawIndexedIndirect(commandBuffer, buffer.buffer, first * stride, count, stride);
+				}
+			} else {
+				for (uint32_t i = firstDraw; i < firstDraw + drawCount; i++) {
+					vkCmdDrawIndexedIndirect(commandBuffer, buffer.buffer, i * stride, 1, stride);
+				}
+			}
+		}
+
+		/** @brief Release the buffer, commands are kept */
+		void destroy()
+		{
+			buffer.destroy();
+			uploadedCount = 0;
+			bufferUsage = 0;
+		}
+
+	private:
+		vks::VulkanDevice *device = nullptr;
+		VkBufferUsageFlags bufferUsage = 0;
+		uint32_t uploadedCount = 0;
+	};
+}
@@ -0,0 +1,509 @@
+/*
+* Vulkan device memory sub-allocator
+*
+* Hands out ranges of a few large VkDeviceMemory blocks per memory type instead of
+* calling vkAllocateMemory for every buffer and image
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	class MemoryAllocator;
+
+	/** @brief Sub-allocation strategy of a memory block */
+	typedef enum AllocationStrategy {
+		/** @brief First fit free list, freed ranges are merged with their free neighbours */
+		ALLOCATION_STRATEGY_FREE_LIST = 0x0,
+		/** @brief Bump allocation, a block is only reclaimed once all of its allocations have been freed (for short lived data like staging buffers) */
+		ALLOCATION_STRATEGY_LINEAR = 0x1
+	} AllocationStrategy;
+
+	/**
+	* @brief Kind of resource that is bound to an allocation
+	* @note Linear and optimal resources never share a block, so neighbouring allocations can't violate bufferImageGranularity
+	*/
+	typedef enum AllocationResourceType {
+		/** @brief Buffers and linear tiled images */
+		ALLOCATION_RESOURCE_LINEAR = 0x0,
+		/** @brief Optimal tiled images */
+		ALLOCATION_RESOURCE_OPTIMAL = 0x1
+	} AllocationResourceType;
+
+	/** @brief Range of a device memory block handed out by the memory allocator */
+	struct Allocation
+	{
+		/** @brief Device memory block the allocation lives in (shared with other allocations) */
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		/** @brief Byte offset of the allocation inside the memory block, to be passed to vkBind*Memory */
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		/** @brief Host pointer to the start of the allocation (only set for host visible memory, blocks stay mapped persistently) */
+		void* mapped = nullptr;
+		MemoryAllocator* allocator = nullptr;
+		/** @brief Owning block, internal to the allocator */
+		void* block = nullptr;
+
+		/** @brief Return the range to the allocator it came from */
+		void free();
+		/**
+		* Flush a range of the allocation to make host writes visible to the device
+		*
+		* @note Only required for non-coherent memory
+		*
+		* @param size (Optional) Size of the range to flush. Pass VK_WHOLE_SIZE to flush the complete allocation.
+		* @param offset (Optional) Byte offset from the beginning of the allocation
+		*/
+		VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		/**
+		* Invalidate a range of the allocation to make device writes visible to the host
+		*
+		* @note Only required for non-coherent memory
+		*
+		* @param size (Optional) Size of the range to invalidate. Pass VK_WHOLE_SIZE to invalidate the complete allocation.
+		* @param offset (Optional) Byte offset from the beginning of the allocation
+		*/
+		VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+	};
+
+	/**
+	* @brief Block based device memory allocator
+	*
+	* Keeps a list of large VkDeviceMemory blocks per memory type and sub-allocates buffers and images from them.
+	* Allocations bigger than half of a block get a dedicated block of their own.
+	* Host visible blocks are mapped once at creation and stay mapped until they are released.
+	*/
+	class MemoryAllocator
+	{
+	public:
+		/** @brief Statistics for a single memory heap */
+		struct HeapStats {
+			/** @brief Number of VkDeviceMemory blocks allocated from this heap */
+			uint32_t blockCount = 0;
+			/** @brief Number of live sub-allocations */
+			uint32_t allocationCount = 0;
+			/** @brief Bytes allocated from the driver */
+			VkDeviceSize blockBytes = 0;
+			/** @brief Bytes handed out to resources (including alignment padding) */
+			VkDeviceSize usedBytes = 0;
+		};
+
+		struct Stats {
+			uint32_t blockCount = 0;
+			uint32_t allocationCount = 0;
+			VkDeviceSize blockBytes = 0;
+			VkDeviceSize usedBytes = 0;
+			/** @brief 1 - (largest free range / total free bytes) over all free list blocks, 0 means no fragmentation */
+			float fragmentation = 0.0f;
+			std::vector<HeapStats> heaps;
+		};
+
+		/** @brief Size of newly created blocks (clamped to 1/8th of the heap size for small heaps) */
+		VkDeviceSize preferredBlockSize = 64 * 1024 * 1024;
+
+		MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const VkPhysicalDeviceLimits &limits)
+		{
+			this->device = device;
+			this->memoryProperties = memoryProperties;
+			this->nonCoherentAtomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+		}
+
+		~MemoryAllocator()
+		{
+			for (auto& block : blocks)
+			{
+				releaseBlock(*block);
+			}
+		}
+
+		/**
+		* Sub-allocate device memory for a resource
+		*
+		* @param memReqs Memory requirements of the resource (size, alignment, memory type bits)
+		* @param memoryPropertyFlags Memory properties the memory type has to support
+		* @param allocation Pointer to the allocation that is filled on success
+		* @param resourceType (Optional) Type of resource the memory is bound to (Defaults to buffers and linear images)
+		* @param strategy (Optional) Sub-allocation strategy of the block to allocate from (Defaults to free list)
+		*
+		* @return VK_SUCCESS or the error of the failed vkAllocateMemory/vkMapMemory call
+		*/
+		VkResult allocate(const VkMemoryRequirements &memReqs, VkMemoryPropertyFlags memoryPropertyFlags, Allocation *allocation, AllocationResourceType resourceType = ALLOCATION_RESOURCE_LINEAR, AllocationStrategy strategy = ALLOCATION_STRATEGY_FREE_LIST)
+		{
+			assert(allocation);
+			uint32_t memoryTypeIndex;
+			if (!findMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags, &memoryTypeIndex))
+			{
+				return VK_ERROR_FEATURE_NOT_PRESENT;
+			}
+
+			VkDeviceSize alignment = std::max<VkDeviceSize>(memReqs.alignment, 1);
+			VkDeviceSize size = memReqs.size;
+			// Keep allocations of non-coherent memory on atom boundaries so flushing one never touches a neighbour
+			if (!isCoherent(memoryTypeIndex))
+			{
+				alignment = std::max(alignment, nonCoherentAtomSize);
+				size = alignUp(size, nonCoherentAtomSize);
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+			if (size > blockSize / 2)
+			{
+				Block *block = nullptr;
+				VkResult result = createBlock(memoryTypeIndex, size, resourceType, strategy, true, &block);
+				if (result != VK_SUCCESS)
+				{
+					return result;
+				}
+				block->freeRanges.clear();
+				commit(*block, 0, size, allocation);
+				return VK_SUCCESS;
+			}
+
+			for (auto& block : blocks)
+			{
+				if (block->dedicated || (block->memoryTypeIndex != memoryTypeIndex) || (block->resourceType != resourceType) || (block->strategy != strategy))
+				{
+					continue;
+				}
+				VkDeviceSize offset;
+				if (findRange(*block, size, alignment, &offset))
+				{
+					commit(*block, offset, size, allocation);
+					return VK_SUCCESS;
+				}
+			}
+
+			Block *block = nullptr;
+			VkResult result = createBlock(memoryTypeIndex, blockSize, resourceType, strategy, false, &block);
+			if (result != VK_SUCCESS)
+			{
+				return result;
+			}
+			VkDeviceSize offset;
+			bool found = findRange(*block, size, alignment, &offset);
+			assert(found);
+			commit(*block, offset, size, allocation);
+			return VK_SUCCESS;
+		}
+
+		/** @brief Return an allocation to its block, blocks that become empty are released (one spare block per kind is kept) */
+		void free(Allocation &allocation)
+		{
+			if (allocation.block == nullptr)
+			{
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Block *block = static_cast<Block*>(allocation.block);
+			block->allocationCount--;
+			block->usedBytes -= allocation.size;
+			if (block->strategy == ALLOCATION_STRATEGY_FREE_LIST)
+			{
+				insertFreeRange(*block, { allocation.offset, allocation.size });
+			}
+			if (block->allocationCount == 0)
+			{
+				block->linearOffset = 0;
+				if (block->dedicated || hasSpareBlock(*block))
+				{
+					auto it = std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<Block> &b) { return b.get() == block; });
+					releaseBlock(*block);
+					blocks.erase(it);
+				}
+			}
+			allocation = {};
+		}
+
+		/** @brief Flush a (sub) range of an allocation, offset and size are expanded to nonCoherentAtomSize */
+		VkResult flush(const Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
+		{
+			VkMappedMemoryRange mappedRange = getMappedRange(allocation, size, offset);
+			return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
+		}
+
+		/** @brief Invalidate a (sub) range of an allocation, offset and size are expanded to nonCoherentAtomSize */
+		VkResult invalidate(const Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
+		{
+			VkMappedMemoryRange mappedRange = getMappedRange(allocation, size, offset);
+			return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
+		}
+
+		/** @brief Gather live allocation, block and fragmentation statistics for all heaps */
+		Stats getStats()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			Stats stats;
+			stats.heaps.resize(memoryProperties.memoryHeapCount);
+			VkDeviceSize totalFree = 0;
+			VkDeviceSize largestFree = 0;
+			for (auto& block : blocks)
+			{
+				HeapStats &heap = stats.heaps[memoryProperties.memoryTypes[block->memoryTypeIndex].heapIndex];
+				heap.blockCount++;
+				heap.allocationCount += block->allocationCount;
+				heap.blockBytes += block->size;
+				heap.usedBytes += block->usedBytes;
+				if (block->strategy == ALLOCATION_STRATEGY_FREE_LIST)
+				{
+					for (auto& range : block->freeRanges)
+					{
+						totalFree += range.size;
+						largestFree = std::max(largestFree, range.size);
+					}
+				}
+			}
+			for (auto& heap : stats.heaps)
+			{
+				stats.blockCount += heap.blockCount;
+				stats.allocationCount += heap.allocationCount;
+				stats.blockBytes += heap.blockBytes;
+				stats.usedBytes += heap.usedBytes;
+			}
+			if (totalFree > 0)
+			{
+				stats.fragmentation = 1.0f - (float)largestFree / (float)totalFree;
+			}
+			return stats;
+		}
+
+	private:
+		struct Range {
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		struct Block {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeIndex = 0;
+			AllocationResourceType resourceType = ALLOCATION_RESOURCE_LINEAR;
+			AllocationStrategy strategy = ALLOCATION_STRATEGY_FREE_LIST;
+			bool dedicated = false;
+			void* mapped = nullptr;
+			/** @brief Free ranges sorted by offset (free list strategy only) */
+			std::vector<Range> freeRanges;
+			/** @brief Next free offset (linear strategy only) */
+			VkDeviceSize linearOffset = 0;
+			uint32_t allocationCount = 0;
+			VkDeviceSize usedBytes = 0;
+		};
+
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize nonCoherentAtomSize;
+		std::vector<std::unique_ptr<Block>> blocks;
+		std::mutex mutex;
+
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		bool findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t *memoryTypeIndex)
+		{
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+			{
+				if ((typeBits & (1u << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+				{
+					*memoryTypeIndex = i;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool isCoherent(uint32_t memoryTypeIndex)
+		{
+			return (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+		}
+
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex)
+		{
+			VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+			return std::min(preferredBlockSize, alignUp(heapSize / 8, 1024 * 1024));
+		}
+
+		VkResult createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, AllocationResourceType resourceType, AllocationStrategy strategy, bool dedicated, Block **block)
+		{
+			std::unique_ptr<Block> newBlock(new Block());
+			VkMemoryAllocateInfo memAlloc{};
+			memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			memAlloc.allocationSize = size;
+			memAlloc.memoryTypeIndex = memoryTypeIndex;
+			VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, &newBlock->memory);
+			if (result != VK_SUCCESS)
+			{
+				return result;
+			}
+			if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+			{
+				result = vkMapMemory(device, newBlock->memory, 0, VK_WHOLE_SIZE, 0, &newBlock->mapped);
+				if (result != VK_SUCCESS)
+				{
+					vkFreeMemory(device, newBlock->memory, nullptr);
+					return result;
+				}
+			}
+			newBlock->size = size;
+			newBlock->memoryTypeIndex = memoryTypeIndex;
+			newBlock->resourceType = resourceType;
+			newBlock->strategy = strategy;
+			newBlock->dedicated = dedicated;
+			if (strategy == ALLOCATION_STRATEGY_FREE_LIST)
+			{
+				newBlock->freeRanges.push_back({ 0, size });
+			}
+			*block = newBlock.get();
+			blocks.push_back(std::move(newBlock));
+			return VK_SUCCESS;
+		}
+
+		void releaseBlock(Block &block)
+		{
+			if (block.mapped)
+			{
+				vkUnmapMemory(device, block.memory);
+			}
+			vkFreeMemory(device, block.memory, nullptr);
+		}
+
+		bool hasSpareBlock(const Block &block)
+		{
+			for (auto& other : blocks)
+			{
+				if ((other.get() != &block) && !other->dedicated && (other->allocationCount == 0) && (other->memoryTypeIndex == block.memoryTypeIndex) && (other->resourceType == block.resourceType) && (other->strategy == block.strategy))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool findRange(Block &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+		{
+			if (block.strategy == ALLOCATION_STRATEGY_LINEAR)
+			{
+				VkDeviceSize alignedOffset = alignUp(block.linearOffset, alignment);
+				if (alignedOffset + size > block.size)
+				{
+					return false;
+				}
+				block.linearOffset = alignedOffset + size;
+				*offset = alignedOffset;
+				return true;
+			}
+
+			for (size_t i = 0; i < block.freeRanges.size(); i++)
+			{
+				Range range = block.freeRanges[i];
+				VkDeviceSize alignedOffset = alignUp(range.offset, alignment);
+				if (alignedOffset + size > range.offset + range.size)
+				{
+					continue;
+				}
+				// Split the free range into the alignment padding in front and the remainder behind the allocation
+				block.freeRanges.erase(block.freeRanges.begin() + i);
+				VkDeviceSize end = alignedOffset + size;
+				if (end < range.offset + range.size)
+				{
+					block.freeRanges.insert(block.freeRanges.begin() + i, { end, range.offset + range.size - end });
+				}
+				if (alignedOffset > range.offset)
+				{
+					block.freeRanges.insert(block.freeRanges.begin() + i, { range.offset, alignedOffset - range.offset });
+				}
+				*offset = alignedOffset;
+				return true;
+			}
+			return false;
+		}
+
+		void insertFreeRange(Block &block, Range range)
+		{
+			auto it = std::lower_bound(block.freeRanges.begin(), block.freeRanges.end(), range, [](const Range &a, const Range &b) { return a.offset < b.offset; });
+			it = block.freeRanges.insert(it, range);
+			// Merge with the following range
+			auto next = it + 1;
+			if ((next != block.freeRanges.end()) && (it->offset + it->size == next->offset))
+			{
+				it->size += next->size;
+				block.freeRanges.erase(next);
+			}
+			// Merge with the preceding range
+			if (it != block.freeRanges.begin())
+			{
+				auto prev = it - 1;
+				if (prev->offset + prev->size == it->offset)
+				{
+					prev->size += it->size;
+					block.freeRanges.erase(it);
+				}
+			}
+		}
+
+		void commit(Block &block, VkDeviceSize offset, VkDeviceSize size, Allocation *allocation)
+		{
+			block.allocationCount++;
+			block.usedBytes += size;
+			allocation->memory = block.memory;
+			allocation->offset = offset;
+			allocation->size = size;
+			allocation->memoryTypeIndex = block.memoryTypeIndex;
+			allocation->mapped = block.mapped ? static_cast<uint8_t*>(block.mapped) + offset : nullptr;
+			allocation->allocator = this;
+			allocation->block = &block;
+		}
+
+		VkMappedMemoryRange getMappedRange(const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset)
+		{
+			if (size == VK_WHOLE_SIZE)
+			{
+				size = allocation.size - offset;
+			}
+			VkDeviceSize begin = allocation.offset + offset;
+			VkDeviceSize end = std::min(alignUp(begin + size, nonCoherentAtomSize), allocation.offset + allocation.size);
+			begin = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+			VkMappedMemoryRange mappedRange{};
+			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			mappedRange.memory = allocation.memory;
+			mappedRange.offset = begin;
+			mappedRange.size = end - begin;
+			return mappedRange;
+		}
+	};
+
+	inline void Allocation::free()
+	{
+		if (allocator)
+		{
+			allocator->free(*this);
+		}
+	}
+
+	inline VkResult Allocation::flush(VkDeviceSize size, VkDeviceSize offset)
+	{
+		assert(allocator);
+		return allocator->flush(*this, size, offset);
+	}
+
+	inline VkResult Allocation::invalidate(VkDeviceSize size, VkDeviceSize offset)
+	{
+		assert(allocator);
+		return allocator->invalidate(*this, size, offset);
+	}
+}
@@ -9,9 +9,15 @@
 #pragma once
 
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <fstream>
 #include <vector>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
 
 #include "vulkan/vulkan.h"
 
@@ -19,6 +25,7 @@
 #include <assimp/scene.h>     
 #include <assimp/postprocess.h>
 #include <assimp/cimport.h>
+#include <assimp/DefaultIOSystem.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -26,6 +33,12 @@
 
 #include "VulkanDevice.hpp"
 #include "VulkanBuffer.hpp"
+#include "VulkanUploadQueue.hpp"
+#include "VulkanIndirectDraw.hpp"
+#include "mappedfile.hpp"
+#include "jobsystem.hpp"
+#include "meshoptimize.hpp"
+#include "quantization.hpp"
 
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
@@ -50,35 +63,158 @@ namespace vks
 	public:
 		/** @brief Components used to generate vertices from */
 		std::vector<Component> components;
+		/**
+		* Store the components in packed formats (see componentFormat): positions and UVs are quantized to the range of the model
+		* and have to be dequantized in the vertex shader (see Model::Dequantization), normals, tangents and bitangents
+		* are octahedral encoded (see quantization.hpp) and colors are 8 bit
+		*/
+		bool packed = false;
 
-		VertexLayout(std::vector<Component> components)
+		VertexLayout(std::vector<Component> components, bool packed = false)
 		{
 			this->components = std::move(components);
+			this->packed = packed;
+		}
+
+		/** @brief Size of a component as converted at load time (32 bit floats) */
+		static uint32_t componentSize(Component component)
+		{
+			switch (component)
+			{
+			case VERTEX_COMPONENT_UV:
+				return 2 * sizeof(float);
+			case VERTEX_COMPONENT_DUMMY_FLOAT:
+				return sizeof(float);
+			case VERTEX_COMPONENT_DUMMY_VEC4:
+				return 4 * sizeof(float);
+			default:
+				// All components except the ones listed above are made up of 3 floats
+				return 3 * sizeof(float);
+			}
+		}
+
+		/** @brief Vertex input format of a component in the vertex buffer */
+		static VkFormat componentFormat(Component component, bool packed)
+		{
+			switch (component)
+			{
+			case VERTEX_COMPONENT_POSITION:
+				return packed ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+			case VERTEX_COMPONENT_NORMAL:
+			case VERTEX_COMPONENT_TANGENT:
+			case VERTEX_COMPONENT_BITANGENT:
+				return packed ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+			case VERTEX_COMPONENT_COLOR:
+				return packed ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+			case VERTEX_COMPONENT_UV:
+				return packed ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R32G32_SFLOAT;
+			case VERTEX_COMPONENT_DUMMY_FLOAT:
+				return VK_FORMAT_R32_SFLOAT;
+			default:
+				return VK_FORMAT_R32G32B32A32_SFLOAT;
+			}
+		}
+
+		/** @brief Size of a component in the vertex buffer */
+		static uint32_t componentSize(Component component, bool packed)
+		{
+			if (!packed)
+				return componentSize(component);
+			switch (component)
+			{
+			case VERTEX_COMPONENT_POSITION:
+				return 4 * sizeof(int16_t);
+			case VERTEX_COMPONENT_DUMMY_FLOAT:
+				return sizeof(float);
+			case VERTEX_COMPONENT_DUMMY_VEC4:
+				return 4 * sizeof(float);
+			default:
+				// Octahedral vectors, UVs and colors are packed into 32 bits
+				return 4;
+			}
 		}
 
-		uint32_t stride()
+		/** @brief Size of a vertex in the vertex buffer */
+		uint32_t stride() const
 		{
 			uint32_t res = 0;
 			for (auto& component : components)
 			{
-				switch (component)
-				{
-				case VERTEX_COMPONENT_UV:
-					res += 2 * sizeof(float);
-					break;
-				case VERTEX_COMPONENT_DUMMY_FLOAT:
-					res += sizeof(float);
-					break;
-				case VERTEX_COMPONENT_DUMMY_VEC4:
-					res += 4 * sizeof(float);
-					break;
-				default:
-					// All components except the ones listed above are made up of 3 floats
-					res += 3 * sizeof(float);
-				}
+				res += componentSize(component, packed);
 			}
 			return res;
 		}
+
+		/** @brief Byte offset of the first occurrence of a component inside a vertex of the vertex buffer, -1 if the layout doesn't contain it */
+		int32_t offset(Component component) const
+		{
+			uint32_t res = 0;
+			for (auto& c : components)
+			{
+				if (c == component)
+					return static_cast<int32_t>(res);
+				res += componentSize(c, packed);
+			}
+			return -1;
+		}
+
+		/** @brief Size of a vertex as converted at load time, before packing */
+		uint32_t unpackedStride() const
+		{
+			uint32_t res = 0;
+			for (auto& component : components)
+			{
+				res += componentSize(component);
+			}
+			return res;
+		}
+
+		/** @brief Byte offset of a component inside a vertex as converted at load time, -1 if the layout doesn't contain it */
+		int32_t unpackedOffset(Component component) const
+		{
+			uint32_t res = 0;
+			for (auto& c : components)
+			{
+				if (c == component)
+					return static_cast<int32_t>(res);
+				res += componentSize(c);
+			}
+			return -1;
+		}
+
+		/** @brief Vertex input attributes of all components at consecutive locations */
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(uint32_t binding, uint32_t firstLocation = 0) const
+		{
+			std::vector<VkVertexInputAttributeDescription> attributes;
+			uint32_t offset = 0;
+			for (auto& component : components)
+			{
+				VkVertexInputAttributeDescription attribute{};
+				attribute.location = firstLocation + static_cast<uint32_t>(attributes.size());
+				attribute.binding = binding;
+				attribute.format = componentFormat(component, packed);
+				attribute.offset = offset;
+				attributes.push_back(attribute);
+				offset += componentSize(component, packed);
+			}
+			return attributes;
+		}
+
+		/** @brief Vertex input attribute of the position only stream (see Model::positionStream), its binding stride is positionStride */
+		VkVertexInputAttributeDescription positionAttributeDescription(uint32_t binding, uint32_t location = 0) const
+		{
+			VkVertexInputAttributeDescription attribute{};
+			attribute.location = location;
+			attribute.binding = binding;
+			attribute.format = componentFormat(VERTEX_COMPONENT_POSITION, packed);
+			attribute.offset = 0;
+			return attribute;
+		}
+
+		uint32_t positionStride() const
+		{
+			return componentSize(VERTEX_COMPONENT_POSITION, packed);
+		}
 	};
 
 	/** @brief Used to parametrize model loading */
@@ -108,16 +244,62 @@ namespace vks
 	struct Model {
 		VkDevice device = nullptr;
 		vks::Buffer vertices;
+		/**
+		* Indices of the parts with 16 bit indices (index16Count entries, starting at offset 0) followed by the indices
+		* of the parts with 32 bit indices (starting at index32Offset), see bindIndexBuffer
+		*/
 		vks::Buffer indices;
 		uint32_t indexCount = 0;
 		uint32_t vertexCount = 0;
+		/** @brief Number of indices of the generated levels of detail, stored behind the indices of the parts of the same index type */
+		uint32_t lodIndexCount = 0;
+		/** @brief Number of 16 bit indices and byte offset of the 32 bit indices in the index buffer */
+		uint32_t index16Count = 0;
+		VkDeviceSize index32Offset = 0;
+		/**
+		* Deduplicated positions and their indices for depth only passes (only if built, see positionStream and bindPositionBuffers)
+		* The position indices have the same layout as the index buffer, so parts and levels of detail are drawn the same way
+		*/
+		vks::Buffer positions;
+		vks::Buffer positionIndices;
+		uint32_t positionCount = 0;
 
-		/** @brief Stores vertex and index base and counts for each part of a model */
+		static constexpr uint32_t maxLodLevels = 8;
+
+		/**
+		* Maps packed positions and UVs of a part back to model space (identity for unpacked layouts):
+		* position = positionOffset.xyz + positionScale.xyz * inPos.xyz, uv = uvOffsetScale.xy + uvOffsetScale.zw * inUV
+		* All members are vec4s, so the struct can be copied into uniform buffers and push constants as is
+		*/
+		struct Dequantization {
+			glm::vec4 positionOffset = glm::vec4(0.0f);
+			glm::vec4 positionScale = glm::vec4(1.0f);
+			glm::vec4 uvOffsetScale = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		};
+
+		/**
+		* Stores vertex and index base and counts for each part of a model
+		*
+		* Indices are relative to the part's vertexBase, which is passed as the vertex offset of its draws
+		* The index ranges of Data::parts point into Data::indices, the ones of Model::parts are relative to the index buffer region of the part's index type
+		*/
 		struct ModelPart {
 			uint32_t vertexBase;
 			uint32_t vertexCount;
 			uint32_t indexBase;
 			uint32_t indexCount;
+			/** @brief Parts with at most 65536 vertices use 16 bit indices */
+			VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+			/** @brief First position of the part in the position only stream, vertex offset of its depth only draws */
+			uint32_t positionBase = 0;
+			/** @brief Bounding sphere of the part in model space */
+			glm::vec3 center = glm::vec3(0.0f);
+			float radius = 0.0f;
+			/** @brief Packed layouts quantize positions and UVs to the range of each part */
+			Dequantization dequantization;
+			/** @brief Levels of detail from the part's own indices (level 0) to the coarsest one, as ranges of the model's index buffer */
+			uint32_t lodCount = 0;
+			vks::mesh::LodLevel lods[maxLodLevels];
 		};
 		std::vector<ModelPart> parts;
 
@@ -130,32 +312,1028 @@ namespace vks
 			glm::vec3 size;
 		} dim;
 
+		/**
+		* Pipeline layout range the draws push the Dequantization of each part to before drawing it (packed layouts),
+		* nothing is pushed if layout is VK_NULL_HANDLE
+		*/
+		struct {
+			VkPipelineLayout layout = VK_NULL_HANDLE;
+			VkShaderStageFlags stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+			uint32_t offset = 0;
+		} dequantizationPush;
+
+		/**
+		* Cold loads write the converted vertex and index data to a binary mesh cache file, later loads of the same source file
+		* with the same vertex layout, create info and flags map that file instead of running ASSIMP
+		*
+		* There is one cache file per source file and load settings, it is rewritten once the source file or one of the
+		* files ASSIMP read along with it (e.g. .mtl material libraries) changes, so superseded entries don't pile up
+		*/
+#if defined(__ANDROID__)
+		static inline bool useCache = false;
+#else
+		static inline bool useCache = true;
+#endif
+
+		/** @brief Per user cache location: XDG_CACHE_HOME (or ~/.cache) on Linux, ~/Library/Caches on macOS, LOCALAPPDATA on Windows, the temporary directory otherwise */
+		static std::string defaultCacheDirectory()
+		{
+			std::filesystem::path base;
+#if defined(_WIN32)
+			if (const char *localAppData = getenv("LOCALAPPDATA")) {
+				base = localAppData;
+			}
+#elif defined(__APPLE__)
+			if (const char *home = getenv("HOME")) {
+				base = std::filesystem::path(home) / "Library" / "Caches";
+			}
+#elif !defined(__ANDROID__)
+			if (const char *cacheHome = getenv("XDG_CACHE_HOME")) {
+				base = cacheHome;
+			} else if (const char *home = getenv("HOME")) {
+				base = std::filesystem::path(home) / ".cache";
+			}
+#endif
+			if (base.empty()) {
+				std::error_code error;
+				base = std::filesystem::temp_directory_path(error);
+			}
+			return (base / "vulkan-examples" / "meshcache").string() + "/";
+		}
+
+		/** @brief Directory the mesh cache files are written to (created on demand, must end with a path separator, working directory if empty) */
+		static inline std::string cacheDirectory = defaultCacheDirectory();
+		/**
+		* Cold loads reorder the indices of each part for vertex cache reuse and reduced overdraw and its vertices for fetch locality
+		* (see meshoptimize.hpp), the optimized data is what gets cached
+		*/
+		static inline bool optimizeMeshes = true;
+		/**
+		* Cold loads generate a chain of simplified levels of detail for each part if the level count is not 0 (at most maxLodLevels - 1),
+		* see selectLod and drawLod
+		*/
+		static inline vks::mesh::LodSettings lodSettings;
+		/**
+		* Cold loads also build a position only stream (in the position format of the layout) with its own index buffer, vertices
+		* split only by other attributes (normal and UV seams) share one position, see bindPositionBuffers
+		*/
+		static inline bool positionStream = false;
+
+		/** @brief CPU side model data in the layout it is uploaded with, see loadData */
+		struct Data {
+			std::vector<ModelPart> parts;
+			Dimension dim;
+			uint32_t vertexCount = 0;
+			uint32_t indexCount = 0;
+			uint32_t lodIndexCount = 0;
+			/** @brief Number of indices of the parts with 16 bit indices (including their levels of detail), they come first */
+			uint32_t index16Count = 0;
+			/** @brief Interleaved vertices in the layout of the vertex buffer (packed for packed layouts), points into the mapped cache file or vertexStorage */
+			const float *vertices = nullptr;
+			/**
+			* Part local indices grouped by index type, each group holds the indices of its parts followed by the indices of their levels of detail
+			* Point into the mapped cache file or indexStorage
+			*/
+			const uint32_t *indices = nullptr;
+			size_t vertexDataSize = 0;
+			std::vector<float> vertexStorage;
+			std::vector<uint32_t> indexStorage;
+			/** @brief Position only stream (empty if not built), positionIndices has the same ranges as indices (relative to the part's positionBase) */
+			uint32_t positionCount = 0;
+			const float *positions = nullptr;
+			const uint32_t *positionIndices = nullptr;
+			size_t positionDataSize = 0;
+			std::vector<float> positionStorage;
+			std::vector<uint32_t> positionIndexStorage;
+			vks::MappedFile cacheFile;
+			/** @brief True if the data was mapped from the mesh cache */
+			bool cached = false;
+			/** @brief Vertex cache efficiency (16 entry FIFO) of the imported and of the final index order */
+			struct CacheEfficiency {
+				float acmr = 0.0f;
+				float atvr = 0.0f;
+			} efficiencyBefore, efficiencyAfter;
+			/** @brief Time spent optimizing the meshes (in ms, 0 for cached data) */
+			double optimizeTime = 0.0;
+			/** @brief Time spent generating levels of detail (in ms, 0 for cached data) */
+			double lodTime = 0.0;
+			/** @brief Time spent in loadData (in ms) */
+			double loadTime = 0.0;
+			std::string error;
+
+			/** @brief Byte offset of the 32 bit indices in the index buffer (behind the 16 bit ones, 4 byte aligned) */
+			VkDeviceSize index32Offset() const
+			{
+				return ((VkDeviceSize)index16Count * sizeof(uint16_t) + 3) & ~VkDeviceSize(3);
+			}
+
+			/** @brief Size of the index buffer (and of the position index buffer) in bytes */
+			VkDeviceSize indexBufferSize() const
+			{
+				return index32Offset() + ((VkDeviceSize)indexCount + lodIndexCount - index16Count) * sizeof(uint32_t);
+			}
+		};
+
+	private:
+		static constexpr uint32_t cacheVersion = 7;
+
+		/**
+		* Followed by the names of the dependencies (null terminated, padded to 8 bytes), the parts, vertices and indices
+		* and the position stream (if built)
+		*/
+		struct CacheHeader {
+			char magic[4];
+			uint32_t version;
+			/** @brief Hash of the source file name and the load settings, also part of the file name */
+			uint64_t settingsKey;
+			/** @brief Hash of the contents of the source file and its dependencies */
+			uint64_t contentKey;
+			uint32_t dependencySize;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t lodIndexCount;
+			uint32_t index16Count;
+			uint32_t partCount;
+			uint32_t stride;
+			uint32_t positionCount;
+			uint32_t positionStride;
+			float dimMin[3];
+			float dimMax[3];
+			float acmr[2];
+			float atvr[2];
+		};
+
+		// Records the files ASSIMP reads besides the source file (material libraries, external buffers, ...), they are part of the cache key
+		class DependencyIOSystem : public Assimp::DefaultIOSystem
+		{
+		public:
+			std::string source;
+			std::vector<std::string> dependencies;
+
+			Assimp::IOStream *Open(const char *file, const char *mode = "rb") override
+			{
+				Assimp::IOStream *stream = Assimp::DefaultIOSystem::Open(file, mode);
+				if (stream && (source != file) && (std::find(dependencies.begin(), dependencies.end(), file) == dependencies.end())) {
+					dependencies.push_back(file);
+				}
+				return stream;
+			}
+		};
+
+		// FNV-1a over 64 bit words (bytes for the remainder), only used to key cache files
+		static uint64_t hashData(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			size_t i = 0;
+			for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+				uint64_t word;
+				memcpy(&word, bytes + i, sizeof(uint64_t));
+				hash ^= word;
+				hash *= 1099511628211ull;
+			}
+			for (; i < size; i++) {
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		// The settings key selects the cache file, it covers everything the converted data depends on except for file contents
+		// The cache version is left out on purpose, so files of older versions are overwritten instead of left behind
+		static uint64_t settingsKey(const std::string &filename, const vks::VertexLayout &layout, const vks::ModelCreateInfo *createInfo, int flags)
+		{
+			float params[8] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f };
+			if (createInfo) {
+				memcpy(&params[0], &createInfo->scale[0], sizeof(float) * 3);
+				memcpy(&params[3], &createInfo->uvscale[0], sizeof(float) * 2);
+				memcpy(&params[5], &createInfo->center[0], sizeof(float) * 3);
+			}
+			uint64_t key = hashData(filename.data(), filename.size());
+			key = hashData(layout.components.data(), layout.components.size() * sizeof(vks::Component), key);
+			key = hashData(&layout.packed, sizeof(layout.packed), key);
+			key = hashData(params, sizeof(params), key);
+			key = hashData(&flags, sizeof(flags), key);
+			key = hashData(&optimizeMeshes, sizeof(optimizeMeshes), key);
+			key = hashData(&lodSettings, sizeof(lodSettings), key);
+			return hashData(&positionStream, sizeof(positionStream), key);
+		}
+
+		// The content key changes with the source file and every dependency (missing or empty dependencies only contribute their name)
+		static uint64_t contentKey(const vks::MappedFile &source, const std::vector<std::string> &dependencies)
+		{
+			uint64_t key = hashData(source.data(), source.size());
+			for (auto& dependency : dependencies) {
+				key = hashData(dependency.c_str(), dependency.size() + 1, key);
+				vks::MappedFile file(dependency);
+				if (file.isOpen()) {
+					key = hashData(file.data(), file.size(), key);
+				}
+			}
+			return key;
+		}
+
+		// Dependency names are stored null terminated and padded to 8 bytes, so the data behind them stays aligned
+		static size_t dependencySize(const std::vector<std::string> &dependencies)
+		{
+			size_t size = 0;
+			for (auto& dependency : dependencies) {
+				size += dependency.size() + 1;
+			}
+			return (size + 7) & ~size_t(7);
+		}
+
+		static std::string cachePath(const std::string &filename, uint64_t key)
+		{
+			const size_t separator = filename.find_last_of("/\\");
+			char keyString[17];
+			snprintf(keyString, sizeof(keyString), "%016llx", (unsigned long long)key);
+			return cacheDirectory + ((separator != std::string::npos) ? filename.substr(separator + 1) : filename) + "." + keyString + ".meshcache";
+		}
+
+		static bool readCache(const std::string &path, uint64_t settingsHash, const vks::MappedFile &source, uint32_t stride, uint32_t positionStride, Data &data)
+		{
+			if (!data.cacheFile.open(path)) {
+				return false;
+			}
+			const uint8_t *bytes = data.cacheFile.data();
+			CacheHeader header;
+			bool valid = data.cacheFile.size() >= sizeof(CacheHeader);
+			if (valid) {
+				memcpy(&header, bytes, sizeof(CacheHeader));
+				const size_t totalIndexCount = (size_t)header.indexCount + header.lodIndexCount;
+				valid = (memcmp(header.magic, "VKMC", 4) == 0) && (header.version == cacheVersion) && (header.settingsKey == settingsHash) && (header.stride == stride) && (header.positionStride == positionStride) && (header.index16Count <= totalIndexCount) &&
+					(data.cacheFile.size() == sizeof(CacheHeader) + header.dependencySize + header.partCount * sizeof(ModelPart) + (size_t)header.vertexCount * stride + totalIndexCount * sizeof(uint32_t) +
+						(header.positionCount > 0 ? (size_t)header.positionCount * positionStride + totalIndexCount * sizeof(uint32_t) : 0));
+			}
+			if (valid) {
+				std::vector<std::string> dependencies;
+				const char *names = reinterpret_cast<const char*>(bytes + sizeof(CacheHeader));
+				for (size_t offset = 0; (offset < header.dependencySize) && (names[offset] != '\0');) {
+					const size_t length = strnlen(names + offset, header.dependencySize - offset);
+					dependencies.push_back(std::string(names + offset, length));
+					offset += length + 1;
+				}
+				valid = header.contentKey == contentKey(source, dependencies);
+			}
+			if (!valid) {
+				data.cacheFile.close();
+				return false;
+			}
+			size_t offset = sizeof(CacheHeader) + header.dependencySize;
+			data.parts.resize(header.partCount);
+			memcpy(data.parts.data(), bytes + offset, header.partCount * sizeof(ModelPart));
+			offset += header.partCount * sizeof(ModelPart);
+			// Vertices and indices are used in place, the file is only paged in while they are uploaded
+			data.vertices = reinterpret_cast<const float*>(bytes + offset);
+			data.vertexDataSize = (size_t)header.vertexCount * stride;
+			offset += data.vertexDataSize;
+			data.indices = reinterpret_cast<const uint32_t*>(bytes + offset);
+			offset += ((size_t)header.indexCount + header.lodIndexCount) * sizeof(uint32_t);
+			if (header.positionCount > 0) {
+				data.positionCount = header.positionCount;
+				data.positions = reinterpret_cast<const float*>(bytes + offset);
+				data.positionDataSize = (size_t)header.positionCount * positionStride;
+				offset += data.positionDataSize;
+				data.positionIndices = reinterpret_cast<const uint32_t*>(bytes + offset);
+			}
+			data.vertexCount = header.vertexCount;
+			data.indexCount = header.indexCount;
+			data.lodIndexCount = header.lodIndexCount;
+			data.index16Count = header.index16Count;
+			data.dim.min = glm::make_vec3(header.dimMin);
+			data.dim.max = glm::make_vec3(header.dimMax);
+			data.dim.size = data.dim.max - data.dim.min;
+			data.efficiencyBefore = { header.acmr[0], header.atvr[0] };
+			data.efficiencyAfter = { header.acmr[1], header.atvr[1] };
+			data.cached = true;
+			return true;
+		}
+
+		// Written to a temporary file first, so an interrupted write never leaves a truncated cache file behind
+		static void writeCache(const std::string &path, uint64_t settingsHash, uint64_t contentHash, const std::vector<std::string> &dependencies, uint32_t stride, uint32_t positionStride, const Data &data)
+		{
+			CacheHeader header{};
+			memcpy(header.magic, "VKMC", 4);
+			header.version = cacheVersion;
+			header.settingsKey = settingsHash;
+			header.contentKey = contentHash;
+			header.dependencySize = static_cast<uint32_t>(dependencySize(dependencies));
+			header.vertexCount = data.vertexCount;
+			header.indexCount = data.indexCount;
+			header.lodIndexCount = data.lodIndexCount;
+			header.index16Count = data.index16Count;
+			header.partCount = static_cast<uint32_t>(data.parts.size());
+			header.stride = stride;
+			header.positionCount = data.positionCount;
+			header.positionStride = positionStride;
+			memcpy(header.dimMin, &data.dim.min[0], sizeof(float) * 3);
+			memcpy(header.dimMax, &data.dim.max[0], sizeof(float) * 3);
+			header.acmr[0] = data.efficiencyBefore.acmr;
+			header.acmr[1] = data.efficiencyAfter.acmr;
+			header.atvr[0] = data.efficiencyBefore.atvr;
+			header.atvr[1] = data.efficiencyAfter.atvr;
+
+			const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+			if (!directory.empty()) {
+				std::error_code error;
+				std::filesystem::create_directories(directory, error);
+			}
+			const std::string tmpPath = path + ".tmp";
+			std::ofstream os(tmpPath, std::ios::binary | std::ios::out | std::ios::trunc);
+			if (!os.is_open()) {
+				return;
+			}
+			os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			std::vector<char> names;
+			for (auto& dependency : dependencies) {
+				names.insert(names.end(), dependency.c_str(), dependency.c_str() + dependency.size() + 1);
+			}
+			names.resize(header.dependencySize, '\0');
+			os.write(names.data(), names.size());
+			os.write(reinterpret_cast<const char*>(data.parts.data()), data.parts.size() * sizeof(ModelPart));
+			os.write(reinterpret_cast<const char*>(data.vertices), data.vertexDataSize);
+			os.write(reinterpret_cast<const char*>(data.indices), ((size_t)data.indexCount + data.lodIndexCount) * sizeof(uint32_t));
+			if (data.positionCount > 0) {
+				os.write(reinterpret_cast<const char*>(data.positions), data.positionDataSize);
+				os.write(reinterpret_cast<const char*>(data.positionIndices), ((size_t)data.indexCount + data.lodIndexCount) * sizeof(uint32_t));
+			}
+			os.close();
+			if (!os) {
+				std::remove(tmpPath.c_str());
+				return;
+			}
+#if defined(_WIN32)
+			// rename does not replace existing files on Windows
+			std::remove(path.c_str());
+#endif
+			if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+				std::remove(tmpPath.c_str());
+			}
+		}
+
+		// Converts all meshes of the scene into the interleaved vertex layout
+		// Vertices are written component by component for ranges of vertices, which are converted in parallel if a job system is passed
+		static void convertScene(const aiScene *scene, const vks::VertexLayout &layout, const vks::ModelCreateInfo *createInfo, vks::JobSystem *jobSystem, Data &data)
+		{
+			glm::vec3 scale(1.0f);
+			glm::vec2 uvscale(1.0f);
+			glm::vec3 center(0.0f);
+			if (createInfo)
+			{
+				scale = createInfo->scale;
+				uvscale = createInfo->uvscale;
+				center = createInfo->center;
+			}
+			const uint32_t stride = layout.unpackedStride() / sizeof(float);
+
+			// Place all meshes in the combined buffers first, so they can be converted independently
+			data.parts.resize(scene->mNumMeshes);
+			data.vertexCount = 0;
+			data.indexCount = 0;
+			for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+			{
+				const aiMesh* mesh = scene->mMeshes[i];
+				ModelPart &part = data.parts[i];
+				part.vertexBase = data.vertexCount;
+				part.vertexCount = mesh->mNumVertices;
+				part.indexBase = data.indexCount;
+				part.indexCount = 0;
+				part.indexType = (part.vertexCount <= 65536) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+				for (unsigned int j = 0; j < mesh->mNumFaces; j++)
+				{
+					if (mesh->mFaces[j].mNumIndices == 3)
+						part.indexCount += 3;
+				}
+				data.vertexCount += part.vertexCount;
+				data.indexCount += part.indexCount;
+			}
+			data.vertexStorage.assign((size_t)data.vertexCount * stride, 0.0f);
+			data.indexStorage.resize(data.indexCount);
+
+			// Large meshes are split into several ranges so a single big mesh doesn't serialize the conversion
+			struct Range {
+				uint32_t mesh;
+				uint32_t first;
+				uint32_t last;
+				glm::vec3 min = glm::vec3(FLT_MAX);
+				glm::vec3 max = glm::vec3(-FLT_MAX);
+			};
+			const uint32_t rangeSize = 16384;
+			std::vector<Range> ranges;
+			for (uint32_t i = 0; i < scene->mNumMeshes; i++)
+			{
+				for (uint32_t first = 0; first < std::max(data.parts[i].vertexCount, 1u); first += rangeSize)
+				{
+					Range range;
+					range.mesh = i;
+					range.first = first;
+					range.last = std::min(first + rangeSize, data.parts[i].vertexCount);
+					ranges.push_back(range);
+				}
+			}
+
+			auto convertRange = [&](Range &range)
+			{
+				const aiMesh* mesh = scene->mMeshes[range.mesh];
+				const ModelPart &part = data.parts[range.mesh];
+				const uint32_t count = range.last - range.first;
+				float *dst = data.vertexStorage.data() + (size_t)(part.vertexBase + range.first) * stride;
+
+				// Writes src * mul + add for all vertices of the range, missing attributes are left zero
+				auto writeVec3 = [&](const aiVector3D *src, uint32_t offset, const glm::vec3 &mul, const glm::vec3 &add)
+				{
+					if (!src)
+						return;
+					src += range.first;
+					for (uint32_t j = 0; j < count; j++)
+					{
+						float *v = dst + (size_t)j * stride + offset;
+						v[0] = src[j].x * mul.x + add.x;
+						v[1] = src[j].y * mul.y + add.y;
+						v[2] = src[j].z * mul.z + add.z;
+					}
+				};
+
+				uint32_t offset = 0;
+				for (auto& component : layout.components)
+				{
+					switch (component) {
+					case VERTEX_COMPONENT_POSITION:
+						writeVec3(mesh->mVertices, offset, glm::vec3(scale.x, -scale.y, scale.z), center);
+						offset += 3;
+						break;
+					case VERTEX_COMPONENT_NORMAL:
+						writeVec3(mesh->mNormals, offset, glm::vec3(1.0f, -1.0f, 1.0f), glm::vec3(0.0f));
+						offset += 3;
+						break;
+					case VERTEX_COMPONENT_UV:
+						if (mesh->HasTextureCoords(0))
+						{
+							const aiVector3D *src = mesh->mTextureCoords[0] + range.first;
+							for (uint32_t j = 0; j < count; j++)
+							{
+								float *v = dst + (size_t)j * stride + offset;
+								v[0] = src[j].x * uvscale.s;
+								v[1] = src[j].y * uvscale.t;
+							}
+						}
+						offset += 2;
+						break;
+					case VERTEX_COMPONENT_COLOR:
+					{
+						aiColor3D color(0.f, 0.f, 0.f);
+						scene->mMaterials[mesh->mMaterialIndex]->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+						for (uint32_t j = 0; j < count; j++)
+						{
+							float *v = dst + (size_t)j * stride + offset;
+							v[0] = color.r;
+							v[1] = color.g;
+							v[2] = color.b;
+						}
+						offset += 3;
+						break;
+					}
+					case VERTEX_COMPONENT_TANGENT:
+						writeVec3(mesh->HasTangentsAndBitangents() ? mesh->mTangents : nullptr, offset, glm::vec3(1.0f), glm::vec3(0.0f));
+						offset += 3;
+						break;
+					case VERTEX_COMPONENT_BITANGENT:
+						writeVec3(mesh->HasTangentsAndBitangents() ? mesh->mBitangents : nullptr, offset, glm::vec3(1.0f), glm::vec3(0.0f));
+						offset += 3;
+						break;
+					// Dummy components for padding
+					case VERTEX_COMPONENT_DUMMY_FLOAT:
+						offset += 1;
+						break;
+					case VERTEX_COMPONENT_DUMMY_VEC4:
+						offset += 4;
+						break;
+					};
+				}
+
+				for (uint32_t j = range.first; j < range.last; j++)
+				{
+					range.min = glm::min(range.min, glm::vec3(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z));
+					range.max = glm::max(range.max, glm::vec3(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z));
+				}
+
+				// Indices are written by the first range of each mesh
+				// They stay local to the mesh, its draws pass the vertex base as vertex offset
+				if (range.first == 0)
+				{
+					uint32_t *index = data.indexStorage.data() + part.indexBase;
+					for (unsigned int j = 0; j < mesh->mNumFaces; j++)
+					{
+						const aiFace& face = mesh->mFaces[j];
+						if (face.mNumIndices != 3)
+							continue;
+						*index++ = face.mIndices[0];
+						*index++ = face.mIndices[1];
+						*index++ = face.mIndices[2];
+					}
+				}
+			};
+
+			if (jobSystem && (ranges.size() > 1))
+			{
+				jobSystem->parallel_for(static_cast<uint32_t>(ranges.size()), 1, [&](uint32_t first, uint32_t last) {
+					for (uint32_t i = first; i < last; i++)
+						convertRange(ranges[i]);
+				});
+			}
+			else
+			{
+				for (auto& range : ranges)
+					convertRange(range);
+			}
+
+			for (auto& range : ranges)
+			{
+				data.dim.min = glm::min(data.dim.min, range.min);
+				data.dim.max = glm::max(data.dim.max, range.max);
+			}
+			data.dim.size = data.dim.max - data.dim.min;
+
+			data.vertices = data.vertexStorage.data();
+			data.vertexDataSize = data.vertexStorage.size() * sizeof(float);
+			data.indices = data.indexStorage.data();
+		}
+
+		// Parts are independent ranges of the vertex and index data, processed in parallel if a job system is passed
+		static void forEachPart(vks::JobSystem *jobSystem, const Data &data, const std::function<void(uint32_t)> &function)
+		{
+			const uint32_t partCount = static_cast<uint32_t>(data.parts.size());
+			if (jobSystem && (partCount > 1))
+			{
+				jobSystem->parallel_for(partCount, 1, [&](uint32_t first, uint32_t last) {
+					for (uint32_t i = first; i < last; i++)
+						function(i);
+				});
+			}
+			else
+			{
+				for (uint32_t i = 0; i < partCount; i++)
+					function(i);
+			}
+		}
+
+		// Optimizes the index and vertex order of each part
+		static void optimizeData(const vks::VertexLayout &layout, vks::JobSystem *jobSystem, Data &data)
+		{
+			auto tStart = std::chrono::high_resolution_clock::now();
+			const uint32_t stride = layout.unpackedStride() / sizeof(float);
+			const int32_t positionOffset = layout.unpackedOffset(VERTEX_COMPONENT_POSITION);
+
+			std::vector<vks::mesh::OptimizeStatistics> statistics(data.parts.size());
+
+			auto optimizePart = [&](uint32_t partIndex)
+			{
+				const ModelPart &part = data.parts[partIndex];
+				if (part.indexCount == 0)
+					return;
+				float *vertices = data.vertexStorage.data() + (size_t)part.vertexBase * stride;
+				uint32_t *indices = data.indexStorage.data() + part.indexBase;
+				statistics[partIndex] = vks::mesh::optimizeMesh(indices, part.indexCount, vertices, stride, part.vertexCount,
+					(positionOffset >= 0) ? positionOffset / (int32_t)sizeof(float) : -1);
+			};
+
+			forEachPart(jobSystem, data, optimizePart);
+			storeEfficiency(statistics, data);
+			data.optimizeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		}
+
+		// Vertex cache efficiency of the imported index order, for loads that don't optimize the meshes
+		static void analyzeData(vks::JobSystem *jobSystem, Data &data)
+		{
+			std::vector<vks::mesh::OptimizeStatistics> statistics(data.parts.size());
+			forEachPart(jobSystem, data, [&](uint32_t partIndex)
+			{
+				const ModelPart &part = data.parts[partIndex];
+				statistics[partIndex].before = statistics[partIndex].after = vks::mesh::analyzeVertexCache(data.indices + part.indexBase, part.indexCount, part.vertexCount);
+			});
+			storeEfficiency(statistics, data);
+		}
+
+		// Model wide ratios, weighted by the triangle and vertex counts of the parts
+		static void storeEfficiency(const std::vector<vks::mesh::OptimizeStatistics> &statistics, Data &data)
+		{
+			uint64_t transformedBefore = 0, transformedAfter = 0, referencedCount = 0;
+			for (auto& partStatistics : statistics)
+			{
+				transformedBefore += partStatistics.before.transformedCount;
+				transformedAfter += partStatistics.after.transformedCount;
+				referencedCount += partStatistics.after.referencedCount;
+			}
+			const uint32_t triangleCount = data.indexCount / 3;
+			if (triangleCount > 0 && referencedCount > 0)
+			{
+				data.efficiencyBefore = { (float)transformedBefore / triangleCount, (float)transformedBefore / referencedCount };
+				data.efficiencyAfter = { (float)transformedAfter / triangleCount, (float)transformedAfter / referencedCount };
+			}
+		}
+
+		// Computes the bounding sphere of each part and generates its level of detail chain, the indices of all levels are appended behind the indices of the parts
+		static void generatePartLods(const vks::VertexLayout &layout, vks::JobSystem *jobSystem, Data &data)
+		{
+			auto tStart = std::chrono::high_resolution_clock::now();
+			const uint32_t stride = layout.unpackedStride() / sizeof(float);
+			const int32_t positionOffset = layout.unpackedOffset(VERTEX_COMPONENT_POSITION);
+			vks::mesh::LodSettings settings = lodSettings;
+			settings.levelCount = (positionOffset >= 0) ? std::min(settings.levelCount, maxLodLevels - 1) : 0;
+
+			std::vector<std::vector<uint32_t>> lodIndices(data.parts.size());
+			forEachPart(jobSystem, data, [&](uint32_t partIndex)
+			{
+				ModelPart &part = data.parts[partIndex];
+				part.lodCount = 1;
+				part.lods[0] = { part.indexBase, part.indexCount, 0.0f };
+				if ((positionOffset < 0) || (part.vertexCount == 0))
+					return;
+
+				const float *vertices = data.vertexStorage.data() + (size_t)part.vertexBase * stride;
+				const uint32_t positionFloat = positionOffset / sizeof(float);
+				glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+				for (uint32_t v = 0; v < part.vertexCount; v++) {
+					const glm::vec3 pos = glm::make_vec3(vertices + (size_t)v * stride + positionFloat);
+					min = glm::min(min, pos);
+					max = glm::max(max, pos);
+				}
+				part.center = (min + max) * 0.5f;
+				for (uint32_t v = 0; v < part.vertexCount; v++) {
+					part.radius = std::max(part.radius, glm::distance(part.center, glm::make_vec3(vertices + (size_t)v * stride + positionFloat)));
+				}
+
+				if ((settings.levelCount == 0) || (part.indexCount == 0))
+					return;
+				std::vector<vks::mesh::LodLevel> levels;
+				vks::mesh::generateLods(data.indexStorage.data() + part.indexBase, part.indexCount, vertices, stride, part.vertexCount, positionFloat, settings, part.radius, lodIndices[partIndex], levels);
+				for (const vks::mesh::LodLevel &level : levels)
+					part.lods[part.lodCount++] = level;
+			});
+
+			data.lodIndexCount = 0;
+			for (size_t i = 0; i < data.parts.size(); i++)
+			{
+				ModelPart &part = data.parts[i];
+				const uint32_t firstIndex = data.indexCount + data.lodIndexCount;
+				for (uint32_t level = 1; level < part.lodCount; level++)
+					part.lods[level].firstIndex += firstIndex;
+				data.indexStorage.insert(data.indexStorage.end(), lodIndices[i].begin(), lodIndices[i].end());
+				data.lodIndexCount += static_cast<uint32_t>(lodIndices[i].size());
+			}
+			data.indices = data.indexStorage.data();
+			data.lodTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		}
+
+		// Moves the index ranges of the parts with 16 bit indices (and of their levels of detail) in front of the ones with 32 bit indices,
+		// so each index type is one contiguous range of the index buffer
+		static void groupIndexTypes(Data &data)
+		{
+			std::vector<uint32_t> grouped;
+			grouped.reserve(data.indexStorage.size());
+			for (VkIndexType indexType : { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 })
+			{
+				if (indexType == VK_INDEX_TYPE_UINT32)
+					data.index16Count = static_cast<uint32_t>(grouped.size());
+				// Indices of the parts first, followed by the indices of their levels of detail
+				for (uint32_t level = 0; level < maxLodLevels; level++)
+				{
+					for (ModelPart &part : data.parts)
+					{
+						if ((part.indexType != indexType) || (level >= part.lodCount))
+							continue;
+						// Level 0 is the part's own index range (see generatePartLods)
+						vks::mesh::LodLevel &lod = part.lods[level];
+						const uint32_t firstIndex = static_cast<uint32_t>(grouped.size());
+						grouped.insert(grouped.end(), data.indexStorage.begin() + lod.firstIndex, data.indexStorage.begin() + lod.firstIndex + lod.indexCount);
+						lod.firstIndex = firstIndex;
+						if (level == 0)
+							part.indexBase = firstIndex;
+					}
+				}
+			}
+			data.indexStorage.swap(grouped);
+			data.indices = data.indexStorage.data();
+		}
+
+		// Packs the converted vertices into the formats of a packed layout, positions and UVs are quantized to their range in each part
+		static void packVertices(const vks::VertexLayout &layout, vks::JobSystem *jobSystem, Data &data)
+		{
+			if (data.vertexCount == 0)
+				return;
+			const uint32_t unpackedStride = layout.unpackedStride() / sizeof(float);
+			const uint32_t packedStride = layout.stride();
+			const int32_t positionComponent = layout.unpackedOffset(VERTEX_COMPONENT_POSITION);
+			const int32_t uvComponent = layout.unpackedOffset(VERTEX_COMPONENT_UV);
+
+			std::vector<float> packed((size_t)data.vertexCount * packedStride / sizeof(float));
+			auto packPart = [&](const ModelPart &part, uint32_t first, uint32_t last)
+			{
+				const Dequantization &dequantization = part.dequantization;
+				const glm::vec3 positionOffset = glm::vec3(dequantization.positionOffset);
+				const glm::vec3 positionScale = glm::vec3(dequantization.positionScale);
+				const glm::vec2 uvMin = glm::vec2(dequantization.uvOffsetScale);
+				const glm::vec2 uvScale = glm::vec2(dequantization.uvOffsetScale.z, dequantization.uvOffsetScale.w);
+				for (uint32_t v = part.vertexBase + first; v < part.vertexBase + last; v++)
+				{
+					const float *src = data.vertexStorage.data() + (size_t)v * unpackedStride;
+					uint8_t *dst = reinterpret_cast<uint8_t*>(packed.data()) + (size_t)v * packedStride;
+					for (auto& component : layout.components)
+					{
+						switch (component) {
+						case VERTEX_COMPONENT_POSITION: {
+							const glm::vec3 position = (glm::make_vec3(src) - positionOffset) / positionScale;
+							const int16_t value[4] = { vks::quantize::snorm16(position.x), vks::quantize::snorm16(position.y), vks::quantize::snorm16(position.z), 32767 };
+							memcpy(dst, value, sizeof(value));
+							break;
+						}
+						case VERTEX_COMPONENT_NORMAL:
+						case VERTEX_COMPONENT_TANGENT:
+						case VERTEX_COMPONENT_BITANGENT: {
+							int16_t value[2];
+							vks::quantize::octEncode(src, value);
+							memcpy(dst, value, sizeof(value));
+							break;
+						}
+						case VERTEX_COMPONENT_UV: {
+							const glm::vec2 uv = (glm::make_vec2(src) - uvMin) / uvScale;
+							const uint16_t value[2] = { vks::quantize::unorm16(uv.x), vks::quantize::unorm16(uv.y) };
+							memcpy(dst, value, sizeof(value));
+							break;
+						}
+						case VERTEX_COMPONENT_COLOR: {
+							const uint8_t value[4] = { vks::quantize::unorm8(src[0]), vks::quantize::unorm8(src[1]), vks::quantize::unorm8(src[2]), 255 };
+							memcpy(dst, value, sizeof(value));
+							break;
+						}
+						default:
+							memcpy(dst, src, VertexLayout::componentSize(component));
+						}
+						src += VertexLayout::componentSize(component) / sizeof(float);
+						dst += VertexLayout::componentSize(component, true);
+					}
+				}
+			};
+
+			for (ModelPart &part : data.parts)
+			{
+				if (part.vertexCount == 0)
+					continue;
+				const float *vertices = data.vertexStorage.data() + (size_t)part.vertexBase * unpackedStride;
+				Dequantization &dequantization = part.dequantization;
+				if (positionComponent >= 0)
+				{
+					glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+					for (uint32_t v = 0; v < part.vertexCount; v++) {
+						const glm::vec3 position = glm::make_vec3(vertices + (size_t)v * unpackedStride + positionComponent / sizeof(float));
+						min = glm::min(min, position);
+						max = glm::max(max, position);
+					}
+					dequantization.positionOffset = glm::vec4((min + max) * 0.5f, 0.0f);
+					dequantization.positionScale = glm::vec4(glm::max((max - min) * 0.5f, glm::vec3(FLT_EPSILON)), 1.0f);
+				}
+				if (uvComponent >= 0)
+				{
+					glm::vec2 min(FLT_MAX), max(-FLT_MAX);
+					for (uint32_t v = 0; v < part.vertexCount; v++) {
+						const glm::vec2 uv = glm::make_vec2(vertices + (size_t)v * unpackedStride + uvComponent / sizeof(float));
+						min = glm::min(min, uv);
+						max = glm::max(max, uv);
+					}
+					dequantization.uvOffsetScale = glm::vec4(min, glm::max(max - min, glm::vec2(FLT_EPSILON)));
+				}
+				if (jobSystem)
+					jobSystem->parallel_for(part.vertexCount, 16384, [&](uint32_t first, uint32_t last) { packPart(part, first, last); });
+				else
+					packPart(part, 0, part.vertexCount);
+			}
+
+			data.vertexStorage.swap(packed);
+			data.vertices = data.vertexStorage.data();
+			data.vertexDataSize = (size_t)data.vertexCount * packedStride;
+		}
+
+		// Uploads indices in the layout of the index buffer, the 16 bit range is converted while it is written to the staging memory
+		static void uploadIndices(vks::UploadQueue *uploadQueue, VkBuffer buffer, const uint32_t *indices, const Data &data)
+		{
+			const uint32_t totalIndexCount = data.indexCount + data.lodIndexCount;
+			if (data.index16Count > 0) {
+				uploadQueue->uploadBuffer(buffer, (VkDeviceSize)data.index16Count * sizeof(uint16_t), [&](void *staging) {
+					uint16_t *dst = static_cast<uint16_t*>(staging);
+					for (uint32_t i = 0; i < data.index16Count; i++)
+						dst[i] = static_cast<uint16_t>(indices[i]);
+				});
+			}
+			if (totalIndexCount > data.index16Count) {
+				uploadQueue->uploadBuffer(buffer, indices + data.index16Count, (VkDeviceSize)(totalIndexCount - data.index16Count) * sizeof(uint32_t), data.index32Offset());
+			}
+		}
+
+		// Copies the (final, possibly packed) positions of each part into a separate stream, bitwise equal positions of a part are merged
+		// Positions are numbered in the order the indices first reference them, which keeps depth pass vertex fetches linear
+		static void buildPositionStream(const vks::VertexLayout &layout, Data &data)
+		{
+			const int32_t positionOffset = layout.offset(VERTEX_COMPONENT_POSITION);
+			if ((positionOffset < 0) || (data.vertexCount == 0))
+				return;
+			const uint32_t stride = layout.stride() / sizeof(float);
+			const uint32_t positionStride = layout.positionStride() / sizeof(float);
+
+			data.positionIndexStorage.resize((size_t)data.indexCount + data.lodIndexCount);
+			data.positionStorage.clear();
+			data.positionStorage.reserve((size_t)data.vertexCount * positionStride);
+			data.positionCount = 0;
+			std::vector<uint32_t> representative, remap;
+			for (ModelPart &part : data.parts)
+			{
+				// Part local, like the indices (the parts may be quantized differently)
+				const float *vertices = data.vertices + (size_t)part.vertexBase * stride;
+				vks::mesh::detail::groupVertices(vertices, stride, part.vertexCount, positionOffset / sizeof(float), positionStride, representative);
+				remap.assign(part.vertexCount, UINT32_MAX);
+				part.positionBase = data.positionCount;
+				for (uint32_t level = 0; level < part.lodCount; level++)
+				{
+					const vks::mesh::LodLevel &lod = part.lods[level];
+					for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; i++)
+					{
+						uint32_t &position = remap[representative[data.indices[i]]];
+						if (position == UINT32_MAX)
+						{
+							const float *src = vertices + (size_t)data.indices[i] * stride + positionOffset / sizeof(float);
+							data.positionStorage.insert(data.positionStorage.end(), src, src + positionStride);
+							position = data.positionCount++ - part.positionBase;
+						}
+						data.positionIndexStorage[i] = position;
+					}
+				}
+			}
+			data.positions = data.positionStorage.data();
+			data.positionIndices = data.positionIndexStorage.data();
+			data.positionDataSize = (size_t)data.positionCount * layout.positionStride();
+		}
+
+	public:
 		/** @brief Release all Vulkan resources of this model */
 		void destroy()
 		{		
 			assert(device);
-			vkDestroyBuffer(device, vertices.buffer, nullptr);
-			vkFreeMemory(device, vertices.memory, nullptr);
-			if (indices.buffer != VK_NULL_HANDLE)
-			{
-				vkDestroyBuffer(device, indices.buffer, nullptr);
-				vkFreeMemory(device, indices.memory, nullptr);
+			vertices.destroy();
+			indices.destroy();
+			positions.destroy();
+			positionIndices.destroy();
+		}
+
+		/**
+		* Bind the vertex buffer and the index buffer range of the first part's index type
+		*
+		* @param binding (Optional) Vertex input binding of the per-vertex data, per-instance data is bound to another binding by the caller
+		*/
+		void bindBuffers(VkCommandBuffer commandBuffer, uint32_t binding = 0) const
+		{
+			const VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, binding, 1, &vertices.buffer, offsets);
+			bindIndexBuffer(commandBuffer, parts.empty() ? VK_INDEX_TYPE_UINT32 : parts[0].indexType);
+		}
+
+		/**
+		* Bind the index buffer range of the parts with the given index type (the index ranges of their parts are relative to it)
+		*
+		* @param positionStream (Optional) Bind the range of the position index buffer instead, see bindPositionBuffers
+		*/
+		void bindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType, bool positionStream = false) const
+		{
+			vkCmdBindIndexBuffer(commandBuffer, positionStream ? positionIndices.buffer : indices.buffer, (indexType == VK_INDEX_TYPE_UINT16) ? 0 : index32Offset, indexType);
+		}
+
+		/**
+		* Bind the position only vertex and index buffers (for depth prepasses and shadow maps), draw with drawPositions
+		*
+		* @note Pipelines have to use the position binding of the layout, see VertexLayout::positionAttributeDescription
+		*/
+		void bindPositionBuffers(VkCommandBuffer commandBuffer, uint32_t binding = 0) const
+		{
+			assert(positionCount > 0);
+			const VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, binding, 1, &positions.buffer, offsets);
+			bindIndexBuffer(commandBuffer, parts.empty() ? VK_INDEX_TYPE_UINT32 : parts[0].indexType, true);
+		}
+
+		/**
+		* Draw all parts of the model with one indexed draw per part (buffers have to be bound, see bindBuffers)
+		*
+		* @param instanceCount (Optional) Number of instances drawn by each part's draw
+		* @param firstInstance (Optional) Instance index of the first instance (offsets instance rate bindings and gl_InstanceIndex)
+		*
+		* @note Per-instance data is read from an instance rate vertex binding or a storage buffer indexed with gl_InstanceIndex
+		* @note Parts with another index type than the first part rebind the index buffer, the first part's index type is bound again afterwards
+		*/
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0) const
+		{
+			drawParts(commandBuffer, false, instanceCount, firstInstance, [](const ModelPart &part) -> const vks::mesh::LodLevel& { return part.lods[0]; });
+		}
+
+		/** @brief Draw all parts from the position only stream (buffers have to be bound, see bindPositionBuffers) */
+		void drawPositions(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0) const
+		{
+			drawParts(commandBuffer, true, instanceCount, firstInstance, [](const ModelPart &part) -> const vks::mesh::LodLevel& { return part.lods[0]; });
+		}
+
+		/**
+		* Select the level of detail of a part for a viewer
+		*
+		* @param viewPosition Position of the viewer in model space (transformed by the inverse model matrix, which accounts for uniform scales)
+		* @param screenScale Pixels per world unit at distance 1 (see vks::mesh::lodScreenScale)
+		* @param pixelThreshold (Optional) Largest allowed projected error in pixels
+		*/
+		static const vks::mesh::LodLevel &selectLod(const ModelPart &part, const glm::vec3 &viewPosition, float screenScale, float pixelThreshold = 1.0f)
+		{
+			assert(part.lodCount > 0);
+			const float distance = std::max(glm::distance(viewPosition, part.center) - part.radius, 0.0f);
+			return part.lods[vks::mesh::selectLod(part.lods, part.lodCount, distance, screenScale, pixelThreshold)];
+		}
+
+		/**
+		* Draw all parts at the level of detail selected for the viewer (see selectLod), buffers have to be bound
+		*
+		* @param positionStream (Optional) Draw from the position only stream, see bindPositionBuffers
+		*
+		* @return Number of triangles drawn per instance
+		*/
+		uint32_t drawLod(VkCommandBuffer commandBuffer, const glm::vec3 &viewPosition, float screenScale, float pixelThreshold = 1.0f, uint32_t instanceCount = 1, uint32_t firstInstance = 0, bool positionStream = false) const
+		{
+			return drawParts(commandBuffer, positionStream, instanceCount, firstInstance, [&](const ModelPart &part) -> const vks::mesh::LodLevel& {
+				return selectLod(part, viewPosition, screenScale, pixelThreshold);
+			});
+		}
+
+		/**
+		* Append one indexed draw command per part to an indirect draw buffer
+		*
+		* @param instanceCount (Optional) Number of instances drawn by each part's command
+		* @param firstInstance (Optional) Instance index of the first instance of each part's command
+		* @param indexType (Optional) Only append the parts with this index type, their commands are drawn with that range bound (see bindIndexBuffer)
+		*
+		* @return Index of the first appended command
+		*
+		* @note The commands of parts with different index types have to be drawn separately, by default all parts are appended
+		*/
+		uint32_t appendDrawCommands(vks::IndirectDrawBuffer &indirectDraws, uint32_t instanceCount = 1, uint32_t firstInstance = 0, VkIndexType indexType = VK_INDEX_TYPE_MAX_ENUM) const
+		{
+			const uint32_t firstDraw = indirectDraws.size();
+			for (const ModelPart &part : parts) {
+				if ((indexType == VK_INDEX_TYPE_MAX_ENUM) || (part.indexType == indexType)) {
+					indirectDraws.add(part.indexCount, part.indexBase, static_cast<int32_t>(part.vertexBase), instanceCount, firstInstance);
+				}
+			}
+			return firstDraw;
+		}
+
+	private:
+		// Draws the index range selected for each part, switching the bound index type and pushing the dequantization as needed
+		template <typename Select>
+		uint32_t drawParts(VkCommandBuffer commandBuffer, bool positionStream, uint32_t instanceCount, uint32_t firstInstance, const Select &select) const
+		{
+			if (parts.empty())
+				return 0;
+			VkIndexType boundType = parts[0].indexType;
+			uint32_t triangleCount = 0;
+			for (const ModelPart &part : parts) {
+				if (part.indexType != boundType) {
+					bindIndexBuffer(commandBuffer, part.indexType, positionStream);
+					boundType = part.indexType;
+				}
+				if (dequantizationPush.layout != VK_NULL_HANDLE) {
+					vkCmdPushConstants(commandBuffer, dequantizationPush.layout, dequantizationPush.stageFlags, dequantizationPush.offset, sizeof(Dequantization), &part.dequantization);
+				}
+				const vks::mesh::LodLevel &lod = select(part);
+				vkCmdDrawIndexed(commandBuffer, lod.indexCount, instanceCount, lod.firstIndex, static_cast<int32_t>(positionStream ? part.positionBase : part.vertexBase), firstInstance);
+				triangleCount += lod.indexCount / 3;
+			}
+			if (boundType != parts[0].indexType) {
+				bindIndexBuffer(commandBuffer, parts[0].indexType, positionStream);
 			}
+			return triangleCount;
 		}
 
+	public:
 		/**
-		* Loads a 3D model from a file into Vulkan buffers
+		* Loads the vertex and index data of a 3D model file without creating any Vulkan resources
 		*
-		* @param device Pointer to the Vulkan device used to generated the vertex and index buffers on
 		* @param filename File to load (must be a model format supported by ASSIMP)
 		* @param layout Vertex layout components (position, normals, tangents, etc.)
 		* @param createInfo MeshCreateInfo structure for load time settings like scale, center, etc.
-		* @param copyQueue Queue used for the memory staging copy commands (must support transfer)
-		* @param (Optional) flags ASSIMP model loading flags
+		* @param flags ASSIMP model loading flags
+		* @param jobSystem (Optional) Job system used to convert the meshes of cold loads in parallel
+		* @param data Receives the loaded data (and the error message if loading failed)
+		*
+		* @note Uses the mesh cache if enabled (see useCache), cold loads (re)write the cache file
+		* @note Nothing is printed, timings and cache hits are returned in data
 		*/
-		bool loadFromFile(const std::string& filename, vks::VertexLayout layout, vks::ModelCreateInfo *createInfo, vks::VulkanDevice *device, VkQueue copyQueue, const int flags = defaultFlags)
+		static bool loadData(const std::string& filename, const vks::VertexLayout &layout, const vks::ModelCreateInfo *createInfo, const int flags, vks::JobSystem *jobSystem, Data &data)
 		{
-			this->device = device->logicalDevice;
+			auto tStart = std::chrono::high_resolution_clock::now();
+			const uint32_t stride = layout.stride();
+			const uint32_t positionStride = layout.positionStride();
 
 			Assimp::Importer Importer;
 			const aiScene* pScene;
@@ -167,10 +1345,9 @@ namespace vks
 
 			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
 			if (!asset) {
-				LOGE("Could not load mesh from \"%s\"!", filename.c_str());
+				data.error = "Could not load mesh from \"" + filename + "\"!";
 				return false;
 			}
-			assert(asset);
 			size_t size = AAsset_getLength(asset);
 
 			assert(size > 0);
@@ -183,199 +1360,167 @@ namespace vks
 
 			free(meshData);
 #else
-			pScene = Importer.ReadFile(filename.c_str(), flags);
-			if (!pScene) {
-				std::string error = Importer.GetErrorString();
-				vks::tools::exitFatal(error + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-			}
-#endif
-
-			if (pScene)
+			uint64_t key = 0;
+			std::string path;
+			vks::MappedFile source;
+			if (useCache)
 			{
-				parts.clear();
-				parts.resize(pScene->mNumMeshes);
-
-				glm::vec3 scale(1.0f);
-				glm::vec2 uvscale(1.0f);
-				glm::vec3 center(0.0f);
-				if (createInfo)
-				{
-					scale = createInfo->scale;
-					uvscale = createInfo->uvscale;
-					center = createInfo->center;
+				if (!source.open(filename)) {
+					data.error = "Could not open \"" + filename + "\"";
+					return false;
 				}
+				key = settingsKey(filename, layout, createInfo, flags);
+				path = cachePath(filename, key);
+				if (readCache(path, key, source, stride, positionStride, data)) {
+					data.loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+					return true;
+				}
+			}
 
-				std::vector<float> vertexBuffer;
-				std::vector<uint32_t> indexBuffer;
-
-				vertexCount = 0;
-				indexCount = 0;
-
-				// Load meshes
-				for (unsigned int i = 0; i < pScene->mNumMeshes; i++)
-				{
-					const aiMesh* paiMesh = pScene->mMeshes[i];
-
-					parts[i] = {};
-					parts[i].vertexBase = vertexCount;
-					parts[i].indexBase = indexCount;
+			// The importer owns the IO system
+			DependencyIOSystem *ioSystem = new DependencyIOSystem();
+			ioSystem->source = filename;
+			Importer.SetIOHandler(ioSystem);
+			pScene = Importer.ReadFile(filename.c_str(), flags);
+#endif
 
-					vertexCount += pScene->mMeshes[i]->mNumVertices;
+			if (!pScene) {
+				data.error = Importer.GetErrorString();
+				return false;
+			}
 
-					aiColor3D pColor(0.f, 0.f, 0.f);
-					pScene->mMaterials[paiMesh->mMaterialIndex]->Get(AI_MATKEY_COLOR_DIFFUSE, pColor);
+			convertScene(pScene, layout, createInfo, jobSystem, data);
+			if (optimizeMeshes) {
+				optimizeData(layout, jobSystem, data);
+			} else {
+				analyzeData(jobSystem, data);
+			}
+			generatePartLods(layout, jobSystem, data);
+			groupIndexTypes(data);
+			if (layout.packed) {
+				packVertices(layout, jobSystem, data);
+			}
+			if (positionStream) {
+				buildPositionStream(layout, data);
+			}
 
-					const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
+#if !defined(__ANDROID__)
+			if (useCache) {
+				writeCache(path, key, contentKey(source, ioSystem->dependencies), ioSystem->dependencies, stride, positionStride, data);
+			}
+#endif
+			data.loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			return true;
+		}
 
-					for (unsigned int j = 0; j < paiMesh->mNumVertices; j++)
-					{
-						const aiVector3D* pPos = &(paiMesh->mVertices[j]);
-						const aiVector3D* pNormal = &(paiMesh->mNormals[j]);
-						const aiVector3D* pTexCoord = (paiMesh->HasTextureCoords(0)) ? &(paiMesh->mTextureCoords[0][j]) : &Zero3D;
-						const aiVector3D* pTangent = (paiMesh->HasTangentsAndBitangents()) ? &(paiMesh->mTangents[j]) : &Zero3D;
-						const aiVector3D* pBiTangent = (paiMesh->HasTangentsAndBitangents()) ? &(paiMesh->mBitangents[j]) : &Zero3D;
+		/**
+		* Loads a 3D model from a file into Vulkan buffers
+		*
+		* @param device Pointer to the Vulkan device used to generated the vertex and index buffers on
+		* @param filename File to load (must be a model format supported by ASSIMP)
+		* @param layout Vertex layout components (position, normals, tangents, etc.)
+		* @param createInfo MeshCreateInfo structure for load time settings like scale, center, etc.
+		* @param copyQueue Graphics queue the model is used on (uploads go through the device's shared upload queue)
+		* @param (Optional) flags ASSIMP model loading flags
+		*
+		* @note Meshes are converted on the device's job system (if set) and the result is cached, see loadData
+		*/
+		bool loadFromFile(const std::string& filename, vks::VertexLayout layout, vks::ModelCreateInfo *createInfo, vks::VulkanDevice *device, VkQueue copyQueue, const int flags = defaultFlags)
+		{
+			this->device = device->logicalDevice;
 
-						for (auto& component : layout.components)
-						{
-							switch (component) {
-							case VERTEX_COMPONENT_POSITION:
-								vertexBuffer.push_back(pPos->x * scale.x + center.x);
-								vertexBuffer.push_back(-pPos->y * scale.y + center.y);
-								vertexBuffer.push_back(pPos->z * scale.z + center.z);
-								break;
-							case VERTEX_COMPONENT_NORMAL:
-								vertexBuffer.push_back(pNormal->x);
-								vertexBuffer.push_back(-pNormal->y);
-								vertexBuffer.push_back(pNormal->z);
-								break;
-							case VERTEX_COMPONENT_UV:
-								vertexBuffer.push_back(pTexCoord->x * uvscale.s);
-								vertexBuffer.push_back(pTexCoord->y * uvscale.t);
-								break;
-							case VERTEX_COMPONENT_COLOR:
-								vertexBuffer.push_back(pColor.r);
-								vertexBuffer.push_back(pColor.g);
-								vertexBuffer.push_back(pColor.b);
-								break;
-							case VERTEX_COMPONENT_TANGENT:
-								vertexBuffer.push_back(pTangent->x);
-								vertexBuffer.push_back(pTangent->y);
-								vertexBuffer.push_back(pTangent->z);
-								break;
-							case VERTEX_COMPONENT_BITANGENT:
-								vertexBuffer.push_back(pBiTangent->x);
-								vertexBuffer.push_back(pBiTangent->y);
-								vertexBuffer.push_back(pBiTangent->z);
-								break;
-							// Dummy components for padding
-							case VERTEX_COMPONENT_DUMMY_FLOAT:
-								vertexBuffer.push_back(0.0f);
-								break;
-							case VERTEX_COMPONENT_DUMMY_VEC4:
-								vertexBuffer.push_back(0.0f);
-								vertexBuffer.push_back(0.0f);
-								vertexBuffer.push_back(0.0f);
-								vertexBuffer.push_back(0.0f);
-								break;
-							};
-						}
+			Data data;
+			if (!loadData(filename, layout, createInfo, flags, device->jobSystem, data))
+			{
+				printf("Error parsing '%s': '%s'\n", filename.c_str(), data.error.c_str());
+#if defined(__ANDROID__)
+				LOGE("Error parsing '%s': '%s'", filename.c_str(), data.error.c_str());
+#else
+				vks::tools::exitFatal(data.error + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+#endif
+				return false;
+			}
 
-						dim.max.x = fmax(pPos->x, dim.max.x);
-						dim.max.y = fmax(pPos->y, dim.max.y);
-						dim.max.z = fmax(pPos->z, dim.max.z);
+			loadFromData(data, device, copyQueue);
+			return true;
+		};
 
-						dim.min.x = fmin(pPos->x, dim.min.x);
-						dim.min.y = fmin(pPos->y, dim.min.y);
-						dim.min.z = fmin(pPos->z, dim.min.z);
-					}
+		/**
+		* Creates the Vulkan buffers of the model from data loaded with loadData
+		*
+		* Allows inspecting the CPU side data (e.g. to compute per-part bounds) without loading the file twice
+		*
+		* @param data Data as returned by loadData
+		* @param device Pointer to the Vulkan device used to generated the vertex and index buffers on
+		* @param copyQueue Graphics queue the model is used on (uploads go through the device's shared upload queue)
+		*/
+		void loadFromData(const Data &data, vks::VulkanDevice *device, VkQueue copyQueue)
+		{
+			this->device = device->logicalDevice;
 
-					dim.size = dim.max - dim.min;
+			parts = data.parts;
+			dim = data.dim;
+			vertexCount = data.vertexCount;
+			indexCount = data.indexCount;
+			lodIndexCount = data.lodIndexCount;
+			index16Count = data.index16Count;
+			index32Offset = data.index32Offset();
 
-					parts[i].vertexCount = paiMesh->mNumVertices;
+			positionCount = data.positionCount;
 
-					uint32_t indexBase = static_cast<uint32_t>(indexBuffer.size());
-					for (unsigned int j = 0; j < paiMesh->mNumFaces; j++)
-					{
-						const aiFace& Face = paiMesh->mFaces[j];
-						if (Face.mNumIndices != 3)
-							continue;
-						indexBuffer.push_back(indexBase + Face.mIndices[0]);
-						indexBuffer.push_back(indexBase + Face.mIndices[1]);
-						indexBuffer.push_back(indexBase + Face.mIndices[2]);
-						parts[i].indexCount += 3;
-						indexCount += 3;
-					}
+			// The index ranges of parts with 32 bit indices become relative to the 32 bit range of the index buffer, see bindIndexBuffer
+			for (ModelPart &part : parts) {
+				if (part.indexType == VK_INDEX_TYPE_UINT32) {
+					part.indexBase -= index16Count;
+					for (uint32_t level = 0; level < part.lodCount; level++)
+						part.lods[level].firstIndex -= index16Count;
 				}
+			}
 
+			uint32_t vBufferSize = static_cast<uint32_t>(data.vertexDataSize);
+			uint32_t iBufferSize = static_cast<uint32_t>(data.indexBufferSize());
 
-				uint32_t vBufferSize = static_cast<uint32_t>(vertexBuffer.size()) * sizeof(float);
-				uint32_t iBufferSize = static_cast<uint32_t>(indexBuffer.size()) * sizeof(uint32_t);
+			// Create device local target buffers
+			// Vertex buffer
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&vertices,
+				vBufferSize));
 
-				// Use staging buffer to move vertex and index buffer to device local memory
-				// Create staging buffers
-				vks::Buffer vertexStaging, indexStaging;
+			// Index buffer
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&indices,
+				iBufferSize));
 
-				// Vertex buffer
-				VK_CHECK_RESULT(device->createBuffer(
-					VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-					&vertexStaging,
-					vBufferSize,
-					vertexBuffer.data()));
+			// Stage vertex and index data through the shared upload queue, the copies are batched and not waited for
+			// (the queue's barriers order them before any later work on the graphics queue)
+			// For warm loads the data is staged straight from the mapped cache file
+			vks::UploadQueue *uploadQueue = vks::UploadQueue::getShared(device, copyQueue);
+			uploadQueue->uploadBuffer(vertices.buffer, data.vertices, vBufferSize);
+			uploadIndices(uploadQueue, indices.buffer, data.indices, data);
 
-				// Index buffer
-				VK_CHECK_RESULT(device->createBuffer(
-					VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-					&indexStaging,
-					iBufferSize,
-					indexBuffer.data()));
-
-				// Create device local target buffers
-				// Vertex buffer
+			if (positionCount > 0)
+			{
+				// Positions are deduplicated per part, so the position indices fit the index type of their part as well
+				const uint32_t pBufferSize = static_cast<uint32_t>(data.positionDataSize);
 				VK_CHECK_RESULT(device->createBuffer(
 					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-					&vertices,
-					vBufferSize));
-
-				// Index buffer
+					&positions,
+					pBufferSize));
 				VK_CHECK_RESULT(device->createBuffer(
 					VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-					&indices,
+					&positionIndices,
 					iBufferSize));
-
-				// Copy from staging buffers
-				VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-				VkBufferCopy copyRegion{};
-
-				copyRegion.size = vertices.size;
-				vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
-
-				copyRegion.size = indices.size;
-				vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
-
-				device->flushCommandBuffer(copyCmd, copyQueue);
-
-				// Destroy staging resources
-				vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-				vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-				vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-				vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
-
-				return true;
+				uploadQueue->uploadBuffer(positions.buffer, data.positions, pBufferSize);
+				uploadIndices(uploadQueue, positionIndices.buffer, data.positionIndices, data);
 			}
-			else
-			{
-				printf("Error parsing '%s': '%s'\n", filename.c_str(), Importer.GetErrorString());
-#if defined(__ANDROID__)
-				LOGE("Error parsing '%s': '%s'", filename.c_str(), Importer.GetErrorString());
-#endif
-				return false;
-			}
-		};
+			uploadQueue->flush();
+		}
 
 		/**
 		* Loads a 3D model from a file into Vulkan buffers
@@ -393,4 +1538,4 @@ namespace vks
 			return loadFromFile(filename, layout, &modelCreateInfo, device, copyQueue, flags);
 		}
 	};
-};
\ No newline at end of file
+};
@@ -0,0 +1,588 @@
+/*
+* Vulkan upload queue
+*
+* Batches host to device copies through a persistently mapped staging ring buffer
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <assert.h>
+#include <string.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Records buffer and image uploads into batches that are submitted without waiting on the host
+	*
+	* Source data is copied into a persistently mapped staging ring buffer right away, so it can be released as soon as an upload call returns.
+	* Copies run on a dedicated transfer queue family if the device has one, ownership is then handed over to the graphics queue family with
+	* release/acquire barriers. The final barriers of a batch are always recorded on the graphics queue, so work submitted to that queue after
+	* the batch sees the uploaded data without any host side wait. Tickets are only needed to know when host memory can be reused.
+	*
+	* @note Not thread safe, uploads and submits must be externally synchronized with other submissions to the same queues
+	*/
+	class UploadQueue
+	{
+	public:
+		/** @brief Identifies a submitted batch, tickets increase monotonically */
+		typedef uint64_t Ticket;
+
+		/**
+		* Create an upload queue
+		*
+		* @param device Vulkan device to upload to, its transfer queue family is used if it differs from the graphics one
+		* @param graphicsQueue Graphics queue that uploaded resources are consumed on
+		* @param ringSize (Optional) Size of the staging ring buffer in bytes, larger uploads get a staging buffer of their own
+		*/
+		UploadQueue(vks::VulkanDevice *device, VkQueue graphicsQueue, VkDeviceSize ringSize = 32 * 1024 * 1024)
+		{
+			this->device = device;
+			this->graphicsQueue = graphicsQueue;
+			graphicsFamily = device->queueFamilyIndices.graphics;
+			transferFamily = device->queueFamilyIndices.transfer;
+			dedicatedTransfer = (transferFamily != graphicsFamily);
+			if (dedicatedTransfer)
+			{
+				vkGetDeviceQueue(device->logicalDevice, transferFamily, 0, &transferQueue);
+			}
+			else
+			{
+				transferQueue = graphicsQueue;
+			}
+			const VkCommandPoolCreateFlags poolFlags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			graphicsPool = device->createCommandPool(graphicsFamily, poolFlags);
+			transferPool = dedicatedTransfer ? device->createCommandPool(transferFamily, poolFlags) : graphicsPool;
+
+			imageAlignment = std::max<VkDeviceSize>(device->properties.limits.optimalBufferCopyOffsetAlignment, 16);
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&ring,
+				ringSize));
+			VK_CHECK_RESULT(ring.map());
+			this->ringSize = ringSize;
+		}
+
+		/**
+		* Get the upload queue shared by the asset loaders of a device, it's created on first use
+		*
+		* @param device Vulkan device the queue belongs to (and is owned by)
+		* @param graphicsQueue Graphics queue that uploaded resources are consumed on
+		*/
+		static UploadQueue* getShared(vks::VulkanDevice *device, VkQueue graphicsQueue)
+		{
+			if (!device->uploadQueue)
+			{
+				device->uploadQueue = std::make_shared<UploadQueue>(device, graphicsQueue);
+			}
+			assert(device->uploadQueue->graphicsQueue == graphicsQueue);
+			return device->uploadQueue.get();
+		}
+
+		/** @brief Waits for all pending uploads and releases the staging ring */
+		~UploadQueue()
+		{
+			waitIdle();
+			for (auto fence : freeFences)
+			{
+				vkDestroyFence(device->logicalDevice, fence, nullptr);
+			}
+			for (auto semaphore : freeSemaphores)
+			{
+				vkDestroySemaphore(device->logicalDevice, semaphore, nullptr);
+			}
+			if (transferPool != graphicsPool)
+			{
+				vkDestroyCommandPool(device->logicalDevice, transferPool, nullptr);
+			}
+			vkDestroyCommandPool(device->logicalDevice, graphicsPool, nullptr);
+			ring.destroy();
+		}
+
+		/**
+		* Upload data into a buffer
+		*
+		* @param buffer Destination buffer (must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+		* @param data Pointer to the source data, copied into the staging ring before the call returns
+		* @param size Size of the data in bytes
+		* @param dstOffset (Optional) Byte offset into the destination buffer
+		* @param dstStageMask (Optional) Pipeline stages that consume the buffer (Defaults to vertex input)
+		* @param dstAccessMask (Optional) Accesses that consume the buffer (Defaults to vertex and index reads)
+		*
+		* @return Ticket of the batch the upload has been recorded into
+		*/
+		Ticket uploadBuffer(VkBuffer buffer, const void *data, VkDeviceSize size, VkDeviceSize dstOffset = 0, VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VkAccessFlags dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT)
+		{
+			return uploadBuffer(buffer, size, [data, size](void *staging) { memcpy(staging, data, size); }, dstOffset, dstStageMask, dstAccessMask);
+		}
+
+		/**
+		* Upload data that is generated straight into the staging memory (e.g. decoded from a file), saves the copy from an intermediate buffer
+		*
+		* @param buffer Destination buffer (must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+		* @param size Size of the data in bytes
+		* @param write Called once before the call returns with a pointer to size bytes of host visible staging memory, which it has to fill completely
+		* @param dstOffset (Optional) Byte offset into the destination buffer
+		* @param dstStageMask (Optional) Pipeline stages that consume the buffer (Defaults to vertex input)
+		* @param dstAccessMask (Optional) Accesses that consume the buffer (Defaults to vertex and index reads)
+		*
+		* @note Staging memory is write combined on many devices, write it sequentially and don't read from it
+		*
+		* @return Ticket of the batch the upload has been recorded into
+		*/
+		Ticket uploadBuffer(VkBuffer buffer, VkDeviceSize size, const std::function<void(void *staging)> &write, VkDeviceSize dstOffset = 0, VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VkAccessFlags dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT)
+		{
+			VkBuffer srcBuffer;
+			VkDeviceSize srcOffset;
+			stage(size, 4, write, &srcBuffer, &srcOffset);
+			begin();
+
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = srcOffset;
+			copyRegion.dstOffset = dstOffset;
+			copyRegion.size = size;
+			vkCmdCopyBuffer(recording.transferCmd, srcBuffer, buffer, 1, &copyRegion);
+
+			VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+			barrier.buffer = buffer;
+			barrier.offset = dstOffset;
+			barrier.size = size;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = dstAccessMask;
+			if (dedicatedTransfer)
+			{
+				// Release on the transfer queue family, acquire on the graphics queue family
+				barrier.srcQueueFamilyIndex = transferFamily;
+				barrier.dstQueueFamilyIndex = graphicsFamily;
+				barrier.dstAccessMask = 0;
+				vkCmdPipelineBarrier(recording.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = dstAccessMask;
+				vkCmdPipelineBarrier(recording.graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+			}
+			else
+			{
+				vkCmdPipelineBarrier(recording.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+			}
+			return recording.ticket;
+		}
+
+		/**
+		* Upload data into an image and transition it to its final layout
+		*
+		* @param image Destination image (must have been created with VK_IMAGE_USAGE_TRANSFER_DST_BIT, current contents are discarded)
+		* @param data Pointer to the source data, copied into the staging ring before the call returns
+		* @param size Size of the data in bytes
+		* @param regions Copy regions, buffer offsets are relative to data
+		* @param subresourceRange Subresources covered by the copy regions
+		* @param finalLayout Layout the subresources are transitioned to after the copy
+		* @param dstStageMask (Optional) Pipeline stages that consume the image (Defaults to the fragment shader)
+		* @param dstAccessMask (Optional) Accesses that consume the image (Defaults to shader reads)
+		*
+		* @return Ticket of the batch the upload has been recorded into
+		*/
+		Ticket uploadImage(VkImage image, const void *data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions, VkImageSubresourceRange subresourceRange, VkImageLayout finalLayout, VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VkAccessFlags dstAccessMask = VK_ACCESS_SHADER_READ_BIT)
+		{
+			VkBuffer srcBuffer;
+			VkDeviceSize srcOffset;
+			stage(data, size, imageAlignment, &srcBuffer, &srcOffset);
+			begin();
+
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.image = image;
+			barrier.subresourceRange = subresourceRange;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(recording.transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			for (auto& region : regions)
+			{
+				region.bufferOffset += srcOffset;
+			}
+			vkCmdCopyBufferToImage(recording.transferCmd, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = finalLayout;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = dstAccessMask;
+			if (dedicatedTransfer)
+			{
+				// Release and acquire have to specify the same layouts, the transition happens once between them
+				barrier.srcQueueFamilyIndex = transferFamily;
+				barrier.dstQueueFamilyIndex = graphicsFamily;
+				barrier.dstAccessMask = 0;
+				vkCmdPipelineBarrier(recording.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = dstAccessMask;
+				vkCmdPipelineBarrier(recording.graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			}
+			else
+			{
+				vkCmdPipelineBarrier(recording.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			}
+			return recording.ticket;
+		}
+
+		/**
+		* Get the graphics queue command buffer of the batch that is currently being recorded
+		*
+		* Used for follow-up work that needs a graphics queue (e.g. generating mip maps with vkCmdBlitImage), it runs after
+		* all uploads that have been recorded so far
+		*
+		* @note Only valid until the next upload or submit call
+		*/
+		VkCommandBuffer getGraphicsCommandBuffer()
+		{
+			begin();
+			return recording.graphicsCmd;
+		}
+
+		/**
+		* Submit all uploads recorded since the last submit (does not wait)
+		*
+		* @return Ticket of the submitted batch, or of the last submitted batch if nothing has been recorded
+		*/
+		Ticket submit()
+		{
+			if (recording.transferCmd == VK_NULL_HANDLE)
+			{
+				return lastSubmitted;
+			}
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(recording.transferCmd));
+			recording.fence = getFence();
+
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &recording.transferCmd;
+			if (dedicatedTransfer)
+			{
+				VK_CHECK_RESULT(vkEndCommandBuffer(recording.graphicsCmd));
+				recording.semaphore = getSemaphore();
+				submitInfo.signalSemaphoreCount = 1;
+				submitInfo.pSignalSemaphores = &recording.semaphore;
+				VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+				// The graphics side only contains the acquire barriers (and follow-up work), the fence covers both submits
+				VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+				submitInfo = vks::initializers::submitInfo();
+				submitInfo.waitSemaphoreCount = 1;
+				submitInfo.pWaitSemaphores = &recording.semaphore;
+				submitInfo.pWaitDstStageMask = &waitStageMask;
+				submitInfo.commandBufferCount = 1;
+				submitInfo.pCommandBuffers = &recording.graphicsCmd;
+				VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, recording.fence));
+			}
+			else
+			{
+				VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, recording.fence));
+			}
+
+			lastSubmitted = recording.ticket;
+			inFlight.push_back(std::move(recording));
+			recording = Batch();
+			return lastSubmitted;
+		}
+
+		/**
+		* Submit pending uploads unless submits are currently deferred
+		*
+		* @note Called by the asset loaders at the end of each load
+		*
+		* @return Ticket of the batch containing the uploads recorded so far
+		*/
+		Ticket flush()
+		{
+			if (deferDepth > 0)
+			{
+				return (recording.transferCmd != VK_NULL_HANDLE) ? recording.ticket : lastSubmitted;
+			}
+			return submit();
+		}
+
+		/** @brief Defer flushes until the matching endDefer call, so the uploads of several assets end up in a single batch */
+		void beginDefer()
+		{
+			deferDepth++;
+		}
+
+		/** @brief End a deferral scope, submits pending uploads when the outermost scope ends */
+		Ticket endDefer()
+		{
+			assert(deferDepth > 0);
+			deferDepth--;
+			return flush();
+		}
+
+		/** @brief Returns true if the batch identified by the ticket has finished executing */
+		bool isComplete(Ticket ticket)
+		{
+			retireCompleted();
+			return ticket <= lastCompleted;
+		}
+
+		/** @brief Wait on the host until the batch identified by the ticket has finished executing (submits it if it's still being recorded) */
+		void wait(Ticket ticket)
+		{
+			if ((recording.transferCmd != VK_NULL_HANDLE) && (ticket >= recording.ticket))
+			{
+				submit();
+			}
+			while (!inFlight.empty() && (inFlight.front().ticket <= ticket))
+			{
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &inFlight.front().fence, VK_TRUE, UINT64_MAX));
+				retire(inFlight.front());
+				inFlight.pop_front();
+			}
+		}
+
+		/** @brief Submit pending uploads and wait for all batches to finish */
+		void waitIdle()
+		{
+			wait(submit());
+		}
+
+	private:
+		struct Batch {
+			Ticket ticket = 0;
+			VkCommandBuffer transferCmd = VK_NULL_HANDLE;
+			/** @brief Equals transferCmd if there is no dedicated transfer queue family */
+			VkCommandBuffer graphicsCmd = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			/** @brief Part of the staging ring used by the batch */
+			bool usesRing = false;
+			VkDeviceSize ringBegin = 0;
+			/** @brief Staging buffers for uploads that don't fit into the ring */
+			std::vector<vks::Buffer> dedicatedStaging;
+		};
+
+		vks::VulkanDevice *device;
+		VkQueue graphicsQueue;
+		VkQueue transferQueue;
+		uint32_t graphicsFamily;
+		uint32_t transferFamily;
+		bool dedicatedTransfer;
+		VkCommandPool graphicsPool;
+		VkCommandPool transferPool;
+
+		vks::Buffer ring;
+		VkDeviceSize ringSize;
+		VkDeviceSize ringHead = 0;
+		VkDeviceSize ringTail = 0;
+		VkDeviceSize imageAlignment;
+
+		Batch recording;
+		std::deque<Batch> inFlight;
+		Ticket nextTicket = 1;
+		Ticket lastSubmitted = 0;
+		Ticket lastCompleted = 0;
+		uint32_t deferDepth = 0;
+		std::vector<VkFence> freeFences;
+		std::vector<VkSemaphore> freeSemaphores;
+
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		/** @brief Start recording a new batch if there is none */
+		void begin()
+		{
+			if (recording.transferCmd != VK_NULL_HANDLE)
+			{
+				return;
+			}
+			recording.ticket = nextTicket++;
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(transferPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &cmdBufAllocateInfo, &recording.transferCmd));
+			VK_CHECK_RESULT(vkBeginCommandBuffer(recording.transferCmd, &cmdBufInfo));
+			if (dedicatedTransfer)
+			{
+				cmdBufAllocateInfo.commandPool = graphicsPool;
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &cmdBufAllocateInfo, &recording.graphicsCmd));
+				VK_CHECK_RESULT(vkBeginCommandBuffer(recording.graphicsCmd, &cmdBufInfo));
+			}
+			else
+			{
+				recording.graphicsCmd = recording.transferCmd;
+			}
+		}
+
+		/** @brief Copy data into the staging ring (or a dedicated staging buffer), may submit the current batch and wait for older ones to make room */
+		void stage(const void *data, VkDeviceSize size, VkDeviceSize alignment, VkBuffer *srcBuffer, VkDeviceSize *srcOffset)
+		{
+			stage(size, alignment, [data, size](void *staging) { memcpy(staging, data, size); }, srcBuffer, srcOffset);
+		}
+
+		/** @brief Let write fill size bytes of the staging ring (or of a dedicated staging buffer) */
+		void stage(VkDeviceSize size, VkDeviceSize alignment, const std::function<void(void *staging)> &write, VkBuffer *srcBuffer, VkDeviceSize *srcOffset)
+		{
+			retireCompleted();
+			VkDeviceSize offset;
+			while (!allocateRing(size, alignment, &offset))
+			{
+				if (recording.usesRing)
+				{
+					// Everything recorded so far has already been staged, so the batch can be handed off right away
+					submit();
+				}
+				else if (!inFlight.empty())
+				{
+					wait(inFlight.front().ticket);
+				}
+				else
+				{
+					// Larger than the whole ring
+					vks::Buffer staging;
+					VK_CHECK_RESULT(device->createBuffer(
+						VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+						&staging,
+						size,
+						nullptr,
+						vks::ALLOCATION_STRATEGY_LINEAR));
+					VK_CHECK_RESULT(staging.map());
+					write(staging.mapped);
+					staging.unmap();
+					*srcBuffer = staging.buffer;
+					*srcOffset = 0;
+					recording.dedicatedStaging.push_back(staging);
+					return;
+				}
+			}
+			write(static_cast<uint8_t*>(ring.mapped) + offset);
+			*srcBuffer = ring.buffer;
+			*srcOffset = offset;
+		}
+
+		bool allocateRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+		{
+			bool empty = !recording.usesRing && std::none_of(inFlight.begin(), inFlight.end(), [](const Batch &batch) { return batch.usesRing; });
+			VkDeviceSize start;
+			if (empty)
+			{
+				ringHead = ringTail = 0;
+				if (size > ringSize)
+				{
+					return false;
+				}
+				start = 0;
+			}
+			else if (ringHead > ringTail)
+			{
+				// Free space is [head, end) and [0, tail)
+				start = alignUp(ringHead, alignment);
+				if (start + size > ringSize)
+				{
+					if (size >= ringTail)
+					{
+						return false;
+					}
+					start = 0;
+				}
+			}
+			else
+			{
+				// Wrapped, free space is [head, tail)
+				start = alignUp(ringHead, alignment);
+				if (start + size >= ringTail)
+				{
+					return false;
+				}
+			}
+			if (!recording.usesRing)
+			{
+				recording.usesRing = true;
+				recording.ringBegin = start;
+			}
+			ringHead = start + size;
+			*offset = start;
+			return true;
+		}
+
+		void retireCompleted()
+		{
+			while (!inFlight.empty() && (vkGetFenceStatus(device->logicalDevice, inFlight.front().fence) == VK_SUCCESS))
+			{
+				retire(inFlight.front());
+				inFlight.pop_front();
+			}
+		}
+
+		void retire(Batch &batch)
+		{
+			vkFreeCommandBuffers(device->logicalDevice, transferPool, 1, &batch.transferCmd);
+			if (dedicatedTransfer)
+			{
+				vkFreeCommandBuffers(device->logicalDevice, graphicsPool, 1, &batch.graphicsCmd);
+				freeSemaphores.push_back(batch.semaphore);
+			}
+			VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &batch.fence));
+			freeFences.push_back(batch.fence);
+			for (auto& staging : batch.dedicatedStaging)
+			{
+				staging.destroy();
+			}
+			lastCompleted = batch.ticket;
+			// The ring is released up to the start of the oldest batch that still uses it
+			for (auto& other : inFlight)
+			{
+				if ((&other != &batch) && other.usesRing)
+				{
+					ringTail = other.ringBegin;
+					return;
+				}
+			}
+			if (recording.usesRing)
+			{
+				ringTail = recording.ringBegin;
+			}
+		}
+
+		VkFence getFence()
+		{
+			if (!freeFences.empty())
+			{
+				VkFence fence = freeFences.back();
+				freeFences.pop_back();
+				return fence;
+			}
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+			VkFence fence;
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &fence));
+			return fence;
+		}
+
+		VkSemaphore getSemaphore()
+		{
+			if (!freeSemaphores.empty())
+			{
+				VkSemaphore semaphore = freeSemaphores.back();
+				freeSemaphores.pop_back();
+				return semaphore;
+			}
+			VkSemaphoreCreateInfo semaphoreInfo = vks::initializers::semaphoreCreateInfo();
+			VkSemaphore semaphore;
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreInfo, nullptr, &semaphore));
+			return semaphore;
+		}
+	};
+}
@@ -9,12 +9,22 @@
 #pragma once
 
 #include <stdlib.h>
+#include <cstddef>
 #include <string>
 #include <fstream>
 #include <vector>
+#include <chrono>
+#include <iostream>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.hpp"
+#include "VulkanUploadQueue.hpp"
+#include "VulkanIndirectDraw.hpp"
+#include "bvh.hpp"
+#include "meshoptimize.hpp"
+#include "accessordecode.hpp"
+#include "mappedfile.hpp"
+#include "animation.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -43,7 +53,7 @@ namespace vkglTF
 		vks::VulkanDevice *device;
 		VkImage image;
 		VkImageLayout imageLayout;
-		VkDeviceMemory deviceMemory;
+		vks::Allocation allocation;
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
@@ -62,7 +72,7 @@ namespace vkglTF
 		{
 			vkDestroyImageView(device->logicalDevice, view, nullptr);
 			vkDestroyImage(device->logicalDevice, image, nullptr);
-			vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+			allocation.free();
 			vkDestroySampler(device->logicalDevice, sampler, nullptr);
 		}
 
@@ -110,30 +120,8 @@ namespace vkglTF
 			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 
-			VkMemoryAllocateInfo memAllocInfo{};
-			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 			VkMemoryRequirements memReqs{};
 
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
-
-			VkBufferCreateInfo bufferCreateInfo{};
-			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-			bufferCreateInfo.size = bufferSize;
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-			uint8_t *data;
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, buffer, bufferSize);
-			vkUnmapMemory(device->logicalDevice, stagingMemory);
-
 			VkImageCreateInfo imageCreateInfo{};
 			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -149,30 +137,14 @@ namespace vkglTF
 			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VK_CHECK_RESULT(device->memoryAllocator->allocate(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation, vks::ALLOCATION_RESOURCE_OPTIMAL));
+			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, allocation.memory, allocation.offset));
 
 			VkImageSubresourceRange subresourceRange = {};
 			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			subresourceRange.levelCount = 1;
 			subresourceRange.layerCount = 1;
 
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = subresourceRange;
-				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-
 			VkBufferImageCopy bufferCopyRegion = {};
 			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			bufferCopyRegion.imageSubresource.mipLevel = 0;
@@ -182,27 +154,13 @@ namespace vkglTF
 			bufferCopyRegion.imageExtent.height = height;
 			bufferCopyRegion.imageExtent.depth = 1;
 
-			vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = subresourceRange;
-				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-
-			device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-			vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+			// Upload the base level through the shared upload queue, it ends up in transfer source layout for the blits below
+			vks::UploadQueue *uploadQueue = vks::UploadQueue::getShared(device, copyQueue);
+			uploadQueue->uploadImage(image, buffer, bufferSize, { bufferCopyRegion }, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
 
 			// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-			VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			// Blits need a graphics queue, so they are recorded into the graphics side of the upload batch
+			VkCommandBuffer blitCmd = uploadQueue->getGraphicsCommandBuffer();
 			for (uint32_t i = 1; i < mipLevels; i++) {
 				VkImageBlit imageBlit{};
 
@@ -268,8 +226,6 @@ namespace vkglTF
 				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
 
-			device->flushCommandBuffer(blitCmd, copyQueue, true);
-
 			VkSamplerCreateInfo samplerInfo{};
 			samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 			samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -334,6 +290,13 @@ namespace vkglTF
 		uint32_t firstIndex;
 		uint32_t indexCount;
 		Material &material;
+		/** @brief Index of the primitive's item in the model's bounding volume hierarchy (see Model::buildBvh) */
+		uint32_t bvhItem = UINT32_MAX;
+		/** @brief Range of the model's vertex buffer used by the primitive */
+		uint32_t vertexBase = 0;
+		uint32_t vertexCount = 0;
+		/** @brief Levels of detail from the primitive's own indices (level 0) to the coarsest one (see Model::lodSettings) */
+		std::vector<vks::mesh::LodLevel> lods;
 
 		struct Dimensions {
 			glm::vec3 min = glm::vec3(FLT_MAX);
@@ -365,7 +328,7 @@ namespace vkglTF
 
 		struct UniformBuffer {
 			VkBuffer buffer;
-			VkDeviceMemory memory;
+			vks::Allocation memory;
 			VkDescriptorBufferInfo descriptor;
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 			void *mapped;
@@ -387,13 +350,13 @@ namespace vkglTF
 				&uniformBuffer.buffer,
 				&uniformBuffer.memory,
 				&uniformBlock));
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
+			uniformBuffer.mapped = uniformBuffer.memory.mapped;
 			uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
 		};
 
 		~Mesh() {
 			vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
+			uniformBuffer.memory.free();
 		}
 
 	};
@@ -406,6 +369,8 @@ namespace vkglTF
 		Node *skeletonRoot = nullptr;
 		std::vector<glm::mat4> inverseBindMatrices;
 		std::vector<Node*> joints;
+		/** @brief Indices of the joints in Model::hierarchy */
+		std::vector<uint32_t> jointIndices;
 	};
 
 	/*
@@ -423,11 +388,16 @@ namespace vkglTF
 		glm::vec3 translation{};
 		glm::vec3 scale{ 1.0f };
 		glm::quat rotation{};
+		/** @brief Set whenever translation, rotation, scale or matrix change, the next Model::updateNodes recomputes the subtree */
+		bool dirty = true;
+		/** @brief Index of the node's matrices in Model::hierarchy, stable for the lifetime of the model */
+		uint32_t hierarchyIndex = 0;
 
 		glm::mat4 localMatrix() {
 			return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
 		}
 
+		/** @brief World matrix computed by walking up the parents, Model::worldMatrix returns the one of the last Model::updateNodes */
 		glm::mat4 getMatrix() {
 			glm::mat4 m = localMatrix();
 			vkglTF::Node *p = parent;
@@ -438,6 +408,7 @@ namespace vkglTF
 			return m;
 		}
 
+		/** @brief Update the uniform buffers of the subtree from scratch (walks up the parents for every node and joint, Model::updateNodes updates all nodes in one pass) */
 		void update() {
 			if (mesh) {
 				glm::mat4 m = getMatrix();
@@ -481,6 +452,8 @@ namespace vkglTF
 		PathType path;
 		Node *node;
 		uint32_t samplerIndex;
+		/** @brief Keyframe interval of the last sample, see vks::animation::findKeyframe */
+		uint32_t cursor = 0;
 	};
 
 	/*
@@ -510,8 +483,8 @@ namespace vkglTF
 	struct Model {
 
 		vks::VulkanDevice *device;
-		VkDescriptorPool descriptorPool;
-		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 
 		struct Vertex {
 			glm::vec3 pos;
@@ -522,18 +495,28 @@ namespace vkglTF
 		};
 
 		struct Vertices {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			vks::Allocation memory;
 		} vertices;
 		struct Indices {
 			int count;
-			VkBuffer buffer;
-			VkDeviceMemory memory;
+			/** @brief 16 bit indices if the model has fewer than 65536 vertices */
+			VkIndexType type = VK_INDEX_TYPE_UINT32;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			vks::Allocation memory;
 		} indices;
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
 
+		/**
+		* Local and world matrices of all nodes in parent before child order, indexed by Node::hierarchyIndex (see updateNodes)
+		* The world matrices are contiguous, so they can be uploaded with a single copy of hierarchy.worldMatrices
+		*/
+		vks::animation::Hierarchy hierarchy;
+		/** @brief Nodes in hierarchy order */
+		std::vector<Node*> hierarchyNodes;
+
 		std::vector<Skin*> skins;
 
 		std::vector<Texture> textures;
@@ -548,16 +531,37 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		/** @brief Hierarchy over the world space bounds of all primitives, built by buildBvh */
+		vks::Bvh bvh;
+		struct BvhItem {
+			Node *node;
+			Primitive *primitive;
+		};
+		std::vector<BvhItem> bvhItems;
+
 		bool metallicRoughnessWorkflow = true;
 
+		/** @brief Time spent in loadFromFile (in ms) and the parts of it spent parsing the file and decoding and staging the accessors */
+		struct LoadTimes {
+			double total = 0.0;
+			double parse = 0.0;
+			double decode = 0.0;
+		} loadTimes;
+
+		/**
+		* Loading generates a chain of simplified levels of detail for each primitive if the level count is not 0 (see drawVisibleLod)
+		* Skinned primitives are simplified in their bind pose
+		*/
+		static inline vks::mesh::LodSettings lodSettings;
+
 		Model() {};
 
 		~Model() 
 		{
 			vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
+			vertices.memory.free();
 			vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+			indices.memory.free();
 			for (auto texture : textures) {
 				texture.destroy();
 			}
@@ -568,7 +572,14 @@ namespace vkglTF
 			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
 		}
 
-		void loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
+		/** @brief Accessors of a primitive and the ranges of the vertex and index buffer it's decoded into (see decodePrimitives) */
+		struct PrimitiveSource {
+			const tinygltf::Primitive *primitive;
+			uint32_t vertexStart;
+			uint32_t indexStart;
+		};
+
+		void loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<PrimitiveSource> &primitiveSources, uint32_t &vertexCount, uint32_t &indexCount, float globalscale)
 		{
 			vkglTF::Node *newNode = new Node{};
 			newNode->index = nodeIndex;
@@ -603,13 +614,13 @@ namespace vkglTF
 			// Node with children
 			if (node.children.size() > 0) {
 				for (auto i = 0; i < node.children.size(); i++) {
-					loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, indexBuffer, vertexBuffer, globalscale);
+					loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, primitiveSources, vertexCount, indexCount, globalscale);
 				}
 			}
 
 			// Node contains mesh data
 			if (node.mesh > -1) {
-				const tinygltf::Mesh mesh = model.meshes[node.mesh];
+				const tinygltf::Mesh &mesh = model.meshes[node.mesh];
 				Mesh *newMesh = new Mesh(device, newNode->matrix);
 				newMesh->name = mesh.name;
 				for (size_t j = 0; j < mesh.primitives.size(); j++) {
@@ -617,108 +628,22 @@ namespace vkglTF
 					if (primitive.indices < 0) {
 						continue;
 					}
-					uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
-					uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
-					uint32_t indexCount = 0;
-					glm::vec3 posMin{};
-					glm::vec3 posMax{};
-					bool hasSkin = false;
-					// Vertices
-					{
-						const float *bufferPos = nullptr;
-						const float *bufferNormals = nullptr;
-						const float *bufferTexCoords = nullptr;
-						const uint16_t *bufferJoints = nullptr;
-						const float *bufferWeights = nullptr;
-
-						// Position attribute is required
-						assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-						const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-						const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-						bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-						posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-						posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-
-						if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-							const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-							const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-							bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-						}
-
-						if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-							const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-							const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-							bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-						}
-
-						// Skinning
-						// Joints
-						if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-							const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-							const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-							bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
-						}
-
-						if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-							const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-							const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-							bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-						}
-
-						hasSkin = (bufferJoints && bufferWeights);
-
-						for (size_t v = 0; v < posAccessor.count; v++) {
-							Vertex vert{};
-							vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-							vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-							vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
-							
-							vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-							vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-							vertexBuffer.push_back(vert);
-						}
-					}
-					// Indices
-					{
-						const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-						const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-						const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
-
-						indexCount = static_cast<uint32_t>(accessor.count);
-
-						switch (accessor.componentType) {
-						case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-							uint32_t *buf = new uint32_t[accessor.count];
-							memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-							for (size_t index = 0; index < accessor.count; index++) {
-								indexBuffer.push_back(buf[index] + vertexStart);
-							}
-							break;
-						}
-						case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-							uint16_t *buf = new uint16_t[accessor.count];
-							memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
-							for (size_t index = 0; index < accessor.count; index++) {
-								indexBuffer.push_back(buf[index] + vertexStart);
-							}
-							break;
-						}
-						case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-							uint8_t *buf = new uint8_t[accessor.count];
-							memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
-							for (size_t index = 0; index < accessor.count; index++) {
-								indexBuffer.push_back(buf[index] + vertexStart);
-							}
-							break;
-						}
-						default:
-							std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-							return;
-						}
-					}
-					Primitive *newPrimitive = new Primitive(indexStart, indexCount, materials[primitive.material]);
+					// Position attribute is required
+					assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
+					const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+					const glm::vec3 posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
+					const glm::vec3 posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
+
+					// Only the ranges are reserved here, all primitives are decoded at once after the hierarchy has been loaded
+					const uint32_t primitiveVertexCount = static_cast<uint32_t>(posAccessor.count);
+					const uint32_t primitiveIndexCount = static_cast<uint32_t>(model.accessors[primitive.indices].count);
+					Primitive *newPrimitive = new Primitive(indexCount, primitiveIndexCount, materials[primitive.material]);
 					newPrimitive->setDimensions(posMin, posMax);
+					newPrimitive->vertexBase = vertexCount;
+					newPrimitive->vertexCount = primitiveVertexCount;
+					primitiveSources.push_back({ &primitive, vertexCount, indexCount });
+					vertexCount += primitiveVertexCount;
+					indexCount += primitiveIndexCount;
 					newMesh->primitives.push_back(newPrimitive);
 				}
 				newNode->mesh = newMesh;
@@ -930,8 +855,158 @@ namespace vkglTF
 			}
 		}
 
+		// Generates the level of detail chain of each primitive (in parallel on the device's job system if set), the indices of all levels are appended to the index buffer
+		void generateLods(std::vector<uint32_t> &indexBuffer, const std::vector<Vertex> &vertexBuffer)
+		{
+			std::vector<Primitive*> primitives;
+			for (auto node : linearNodes) {
+				if (node->mesh) {
+					primitives.insert(primitives.end(), node->mesh->primitives.begin(), node->mesh->primitives.end());
+				}
+			}
+
+			std::vector<std::vector<uint32_t>> lodIndices(primitives.size());
+			auto generate = [&](uint32_t i) {
+				Primitive *primitive = primitives[i];
+				primitive->lods = { { primitive->firstIndex, primitive->indexCount, 0.0f } };
+				if ((lodSettings.levelCount == 0) || (primitive->indexCount == 0)) {
+					return;
+				}
+				const float *vertices = reinterpret_cast<const float*>(vertexBuffer.data() + primitive->vertexBase);
+				std::vector<uint32_t> local(indexBuffer.begin() + primitive->firstIndex, indexBuffer.begin() + primitive->firstIndex + primitive->indexCount);
+				for (uint32_t &index : local) {
+					index -= primitive->vertexBase;
+				}
+				std::vector<vks::mesh::LodLevel> levels;
+				vks::mesh::generateLods(local.data(), local.size(), vertices, sizeof(Vertex) / sizeof(float), primitive->vertexCount, offsetof(Vertex, pos) / sizeof(float),
+					lodSettings, primitive->dimensions.radius, lodIndices[i], levels);
+				for (uint32_t &index : lodIndices[i]) {
+					index += primitive->vertexBase;
+				}
+				primitive->lods.insert(primitive->lods.end(), levels.begin(), levels.end());
+			};
+			if (device->jobSystem && (primitives.size() > 1)) {
+				device->jobSystem->parallel_for(static_cast<uint32_t>(primitives.size()), 1, [&](uint32_t first, uint32_t last) {
+					for (uint32_t i = first; i < last; i++) {
+						generate(i);
+					}
+				});
+			} else {
+				for (uint32_t i = 0; i < static_cast<uint32_t>(primitives.size()); i++) {
+					generate(i);
+				}
+			}
+
+			for (size_t i = 0; i < primitives.size(); i++) {
+				const uint32_t firstIndex = static_cast<uint32_t>(indexBuffer.size());
+				for (size_t level = 1; level < primitives[i]->lods.size(); level++) {
+					primitives[i]->lods[level].firstIndex += firstIndex;
+				}
+				indexBuffer.insert(indexBuffer.end(), lodIndices[i].begin(), lodIndices[i].end());
+			}
+		}
+
+		// Converts count elements of an accessor starting at first into floats (dstStride floats apart)
+		// Accessors without a buffer view are all zero, sparse accessors are not supported
+		static void readAccessor(const tinygltf::Model &model, const tinygltf::Accessor &accessor, uint32_t componentCount, size_t first, size_t count, float *dst, size_t dstStride)
+		{
+			if (accessor.bufferView < 0) {
+				for (size_t i = 0; i < count; i++) {
+					std::fill(dst + i * dstStride, dst + i * dstStride + componentCount, 0.0f);
+				}
+				return;
+			}
+			const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
+			const size_t stride = static_cast<size_t>(accessor.ByteStride(bufferView));
+			const uint8_t *src = model.buffers[bufferView.buffer].data.data() + bufferView.byteOffset + accessor.byteOffset + first * stride;
+			componentCount = std::min(componentCount, static_cast<uint32_t>(tinygltf::GetNumComponentsInType(accessor.type)));
+			vks::accessor::decodeFloat(src, stride, accessor.componentType, accessor.normalized, componentCount, count, dst, dstStride);
+		}
+
+		// Decodes the vertices of a primitive in small blocks that are copied to dst as a whole, so dst may be write combined staging memory
+		static void decodeVertices(const tinygltf::Model &model, const tinygltf::Primitive &primitive, Vertex *dst)
+		{
+			auto findAccessor = [&](const char *name) -> const tinygltf::Accessor* {
+				auto attribute = primitive.attributes.find(name);
+				return (attribute != primitive.attributes.end()) ? &model.accessors[attribute->second] : nullptr;
+			};
+			const tinygltf::Accessor *position = findAccessor("POSITION");
+			const tinygltf::Accessor *normal = findAccessor("NORMAL");
+			const tinygltf::Accessor *uv = findAccessor("TEXCOORD_0");
+			const tinygltf::Accessor *joints = findAccessor("JOINTS_0");
+			const tinygltf::Accessor *weights = findAccessor("WEIGHTS_0");
+			const bool hasSkin = joints && weights;
+
+			constexpr size_t blockSize = 256;
+			constexpr size_t stride = sizeof(Vertex) / sizeof(float);
+			Vertex block[blockSize];
+			for (size_t first = 0; first < position->count; first += blockSize) {
+				const size_t count = std::min(blockSize, position->count - first);
+				std::fill(block, block + count, Vertex{});
+				readAccessor(model, *position, 3, first, count, &block[0].pos.x, stride);
+				if (normal) {
+					readAccessor(model, *normal, 3, first, count, &block[0].normal.x, stride);
+					for (size_t v = 0; v < count; v++) {
+						const float length = glm::length(block[v].normal);
+						if (length > 0.0f) {
+							block[v].normal /= length;
+						}
+					}
+				}
+				if (uv) {
+					readAccessor(model, *uv, 2, first, count, &block[0].uv.x, stride);
+				}
+				if (hasSkin) {
+					readAccessor(model, *joints, 4, first, count, &block[0].joint0.x, stride);
+					readAccessor(model, *weights, 4, first, count, &block[0].weight0.x, stride);
+				}
+				memcpy(dst + first, block, count * sizeof(Vertex));
+			}
+		}
+
+		template <typename T>
+		static void decodeIndices(const tinygltf::Model &model, const tinygltf::Primitive &primitive, uint32_t vertexBase, T *dst)
+		{
+			const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
+			const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
+			const uint8_t *src = model.buffers[bufferView.buffer].data.data() + bufferView.byteOffset + accessor.byteOffset;
+			if (!vks::accessor::decodeIndices(src, static_cast<size_t>(accessor.ByteStride(bufferView)), accessor.componentType, accessor.count, vertexBase, dst)) {
+				std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
+				std::fill(dst, dst + accessor.count, static_cast<T>(vertexBase));
+			}
+		}
+
+		// Decodes the vertices and indices of all primitives into their ranges of vertices and indices, primitives are decoded in parallel on the device's job system (if set)
+		template <typename T>
+		void decodePrimitives(const tinygltf::Model &model, const std::vector<PrimitiveSource> &primitiveSources, Vertex *vertices, T *indices)
+		{
+			auto decode = [&](uint32_t first, uint32_t last) {
+				for (uint32_t i = first; i < last; i++) {
+					const PrimitiveSource &source = primitiveSources[i];
+					if (vertices) {
+						decodeVertices(model, *source.primitive, vertices + source.vertexStart);
+					}
+					if (indices) {
+						decodeIndices(model, *source.primitive, source.vertexStart, indices + source.indexStart);
+					}
+				}
+			};
+			if (device->jobSystem && (primitiveSources.size() > 1)) {
+				device->jobSystem->parallel_for(static_cast<uint32_t>(primitiveSources.size()), 1, decode);
+			} else {
+				decode(0, static_cast<uint32_t>(primitiveSources.size()));
+			}
+		}
+
+		/**
+		* Load a glTF model, either a .gltf file (with embedded or external buffers) or a binary .glb file
+		*
+		* Binary files are memory mapped instead of being read into memory. Without level of detail generation, vertices and
+		* indices are decoded straight into the staging memory of the upload queue, otherwise into CPU side buffers first.
+		*/
 		void loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, float scale = 1.0f)
 		{
+			auto tStart = std::chrono::high_resolution_clock::now();
 			tinygltf::Model gltfModel;
 			tinygltf::TinyGLTF gltfContext;
 			std::string error, warning;
@@ -947,13 +1022,29 @@ namespace vkglTF
 			AAsset_read(asset, fileData, size);
 			AAsset_close(asset);
 			std::string baseDir;
-			bool fileLoaded = gltfContext.LoadASCIIFromString(&gltfModel, &error, &warning, fileData, size, baseDir);
-			free(fileData);
+			const bool binary = (size >= 4) && (memcmp(fileData, "glTF", 4) == 0);
+			bool fileLoaded = binary ?
+				gltfContext.LoadBinaryFromMemory(&gltfModel, &error, &warning, reinterpret_cast<const unsigned char*>(fileData), static_cast<unsigned int>(size), baseDir) :
+				gltfContext.LoadASCIIFromString(&gltfModel, &error, &warning, fileData, static_cast<unsigned int>(size), baseDir);
+			delete[] fileData;
 #else
-			bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+			// Binary files start with the "glTF" magic
+			vks::MappedFile file(filename);
+			const bool binary = file.isOpen() && (file.size() >= 4) && (memcmp(file.data(), "glTF", 4) == 0);
+			bool fileLoaded;
+			if (binary) {
+				const size_t separator = filename.find_last_of("/\\");
+				const std::string baseDir = (separator != std::string::npos) ? filename.substr(0, separator) : "";
+				fileLoaded = gltfContext.LoadBinaryFromMemory(&gltfModel, &error, &warning, file.data(), static_cast<unsigned int>(file.size()), baseDir);
+			} else {
+				file.close();
+				fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+			}
 #endif
-			std::vector<uint32_t> indexBuffer;
-			std::vector<Vertex> vertexBuffer;
+			loadTimes.parse = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::vector<PrimitiveSource> primitiveSources;
+			uint32_t vertexCount = 0;
+			uint32_t indexCount = 0;
 
 			if (fileLoaded) {
 				loadImages(gltfModel, device, transferQueue);
@@ -961,7 +1052,7 @@ namespace vkglTF
 				const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
 				for (size_t i = 0; i < scene.nodes.size(); i++) {
 					const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-					loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+					loadNode(nullptr, node, scene.nodes[i], gltfModel, primitiveSources, vertexCount, indexCount, scale);
 				}
 				if (gltfModel.animations.size() > 0) {
 					loadAnimations(gltfModel);
@@ -973,11 +1064,10 @@ namespace vkglTF
 					if (node->skinIndex > -1) {
 						node->skin = skins[node->skinIndex];
 					}
-					// Initial pose
-					if (node->mesh) {
-						node->update();
-					}
 				}
+				buildHierarchy();
+				// Initial pose
+				updateNodes();
 			}
 			else {
 				// TODO: throw
@@ -992,34 +1082,28 @@ namespace vkglTF
 				}
 			}
 
-			size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-			size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-			indices.count = static_cast<uint32_t>(indexBuffer.size());
+			// Indices include the vertex base of their primitive, so 16 bit indices require the whole model to have fewer than 65536 vertices
+			indices.type = (vertexCount <= 65536) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+			const size_t indexSize = (indices.type == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
 
-			assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+			// Level of detail generation needs the decoded data on the CPU, otherwise it's decoded straight into the staging memory
+			auto tDecode = std::chrono::high_resolution_clock::now();
+			std::vector<uint32_t> indexBuffer;
+			std::vector<Vertex> vertexBuffer;
+			const bool decodeToStaging = (lodSettings.levelCount == 0);
+			if (!decodeToStaging) {
+				vertexBuffer.resize(vertexCount);
+				indexBuffer.resize(indexCount);
+				decodePrimitives(gltfModel, primitiveSources, vertexBuffer.data(), indexBuffer.data());
+			}
+			// Without level of detail generation this only sets up the full resolution level of each primitive
+			generateLods(indexBuffer, vertexBuffer);
+			indices.count = decodeToStaging ? indexCount : static_cast<uint32_t>(indexBuffer.size());
 
-			struct StagingBuffer {
-				VkBuffer buffer;
-				VkDeviceMemory memory;
-			} vertexStaging, indexStaging;
+			size_t vertexBufferSize = static_cast<size_t>(vertexCount) * sizeof(Vertex);
+			size_t indexBufferSize = static_cast<size_t>(indices.count) * indexSize;
 
-			// Create staging buffers
-			// Vertex data
-			VK_CHECK_RESULT(device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				vertexBufferSize,
-				&vertexStaging.buffer,
-				&vertexStaging.memory,
-				vertexBuffer.data()));
-			// Index data
-			VK_CHECK_RESULT(device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				indexBufferSize,
-				&indexStaging.buffer,
-				&indexStaging.memory,
-				indexBuffer.data()));
+			assert((vertexBufferSize > 0) && (indexBufferSize > 0));
 
 			// Create device local buffers
 			// Vertex buffer
@@ -1037,23 +1121,31 @@ namespace vkglTF
 				&indices.buffer,
 				&indices.memory));
 
-			// Copy from staging buffers
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			VkBufferCopy copyRegion = {};
-
-			copyRegion.size = vertexBufferSize;
-			vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
-
-			copyRegion.size = indexBufferSize;
-			vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
-
-			device->flushCommandBuffer(copyCmd, transferQueue, true);
-
-			vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+			// Vertex and index data go into the same upload batch as the images, submitted once for the whole model without waiting
+			vks::UploadQueue *uploadQueue = vks::UploadQueue::getShared(device, transferQueue);
+			if (decodeToStaging) {
+				uploadQueue->uploadBuffer(vertices.buffer, vertexBufferSize, [&](void *staging) {
+					decodePrimitives<uint32_t>(gltfModel, primitiveSources, static_cast<Vertex*>(staging), nullptr);
+				});
+				uploadQueue->uploadBuffer(indices.buffer, indexBufferSize, [&](void *staging) {
+					if (indices.type == VK_INDEX_TYPE_UINT16) {
+						decodePrimitives(gltfModel, primitiveSources, nullptr, static_cast<uint16_t*>(staging));
+					} else {
+						decodePrimitives(gltfModel, primitiveSources, nullptr, static_cast<uint32_t*>(staging));
+					}
+				});
+			} else {
+				uploadQueue->uploadBuffer(vertices.buffer, vertexBuffer.data(), vertexBufferSize);
+				if (indices.type == VK_INDEX_TYPE_UINT16) {
+					std::vector<uint16_t> indexBuffer16(indexBuffer.begin(), indexBuffer.end());
+					uploadQueue->uploadBuffer(indices.buffer, indexBuffer16.data(), indexBufferSize);
+				} else {
+					uploadQueue->uploadBuffer(indices.buffer, indexBuffer.data(), indexBufferSize);
+				}
+			}
+			uploadQueue->flush();
+			loadTimes.decode = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tDecode).count();
+			loadTimes.total = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 
 			getSceneDimensions();
 
@@ -1083,34 +1175,201 @@ namespace vkglTF
 			}
 		}
 
-		void drawNode(Node *node, VkCommandBuffer commandBuffer)
+		void drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0)
 		{
 			if (node->mesh) {
 				for (Primitive *primitive : node->mesh->primitives) {
-					vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+					vkCmdDrawIndexed(commandBuffer, primitive->indexCount, instanceCount, primitive->firstIndex, 0, firstInstance);
 				}
 			}
 			for (auto& child : node->children) {
-				drawNode(child, commandBuffer);
+				drawNode(child, commandBuffer, instanceCount, firstInstance);
 			}
 		}
 
-		void draw(VkCommandBuffer commandBuffer)
+		/**
+		* Draw all nodes of the model, one indexed draw per primitive covering all instances
+		*
+		* @param instanceCount (Optional) Number of instances drawn by each primitive's draw
+		* @param firstInstance (Optional) Instance index of the first instance
+		*
+		* @note Vertex data is bound to binding 0, per-instance data has to be bound to another binding (or read from a storage buffer) by the caller
+		*/
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0)
 		{
 			const VkDeviceSize offsets[1] = { 0 };
 			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
+			for (auto& node : nodes) {
+				drawNode(node, commandBuffer, instanceCount, firstInstance);
+			}
+		}
+
+		void appendNodeDrawCommands(Node *node, vks::IndirectDrawBuffer &indirectDraws, std::vector<glm::mat4> *drawMatrices, uint32_t &drawInstance)
+		{
+			if (node->mesh) {
+				const glm::mat4 &matrix = worldMatrix(node);
+				for (Primitive *primitive : node->mesh->primitives) {
+					// The per-draw data index is passed as first instance, so gl_InstanceIndex (or an instance rate binding) selects the draw's data
+					indirectDraws.add(primitive->indexCount, primitive->firstIndex, 0, 1, drawMatrices ? static_cast<uint32_t>(drawMatrices->size()) : drawInstance++);
+					if (drawMatrices) {
+						drawMatrices->push_back(matrix);
+					}
+				}
+			}
+			for (auto& child : node->children) {
+				appendNodeDrawCommands(child, indirectDraws, drawMatrices, drawInstance);
+			}
+		}
+
+		/**
+		* Append one indexed draw command per primitive of all nodes to an indirect draw buffer
+		*
+		* Replaces the per-primitive draws of draw() with a single indirect draw (see vks::IndirectDrawBuffer::draw).
+		* Each command's first instance indexes its per-draw data, this requires the drawIndirectFirstInstance feature.
+		*
+		* @param drawMatrices (Optional) Receives the world matrix of the node for each appended command, each command's first instance is the index of its matrix
+		* (so several models can append to the same buffer and matrix array)
+		* @param firstInstance (Optional) First instance of the first command if no drawMatrices are passed, the following commands count up from it
+		*
+		* @return Index of the first appended command
+		*/
+		uint32_t appendDrawCommands(vks::IndirectDrawBuffer &indirectDraws, std::vector<glm::mat4> *drawMatrices = nullptr, uint32_t firstInstance = 0)
+		{
+			const uint32_t firstDraw = indirectDraws.size();
+			for (auto& node : nodes) {
+				appendNodeDrawCommands(node, indirectDraws, drawMatrices, firstInstance);
+			}
+			return firstDraw;
+		}
+
+		vks::Bvh::Bounds getPrimitiveBounds(const Primitive *primitive, const glm::mat4 &matrix)
+		{
+			vks::Bvh::Bounds bounds;
+			bounds.min = primitive->dimensions.min;
+			bounds.max = primitive->dimensions.max;
+			return bounds.transformed(matrix);
+		}
+
+		void addNodeBvhItems(Node *node, std::vector<vks::Bvh::Bounds> &itemBounds)
+		{
+			if (node->mesh) {
+				const glm::mat4 &matrix = worldMatrix(node);
+				for (Primitive *primitive : node->mesh->primitives) {
+					primitive->bvhItem = static_cast<uint32_t>(bvhItems.size());
+					bvhItems.push_back({ node, primitive });
+					itemBounds.push_back(getPrimitiveBounds(primitive, matrix));
+				}
+			}
+			for (auto& child : node->children) {
+				addNodeBvhItems(child, itemBounds);
+			}
+		}
+
+		/**
+		* Build the bounding volume hierarchy over the world space bounds of all primitives for hierarchical frustum culling
+		*
+		* Once built, updateAnimation refits the bounds of the animated subtrees. Skinned primitives keep the bounds of their bind pose.
+		*/
+		void buildBvh()
+		{
+			bvhItems.clear();
+			std::vector<vks::Bvh::Bounds> itemBounds;
 			for (auto& node : nodes) {
-				drawNode(node, commandBuffer);
+				addNodeBvhItems(node, itemBounds);
+			}
+			bvh.build(itemBounds);
+		}
+
+		void updateNodeBvhItems(Node *node)
+		{
+			// The subtree is the contiguous range of nodes up to the subtree end in hierarchy order
+			for (uint32_t i = node->hierarchyIndex; i < hierarchy.subtreeEnds[node->hierarchyIndex]; i++) {
+				if (hierarchyNodes[i]->mesh) {
+					for (Primitive *primitive : hierarchyNodes[i]->mesh->primitives) {
+						bvh.setItemBounds(primitive->bvhItem, getPrimitiveBounds(primitive, hierarchy.worldMatrices[i]));
+					}
+				}
+			}
+		}
+
+		/**
+		* Collect the primitives that are (partially) inside of the frustum using the bounding volume hierarchy
+		*
+		* @param visibleItems Receives the indices into bvhItems of the visible primitives
+		*
+		* @return Number of bounding box tests performed
+		*/
+		uint32_t cullPrimitives(const vks::Frustum &frustum, std::vector<uint32_t> &visibleItems) const
+		{
+			assert(!bvhItems.empty());
+			return bvh.cull(frustum, visibleItems);
+		}
+
+		/**
+		* Draw the primitives visible in the frustum, one indexed draw per primitive
+		*
+		* @note Requires buildBvh, bindings as for draw()
+		*/
+		void drawVisible(VkCommandBuffer commandBuffer, const vks::Frustum &frustum, uint32_t instanceCount = 1, uint32_t firstInstance = 0)
+		{
+			const VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
+			bvh.cull(frustum, [this, commandBuffer, instanceCount, firstInstance](uint32_t item) {
+				const Primitive *primitive = bvhItems[item].primitive;
+				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, instanceCount, primitive->firstIndex, 0, firstInstance);
+			});
+		}
+
+		/**
+		* Select the level of detail of a node's primitive for a viewer
+		*
+		* @param viewPosition Position of the viewer in world space
+		* @param screenScale Pixels per world unit at distance 1 (see vks::mesh::lodScreenScale)
+		* @param pixelThreshold Largest allowed projected error in pixels
+		*/
+		vks::mesh::LodLevel selectLod(Node *node, const Primitive *primitive, const glm::vec3 &viewPosition, float screenScale, float pixelThreshold = 1.0f)
+		{
+			if (primitive->lods.size() <= 1) {
+				return { primitive->firstIndex, primitive->indexCount, 0.0f };
 			}
+			// Errors are in model units, the largest axis scale of the node keeps the selection conservative
+			const glm::mat4 &matrix = worldMatrix(node);
+			const float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+			const glm::vec3 center = glm::vec3(matrix * glm::vec4(primitive->dimensions.center, 1.0f));
+			const float distance = std::max(glm::distance(viewPosition, center) - primitive->dimensions.radius * scale, 0.0f);
+			return primitive->lods[vks::mesh::selectLod(primitive->lods.data(), static_cast<uint32_t>(primitive->lods.size()), distance, screenScale * scale, pixelThreshold)];
+		}
+
+		/**
+		* Draw the primitives visible in the frustum at the level of detail selected for the viewer (see selectLod)
+		*
+		* @note Requires buildBvh, bindings as for draw()
+		*
+		* @return Number of triangles drawn per instance
+		*/
+		uint32_t drawVisibleLod(VkCommandBuffer commandBuffer, const vks::Frustum &frustum, const glm::vec3 &viewPosition, float screenScale, float pixelThreshold = 1.0f,
+			uint32_t instanceCount = 1, uint32_t firstInstance = 0)
+		{
+			const VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
+			uint32_t triangleCount = 0;
+			bvh.cull(frustum, [&](uint32_t item) {
+				const vks::mesh::LodLevel lod = selectLod(bvhItems[item].node, bvhItems[item].primitive, viewPosition, screenScale, pixelThreshold);
+				vkCmdDrawIndexed(commandBuffer, lod.indexCount, instanceCount, lod.firstIndex, 0, firstInstance);
+				triangleCount += lod.indexCount / 3;
+			});
+			return triangleCount;
 		}
 
 		void getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
 		{
 			if (node->mesh) {
 				for (Primitive *primitive : node->mesh->primitives) {
-					glm::vec4 locMin = glm::vec4(primitive->dimensions.min, 1.0f) * node->getMatrix();
-					glm::vec4 locMax = glm::vec4(primitive->dimensions.max, 1.0f) * node->getMatrix();
+					glm::vec4 locMin = glm::vec4(primitive->dimensions.min, 1.0f) * worldMatrix(node);
+					glm::vec4 locMax = glm::vec4(primitive->dimensions.max, 1.0f) * worldMatrix(node);
 					if (locMin.x < min.x) { min.x = locMin.x; }
 					if (locMin.y < min.y) { min.y = locMin.y; }
 					if (locMin.z < min.z) { min.z = locMin.z; }
@@ -1145,50 +1404,134 @@ namespace vkglTF
 			Animation &animation = animations[index];
 
 			bool updated = false;
+			std::vector<Node*> animatedNodes;
 			for (auto& channel : animation.channels) {
 				vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
 				if (sampler.inputs.size() > sampler.outputsVec4.size()) {
 					continue;
 				}
-
-				for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-					if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-						float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-						if (u <= 1.0f) {
-							switch (channel.path) {
-							case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-								glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-								channel.node->translation = glm::vec3(trans);
-								break;
-							}
-							case vkglTF::AnimationChannel::PathType::SCALE: {
-								glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-								channel.node->scale = glm::vec3(trans);
-								break;
-							}
-							case vkglTF::AnimationChannel::PathType::ROTATION: {
-								glm::quat q1;
-								q1.x = sampler.outputsVec4[i].x;
-								q1.y = sampler.outputsVec4[i].y;
-								q1.z = sampler.outputsVec4[i].z;
-								q1.w = sampler.outputsVec4[i].w;
-								glm::quat q2;
-								q2.x = sampler.outputsVec4[i + 1].x;
-								q2.y = sampler.outputsVec4[i + 1].y;
-								q2.z = sampler.outputsVec4[i + 1].z;
-								q2.w = sampler.outputsVec4[i + 1].w;
-								channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-								break;
-							}
-							}
-							updated = true;
-						}
-					}
+				if (!vks::animation::findKeyframe(sampler.inputs.data(), static_cast<uint32_t>(sampler.inputs.size()), time, channel.cursor)) {
+					continue;
+				}
+				const uint32_t i = channel.cursor;
+				const float span = sampler.inputs[i + 1] - sampler.inputs[i];
+				const float u = (span > 0.0f) ? std::max(0.0f, time - sampler.inputs[i]) / span : 1.0f;
+				switch (channel.path) {
+				case vkglTF::AnimationChannel::PathType::TRANSLATION: {
+					glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
+					channel.node->translation = glm::vec3(trans);
+					break;
+				}
+				case vkglTF::AnimationChannel::PathType::SCALE: {
+					glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
+					channel.node->scale = glm::vec3(trans);
+					break;
+				}
+				case vkglTF::AnimationChannel::PathType::ROTATION: {
+					glm::quat q1;
+					q1.x = sampler.outputsVec4[i].x;
+					q1.y = sampler.outputsVec4[i].y;
+					q1.z = sampler.outputsVec4[i].z;
+					q1.w = sampler.outputsVec4[i].w;
+					glm::quat q2;
+					q2.x = sampler.outputsVec4[i + 1].x;
+					q2.y = sampler.outputsVec4[i + 1].y;
+					q2.z = sampler.outputsVec4[i + 1].z;
+					q2.w = sampler.outputsVec4[i + 1].w;
+					channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
+					break;
+				}
+				}
+				channel.node->dirty = true;
+				updated = true;
+				if (!bvhItems.empty()) {
+					animatedNodes.push_back(channel.node);
 				}
 			}
 			if (updated) {
-				for (auto &node : nodes) {
-					node->update();
+				updateNodes();
+				// Only the subtrees below animated nodes can have moved
+				if (!animatedNodes.empty()) {
+					std::sort(animatedNodes.begin(), animatedNodes.end());
+					animatedNodes.erase(std::unique(animatedNodes.begin(), animatedNodes.end()), animatedNodes.end());
+					for (Node *node : animatedNodes) {
+						updateNodeBvhItems(node);
+					}
+					bvh.refit();
+				}
+			}
+		}
+
+		/** @brief Flatten the node tree into the hierarchy and assign the hierarchy indices of nodes and skin joints */
+		void buildHierarchy()
+		{
+			hierarchyNodes = hierarchy.build(nodes);
+			for (uint32_t i = 0; i < hierarchy.size(); i++) {
+				hierarchyNodes[i]->hierarchyIndex = i;
+				hierarchyNodes[i]->dirty = true;
+			}
+			for (Skin *skin : skins) {
+				skin->jointIndices.clear();
+				for (const Node *joint : skin->joints) {
+					skin->jointIndices.push_back(joint->hierarchyIndex);
+				}
+			}
+		}
+
+		/** @brief World matrix of a node as of the last updateNodes */
+		const glm::mat4& worldMatrix(const Node *node) const
+		{
+			return hierarchy.worldMatrices[node->hierarchyIndex];
+		}
+
+		/** @brief Write the world matrix (and the joint matrices of skinned meshes) of a node into its mesh's uniform buffer */
+		void updateMesh(Node *node)
+		{
+			assert(node->mesh);
+			Mesh *mesh = node->mesh;
+			const glm::mat4 &m = worldMatrix(node);
+			if (node->skin) {
+				const Skin *skin = node->skin;
+				mesh->uniformBlock.matrix = m;
+				glm::mat4 inverseTransform = glm::inverse(m);
+				for (size_t i = 0; i < skin->jointIndices.size(); i++) {
+					mesh->uniformBlock.jointMatrix[i] = inverseTransform * hierarchy.worldMatrices[skin->jointIndices[i]] * skin->inverseBindMatrices[i];
+				}
+				mesh->uniformBlock.jointcount = (float)skin->jointIndices.size();
+				memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
+			} else {
+				memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
+			}
+		}
+
+		/**
+		* Recompute the world matrices of all nodes whose local transform changed (see Node::dirty) and of their descendants,
+		* then update the uniform buffers of the meshes that moved or whose skin joints moved
+		*
+		* World matrices are resolved in one pass over the hierarchy, large hierarchies are split across the device's job system
+		*
+		* @note Has to be called after changing node transforms outside of updateAnimation
+		*/
+		void updateNodes()
+		{
+			for (uint32_t i = 0; i < hierarchy.size(); i++) {
+				Node *node = hierarchyNodes[i];
+				if (node->dirty) {
+					hierarchy.setLocalMatrix(i, node->localMatrix());
+					node->dirty = false;
+				}
+			}
+			hierarchy.update(device ? device->jobSystem : nullptr);
+			for (Node *node : hierarchyNodes) {
+				if (!node->mesh) {
+					continue;
+				}
+				bool moved = hierarchy.changed(node->hierarchyIndex);
+				if (!moved && node->skin) {
+					moved = std::any_of(node->skin->jointIndices.begin(), node->skin->jointIndices.end(), [this](uint32_t joint) { return hierarchy.changed(joint); });
+				}
+				if (moved) {
+					updateMesh(node);
 				}
 			}
 		}
@@ -0,0 +1,205 @@
+/*
+* Decoding of glTF style accessors (strided arrays of integer or float components) into interleaved vertex and index data
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "simd.hpp"
+
+namespace vks
+{
+	namespace accessor
+	{
+		/** @brief Component types, values match the glTF (and GL) enums */
+		enum ComponentType {
+			COMPONENT_BYTE = 5120,
+			COMPONENT_UNSIGNED_BYTE = 5121,
+			COMPONENT_SHORT = 5122,
+			COMPONENT_UNSIGNED_SHORT = 5123,
+			COMPONENT_UNSIGNED_INT = 5125,
+			COMPONENT_FLOAT = 5126
+		};
+
+		/** @brief Size of a component in bytes, 0 for unknown types */
+		inline uint32_t componentSize(int componentType)
+		{
+			switch (componentType) {
+			case COMPONENT_BYTE:
+			case COMPONENT_UNSIGNED_BYTE:
+				return 1;
+			case COMPONENT_SHORT:
+			case COMPONENT_UNSIGNED_SHORT:
+				return 2;
+			case COMPONENT_UNSIGNED_INT:
+			case COMPONENT_FLOAT:
+				return 4;
+			default:
+				return 0;
+			}
+		}
+
+		namespace detail
+		{
+			inline float toFloat(const uint8_t *src, int componentType, bool normalized)
+			{
+				switch (componentType) {
+				case COMPONENT_BYTE: {
+					const float v = static_cast<float>(static_cast<int8_t>(*src));
+					return normalized ? std::max(v / 127.0f, -1.0f) : v;
+				}
+				case COMPONENT_UNSIGNED_BYTE: {
+					const float v = static_cast<float>(*src);
+					return normalized ? v / 255.0f : v;
+				}
+				case COMPONENT_SHORT: {
+					int16_t s;
+					memcpy(&s, src, sizeof(s));
+					return normalized ? std::max(static_cast<float>(s) / 32767.0f, -1.0f) : static_cast<float>(s);
+				}
+				case COMPONENT_UNSIGNED_SHORT: {
+					uint16_t s;
+					memcpy(&s, src, sizeof(s));
+					return normalized ? static_cast<float>(s) / 65535.0f : static_cast<float>(s);
+				}
+				case COMPONENT_UNSIGNED_INT: {
+					uint32_t s;
+					memcpy(&s, src, sizeof(s));
+					return normalized ? static_cast<float>(static_cast<double>(s) / 4294967295.0) : static_cast<float>(s);
+				}
+				default: {
+					float f;
+					memcpy(&f, src, sizeof(f));
+					return f;
+				}
+				}
+			}
+
+#if defined(VKS_SIMD_X86)
+			// Converts the 8 and 16 bit components of one element (up to four) at once, sign extension by unpacking into the upper half and shifting back
+			inline __m128 toFloat4(const uint8_t *src, int componentType, uint32_t componentCount, __m128 scale, bool clampSigned)
+			{
+				__m128i v;
+				if (componentType == COMPONENT_BYTE || componentType == COMPONENT_UNSIGNED_BYTE) {
+					int32_t bytes = 0;
+					memcpy(&bytes, src, componentCount);
+					v = _mm_cvtsi32_si128(bytes);
+					if (componentType == COMPONENT_BYTE) {
+						v = _mm_unpacklo_epi8(v, v);
+						v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+					} else {
+						v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, _mm_setzero_si128()), _mm_setzero_si128());
+					}
+				} else {
+					int64_t shorts = 0;
+					memcpy(&shorts, src, componentCount * sizeof(uint16_t));
+					v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&shorts));
+					if (componentType == COMPONENT_SHORT) {
+						v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+					} else {
+						v = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+					}
+				}
+				__m128 f = _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+				return clampSigned ? _mm_max_ps(f, _mm_set1_ps(-1.0f)) : f;
+			}
+#endif
+		}
+
+		/**
+		* Convert the elements of an accessor to floats
+		*
+		* @param src First element of the accessor
+		* @param srcStride Distance between elements in bytes (the buffer view's byte stride, or the element size for tightly packed data)
+		* @param componentType Type of the components (see ComponentType)
+		* @param normalized Integer components are mapped to [0, 1] (unsigned) or [-1, 1] (signed)
+		* @param componentCount Number of components per element (1 to 4)
+		* @param count Number of elements
+		* @param dst First float written
+		* @param dstStride Distance between the destination elements in floats (e.g. the size of an interleaved vertex)
+		*/
+		inline void decodeFloat(const uint8_t *src, size_t srcStride, int componentType, bool normalized, uint32_t componentCount, size_t count, float *dst, size_t dstStride)
+		{
+			if (componentType == COMPONENT_FLOAT) {
+				const size_t elementSize = componentCount * sizeof(float);
+				for (size_t i = 0; i < count; i++) {
+					memcpy(dst + i * dstStride, src + i * srcStride, elementSize);
+				}
+				return;
+			}
+#if defined(VKS_SIMD_X86)
+			if (componentType != COMPONENT_UNSIGNED_INT) {
+				float scale = 1.0f;
+				if (normalized) {
+					switch (componentType) {
+					case COMPONENT_BYTE: scale = 1.0f / 127.0f; break;
+					case COMPONENT_UNSIGNED_BYTE: scale = 1.0f / 255.0f; break;
+					case COMPONENT_SHORT: scale = 1.0f / 32767.0f; break;
+					default: scale = 1.0f / 65535.0f; break;
+					}
+				}
+				const bool clampSigned = normalized && ((componentType == COMPONENT_BYTE) || (componentType == COMPONENT_SHORT));
+				const __m128 scale4 = _mm_set1_ps(scale);
+				alignas(16) float result[4];
+				for (size_t i = 0; i < count; i++) {
+					_mm_store_ps(result, detail::toFloat4(src + i * srcStride, componentType, componentCount, scale4, clampSigned));
+					memcpy(dst + i * dstStride, result, componentCount * sizeof(float));
+				}
+				return;
+			}
+#endif
+			const uint32_t size = componentSize(componentType);
+			for (size_t i = 0; i < count; i++) {
+				for (uint32_t c = 0; c < componentCount; c++) {
+					dst[i * dstStride + c] = detail::toFloat(src + i * srcStride + c * size, componentType, normalized);
+				}
+			}
+		}
+
+		/**
+		* Convert an index accessor, adding a vertex base to each index
+		*
+		* @param src First index
+		* @param srcStride Distance between indices in bytes
+		* @param componentType COMPONENT_UNSIGNED_BYTE, COMPONENT_UNSIGNED_SHORT or COMPONENT_UNSIGNED_INT
+		* @param count Number of indices
+		* @param vertexBase Added to every index
+		* @param dst Destination (uint16_t or uint32_t), indices plus vertex base have to fit
+		*
+		* @return False for unsupported component types
+		*/
+		template <typename T>
+		bool decodeIndices(const uint8_t *src, size_t srcStride, int componentType, size_t count, uint32_t vertexBase, T *dst)
+		{
+			switch (componentType) {
+			case COMPONENT_UNSIGNED_BYTE:
+				for (size_t i = 0; i < count; i++) {
+					dst[i] = static_cast<T>(src[i * srcStride] + vertexBase);
+				}
+				return true;
+			case COMPONENT_UNSIGNED_SHORT:
+				for (size_t i = 0; i < count; i++) {
+					uint16_t index;
+					memcpy(&index, src + i * srcStride, sizeof(index));
+					dst[i] = static_cast<T>(index + vertexBase);
+				}
+				return true;
+			case COMPONENT_UNSIGNED_INT:
+				for (size_t i = 0; i < count; i++) {
+					uint32_t index;
+					memcpy(&index, src + i * srcStride, sizeof(index));
+					dst[i] = static_cast<T>(index + vertexBase);
+				}
+				return true;
+			default:
+				return false;
+			}
+		}
+	}
+}
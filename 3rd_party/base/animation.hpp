@@ -0,0 +1,232 @@
+/*
+* Keyframe lookup and node hierarchy updates for node and skeletal animation
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <glm/glm.hpp>
+
+#include "jobsystem.hpp"
+
+namespace vks
+{
+	namespace animation
+	{
+		/**
+		* Find the keyframe interval [inputs[i], inputs[i + 1]] that contains a time
+		*
+		* @param inputs Keyframe times in ascending order
+		* @param count Number of keyframes
+		* @param time Sample time
+		* @param cursor Interval found by the previous lookup of the same channel on input, interval containing the time on output
+		*
+		* @note Playback that stays in the interval of the last lookup or moves on to the next one is resolved in constant time,
+		* seeks (and jumps over more than one keyframe) fall back to a binary search
+		*
+		* @return False if the time lies outside of the keyframes or there are fewer than two of them (cursor is left unchanged)
+		*/
+		inline bool findKeyframe(const float *inputs, uint32_t count, float time, uint32_t &cursor)
+		{
+			if ((count < 2) || !(time >= inputs[0]) || !(time <= inputs[count - 1])) {
+				return false;
+			}
+			const uint32_t last = count - 2;
+			uint32_t i = std::min(cursor, last);
+			if (time >= inputs[i]) {
+				if (time <= inputs[i + 1]) {
+					cursor = i;
+					return true;
+				}
+				if ((i < last) && (time <= inputs[i + 2])) {
+					cursor = i + 1;
+					return true;
+				}
+			}
+			// First keyframe after the time, the interval starts one before it
+			i = static_cast<uint32_t>(std::upper_bound(inputs, inputs + count, time) - inputs);
+			cursor = std::min(i > 0 ? i - 1 : 0, last);
+			return true;
+		}
+
+		/**
+		* @brief Node hierarchy flattened into parent before child order with contiguous local and world matrices
+		*
+		* Nodes are numbered depth first, so every subtree occupies a contiguous index range and one pass in index order
+		* resolves all world matrices. Indices stay stable until the next build, meshes and skin joints can refer to their
+		* world matrices by index and worldMatrices can be uploaded with a single copy.
+		*/
+		class Hierarchy
+		{
+		public:
+			/** @brief Index of the parent node or -1 for roots */
+			std::vector<int32_t> parents;
+			/** @brief One past the last node of the subtree below each node */
+			std::vector<uint32_t> subtreeEnds;
+			std::vector<glm::mat4> localMatrices;
+			std::vector<glm::mat4> worldMatrices;
+			/** @brief updateStamp of the update that last recomputed each world matrix */
+			std::vector<uint32_t> worldStamps;
+			/** @brief Incremented by every update */
+			uint32_t updateStamp = 0;
+			/** @brief Subtrees with more nodes are split into their root (updated first) and the subtrees below it for parallel updates */
+			uint32_t grainSize = 512;
+
+			/**
+			* Flatten a node tree
+			*
+			* @param roots Root nodes, NodeT has to provide children (range of NodeT*)
+			*
+			* @return Nodes in hierarchy order, element i is node i of the hierarchy
+			*
+			* @note All local matrices start as identities marked as changed, set them with setLocalMatrix before the first update
+			*/
+			template <typename NodeT>
+			std::vector<NodeT*> build(const std::vector<NodeT*> &roots)
+			{
+				std::vector<NodeT*> nodes;
+				parents.clear();
+				// Explicit stack instead of recursion, children are pushed in reverse to keep their order
+				std::vector<std::pair<NodeT*, int32_t>> stack;
+				for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+					stack.push_back({ *it, -1 });
+				}
+				while (!stack.empty()) {
+					const std::pair<NodeT*, int32_t> entry = stack.back();
+					stack.pop_back();
+					const int32_t index = static_cast<int32_t>(nodes.size());
+					nodes.push_back(entry.first);
+					parents.push_back(entry.second);
+					for (auto it = entry.first->children.rbegin(); it != entry.first->children.rend(); ++it) {
+						stack.push_back({ *it, index });
+					}
+				}
+
+				const uint32_t count = size();
+				localMatrices.assign(count, glm::mat4(1.0f));
+				worldMatrices.assign(count, glm::mat4(1.0f));
+				worldStamps.assign(count, 0);
+				dirty.assign(count, 1);
+				updateStamp = 0;
+
+				// Children come after their parent, so accumulating backwards yields the subtree sizes
+				std::vector<uint32_t> sizes(count, 1);
+				for (uint32_t i = count; i-- > 0;) {
+					if (parents[i] >= 0) {
+						sizes[parents[i]] += sizes[i];
+					}
+				}
+				subtreeEnds.resize(count);
+				for (uint32_t i = 0; i < count; i++) {
+					subtreeEnds[i] = i + sizes[i];
+				}
+				partition();
+				return nodes;
+			}
+
+			uint32_t size() const
+			{
+				return static_cast<uint32_t>(parents.size());
+			}
+
+			/** @brief Set the local matrix of a node, the next update recomputes the world matrices of its subtree */
+			void setLocalMatrix(uint32_t index, const glm::mat4 &matrix)
+			{
+				localMatrices[index] = matrix;
+				dirty[index] = 1;
+			}
+
+			/** @brief The world matrix of the node was recomputed by the last update */
+			bool changed(uint32_t index) const
+			{
+				return worldStamps[index] == updateStamp;
+			}
+
+			/**
+			* Recompute the world matrices of all nodes whose own or whose ancestors' local matrices changed since the last update
+			*
+			* @param jobSystem (Optional) Job system to update the subtrees below the split nodes in parallel (see grainSize), nullptr runs a single pass on the calling thread
+			*/
+			void update(vks::JobSystem *jobSystem = nullptr)
+			{
+				updateStamp++;
+				if (!jobSystem || (subtrees.size() <= 1)) {
+					updateRange(0, size());
+					return;
+				}
+				// Split nodes are the ancestors of the subtrees, so they are done first
+				for (uint32_t index : splitNodes) {
+					updateNode(index);
+				}
+				jobSystem->parallel_for(static_cast<uint32_t>(subtrees.size()), 1, [this](uint32_t first, uint32_t last) {
+					for (uint32_t i = first; i < last; i++) {
+						updateRange(subtrees[i].first, subtrees[i].second);
+					}
+				});
+			}
+
+		private:
+			std::vector<uint8_t> dirty;
+			/** @brief Roots of the subtrees larger than grainSize in index order */
+			std::vector<uint32_t> splitNodes;
+			/** @brief Index ranges of the subtrees (or runs of sibling subtrees) below the split nodes, each updated by one job */
+			std::vector<std::pair<uint32_t, uint32_t>> subtrees;
+
+			void updateNode(uint32_t index)
+			{
+				const int32_t parent = parents[index];
+				if (dirty[index] || ((parent >= 0) && (worldStamps[parent] == updateStamp))) {
+					worldMatrices[index] = (parent >= 0) ? worldMatrices[parent] * localMatrices[index] : localMatrices[index];
+					worldStamps[index] = updateStamp;
+					dirty[index] = 0;
+				}
+			}
+
+			void updateRange(uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++) {
+					updateNode(i);
+				}
+			}
+
+			void partition()
+			{
+				splitNodes.clear();
+				subtrees.clear();
+				std::vector<uint32_t> pending;
+				for (uint32_t i = 0; i < size(); i = subtreeEnds[i]) {
+					pending.push_back(i);
+				}
+				while (!pending.empty()) {
+					const uint32_t index = pending.back();
+					pending.pop_back();
+					if (subtreeEnds[index] - index > grainSize) {
+						splitNodes.push_back(index);
+						for (uint32_t child = index + 1; child < subtreeEnds[index]; child = subtreeEnds[child]) {
+							pending.push_back(child);
+						}
+					} else {
+						subtrees.push_back({ index, subtreeEnds[index] });
+					}
+				}
+				std::sort(splitNodes.begin(), splitNodes.end());
+				std::sort(subtrees.begin(), subtrees.end());
+				// Runs of adjacent small subtrees (e.g. the leaf joints below a split node) are merged into jobs of up to grainSize nodes
+				size_t merged = 0;
+				for (size_t i = 1; i < subtrees.size(); i++) {
+					if ((subtrees[merged].second == subtrees[i].first) && (subtrees[i].second - subtrees[merged].first <= grainSize)) {
+						subtrees[merged].second = subtrees[i].second;
+					} else {
+						subtrees[++merged] = subtrees[i];
+					}
+				}
+				subtrees.resize(subtrees.empty() ? 0 : merged + 1);
+			}
+		};
+	}
+}
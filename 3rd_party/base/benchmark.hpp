@@ -6,31 +6,250 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <vector>
 #include <string>
+#include <iostream>
 #include <algorithm>
 #include <limits>
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <numeric>
+#include <fstream>
+#include <cmath>
+#include <map>
+#include <set>
+#include <iterator>
+
+#include "vulkan/vulkan.h"
 
 namespace vks
 {
 	class Benchmark {
+	public:
+		/** @brief Summary statistics of a series of per-frame timings (in ms) */
+		struct Statistics {
+			uint32_t count = 0;
+			double min = 0.0;
+			double max = 0.0;
+			double mean = 0.0;
+			double stddev = 0.0;
+			double p50 = 0.0;
+			double p90 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+			/** @brief Number of samples outside of the Tukey fences (more than 1.5 interquartile ranges below the first or above the third quartile) */
+			uint32_t outliers = 0;
+
+			/** @brief Distance of p90 above the median relative to the median, how noisy the samples are */
+			double p90Spread() const {
+				return (p50 > 0.0) ? (p90 / p50 - 1.0) : 0.0;
+			}
+		};
+
+		/** @brief Percentile (0..100) of sorted samples, linearly interpolated between the closest ranks */
+		static double percentile(const std::vector<double> &sorted, double p)
+		{
+			if (sorted.empty()) {
+				return 0.0;
+			}
+			const double rank = (p / 100.0) * (double)(sorted.size() - 1);
+			const size_t lower = (size_t)std::floor(rank);
+			const size_t upper = std::min(lower + 1, sorted.size() - 1);
+			return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - (double)lower);
+		}
+
+		/** @brief Calculate statistics for the samples, NaN entries (e.g. missing GPU timings) are skipped */
+		static Statistics computeStatistics(const std::vector<double> &samples)
+		{
+			Statistics stats;
+			std::vector<double> sorted;
+			sorted.reserve(samples.size());
+			for (double sample : samples) {
+				if (!std::isnan(sample)) {
+					sorted.push_back(sample);
+				}
+			}
+			if (sorted.empty()) {
+				return stats;
+			}
+			std::sort(sorted.begin(), sorted.end());
+			stats.count = static_cast<uint32_t>(sorted.size());
+			stats.min = sorted.front();
+			stats.max = sorted.back();
+			stats.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / (double)sorted.size();
+			if (sorted.size() > 1) {
+				double sumSq = 0.0;
+				for (double sample : sorted) {
+					sumSq += (sample - stats.mean) * (sample - stats.mean);
+				}
+				// Sample standard deviation
+				stats.stddev = std::sqrt(sumSq / (double)(sorted.size() - 1));
+			}
+			stats.p50 = percentile(sorted, 50.0);
+			stats.p90 = percentile(sorted, 90.0);
+			stats.p99 = percentile(sorted, 99.0);
+			stats.p999 = percentile(sorted, 99.9);
+			const double q1 = percentile(sorted, 25.0);
+			const double q3 = percentile(sorted, 75.0);
+			const double iqr = q3 - q1;
+			for (double sample : sorted) {
+				if ((sample < q1 - 1.5 * iqr) || (sample > q3 + 1.5 * iqr)) {
+					stats.outliers++;
+				}
+			}
+			return stats;
+		}
+
+		/**
+		* Time a function on the CPU
+		*
+		* @param repeat Calls per sample, the time of a sample is divided by it (short functions need to be repeated to get above the timer resolution)
+		* @param function Function to measure, called once before the samples to warm up caches
+		* @param samples (Optional) Number of timed samples
+		* @param prepare (Optional) Called before the warm up call and before every sample without being timed (e.g. to reset a cache)
+		*
+		* @return Statistics of the time of one call (in ms)
+		*/
+		static Statistics measure(uint32_t repeat, const std::function<void()> &function, uint32_t samples = 5, const std::function<void()> &prepare = nullptr)
+		{
+			repeat = std::max(repeat, 1u);
+			std::vector<double> times;
+			times.reserve(samples);
+			if (prepare) {
+				prepare();
+			}
+			function();
+			for (uint32_t s = 0; s < samples; s++) {
+				if (prepare) {
+					prepare();
+				}
+				auto tStart = std::chrono::high_resolution_clock::now();
+				for (uint32_t r = 0; r < repeat; r++) {
+					function();
+				}
+				times.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count() / repeat);
+			}
+			return computeStatistics(times);
+		}
+
 	private:
 		FILE *stream;
 		VkPhysicalDeviceProperties deviceProps;
+		// True during the measured phase (after warm up)
+		bool measuring = false;
+
+		void printStatistics(const std::string &name, const Statistics &stats, const std::string &unit = " ms") {
+			std::cout << std::left << std::setw(7) << name << std::right << ": "
+				<< "mean " << stats.mean << unit << ", stddev " << stats.stddev
+				<< ", p50 " << stats.p50 << ", p90 " << stats.p90 << ", p99 " << stats.p99 << ", p99.9 " << stats.p999
+				<< ", min " << stats.min << ", max " << stats.max << ", outliers " << stats.outliers << std::endl;
+		}
+
+		static void writeStatisticsJson(std::ofstream &result, const std::string &name, const Statistics &stats, bool last) {
+			result << "\t\t\"" << name << "\": { "
+				<< "\"count\": " << stats.count << ", "
+				<< "\"min\": " << stats.min << ", "
+				<< "\"max\": " << stats.max << ", "
+				<< "\"mean\": " << stats.mean << ", "
+				<< "\"stddev\": " << stats.stddev << ", "
+				<< "\"p50\": " << stats.p50 << ", "
+				<< "\"p90\": " << stats.p90 << ", "
+				<< "\"p99\": " << stats.p99 << ", "
+				<< "\"p99.9\": " << stats.p999 << ", "
+				<< "\"outliers\": " << stats.outliers << " }" << (last ? "" : ",") << std::endl;
+		}
+
+		static void writeArrayJson(std::ofstream &result, const std::string &name, const std::vector<double> &values, bool last) {
+			result << "\t\"" << name << "\": [";
+			for (size_t i = 0; i < values.size(); i++) {
+				// JSON has no NaN, missing values are written as null
+				if (std::isnan(values[i])) {
+					result << "null";
+				} else {
+					result << values[i];
+				}
+				result << ((i + 1 < values.size()) ? ", " : "");
+			}
+			result << "]" << (last ? "" : ",") << std::endl;
+		}
+
+		static std::string escapeJson(const std::string &str) {
+			std::string escaped;
+			for (char c : str) {
+				if ((c == '"') || (c == '\\')) {
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped;
+		}
+
 	public:
 		bool active = false;
 		bool outputFrameTimes = false;
+		/** @brief Warm up time (in seconds) */
 		uint32_t warmup = 1;
+		/** @brief Benchmark duration (in seconds), ignored if frameLimit is set */
 		uint32_t duration = 10;
+		/** @brief Number of frames to measure (0 = run for duration seconds instead) */
+		uint32_t frameLimit = 0;
+		/** @brief Wall clock time of each measured frame (ms) */
 		std::vector<double> frameTimes;
+		/** @brief CPU time of each measured frame, i.e. the frame time minus the time spent waiting for the GPU and the swap chain (ms) */
+		std::vector<double> cpuTimes;
+		/** @brief GPU time of each measured frame from timestamp queries (ms), NaN if not available */
+		std::vector<double> gpuTimes;
+		/** @brief GPU time of each profiler scope (see vks::GpuProfiler) per measured frame (ms) */
+		std::map<std::string, std::vector<double>> scopeTimes;
+		/** @brief Timings reported by the example itself (e.g. CPU time of a draw path), stored by metric name */
+		std::map<std::string, std::vector<double>> customTimes;
+		/** @brief Names of the custom metrics that are counts instead of timings (see addCount) */
+		std::set<std::string> countNames;
+		/** @brief Time the current frame spent waiting on fences and image acquisition (ms), to be accumulated by the renderer */
+		double waitTime = 0.0;
+		/** @brief Result file name, written as JSON if it ends with ".json" and as CSV otherwise */
 		std::string filename = "";
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		/** @brief Index of the frame that is currently being measured or UINT32_MAX during warm up */
+		uint32_t currentFrameIndex() const {
+			return measuring ? frameCount : std::numeric_limits<uint32_t>::max();
+		}
+
+		/** @brief Store the GPU time of a measured frame, GPU timings become available a few frames later */
+		void setGpuTime(uint32_t frameIndex, double ms) {
+			if (frameIndex < gpuTimes.size()) {
+				gpuTimes[frameIndex] = ms;
+			}
+		}
+
+		/** @brief Store the GPU time of a profiler scope, ignored outside of the measured phase */
+		void addScopeTime(const std::string &name, double ms) {
+			if (measuring) {
+				scopeTimes[name].push_back(ms);
+			}
+		}
+
+		/** @brief Store a timing measured by the example, ignored outside of the measured phase */
+		void addTime(const std::string &name, double ms) {
+			if (measuring) {
+				customTimes[name].push_back(ms);
+			}
+		}
+
+		/** @brief Store a per frame count reported by the example (e.g. visible objects), ignored outside of the measured phase */
+		void addCount(const std::string &name, double value) {
+			if (measuring) {
+				customTimes[name].push_back(value);
+				countNames.insert(name);
+			}
+		}
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
@@ -54,14 +273,19 @@ namespace vks
 
 			// Benchmark phase
 			{
-				while (runtime < (duration * 1000.0)) {
+				measuring = true;
+				while ((frameLimit > 0) ? (frameCount < frameLimit) : (runtime < (duration * 1000.0))) {
+					waitTime = 0.0;
+					gpuTimes.push_back(std::numeric_limits<double>::quiet_NaN());
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
+					cpuTimes.push_back(std::max(tDiff - waitTime, 0.0));
 					frameCount++;
 				};
+				measuring = false;
 				std::cout << "Benchmark finished" << std::endl;
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << std::endl;
 				std::cout << "runtime: " << (runtime / 1000.0) << std::endl;
@@ -70,26 +294,84 @@ namespace vks
 			}
 		}
 
+		/** @brief Print statistics, call once all GPU timings have been stored */
+		void printResults() {
+			printStatistics("frame", computeStatistics(frameTimes));
+			printStatistics("cpu", computeStatistics(cpuTimes));
+			Statistics gpuStats = computeStatistics(gpuTimes);
+			if (gpuStats.count > 0) {
+				printStatistics("gpu", gpuStats);
+			}
+			for (auto& scope : scopeTimes) {
+				printStatistics("scope:" + scope.first, computeStatistics(scope.second));
+			}
+			for (auto& custom : customTimes) {
+				printStatistics(custom.first, computeStatistics(custom.second), countNames.count(custom.first) ? "" : " ms");
+			}
+		}
+
 		void saveResults() {
 			std::ofstream result(filename, std::ios::out);
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << std::endl;
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << std::endl;
+				const Statistics frameStats = computeStatistics(frameTimes);
+				const Statistics cpuStats = computeStatistics(cpuTimes);
+				const Statistics gpuStats = computeStatistics(gpuTimes);
+				const bool json = (filename.size() >= 5) && (filename.compare(filename.size() - 5, 5, ".json") == 0);
+
+				if (json) {
+					result << "{" << std::endl;
+					result << "\t\"device\": \"" << escapeJson(deviceProps.deviceName) << "\"," << std::endl;
+					result << "\t\"driverVersion\": " << deviceProps.driverVersion << "," << std::endl;
+					result << "\t\"runtime\": " << runtime << "," << std::endl;
+					result << "\t\"frames\": " << frameCount << "," << std::endl;
+					result << "\t\"fps\": " << frameCount / (runtime / 1000.0) << "," << std::endl;
+					result << "\t\"metrics\": {" << std::endl;
+					writeStatisticsJson(result, "frame", frameStats, false);
+					writeStatisticsJson(result, "cpu", cpuStats, false);
+					writeStatisticsJson(result, "gpu", gpuStats, scopeTimes.empty() && customTimes.empty());
+					for (auto it = scopeTimes.begin(); it != scopeTimes.end(); ++it) {
+						writeStatisticsJson(result, escapeJson("scope:" + it->first), computeStatistics(it->second), (std::next(it) == scopeTimes.end()) && customTimes.empty());
+					}
+					for (auto it = customTimes.begin(); it != customTimes.end(); ++it) {
+						writeStatisticsJson(result, escapeJson(it->first), computeStatistics(it->second), std::next(it) == customTimes.end());
+					}
+					result << "\t}" << (outputFrameTimes ? "," : "") << std::endl;
+					if (outputFrameTimes) {
+						writeArrayJson(result, "frameTimes", frameTimes, false);
+						writeArrayJson(result, "cpuTimes", cpuTimes, false);
+						writeArrayJson(result, "gpuTimes", gpuTimes, true);
+					}
+					result << "}" << std::endl;
+				} else {
+					result << "device,driverversion,duration (ms),frames,fps" << std::endl;
+					result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << std::endl;
+
+					result << std::endl << "metric,count,min,max,mean,stddev,p50,p90,p99,p99.9,outliers" << std::endl;
+					std::vector<std::pair<std::string, Statistics>> metrics = { { "frame", frameStats }, { "cpu", cpuStats }, { "gpu", gpuStats } };
+					for (auto& scope : scopeTimes) {
+						metrics.push_back({ "scope:" + scope.first, computeStatistics(scope.second) });
+					}
+					for (auto& custom : customTimes) {
+						metrics.push_back({ custom.first, computeStatistics(custom.second) });
+					}
+					for (auto& metric : metrics) {
+						const Statistics &stats = metric.second;
+						result << metric.first << "," << stats.count << "," << stats.min << "," << stats.max << "," << stats.mean << "," << stats.stddev << ","
+							<< stats.p50 << "," << stats.p90 << "," << stats.p99 << "," << stats.p999 << "," << stats.outliers << std::endl;
+					}
 
-				if (outputFrameTimes) {
-					result << std::endl << "frame,ms" << std::endl;
-					for (size_t i = 0; i < frameTimes.size(); i++) {
-						result << i << "," << frameTimes[i] << std::endl;
+					if (outputFrameTimes) {
+						result << std::endl << "frame,ms,cpu ms,gpu ms" << std::endl;
+						for (size_t i = 0; i < frameTimes.size(); i++) {
+							result << i << "," << frameTimes[i] << "," << cpuTimes[i] << ",";
+							if (!std::isnan(gpuTimes[i])) {
+								result << gpuTimes[i];
+							}
+							result << std::endl;
+						}
 					}
-					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
-					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
-					double tAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
-					std::cout << "best   : " << (1000.0 / tMin) << " fps (" << tMin << " ms)" << std::endl;
-					std::cout << "worst  : " << (1000.0 / tMax) << " fps (" << tMax << " ms)" << std::endl;
-					std::cout << "avg    : " << (1000.0 / tAvg) << " fps (" << tAvg << " ms)" << std::endl;
-					std::cout << std::endl;
 				}
 
 				result.flush();
@@ -99,4 +381,4 @@ namespace vks
 			}
 		}
 	};
-}
\ No newline at end of file
+}
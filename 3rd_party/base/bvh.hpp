@@ -0,0 +1,317 @@
+/*
+* Bounding volume hierarchy over axis aligned boxes with incremental refit and frustum traversal
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Binary tree of axis aligned bounding boxes over a set of items (e.g. the primitives of a scene)
+	*
+	* Built top down by splitting at the median item center along the longest axis. The items of every subtree are
+	* contiguous in the item order, so a subtree that is completely inside the frustum is accepted without visiting its nodes.
+	* Moving items only requires a refit: the bounds of the changed leaves and their ancestors are recomputed, the tree
+	* topology is kept (rebuild if items moved far from their original neighbours).
+	*/
+	class Bvh
+	{
+	public:
+		struct Bounds {
+			glm::vec3 min = glm::vec3(FLT_MAX);
+			glm::vec3 max = glm::vec3(-FLT_MAX);
+
+			void grow(const Bounds &bounds)
+			{
+				min = glm::vec3(std::min(min.x, bounds.min.x), std::min(min.y, bounds.min.y), std::min(min.z, bounds.min.z));
+				max = glm::vec3(std::max(max.x, bounds.max.x), std::max(max.y, bounds.max.y), std::max(max.z, bounds.max.z));
+			}
+
+			glm::vec3 center() const
+			{
+				return (min + max) * 0.5f;
+			}
+
+			/** @brief Bounds of the box after transforming it by an affine matrix */
+			Bounds transformed(const glm::mat4 &matrix) const
+			{
+				const glm::vec3 c = center();
+				const glm::vec3 e = (max - min) * 0.5f;
+				Bounds result;
+				for (int i = 0; i < 3; i++) {
+					const float center = matrix[0][i] * c.x + matrix[1][i] * c.y + matrix[2][i] * c.z + matrix[3][i];
+					const float extent = fabsf(matrix[0][i]) * e.x + fabsf(matrix[1][i]) * e.y + fabsf(matrix[2][i]) * e.z;
+					result.min[i] = center - extent;
+					result.max[i] = center + extent;
+				}
+				return result;
+			}
+
+			bool operator==(const Bounds &other) const
+			{
+				return (min.x == other.min.x) && (min.y == other.min.y) && (min.z == other.min.z) && (max.x == other.max.x) && (max.y == other.max.y) && (max.z == other.max.z);
+			}
+		};
+
+		struct Node {
+			Bounds bounds;
+			/** @brief Index of the left child (the right one follows it), 0 for leaves */
+			uint32_t leftChild = 0;
+			/** @brief Range of the subtree's items in itemOrder */
+			uint32_t firstItem = 0;
+			uint32_t itemCount = 0;
+			uint32_t parent = UINT32_MAX;
+		};
+
+		/** @brief Nodes with the root at index 0, children are always stored after their parent */
+		std::vector<Node> nodes;
+		/** @brief Item indices ordered so that the items of each subtree are contiguous */
+		std::vector<uint32_t> itemOrder;
+		/** @brief Maximum number of items in a leaf */
+		uint32_t maxLeafSize = 4;
+
+		/** @brief Build the tree over the bounds of all items (item i has bounds itemBounds[i]) */
+		void build(const std::vector<Bounds> &itemBounds)
+		{
+			this->itemBounds = itemBounds;
+			const uint32_t itemCount = static_cast<uint32_t>(itemBounds.size());
+			nodes.clear();
+			nodes.reserve(itemCount > 0 ? 2 * itemCount : 0);
+			itemOrder.resize(itemCount);
+			itemLeaves.assign(itemCount, 0);
+			dirtyItems.clear();
+			for (uint32_t i = 0; i < itemCount; i++) {
+				itemOrder[i] = i;
+			}
+			if (itemCount == 0) {
+				return;
+			}
+			std::vector<glm::vec3> centers(itemCount);
+			for (uint32_t i = 0; i < itemCount; i++) {
+				centers[i] = itemBounds[i].center();
+			}
+			nodes.emplace_back();
+			nodes[0].itemCount = itemCount;
+			subdivide(0, centers);
+		}
+
+		bool empty() const
+		{
+			return nodes.empty();
+		}
+
+		uint32_t getItemCount() const
+		{
+			return static_cast<uint32_t>(itemBounds.size());
+		}
+
+		const Bounds& getItemBounds(uint32_t item) const
+		{
+			return itemBounds[item];
+		}
+
+		/** @brief Change the bounds of an item, the tree is updated by the next refit */
+		void setItemBounds(uint32_t item, const Bounds &bounds)
+		{
+			if (itemBounds[item] == bounds) {
+				return;
+			}
+			itemBounds[item] = bounds;
+			dirtyItems.push_back(item);
+		}
+
+		/**
+		* Recompute the bounds of all leaves with changed items and of their ancestors
+		*
+		* @return Number of nodes that were updated
+		*/
+		uint32_t refit()
+		{
+			// Children are stored after their parents, so processing the highest index first updates children before parents
+			std::priority_queue<uint32_t> queue;
+			std::vector<bool> queued(nodes.size(), false);
+			for (uint32_t item : dirtyItems) {
+				const uint32_t leaf = itemLeaves[item];
+				if (!queued[leaf]) {
+					queued[leaf] = true;
+					queue.push(leaf);
+				}
+			}
+			dirtyItems.clear();
+			uint32_t updatedCount = 0;
+			while (!queue.empty()) {
+				const uint32_t index = queue.top();
+				queue.pop();
+				Node &node = nodes[index];
+				Bounds bounds;
+				if (node.leftChild == 0) {
+					for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++) {
+						bounds.grow(itemBounds[itemOrder[i]]);
+					}
+				} else {
+					bounds = nodes[node.leftChild].bounds;
+					bounds.grow(nodes[node.leftChild + 1].bounds);
+				}
+				updatedCount++;
+				// Ancestors only change if this node did
+				if (bounds == node.bounds) {
+					continue;
+				}
+				node.bounds = bounds;
+				if ((node.parent != UINT32_MAX) && !queued[node.parent]) {
+					queued[node.parent] = true;
+					queue.push(node.parent);
+				}
+			}
+			return updatedCount;
+		}
+
+		/**
+		* Visit all items whose bounds are not completely outside of the frustum
+		*
+		* Subtrees outside of the frustum are rejected with a single test, subtrees completely inside are accepted without
+		* further tests, planes a node is completely inside of are not tested again for its descendants.
+		*
+		* @param visit Called as visit(uint32_t item) for every visible item
+		*
+		* @return Number of bounding box tests performed (nodes and items)
+		*/
+		template<typename F>
+		uint32_t cull(const Frustum &frustum, const F &visit) const
+		{
+			if (nodes.empty()) {
+				return 0;
+			}
+			const uint32_t allPlanes = (1u << 6) - 1;
+			uint32_t testCount = 0;
+			struct Entry {
+				uint32_t node;
+				uint32_t planeMask;
+			};
+			std::vector<Entry> stack;
+			stack.reserve(64);
+			stack.push_back({ 0, allPlanes });
+			while (!stack.empty()) {
+				const Entry entry = stack.back();
+				stack.pop_back();
+				const Node &node = nodes[entry.node];
+				uint32_t planeMask = entry.planeMask;
+				testCount++;
+				if (!test(frustum, node.bounds, planeMask)) {
+					continue;
+				}
+				if (planeMask == 0) {
+					// Completely inside, all items of the subtree are visible
+					for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++) {
+						visit(itemOrder[i]);
+					}
+				} else if (node.leftChild == 0) {
+					for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++) {
+						uint32_t itemMask = planeMask;
+						testCount++;
+						if (test(frustum, itemBounds[itemOrder[i]], itemMask)) {
+							visit(itemOrder[i]);
+						}
+					}
+				} else {
+					stack.push_back({ node.leftChild + 1, planeMask });
+					stack.push_back({ node.leftChild, planeMask });
+				}
+			}
+			return testCount;
+		}
+
+		/** @brief Collect the indices of all visible items, see cull */
+		uint32_t cull(const Frustum &frustum, std::vector<uint32_t> &visibleItems) const
+		{
+			visibleItems.clear();
+			return cull(frustum, [&visibleItems](uint32_t item) { visibleItems.push_back(item); });
+		}
+
+	private:
+		std::vector<Bounds> itemBounds;
+		/** @brief Leaf node containing each item */
+		std::vector<uint32_t> itemLeaves;
+		std::vector<uint32_t> dirtyItems;
+
+		/**
+		* Test bounds against the planes in the mask (same test as Frustum::classifyBoxes)
+		*
+		* @param planeMask Planes to test, planes the box is completely inside of are removed
+		*
+		* @return False if the box is completely outside of one of the planes
+		*/
+		static bool test(const Frustum &frustum, const Bounds &bounds, uint32_t &planeMask)
+		{
+			const glm::vec3 c = bounds.center();
+			const glm::vec3 e = (bounds.max - bounds.min) * 0.5f;
+			for (uint32_t p = 0; p < 6; p++) {
+				if ((planeMask & (1u << p)) == 0) {
+					continue;
+				}
+				const glm::vec4 &plane = frustum.planes[p];
+				const float distance = (plane.x * c.x) + (plane.y * c.y) + (plane.z * c.z) + plane.w;
+				const float radius = (fabsf(plane.x) * e.x) + (fabsf(plane.y) * e.y) + (fabsf(plane.z) * e.z);
+				if (distance <= -radius) {
+					return false;
+				}
+				if (distance >= radius) {
+					planeMask &= ~(1u << p);
+				}
+			}
+			return true;
+		}
+
+		void subdivide(uint32_t index, const std::vector<glm::vec3> &centers)
+		{
+			const uint32_t firstItem = nodes[index].firstItem;
+			const uint32_t itemCount = nodes[index].itemCount;
+			Bounds bounds, centerBounds;
+			for (uint32_t i = firstItem; i < firstItem + itemCount; i++) {
+				bounds.grow(itemBounds[itemOrder[i]]);
+				const glm::vec3 &center = centers[itemOrder[i]];
+				centerBounds.grow(Bounds{ center, center });
+			}
+			nodes[index].bounds = bounds;
+
+			const glm::vec3 size = centerBounds.max - centerBounds.min;
+			const int axis = (size.x >= size.y) ? ((size.x >= size.z) ? 0 : 2) : ((size.y >= size.z) ? 1 : 2);
+			// Items with the same center can't be separated
+			if ((itemCount <= maxLeafSize) || (size[axis] <= 0.0f)) {
+				for (uint32_t i = firstItem; i < firstItem + itemCount; i++) {
+					itemLeaves[itemOrder[i]] = index;
+				}
+				return;
+			}
+
+			const uint32_t half = itemCount / 2;
+			std::nth_element(itemOrder.begin() + firstItem, itemOrder.begin() + firstItem + half, itemOrder.begin() + firstItem + itemCount,
+				[&centers, axis](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+
+			const uint32_t leftChild = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+			nodes.emplace_back();
+			nodes[index].leftChild = leftChild;
+			nodes[leftChild].parent = index;
+			nodes[leftChild].firstItem = firstItem;
+			nodes[leftChild].itemCount = half;
+			nodes[leftChild + 1].parent = index;
+			nodes[leftChild + 1].firstItem = firstItem + half;
+			nodes[leftChild + 1].itemCount = itemCount - half;
+			subdivide(leftChild, centers);
+			subdivide(leftChild + 1, centers);
+		}
+	};
+}
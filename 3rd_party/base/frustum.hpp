@@ -6,10 +6,17 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
+#include <algorithm>
 #include <array>
 #include <math.h>
+#include <cstdint>
+#include <cstring>
 #include <glm/glm.hpp>
 
+#include "simd.hpp"
+
 namespace vks
 {
 	class Frustum
@@ -18,6 +25,34 @@ namespace vks
 		enum side { LEFT = 0, RIGHT = 1, TOP = 2, BOTTOM = 3, BACK = 4, FRONT = 5 };
 		std::array<glm::vec4, 6> planes;
 
+		/** @brief Result of classifying a bounding volume, volumes that are inside need no further tests of their children */
+		enum Visibility : uint8_t {
+			VISIBILITY_OUTSIDE = 0,
+			VISIBILITY_INTERSECTING = 1,
+			VISIBILITY_INSIDE = 2
+		};
+
+		/** @brief Bounding spheres in structure of arrays layout */
+		struct SphereArrays {
+			const float *centerX;
+			const float *centerY;
+			const float *centerZ;
+			const float *radius;
+		};
+
+		/** @brief Axis aligned bounding boxes in structure of arrays layout */
+		struct BoxArrays {
+			const float *minX;
+			const float *minY;
+			const float *minZ;
+			const float *maxX;
+			const float *maxY;
+			const float *maxZ;
+		};
+
+		/** @brief Highest instruction set used by the batch tests (clamped to what the CPU supports) */
+		simd::Level level = simd::LEVEL_AVX2;
+
 		void update(glm::mat4 matrix)
 		{
 			planes[LEFT].x = matrix[0].w + matrix[0].x;
@@ -68,5 +103,305 @@ namespace vks
 			}
 			return true;
 		}
+
+		/**
+		* Test many spheres against the frustum, 4/8 at a time with the SSE/AVX2 kernels
+		*
+		* @param visibleMask Receives one bit per sphere (bit i % 32 of word i / 32), set if the sphere is not completely outside
+		* (same test as checkSphere), must hold (count + 31) / 32 words
+		*/
+		void cullSpheres(const SphereArrays &spheres, uint32_t count, uint32_t *visibleMask) const
+		{
+			test<false>(spheres, 0, count, visibleMask, nullptr);
+		}
+
+		/** @brief Test many axis aligned boxes against the frustum, see cullSpheres */
+		void cullBoxes(const BoxArrays &boxes, uint32_t count, uint32_t *visibleMask) const
+		{
+			test<false>(boxes, 0, count, visibleMask, nullptr);
+		}
+
+		/**
+		* Test many spheres against the frustum and write the indices of the visible ones
+		*
+		* @param visibleIndices Receives the indices of the visible spheres in ascending order, must hold count entries
+		*
+		* @return Number of visible spheres
+		*/
+		uint32_t compactSpheres(const SphereArrays &spheres, uint32_t count, uint32_t *visibleIndices) const
+		{
+			return compact(spheres, count, visibleIndices);
+		}
+
+		/** @brief Test many axis aligned boxes against the frustum and write the indices of the visible ones, see compactSpheres */
+		uint32_t compactBoxes(const BoxArrays &boxes, uint32_t count, uint32_t *visibleIndices) const
+		{
+			return compact(boxes, count, visibleIndices);
+		}
+
+		/**
+		* Classify many spheres as outside, intersecting or completely inside of the frustum (e.g. for hierarchical culling)
+		*
+		* @param results Receives one classification per sphere, must hold count entries
+		*/
+		void classifySpheres(const SphereArrays &spheres, uint32_t count, Visibility *results) const
+		{
+			classify(spheres, count, results);
+		}
+
+		/** @brief Classify many axis aligned boxes as outside, intersecting or completely inside of the frustum, see classifySpheres */
+		void classifyBoxes(const BoxArrays &boxes, uint32_t count, Visibility *results) const
+		{
+			classify(boxes, count, results);
+		}
+
+	private:
+		/** @brief Objects handled per block by compact and classify (bit masks of one block are kept on the stack) */
+		static const uint32_t blockSize = 1024;
+
+		/**
+		* Write the visible (and if requested inside) bits of the objects [first, last) to bit masks starting at bit 0
+		*/
+		template<bool Inside, typename Arrays>
+		void test(const Arrays &arrays, uint32_t first, uint32_t last, uint32_t *visibleMask, uint32_t *insideMask) const
+		{
+			const uint32_t wordCount = (last - first + 31) / 32;
+			memset(visibleMask, 0, wordCount * sizeof(uint32_t));
+			if (Inside) {
+				memset(insideMask, 0, wordCount * sizeof(uint32_t));
+			}
+			uint32_t i = first;
+#if defined(VKS_SIMD_X86)
+			const simd::Level kernelLevel = simd::selectLevel(level);
+			if (kernelLevel >= simd::LEVEL_AVX2) {
+				i = testAVX2<Inside>(planes.data(), arrays, first, last, visibleMask, insideMask);
+			} else if (kernelLevel >= simd::LEVEL_SSE) {
+				i = testSSE<Inside>(planes.data(), arrays, first, last, visibleMask, insideMask);
+			}
+#endif
+			for (; i < last; i++) {
+				const Visibility visibility = classifyScalar(arrays, i);
+				const uint32_t bit = i - first;
+				if (visibility != VISIBILITY_OUTSIDE) {
+					visibleMask[bit >> 5] |= 1u << (bit & 31);
+				}
+				if (Inside && (visibility == VISIBILITY_INSIDE)) {
+					insideMask[bit >> 5] |= 1u << (bit & 31);
+				}
+			}
+		}
+
+		template<typename Arrays>
+		uint32_t compact(const Arrays &arrays, uint32_t count, uint32_t *visibleIndices) const
+		{
+			uint32_t visibleCount = 0;
+			uint32_t visibleMask[blockSize / 32];
+			for (uint32_t first = 0; first < count; first += blockSize) {
+				const uint32_t last = std::min(first + blockSize, count);
+				test<false>(arrays, first, last, visibleMask, nullptr);
+				for (uint32_t word = 0; word < (last - first + 31) / 32; word++) {
+					for (uint32_t bits = visibleMask[word]; bits != 0; bits &= bits - 1) {
+						visibleIndices[visibleCount++] = first + word * 32 + simd::countTrailingZeros(bits);
+					}
+				}
+			}
+			return visibleCount;
+		}
+
+		template<typename Arrays>
+		void classify(const Arrays &arrays, uint32_t count, Visibility *results) const
+		{
+			uint32_t visibleMask[blockSize / 32];
+			uint32_t insideMask[blockSize / 32];
+			for (uint32_t first = 0; first < count; first += blockSize) {
+				const uint32_t last = std::min(first + blockSize, count);
+				test<true>(arrays, first, last, visibleMask, insideMask);
+				for (uint32_t i = first; i < last; i++) {
+					const uint32_t bit = i - first;
+					const uint32_t visible = (visibleMask[bit >> 5] >> (bit & 31)) & 1;
+					const uint32_t inside = (insideMask[bit >> 5] >> (bit & 31)) & 1;
+					results[i] = static_cast<Visibility>(visible + inside);
+				}
+			}
+		}
+
+		/** @brief Same plane test as checkSphere, inside if the sphere is on the positive side of all planes */
+		Visibility classifyScalar(const SphereArrays &spheres, uint32_t i) const
+		{
+			const float x = spheres.centerX[i], y = spheres.centerY[i], z = spheres.centerZ[i], radius = spheres.radius[i];
+			Visibility visibility = VISIBILITY_INSIDE;
+			for (size_t p = 0; p < planes.size(); p++) {
+				const float distance = (planes[p].x * x) + (planes[p].y * y) + (planes[p].z * z) + planes[p].w;
+				if (distance <= -radius) {
+					return VISIBILITY_OUTSIDE;
+				}
+				if (distance < radius) {
+					visibility = VISIBILITY_INTERSECTING;
+				}
+			}
+			return visibility;
+		}
+
+		/** @brief Box test with center and half extent, the extent projected onto the plane normal acts as radius */
+		Visibility classifyScalar(const BoxArrays &boxes, uint32_t i) const
+		{
+			const float x = (boxes.minX[i] + boxes.maxX[i]) * 0.5f, y = (boxes.minY[i] + boxes.maxY[i]) * 0.5f, z = (boxes.minZ[i] + boxes.maxZ[i]) * 0.5f;
+			const float ex = (boxes.maxX[i] - boxes.minX[i]) * 0.5f, ey = (boxes.maxY[i] - boxes.minY[i]) * 0.5f, ez = (boxes.maxZ[i] - boxes.minZ[i]) * 0.5f;
+			Visibility visibility = VISIBILITY_INSIDE;
+			for (size_t p = 0; p < planes.size(); p++) {
+				const float distance = (planes[p].x * x) + (planes[p].y * y) + (planes[p].z * z) + planes[p].w;
+				const float radius = (fabsf(planes[p].x) * ex) + (fabsf(planes[p].y) * ey) + (fabsf(planes[p].z) * ez);
+				if (distance <= -radius) {
+					return VISIBILITY_OUTSIDE;
+				}
+				if (distance < radius) {
+					visibility = VISIBILITY_INTERSECTING;
+				}
+			}
+			return visibility;
+		}
+
+#if defined(VKS_SIMD_X86)
+		/** @brief Tests blocks of 4 spheres, returns the index of the first sphere left for the scalar tail */
+		template<bool Inside>
+		static uint32_t testSSE(const glm::vec4 *planes, const SphereArrays &spheres, uint32_t first, uint32_t last, uint32_t *visibleMask, uint32_t *insideMask)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			uint32_t i = first;
+			for (; i + 4 <= last; i += 4) {
+				const __m128 x = _mm_loadu_ps(spheres.centerX + i), y = _mm_loadu_ps(spheres.centerY + i), z = _mm_loadu_ps(spheres.centerZ + i);
+				const __m128 radius = _mm_loadu_ps(spheres.radius + i);
+				const __m128 negRadius = _mm_sub_ps(zero, radius);
+				__m128 visible = _mm_cmpeq_ps(zero, zero);
+				__m128 inside = visible;
+				for (uint32_t p = 0; p < 6; p++) {
+					__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), x), _mm_mul_ps(_mm_set1_ps(planes[p].y), y));
+					distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes[p].z), z)), _mm_set1_ps(planes[p].w));
+					visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, negRadius));
+					if (Inside) {
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, radius));
+					}
+				}
+				const uint32_t bit = i - first;
+				visibleMask[bit >> 5] |= static_cast<uint32_t>(_mm_movemask_ps(visible)) << (bit & 31);
+				if (Inside) {
+					insideMask[bit >> 5] |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (bit & 31);
+				}
+			}
+			return i;
+		}
+
+		/** @brief Tests blocks of 4 boxes, returns the index of the first box left for the scalar tail */
+		template<bool Inside>
+		static uint32_t testSSE(const glm::vec4 *planes, const BoxArrays &boxes, uint32_t first, uint32_t last, uint32_t *visibleMask, uint32_t *insideMask)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 half = _mm_set1_ps(0.5f);
+			uint32_t i = first;
+			for (; i + 4 <= last; i += 4) {
+				const __m128 minX = _mm_loadu_ps(boxes.minX + i), minY = _mm_loadu_ps(boxes.minY + i), minZ = _mm_loadu_ps(boxes.minZ + i);
+				const __m128 maxX = _mm_loadu_ps(boxes.maxX + i), maxY = _mm_loadu_ps(boxes.maxY + i), maxZ = _mm_loadu_ps(boxes.maxZ + i);
+				const __m128 x = _mm_mul_ps(_mm_add_ps(minX, maxX), half), y = _mm_mul_ps(_mm_add_ps(minY, maxY), half), z = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+				const __m128 ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half), ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half), ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+				__m128 visible = _mm_cmpeq_ps(zero, zero);
+				__m128 inside = visible;
+				for (uint32_t p = 0; p < 6; p++) {
+					__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), x), _mm_mul_ps(_mm_set1_ps(planes[p].y), y));
+					distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes[p].z), z)), _mm_set1_ps(planes[p].w));
+					__m128 radius = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(fabsf(planes[p].x)), ex), _mm_mul_ps(_mm_set1_ps(fabsf(planes[p].y)), ey));
+					radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(fabsf(planes[p].z)), ez));
+					visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, _mm_sub_ps(zero, radius)));
+					if (Inside) {
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, radius));
+					}
+				}
+				const uint32_t bit = i - first;
+				visibleMask[bit >> 5] |= static_cast<uint32_t>(_mm_movemask_ps(visible)) << (bit & 31);
+				if (Inside) {
+					insideMask[bit >> 5] |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (bit & 31);
+				}
+			}
+			return i;
+		}
+
+		/** @brief Tests blocks of 8 spheres, returns the index of the first sphere left for the scalar tail */
+		template<bool Inside>
+		VKS_TARGET_AVX2 static uint32_t testAVX2(const glm::vec4 *planes, const SphereArrays &spheres, uint32_t first, uint32_t last, uint32_t *visibleMask, uint32_t *insideMask)
+		{
+			const __m256 zero = _mm256_setzero_ps();
+			__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+			for (uint32_t p = 0; p < 6; p++) {
+				planeX[p] = _mm256_set1_ps(planes[p].x);
+				planeY[p] = _mm256_set1_ps(planes[p].y);
+				planeZ[p] = _mm256_set1_ps(planes[p].z);
+				planeW[p] = _mm256_set1_ps(planes[p].w);
+			}
+			uint32_t i = first;
+			for (; i + 8 <= last; i += 8) {
+				const __m256 x = _mm256_loadu_ps(spheres.centerX + i), y = _mm256_loadu_ps(spheres.centerY + i), z = _mm256_loadu_ps(spheres.centerZ + i);
+				const __m256 radius = _mm256_loadu_ps(spheres.radius + i);
+				const __m256 negRadius = _mm256_sub_ps(zero, radius);
+				__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				__m256 inside = visible;
+				for (uint32_t p = 0; p < 6; p++) {
+					const __m256 distance = _mm256_fmadd_ps(planeX[p], x, _mm256_fmadd_ps(planeY[p], y, _mm256_fmadd_ps(planeZ[p], z, planeW[p])));
+					visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, negRadius, _CMP_GT_OQ));
+					if (Inside) {
+						inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, radius, _CMP_GE_OQ));
+					}
+				}
+				const uint32_t bit = i - first;
+				visibleMask[bit >> 5] |= static_cast<uint32_t>(_mm256_movemask_ps(visible)) << (bit & 31);
+				if (Inside) {
+					insideMask[bit >> 5] |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (bit & 31);
+				}
+			}
+			_mm256_zeroupper();
+			return i;
+		}
+
+		/** @brief Tests blocks of 8 boxes, returns the index of the first box left for the scalar tail */
+		template<bool Inside>
+		VKS_TARGET_AVX2 static uint32_t testAVX2(const glm::vec4 *planes, const BoxArrays &boxes, uint32_t first, uint32_t last, uint32_t *visibleMask, uint32_t *insideMask)
+		{
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 half = _mm256_set1_ps(0.5f);
+			__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+			__m256 absX[6], absY[6], absZ[6];
+			for (uint32_t p = 0; p < 6; p++) {
+				planeX[p] = _mm256_set1_ps(planes[p].x);
+				planeY[p] = _mm256_set1_ps(planes[p].y);
+				planeZ[p] = _mm256_set1_ps(planes[p].z);
+				planeW[p] = _mm256_set1_ps(planes[p].w);
+				absX[p] = _mm256_set1_ps(fabsf(planes[p].x));
+				absY[p] = _mm256_set1_ps(fabsf(planes[p].y));
+				absZ[p] = _mm256_set1_ps(fabsf(planes[p].z));
+			}
+			uint32_t i = first;
+			for (; i + 8 <= last; i += 8) {
+				const __m256 minX = _mm256_loadu_ps(boxes.minX + i), minY = _mm256_loadu_ps(boxes.minY + i), minZ = _mm256_loadu_ps(boxes.minZ + i);
+				const __m256 maxX = _mm256_loadu_ps(boxes.maxX + i), maxY = _mm256_loadu_ps(boxes.maxY + i), maxZ = _mm256_loadu_ps(boxes.maxZ + i);
+				const __m256 x = _mm256_mul_ps(_mm256_add_ps(minX, maxX), half), y = _mm256_mul_ps(_mm256_add_ps(minY, maxY), half), z = _mm256_mul_ps(_mm256_add_ps(minZ, maxZ), half);
+				const __m256 ex = _mm256_mul_ps(_mm256_sub_ps(maxX, minX), half), ey = _mm256_mul_ps(_mm256_sub_ps(maxY, minY), half), ez = _mm256_mul_ps(_mm256_sub_ps(maxZ, minZ), half);
+				__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				__m256 inside = visible;
+				for (uint32_t p = 0; p < 6; p++) {
+					const __m256 distance = _mm256_fmadd_ps(planeX[p], x, _mm256_fmadd_ps(planeY[p], y, _mm256_fmadd_ps(planeZ[p], z, planeW[p])));
+					const __m256 radius = _mm256_fmadd_ps(absX[p], ex, _mm256_fmadd_ps(absY[p], ey, _mm256_mul_ps(absZ[p], ez)));
+					visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, _mm256_sub_ps(zero, radius), _CMP_GT_OQ));
+					if (Inside) {
+						inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, radius, _CMP_GE_OQ));
+					}
+				}
+				const uint32_t bit = i - first;
+				visibleMask[bit >> 5] |= static_cast<uint32_t>(_mm256_movemask_ps(visible)) << (bit & 31);
+				if (Inside) {
+					insideMask[bit >> 5] |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (bit & 31);
+				}
+			}
+			_mm256_zeroupper();
+			return i;
+		}
+#endif
 	};
 }
@@ -0,0 +1,433 @@
+/*
+* Work stealing job system
+*
+* Every worker owns a lock-free deque (Chase-Lev) it pushes to and pops from at the bottom,
+* idle workers steal from the top of the other workers' deques
+* Jobs are stored inline in fixed size per-thread job pools, so scheduling a job does not allocate
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+
+namespace vks
+{
+	/** @brief Counts unfinished jobs, used for fork-join style waiting (see JobSystem::wait) */
+	struct JobCounter
+	{
+		std::atomic<uint32_t> count{ 0 };
+
+		/** @brief Returns true once all jobs added with this counter (and their child jobs) have finished */
+		bool isDone() const
+		{
+			return count.load(std::memory_order_acquire) == 0;
+		}
+	};
+
+	/** @brief Type erased callable with inline (small buffer) storage */
+	struct Job
+	{
+		/** @brief Callables up to this size are stored inline, larger ones fall back to a heap allocation */
+		static const size_t storageSize = 48;
+
+		void(*invoke)(void*) = nullptr;
+		void(*destroy)(void*) = nullptr;
+		JobCounter *counter = nullptr;
+		enum State : uint32_t { STATE_FREE, STATE_QUEUED, STATE_RUNNING };
+		// A pool slot is only reused once it is free again
+		std::atomic<uint32_t> state{ STATE_FREE };
+		// Job was allocated on the heap (scheduled from a thread that is not part of the job system)
+		bool heapAllocated = false;
+		alignas(std::max_align_t) unsigned char storage[storageSize];
+
+		template<typename F>
+		void set(F&& function)
+		{
+			typedef typename std::decay<F>::type Function;
+			if (sizeof(Function) <= storageSize && alignof(Function) <= alignof(std::max_align_t)) {
+				new (storage) Function(std::forward<F>(function));
+				invoke = [](void* data) { (*reinterpret_cast<Function*>(data))(); };
+				destroy = [](void* data) { reinterpret_cast<Function*>(data)->~Function(); };
+			} else {
+				*reinterpret_cast<Function**>(storage) = new Function(std::forward<F>(function));
+				invoke = [](void* data) { (**reinterpret_cast<Function**>(data))(); };
+				destroy = [](void* data) { delete *reinterpret_cast<Function**>(data); };
+			}
+		}
+	};
+
+	/**
+	* Fixed size lock-free work stealing deque (Chase-Lev, with the memory orderings from Le et al. 2013)
+	* push and pop must only be called by the owning thread, steal can be called from any thread
+	*/
+	class WorkStealingQueue
+	{
+	private:
+		static const int64_t capacity = 4096;
+		static const int64_t mask = capacity - 1;
+		std::atomic<int64_t> top{ 0 };
+		std::atomic<int64_t> bottom{ 0 };
+		std::atomic<Job*> jobs[capacity];
+
+	public:
+		WorkStealingQueue()
+		{
+			for (auto& job : jobs) {
+				job.store(nullptr, std::memory_order_relaxed);
+			}
+		}
+
+		/** @brief Returns false if the queue is full */
+		bool push(Job* job)
+		{
+			int64_t b = bottom.load(std::memory_order_relaxed);
+			int64_t t = top.load(std::memory_order_acquire);
+			if (b - t >= capacity) {
+				return false;
+			}
+			jobs[b & mask].store(job, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_release);
+			return true;
+		}
+
+		Job* pop()
+		{
+			int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t <= b) {
+				Job* job = jobs[b & mask].load(std::memory_order_relaxed);
+				if (t == b) {
+					// Last job in the queue, race against thieves
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+						job = nullptr;
+					}
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return job;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t b = bottom.load(std::memory_order_acquire);
+			if (t < b) {
+				Job* job = jobs[t & mask].load(std::memory_order_relaxed);
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					return nullptr;
+				}
+				return job;
+			}
+			return nullptr;
+		}
+	};
+
+	/**
+	* Work stealing job system
+	*
+	* The thread that creates the job system takes part in it as worker 0, jobs scheduled from it (or from jobs) go to the deque of the scheduling worker
+	* Jobs scheduled from other threads go to a shared (locked) queue
+	* Waiting on a counter executes other jobs instead of blocking, so jobs may schedule and wait for child jobs
+	*/
+	class JobSystem
+	{
+	private:
+		// Size of each worker's job pool (must be a power of two)
+		static const uint32_t jobPoolSize = 4096;
+
+		struct Worker {
+			WorkStealingQueue queue;
+			std::unique_ptr<Job[]> jobPool{ new Job[jobPoolSize] };
+			uint32_t jobPoolIndex = 0;
+			std::thread thread;
+		};
+
+		struct ThreadContext {
+			const JobSystem *owner = nullptr;
+			uint32_t index = 0;
+		};
+
+		static ThreadContext& threadContext()
+		{
+			static thread_local ThreadContext context;
+			return context;
+		}
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic<bool> running{ true };
+
+		// Queue for jobs scheduled from threads that are not part of the job system
+		std::deque<Job*> sharedQueue;
+		std::mutex sharedQueueMutex;
+		std::atomic<uint32_t> sharedQueueSize{ 0 };
+
+		// Idle workers sleep until new jobs are scheduled
+		std::atomic<uint32_t> queuedJobs{ 0 };
+		std::atomic<uint32_t> sleepingWorkers{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+
+		// Returns the index of the calling worker or -1 if the calling thread is not part of this job system
+		int32_t currentWorker() const
+		{
+			const ThreadContext &context = threadContext();
+			return (context.owner == this) ? (int32_t)context.index : -1;
+		}
+
+		Job* allocateJob(int32_t workerIndex)
+		{
+			if (workerIndex < 0) {
+				Job *job = new Job();
+				job->heapAllocated = true;
+				return job;
+			}
+			Worker &worker = *workers[workerIndex];
+			for (uint32_t i = 0; i < jobPoolSize; i++) {
+				Job *job = &worker.jobPool[worker.jobPoolIndex++ & (jobPoolSize - 1)];
+				// More than jobPoolSize jobs in flight from this worker, help out until the queued job in this slot has been picked up
+				uint32_t state;
+				while ((state = job->state.load(std::memory_order_acquire)) == Job::STATE_QUEUED) {
+					if (!executeNext(workerIndex)) {
+						std::this_thread::yield();
+					}
+				}
+				// Running jobs are skipped, waiting for them could deadlock if the job is further up this thread's stack
+				if (state == Job::STATE_FREE) {
+					return job;
+				}
+			}
+			Job *job = new Job();
+			job->heapAllocated = true;
+			return job;
+		}
+
+		void schedule(Job *job, int32_t workerIndex)
+		{
+			queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+			if ((workerIndex < 0) || !workers[workerIndex]->queue.push(job)) {
+				if (workerIndex >= 0) {
+					// Own deque is full, run the job right away instead
+					queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+					execute(job);
+					return;
+				}
+				std::lock_guard<std::mutex> lock(sharedQueueMutex);
+				sharedQueue.push_back(job);
+				sharedQueueSize.fetch_add(1, std::memory_order_release);
+			}
+			if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				sleepCondition.notify_one();
+			}
+		}
+
+		Job* getJob(int32_t workerIndex)
+		{
+			Job *job = nullptr;
+			if (workerIndex >= 0) {
+				job = workers[workerIndex]->queue.pop();
+			}
+			if (!job && sharedQueueSize.load(std::memory_order_acquire) > 0) {
+				std::lock_guard<std::mutex> lock(sharedQueueMutex);
+				if (!sharedQueue.empty()) {
+					job = sharedQueue.front();
+					sharedQueue.pop_front();
+					sharedQueueSize.fetch_sub(1, std::memory_order_relaxed);
+				}
+			}
+			if (!job) {
+				// Steal from the other workers, starting with the next one to spread contention
+				const uint32_t count = static_cast<uint32_t>(workers.size());
+				const uint32_t start = (workerIndex >= 0) ? (uint32_t)workerIndex + 1 : 0;
+				for (uint32_t i = 0; (i < count) && !job; i++) {
+					const uint32_t victim = (start + i) % count;
+					if ((int32_t)victim != workerIndex) {
+						job = workers[victim]->queue.steal();
+					}
+				}
+			}
+			if (job) {
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		void execute(Job *job)
+		{
+			job->state.store(Job::STATE_RUNNING, std::memory_order_relaxed);
+			job->invoke(job->storage);
+			job->destroy(job->storage);
+			// Child jobs added to the same counter while running have already incremented it, so it only reaches zero once they are done too
+			JobCounter *counter = job->counter;
+			if (job->heapAllocated) {
+				delete job;
+			} else {
+				job->state.store(Job::STATE_FREE, std::memory_order_release);
+			}
+			if (counter) {
+				counter->count.fetch_sub(1, std::memory_order_acq_rel);
+			}
+		}
+
+		bool executeNext(int32_t workerIndex)
+		{
+			Job *job = getJob(workerIndex);
+			if (job) {
+				execute(job);
+				return true;
+			}
+			return false;
+		}
+
+		void workerLoop(uint32_t index)
+		{
+			threadContext().owner = this;
+			threadContext().index = index;
+			while (running.load(std::memory_order_acquire)) {
+				// Spin for a short while before going to sleep, jobs often come in bursts
+				bool executed = false;
+				for (uint32_t spin = 0; (spin < 64) && !executed; spin++) {
+					executed = executeNext(index);
+					if (!executed) {
+						std::this_thread::yield();
+					}
+				}
+				if (!executed) {
+					std::unique_lock<std::mutex> lock(sleepMutex);
+					sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+					sleepCondition.wait(lock, [this] { return (queuedJobs.load(std::memory_order_seq_cst) > 0) || !running.load(std::memory_order_acquire); });
+					sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+				}
+			}
+		}
+
+	public:
+		/**
+		* Create the job system
+		*
+		* @param threadCount Total number of threads executing jobs, including the calling thread (0 = number of hardware threads)
+		*/
+		explicit JobSystem(uint32_t threadCount = 0)
+		{
+			if (threadCount == 0) {
+				threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+			for (uint32_t i = 0; i < threadCount; i++) {
+				workers.push_back(std::unique_ptr<Worker>(new Worker()));
+			}
+			// The creating thread is worker 0
+			threadContext().owner = this;
+			threadContext().index = 0;
+			for (uint32_t i = 1; i < threadCount; i++) {
+				workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+			}
+		}
+
+		~JobSystem()
+		{
+			// Finish all remaining jobs
+			while (queuedJobs.load(std::memory_order_acquire) > 0) {
+				if (!executeNext(currentWorker())) {
+					std::this_thread::yield();
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				running.store(false, std::memory_order_release);
+				sleepCondition.notify_all();
+			}
+			for (auto& worker : workers) {
+				if (worker->thread.joinable()) {
+					worker->thread.join();
+				}
+			}
+			if (threadContext().owner == this) {
+				threadContext().owner = nullptr;
+			}
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		/** @brief Total number of threads executing jobs (including the thread that created the job system) */
+		uint32_t getThreadCount() const
+		{
+			return static_cast<uint32_t>(workers.size());
+		}
+
+		/**
+		* Schedule a job
+		*
+		* @param function Callable to execute, stored inline if it fits into Job::storageSize
+		* @param counter (Optional) Counter incremented now and decremented once the job has finished, pass the parent's counter from inside a job for fork-join
+		*/
+		template<typename F>
+		void run(F&& function, JobCounter *counter = nullptr)
+		{
+			const int32_t workerIndex = currentWorker();
+			Job *job = allocateJob(workerIndex);
+			job->set(std::forward<F>(function));
+			job->counter = counter;
+			job->state.store(Job::STATE_QUEUED, std::memory_order_relaxed);
+			if (counter) {
+				counter->count.fetch_add(1, std::memory_order_relaxed);
+			}
+			schedule(job, workerIndex);
+		}
+
+		/** @brief Wait until all jobs of the counter have finished, executes other jobs while waiting */
+		void wait(JobCounter &counter)
+		{
+			const int32_t workerIndex = currentWorker();
+			while (!counter.isDone()) {
+				if (!executeNext(workerIndex)) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/**
+		* Call function(first, last) for ranges of at most grainSize items covering [0, count) in parallel and wait for all of them
+		*
+		* @note The calling thread executes ranges too
+		*/
+		template<typename F>
+		void parallel_for(uint32_t count, uint32_t grainSize, const F &function)
+		{
+			if (count == 0) {
+				return;
+			}
+			grainSize = std::max(grainSize, 1u);
+			if (count <= grainSize) {
+				function(0u, count);
+				return;
+			}
+			JobCounter counter;
+			for (uint32_t first = 0; first < count; first += grainSize) {
+				const uint32_t last = std::min(first + grainSize, count);
+				run([&function, first, last] { function(first, last); }, &counter);
+			}
+			wait(counter);
+		}
+	};
+}
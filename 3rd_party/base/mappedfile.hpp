@@ -0,0 +1,143 @@
+/*
+* Read-only memory mapped file
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace vks
+{
+	/** @brief Maps a whole file read-only into memory, pages are loaded on first access (no copy into a user buffer) */
+	class MappedFile
+	{
+	private:
+		const uint8_t *mappedData = nullptr;
+		size_t mappedSize = 0;
+#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#endif
+
+	public:
+		MappedFile() {}
+
+		explicit MappedFile(const std::string &filename)
+		{
+			open(filename);
+		}
+
+		~MappedFile()
+		{
+			close();
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/**
+		* Map a file
+		*
+		* @return True if the file could be opened and mapped (empty files can't be mapped)
+		*/
+		bool open(const std::string &filename)
+		{
+			close();
+#if defined(_WIN32)
+			file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			if (file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0)) {
+				close();
+				return false;
+			}
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping == NULL) {
+				close();
+				return false;
+			}
+			mappedData = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			if (mappedData == nullptr) {
+				close();
+				return false;
+			}
+			mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+			int fd = ::open(filename.c_str(), O_RDONLY);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat info;
+			if ((fstat(fd, &info) != 0) || (info.st_size == 0)) {
+				::close(fd);
+				return false;
+			}
+			void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			// The mapping keeps its own reference to the file
+			::close(fd);
+			if (data == MAP_FAILED) {
+				return false;
+			}
+			mappedData = static_cast<const uint8_t*>(data);
+			mappedSize = static_cast<size_t>(info.st_size);
+#endif
+			return true;
+		}
+
+		void close()
+		{
+#if defined(_WIN32)
+			if (mappedData) {
+				UnmapViewOfFile(mappedData);
+			}
+			if (mapping != NULL) {
+				CloseHandle(mapping);
+				mapping = NULL;
+			}
+			if (file != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+				file = INVALID_HANDLE_VALUE;
+			}
+#else
+			if (mappedData) {
+				munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+			}
+#endif
+			mappedData = nullptr;
+			mappedSize = 0;
+		}
+
+		bool isOpen() const
+		{
+			return mappedData != nullptr;
+		}
+
+		const uint8_t* data() const
+		{
+			return mappedData;
+		}
+
+		size_t size() const
+		{
+			return mappedSize;
+		}
+	};
+}
@@ -0,0 +1,822 @@
+/*
+* Index and vertex reordering for post-transform vertex cache reuse, reduced overdraw and vertex fetch locality,
+* quadric error simplification for level of detail chains
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+namespace vks
+{
+	namespace mesh
+	{
+		/** @brief Efficiency of an index order for a FIFO post-transform vertex cache */
+		struct VertexCacheStatistics {
+			/** @brief Number of vertex shader invocations */
+			uint32_t transformedCount = 0;
+			/** @brief Average cache miss ratio: transformed vertices per triangle (0.5 at best, 3 at worst) */
+			float acmr = 0.0f;
+			/** @brief Average transform to vertex ratio: transformed vertices per referenced vertex (1 at best) */
+			float atvr = 0.0f;
+			/** @brief Number of distinct vertices referenced by the indices */
+			uint32_t referencedCount = 0;
+		};
+
+		/**
+		* Simulate a FIFO vertex cache for a triangle list
+		*
+		* @param indices Triangle list indices (in the range [0, vertexCount))
+		* @param cacheSize (Optional) Number of cache entries
+		*/
+		inline VertexCacheStatistics analyzeVertexCache(const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = 16)
+		{
+			VertexCacheStatistics statistics;
+			// A vertex is in the cache if it was inserted less than cacheSize misses ago
+			std::vector<uint32_t> insertedAt(vertexCount, 0);
+			std::vector<bool> referenced(vertexCount, false);
+			uint32_t time = cacheSize + 1;
+			for (size_t i = 0; i < indexCount; i++) {
+				const uint32_t index = indices[i];
+				assert(index < vertexCount);
+				if (time - insertedAt[index] > cacheSize) {
+					insertedAt[index] = time++;
+					statistics.transformedCount++;
+				}
+				if (!referenced[index]) {
+					referenced[index] = true;
+					statistics.referencedCount++;
+				}
+			}
+			statistics.acmr = (indexCount >= 3) ? (float)statistics.transformedCount / (float)(indexCount / 3) : 0.0f;
+			statistics.atvr = (statistics.referencedCount > 0) ? (float)statistics.transformedCount / (float)statistics.referencedCount : 0.0f;
+			return statistics;
+		}
+
+		/**
+		* Reorder triangles for vertex cache reuse (Tipsify, Sander et al. "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+		*
+		* Triangles are emitted in fans around vertices, the next fan center is picked among the vertices of the last fans that
+		* will still be in the cache, so vertices are reused while they are cached independent of the hardware's exact cache size.
+		*
+		* @param destination Receives the reordered indices (must not alias indices)
+		* @param clusters (Optional) Receives the first triangle of each run that started with a cold cache, see optimizeOverdraw
+		*/
+		inline void optimizeVertexCache(uint32_t *destination, const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = 16,
+			std::vector<uint32_t> *clusters = nullptr)
+		{
+			assert(destination != indices);
+			const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+			if (clusters) {
+				clusters->clear();
+			}
+			if (triangleCount == 0) {
+				return;
+			}
+
+			// Triangles adjacent to each vertex
+			std::vector<uint32_t> liveCount(vertexCount, 0);
+			for (size_t i = 0; i < triangleCount * 3; i++) {
+				liveCount[indices[i]]++;
+			}
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveCount[v];
+			}
+			std::vector<uint32_t> adjacency(triangleCount * 3);
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t t = 0; t < triangleCount; t++) {
+				for (uint32_t k = 0; k < 3; k++) {
+					adjacency[fill[indices[t * 3 + k]]++] = t;
+				}
+			}
+
+			std::vector<uint32_t> cacheTime(vertexCount, 0);
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> deadEnd;
+			std::vector<uint32_t> candidates;
+			deadEnd.reserve(triangleCount * 3);
+			uint32_t time = cacheSize + 1;
+			uint32_t cursor = 0;
+			uint32_t outputTriangles = 0;
+
+			// The first fan starts at the first vertex with triangles
+			while ((cursor < vertexCount) && (liveCount[cursor] == 0)) {
+				cursor++;
+			}
+			int64_t fanning = cursor;
+			bool coldStart = true;
+			while (fanning >= 0) {
+				const uint32_t f = static_cast<uint32_t>(fanning);
+				candidates.clear();
+				for (uint32_t a = adjacencyOffsets[f]; a < adjacencyOffsets[f + 1]; a++) {
+					const uint32_t t = adjacency[a];
+					if (emitted[t]) {
+						continue;
+					}
+					if (coldStart && clusters) {
+						clusters->push_back(outputTriangles);
+					}
+					coldStart = false;
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t v = indices[t * 3 + k];
+						destination[outputTriangles * 3 + k] = v;
+						deadEnd.push_back(v);
+						candidates.push_back(v);
+						liveCount[v]--;
+						if (time - cacheTime[v] > cacheSize) {
+							cacheTime[v] = time++;
+						}
+					}
+					emitted[t] = true;
+					outputTriangles++;
+				}
+
+				// Next fan: the candidate with the most remaining triangles that is still cached once they are emitted
+				int64_t best = -1;
+				int64_t bestPriority = -1;
+				for (uint32_t v : candidates) {
+					if (liveCount[v] == 0) {
+						continue;
+					}
+					int64_t priority = 0;
+					if ((time - cacheTime[v]) + 2 * liveCount[v] <= cacheSize) {
+						priority = time - cacheTime[v];
+					}
+					if (priority > bestPriority) {
+						best = v;
+						bestPriority = priority;
+					}
+				}
+				if (best < 0) {
+					// Dead end: recently used vertices first, then the next vertex in input order (the cache is cold again)
+					while (!deadEnd.empty()) {
+						const uint32_t v = deadEnd.back();
+						deadEnd.pop_back();
+						if (liveCount[v] > 0) {
+							best = v;
+							break;
+						}
+					}
+					if (best < 0) {
+						while ((cursor < vertexCount) && (liveCount[cursor] == 0)) {
+							cursor++;
+						}
+						if (cursor < vertexCount) {
+							best = cursor;
+							coldStart = true;
+						}
+					}
+				}
+				fanning = best;
+			}
+			assert(outputTriangles == triangleCount);
+		}
+
+		/**
+		* Reorder clusters of triangles so triangles likely to occlude others are drawn first (Sander et al.)
+		*
+		* The clusters of the vertex cache order are split further where the cache efficiency of the part so far is within
+		* the threshold of the whole mesh, then sorted by how much they face away from the mesh center. Triangles inside a
+		* cluster keep their order, so the cache efficiency stays within the threshold.
+		*
+		* @param indices Indices in vertex cache order, reordered in place
+		* @param positions Vertex positions (3 floats each) with a stride in floats
+		* @param clusters First triangle of each cold cache run as returned by optimizeVertexCache
+		* @param threshold (Optional) Allowed ACMR increase over the vertex cache order, e.g. 1.05 for 5%
+		*/
+		inline void optimizeOverdraw(uint32_t *indices, size_t indexCount, const float *positions, size_t stride, uint32_t vertexCount,
+			const std::vector<uint32_t> &clusters, float threshold = 1.05f, uint32_t cacheSize = 16)
+		{
+			const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+			if ((triangleCount < 2) || clusters.empty()) {
+				return;
+			}
+			const float meshAcmr = analyzeVertexCache(indices, triangleCount * 3, vertexCount, cacheSize).acmr;
+
+			// Soft boundaries inside the hard clusters
+			std::vector<uint32_t> boundaries;
+			std::vector<uint32_t> insertedAt(vertexCount, 0);
+			uint32_t time = cacheSize + 1;
+			for (size_t c = 0; c < clusters.size(); c++) {
+				const uint32_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+				uint32_t start = clusters[c];
+				boundaries.push_back(start);
+				uint32_t transformed = 0;
+				// Start every cluster with a cold cache
+				time += cacheSize + 1;
+				for (uint32_t t = start; t < end; t++) {
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t v = indices[t * 3 + k];
+						if (time - insertedAt[v] > cacheSize) {
+							insertedAt[v] = time++;
+							transformed++;
+						}
+					}
+					const uint32_t clusterTriangles = t - start + 1;
+					if ((t + 1 < end) && ((float)transformed <= threshold * meshAcmr * (float)clusterTriangles)) {
+						start = t + 1;
+						boundaries.push_back(start);
+						transformed = 0;
+						time += cacheSize + 1;
+					}
+				}
+			}
+			if (boundaries.size() < 2) {
+				return;
+			}
+
+			auto position = [&](uint32_t v, uint32_t component) {
+				return positions[(size_t)v * stride + component];
+			};
+
+			// Area weighted centroid of the mesh
+			double meshCenter[3] = { 0.0, 0.0, 0.0 };
+			double meshArea = 0.0;
+			for (uint32_t t = 0; t < triangleCount; t++) {
+				const uint32_t a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+				float e1[3], e2[3], n[3];
+				for (uint32_t k = 0; k < 3; k++) {
+					e1[k] = position(b, k) - position(a, k);
+					e2[k] = position(c, k) - position(a, k);
+				}
+				n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+				n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+				n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+				const float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (uint32_t k = 0; k < 3; k++) {
+					meshCenter[k] += (position(a, k) + position(b, k) + position(c, k)) / 3.0 * area;
+				}
+				meshArea += area;
+			}
+			if (meshArea > 0.0) {
+				for (uint32_t k = 0; k < 3; k++) {
+					meshCenter[k] /= meshArea;
+				}
+			}
+
+			// Clusters facing away from the center are more likely to occlude the rest of the mesh
+			struct Cluster {
+				uint32_t first;
+				uint32_t count;
+				float sortKey;
+			};
+			std::vector<Cluster> sorted(boundaries.size());
+			for (size_t c = 0; c < boundaries.size(); c++) {
+				Cluster &cluster = sorted[c];
+				cluster.first = boundaries[c];
+				cluster.count = ((c + 1 < boundaries.size()) ? boundaries[c + 1] : triangleCount) - cluster.first;
+				double center[3] = { 0.0, 0.0, 0.0 };
+				double normal[3] = { 0.0, 0.0, 0.0 };
+				double area = 0.0;
+				for (uint32_t t = cluster.first; t < cluster.first + cluster.count; t++) {
+					const uint32_t a = indices[t * 3], b = indices[t * 3 + 1], c2 = indices[t * 3 + 2];
+					float e1[3], e2[3];
+					for (uint32_t k = 0; k < 3; k++) {
+						e1[k] = position(b, k) - position(a, k);
+						e2[k] = position(c2, k) - position(a, k);
+					}
+					const double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+					const double triangleArea = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					for (uint32_t k = 0; k < 3; k++) {
+						center[k] += (position(a, k) + position(b, k) + position(c2, k)) / 3.0 * triangleArea;
+						normal[k] += n[k];
+					}
+					area += triangleArea;
+				}
+				const double normalLength = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				cluster.sortKey = 0.0f;
+				if ((area > 0.0) && (normalLength > 0.0)) {
+					double key = 0.0;
+					for (uint32_t k = 0; k < 3; k++) {
+						key += (center[k] / area - meshCenter[k]) * normal[k] / normalLength;
+					}
+					cluster.sortKey = (float)key;
+				}
+			}
+			std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+			std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+			uint32_t *output = indices;
+			for (const Cluster &cluster : sorted) {
+				memcpy(output, source.data() + cluster.first * 3, cluster.count * 3 * sizeof(uint32_t));
+				output += cluster.count * 3;
+			}
+		}
+
+		/**
+		* Reorder vertices in the order of their first use by the indices, so vertex fetches walk the buffer linearly
+		*
+		* Unreferenced vertices are moved behind the referenced ones, the vertex count is unchanged.
+		*
+		* @param vertices Interleaved vertices with a stride in floats, reordered in place
+		* @param indices Remapped in place
+		*
+		* @return Number of referenced vertices
+		*/
+		inline uint32_t optimizeVertexFetch(float *vertices, size_t stride, uint32_t vertexCount, uint32_t *indices, size_t indexCount)
+		{
+			const uint32_t unassigned = UINT32_MAX;
+			std::vector<uint32_t> remap(vertexCount, unassigned);
+			uint32_t next = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				uint32_t &target = remap[indices[i]];
+				if (target == unassigned) {
+					target = next++;
+				}
+				indices[i] = target;
+			}
+			const uint32_t referencedCount = next;
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				if (remap[v] == unassigned) {
+					remap[v] = next++;
+				}
+			}
+
+			std::vector<float> source(vertices, vertices + (size_t)vertexCount * stride);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				memcpy(vertices + (size_t)remap[v] * stride, source.data() + (size_t)v * stride, stride * sizeof(float));
+			}
+			return referencedCount;
+		}
+
+		/** @brief Vertex cache efficiency of a mesh before and after optimizeMesh */
+		struct OptimizeStatistics {
+			VertexCacheStatistics before;
+			VertexCacheStatistics after;
+		};
+
+		/**
+		* Reorder a mesh for post-transform cache reuse (optimizeVertexCache), less overdraw (optimizeOverdraw) and linear vertex fetches (optimizeVertexFetch)
+		*
+		* @param indices Triangle list indices (in the range [0, vertexCount)), reordered and remapped in place
+		* @param vertices Interleaved vertices with a stride in floats, reordered in place
+		* @param positionOffset Offset of the position in a vertex in floats, the overdraw pass is skipped if negative
+		*/
+		inline OptimizeStatistics optimizeMesh(uint32_t *indices, size_t indexCount, float *vertices, size_t stride, uint32_t vertexCount, int32_t positionOffset = 0,
+			uint32_t cacheSize = 16)
+		{
+			OptimizeStatistics statistics;
+			statistics.before = analyzeVertexCache(indices, indexCount, vertexCount, cacheSize);
+			std::vector<uint32_t> optimized(indexCount);
+			std::vector<uint32_t> clusters;
+			optimizeVertexCache(optimized.data(), indices, indexCount, vertexCount, cacheSize, &clusters);
+			if (positionOffset >= 0) {
+				optimizeOverdraw(optimized.data(), indexCount, vertices + positionOffset, stride, vertexCount, clusters, 1.05f, cacheSize);
+			}
+			optimizeVertexFetch(vertices, stride, vertexCount, optimized.data(), indexCount);
+			statistics.after = analyzeVertexCache(optimized.data(), indexCount, vertexCount, cacheSize);
+			std::copy(optimized.begin(), optimized.end(), indices);
+			return statistics;
+		}
+
+		/** @brief One level of detail of a mesh: a range of a shared index buffer and its geometric error */
+		struct LodLevel {
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			/** @brief Estimated distance of the simplified surface from the source surface (in model units, 0 for the source) */
+			float error = 0.0f;
+		};
+
+		/** @brief Parameters of the level of detail chains generated at import */
+		struct LodSettings {
+			/** @brief Number of simplified levels generated per mesh (0 disables generation) */
+			uint32_t levelCount = 0;
+			/** @brief Target triangle count of each level relative to the previous one */
+			float reduction = 0.5f;
+			/** @brief Error bound of every level, relative to the bounding sphere radius of the mesh */
+			float maxError = 0.02f;
+		};
+
+		namespace detail
+		{
+			struct Quadric {
+				double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+				double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+				double c = 0.0;
+				double weight = 0.0;
+
+				// Plane n.p + d = 0 with a unit normal
+				void addPlane(const double n[3], double d, double w)
+				{
+					a00 += w * n[0] * n[0]; a11 += w * n[1] * n[1]; a22 += w * n[2] * n[2];
+					a01 += w * n[0] * n[1]; a02 += w * n[0] * n[2]; a12 += w * n[1] * n[2];
+					b0 += w * n[0] * d; b1 += w * n[1] * d; b2 += w * n[2] * d;
+					c += w * d * d;
+					weight += w;
+				}
+
+				void add(const Quadric &q)
+				{
+					a00 += q.a00; a11 += q.a11; a22 += q.a22; a01 += q.a01; a02 += q.a02; a12 += q.a12;
+					b0 += q.b0; b1 += q.b1; b2 += q.b2;
+					c += q.c;
+					weight += q.weight;
+				}
+
+				// Weighted mean of the squared distances of the point to the planes
+				double error(const float *p) const
+				{
+					const double x = p[0], y = p[1], z = p[2];
+					const double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+					return (weight > 0.0) ? std::max(e, 0.0) / weight : 0.0;
+				}
+			};
+
+			inline void cross(const double a[3], const double b[3], double r[3])
+			{
+				r[0] = a[1] * b[2] - a[2] * b[1];
+				r[1] = a[2] * b[0] - a[0] * b[2];
+				r[2] = a[0] * b[1] - a[1] * b[0];
+			}
+
+			inline void triangleNormal(const float *p0, const float *p1, const float *p2, double n[3])
+			{
+				const double e0[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+				const double e1[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1], (double)p2[2] - p0[2] };
+				cross(e0, e1, n);
+			}
+
+			// Groups vertices whose first count floats (starting at offset) are bitwise equal, representative is the lowest vertex of each group
+			inline void groupVertices(const float *vertices, size_t stride, uint32_t vertexCount, size_t offset, size_t count, std::vector<uint32_t> &representative)
+			{
+				std::vector<uint32_t> order(vertexCount);
+				std::iota(order.begin(), order.end(), 0);
+				auto compare = [&](uint32_t a, uint32_t b) {
+					const int result = memcmp(vertices + (size_t)a * stride + offset, vertices + (size_t)b * stride + offset, count * sizeof(float));
+					return (result < 0) || ((result == 0) && (a < b));
+				};
+				std::sort(order.begin(), order.end(), compare);
+				representative.resize(vertexCount);
+				for (size_t i = 0; i < order.size(); i++) {
+					const bool equal = (i > 0) && (memcmp(vertices + (size_t)order[i] * stride + offset, vertices + (size_t)order[i - 1] * stride + offset, count * sizeof(float)) == 0);
+					representative[order[i]] = equal ? representative[order[i - 1]] : order[i];
+				}
+			}
+		}
+
+		namespace detail
+		{
+			// Half edge collapse simplification state, can be run to successively lower targets (for level of detail chains)
+			class Simplifier
+			{
+			public:
+				Simplifier(const uint32_t *indices, size_t indexCount, const float *vertices, size_t stride, uint32_t vertexCount, size_t positionOffset)
+					: vertices(vertices), stride(stride), vertexCount(vertexCount), positionOffset(positionOffset),
+					kind(vertexCount, Manifold), borderNext(vertexCount, UINT32_MAX), borderPrev(vertexCount, UINT32_MAX), quadrics(vertexCount),
+					adjacencyOffsets(vertexCount + 1), collapseTarget(vertexCount), touched(vertexCount)
+				{
+					std::vector<uint32_t> canonical, positionGroup;
+					groupVertices(vertices, stride, vertexCount, 0, stride, canonical);
+					groupVertices(vertices, stride, vertexCount, positionOffset, 3, positionGroup);
+
+					result.reserve(indexCount);
+					for (size_t i = 0; i + 2 < indexCount; i += 3) {
+						const uint32_t a = canonical[indices[i]], b = canonical[indices[i + 1]], c = canonical[indices[i + 2]];
+						if ((a != b) && (b != c) && (a != c)) {
+							result.insert(result.end(), { a, b, c });
+						}
+					}
+
+					// Attribute seams: more than one merged vertex at the same position
+					std::vector<uint32_t> positionOwner(vertexCount, UINT32_MAX);
+					for (uint32_t v : result) {
+						uint32_t &owner = positionOwner[positionGroup[v]];
+						if (owner == UINT32_MAX) {
+							owner = v;
+						} else if (owner != v) {
+							kind[v] = Locked;
+							kind[owner] = Locked;
+						}
+					}
+
+					// Open borders: directed edges without an opposite edge, each border vertex needs exactly one incoming and one outgoing border edge
+					auto edgeKey = [](uint32_t a, uint32_t b) { return ((uint64_t)a << 32) | b; };
+					std::unordered_map<uint64_t, uint32_t> edges;
+					edges.reserve(result.size());
+					for (size_t i = 0; i < result.size(); i += 3) {
+						for (uint32_t k = 0; k < 3; k++) {
+							edges[edgeKey(result[i + k], result[i + (k + 1) % 3])]++;
+						}
+					}
+					std::vector<uint8_t> borderCount(vertexCount, 0);
+					for (size_t i = 0; i < result.size(); i += 3) {
+						double normal[3];
+						triangleNormal(position(result[i]), position(result[i + 1]), position(result[i + 2]), normal);
+						const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+						if (length <= 0.0) {
+							continue;
+						}
+						for (double &n : normal) {
+							n /= length;
+						}
+						const float *p0 = position(result[i]);
+						const double d = -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+						for (uint32_t k = 0; k < 3; k++) {
+							quadrics[result[i + k]].addPlane(normal, d, length * 0.5);
+						}
+
+						for (uint32_t k = 0; k < 3; k++) {
+							const uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+							if (edges[edgeKey(a, b)] > 1) {
+								// Non-manifold edge
+								kind[a] = Locked;
+								kind[b] = Locked;
+								continue;
+							}
+							if (edges.count(edgeKey(b, a)) > 0) {
+								continue;
+							}
+							borderNext[a] = b;
+							borderPrev[b] = a;
+							// Outgoing edges count in the low, incoming edges in the high nibble
+							borderCount[a] += 0x01;
+							borderCount[b] += 0x10;
+							if (kind[a] == Manifold) kind[a] = Border;
+							if (kind[b] == Manifold) kind[b] = Border;
+
+							// Plane through the border edge perpendicular to the triangle keeps the border in place
+							const float *pa = position(a), *pb = position(b);
+							const double edge[3] = { (double)pb[0] - pa[0], (double)pb[1] - pa[1], (double)pb[2] - pa[2] };
+							double plane[3];
+							cross(edge, normal, plane);
+							const double planeLength = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+							if (planeLength > 0.0) {
+								for (double &n : plane) {
+									n /= planeLength;
+								}
+								const double edgeLengthSquared = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+								const double planeD = -(plane[0] * pa[0] + plane[1] * pa[1] + plane[2] * pa[2]);
+								quadrics[a].addPlane(plane, planeD, edgeLengthSquared * 10.0);
+								quadrics[b].addPlane(plane, planeD, edgeLengthSquared * 10.0);
+							}
+						}
+					}
+					for (uint32_t v = 0; v < vertexCount; v++) {
+						if ((kind[v] == Border) && (borderCount[v] != 0x11)) {
+							kind[v] = Locked;
+						}
+					}
+				}
+
+				// Collapses edges until the index count is at or below the target or the next collapse would exceed the error limit
+				void run(size_t targetIndexCount, float targetError)
+				{
+					const double errorLimit = (double)targetError * (double)targetError;
+					while (result.size() > targetIndexCount) {
+						const uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+
+						// Triangles around each vertex
+						std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+						for (uint32_t v : result) {
+							adjacencyOffsets[v + 1]++;
+						}
+						for (uint32_t v = 0; v < vertexCount; v++) {
+							adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+						}
+						adjacency.resize(result.size());
+						fill.assign(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+						for (uint32_t t = 0; t < triangleCount; t++) {
+							for (uint32_t k = 0; k < 3; k++) {
+								adjacency[fill[result[t * 3 + k]]++] = t;
+							}
+						}
+
+						candidates.clear();
+						for (uint32_t t = 0; t < triangleCount; t++) {
+							for (uint32_t k = 0; k < 3; k++) {
+								const uint32_t a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+								addCandidate(a, b);
+								addCandidate(b, a);
+							}
+						}
+						std::sort(candidates.begin(), candidates.end(), [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+						// Collapses of one pass don't share any triangles, so they can be applied to the index list at once
+						const size_t removeTarget = std::max<size_t>((result.size() - targetIndexCount) / 3, 1);
+						size_t removed = 0;
+						uint32_t collapseCount = 0;
+						std::fill(touched.begin(), touched.end(), 0);
+						std::iota(collapseTarget.begin(), collapseTarget.end(), 0);
+						for (const Collapse &collapse : candidates) {
+							if (collapse.error > errorLimit) {
+								break;
+							}
+							const uint32_t from = collapse.from, to = collapse.to;
+							if (touched[from] || touched[to] || flips(from, to)) {
+								continue;
+							}
+
+							collapseTarget[from] = to;
+							quadrics[to].add(quadrics[from]);
+							for (uint32_t i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; i++) {
+								const uint32_t *triangle = &result[adjacency[i] * 3];
+								if ((triangle[0] == to) || (triangle[1] == to) || (triangle[2] == to)) {
+									removed++;
+								}
+								touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+							}
+							if (kind[from] == Border) {
+								if (to == borderNext[from]) {
+									borderNext[borderPrev[from]] = to;
+									borderPrev[to] = borderPrev[from];
+								} else {
+									borderPrev[borderNext[from]] = to;
+									borderNext[to] = borderNext[from];
+								}
+							}
+							maxError = std::max(maxError, collapse.error);
+							collapseCount++;
+							if (removed >= removeTarget) {
+								break;
+							}
+						}
+						if (collapseCount == 0) {
+							break;
+						}
+
+						size_t write = 0;
+						for (size_t i = 0; i < result.size(); i += 3) {
+							const uint32_t a = collapseTarget[result[i]], b = collapseTarget[result[i + 1]], c = collapseTarget[result[i + 2]];
+							if ((a != b) && (b != c) && (a != c)) {
+								result[write++] = a;
+								result[write++] = b;
+								result[write++] = c;
+							}
+						}
+						result.resize(write);
+					}
+				}
+
+				const std::vector<uint32_t> &indices() const { return result; }
+
+				// Largest error of the collapses performed so far
+				float error() const { return static_cast<float>(std::sqrt(maxError)); }
+
+			private:
+				enum Kind : uint8_t { Manifold, Border, Locked };
+				struct Collapse {
+					uint32_t from;
+					uint32_t to;
+					double error;
+				};
+
+				const float *vertices;
+				size_t stride;
+				uint32_t vertexCount;
+				size_t positionOffset;
+
+				std::vector<uint32_t> result;
+				std::vector<Kind> kind;
+				std::vector<uint32_t> borderNext, borderPrev;
+				std::vector<Quadric> quadrics;
+				double maxError = 0.0;
+
+				// Per pass scratch data
+				std::vector<uint32_t> adjacencyOffsets, adjacency, fill;
+				std::vector<uint32_t> collapseTarget;
+				std::vector<uint8_t> touched;
+				std::vector<Collapse> candidates;
+
+				const float *position(uint32_t v) const
+				{
+					return vertices + (size_t)v * stride + positionOffset;
+				}
+
+				void addCandidate(uint32_t from, uint32_t to)
+				{
+					if (kind[from] == Locked) {
+						return;
+					}
+					if (kind[from] == Border) {
+						// Only along the border, and never closing a border loop of three edges
+						const uint32_t next = borderNext[from], prev = borderPrev[from];
+						if (((to != next) && (to != prev)) || (borderNext[next] == prev)) {
+							return;
+						}
+					}
+					Quadric q = quadrics[from];
+					q.add(quadrics[to]);
+					candidates.push_back({ from, to, q.error(position(to)) });
+				}
+
+				// True if moving from onto to flips one of the remaining triangles around from
+				bool flips(uint32_t from, uint32_t to) const
+				{
+					for (uint32_t i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; i++) {
+						const uint32_t *triangle = &result[adjacency[i] * 3];
+						if ((triangle[0] == to) || (triangle[1] == to) || (triangle[2] == to)) {
+							continue;
+						}
+						double before[3], after[3];
+						triangleNormal(position(triangle[0]), position(triangle[1]), position(triangle[2]), before);
+						triangleNormal(position(triangle[0] == from ? to : triangle[0]), position(triangle[1] == from ? to : triangle[1]), position(triangle[2] == from ? to : triangle[2]), after);
+						if ((before[0] * after[0] + before[1] * after[1] + before[2] * after[2]) <= 0.0) {
+							return true;
+						}
+					}
+					return false;
+				}
+			};
+		}
+
+		/**
+		* Simplify a triangle list with half edge collapses ordered by quadric error (Garland and Heckbert)
+		*
+		* Vertices with identical attributes are merged first. Vertices on attribute seams (same position, different attributes)
+		* and on non-manifold edges never move, vertices on open borders only collapse along the border. Collapses only move
+		* vertices onto existing ones, so the simplified mesh references a subset of the source vertices and keeps their UVs.
+		*
+		* @param destination Receives the simplified indices (at most indexCount)
+		* @param vertices Interleaved vertices with a stride in floats
+		* @param positionOffset Offset of the position (3 floats) inside a vertex in floats
+		* @param targetIndexCount Simplification stops once the index count is at or below the target
+		* @param targetError Simplification also stops before any collapse whose error exceeds this distance (in model units)
+		* @param resultError (Optional) Receives the largest error of the performed collapses
+		*
+		* @return Index count of the simplified mesh
+		*/
+		inline size_t simplify(uint32_t *destination, const uint32_t *indices, size_t indexCount, const float *vertices, size_t stride, uint32_t vertexCount,
+			size_t positionOffset, size_t targetIndexCount, float targetError, float *resultError = nullptr)
+		{
+			detail::Simplifier simplifier(indices, indexCount, vertices, stride, vertexCount, positionOffset);
+			simplifier.run(targetIndexCount, targetError);
+			std::copy(simplifier.indices().begin(), simplifier.indices().end(), destination);
+			if (resultError) {
+				*resultError = simplifier.error();
+			}
+			return simplifier.indices().size();
+		}
+
+		/**
+		* Generate a chain of simplified levels of detail for a mesh
+		*
+		* Levels are snapshots of one simplification run towards successively lower targets (each the reduction of the previous one),
+		* so errors accumulate over the chain and stay relative to the source mesh. The chain ends early once the error bound of the
+		* settings prevents a significant reduction.
+		*
+		* @param radius Bounding sphere radius of the mesh, scales the error bound of the settings
+		* @param lodIndices Receives the (vertex cache optimized) indices of all levels
+		* @param levels Receives the simplified levels, first index is relative to the start of lodIndices
+		*/
+		inline void generateLods(const uint32_t *indices, size_t indexCount, const float *vertices, size_t stride, uint32_t vertexCount, size_t positionOffset,
+			const LodSettings &settings, float radius, std::vector<uint32_t> &lodIndices, std::vector<LodLevel> &levels)
+		{
+			if (settings.levelCount == 0) {
+				return;
+			}
+			detail::Simplifier simplifier(indices, indexCount, vertices, stride, vertexCount, positionOffset);
+			size_t previousCount = indexCount;
+			float targetCount = static_cast<float>(indexCount);
+			for (uint32_t level = 1; level <= settings.levelCount; level++) {
+				targetCount *= settings.reduction;
+				simplifier.run(static_cast<size_t>(targetCount) / 3 * 3, settings.maxError * radius);
+				const size_t count = simplifier.indices().size();
+				if ((count == 0) || (count > previousCount * 9 / 10)) {
+					break;
+				}
+				LodLevel lod;
+				lod.firstIndex = static_cast<uint32_t>(lodIndices.size());
+				lod.indexCount = static_cast<uint32_t>(count);
+				lod.error = simplifier.error();
+				lodIndices.resize(lodIndices.size() + count);
+				optimizeVertexCache(lodIndices.data() + lod.firstIndex, simplifier.indices().data(), count, vertexCount);
+				levels.push_back(lod);
+				previousCount = count;
+			}
+		}
+
+		/** @brief Pixels per model unit at distance 1 for a perspective projection (vertical field of view in radians, viewport height in pixels) */
+		inline float lodScreenScale(float fovY, float viewportHeight)
+		{
+			return viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+		}
+
+		/**
+		* Select the least detailed level whose error projected to the screen stays within a threshold
+		*
+		* @param levels Levels ordered from the most to the least detailed, with increasing errors
+		* @param distance Distance of the viewer to the bounds of the mesh
+		* @param screenScale Pixels per model unit at distance 1 (see lodScreenScale)
+		* @param pixelThreshold Largest allowed projected error in pixels
+		*/
+		inline uint32_t selectLod(const LodLevel *levels, uint32_t levelCount, float distance, float screenScale, float pixelThreshold)
+		{
+			const float maxError = pixelThreshold * std::max(distance, 0.0f) / screenScale;
+			uint32_t selected = 0;
+			for (uint32_t i = 1; (i < levelCount) && (levels[i].error <= maxError); i++) {
+				selected = i;
+			}
+			return selected;
+		}
+	}
+}
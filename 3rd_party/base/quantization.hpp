@@ -0,0 +1,91 @@
+/*
+* Quantization helpers for packed vertex formats (normalized integers and octahedral unit vectors)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace vks
+{
+	namespace quantize
+	{
+		/** @brief Float in [-1, 1] to a signed normalized 16 bit integer (VK_FORMAT_*_SNORM) */
+		inline int16_t snorm16(float v)
+		{
+			return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+		}
+
+		inline float fromSnorm16(int16_t v)
+		{
+			// Vulkan maps both -32768 and -32767 to -1
+			return std::max(static_cast<float>(v) / 32767.0f, -1.0f);
+		}
+
+		/** @brief Float in [0, 1] to an unsigned normalized 16 bit integer (VK_FORMAT_*_UNORM) */
+		inline uint16_t unorm16(float v)
+		{
+			return static_cast<uint16_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+		}
+
+		inline float fromUnorm16(uint16_t v)
+		{
+			return static_cast<float>(v) / 65535.0f;
+		}
+
+		/** @brief Float in [0, 1] to an unsigned normalized 8 bit integer (VK_FORMAT_*_UNORM) */
+		inline uint8_t unorm8(float v)
+		{
+			return static_cast<uint8_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f));
+		}
+
+		inline float fromUnorm8(uint8_t v)
+		{
+			return static_cast<float>(v) / 255.0f;
+		}
+
+		/**
+		* Encode a unit vector as two signed normalized 16 bit integers using the octahedral mapping (Cigolle et al.)
+		*
+		* The vector is projected onto the octahedron |x| + |y| + |z| = 1, whose lower half is folded over the upper half.
+		* The angular error stays below 0.005 degrees for 16 bit components. Zero vectors encode as (0, 0), which decodes to +z.
+		*/
+		inline void octEncode(const float *n, int16_t *encoded)
+		{
+			const float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+			if (l1 <= 0.0f) {
+				encoded[0] = encoded[1] = 0;
+				return;
+			}
+			float x = n[0] / l1;
+			float y = n[1] / l1;
+			if (n[2] < 0.0f) {
+				const float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+				const float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+				x = fx;
+				y = fy;
+			}
+			encoded[0] = snorm16(x);
+			encoded[1] = snorm16(y);
+		}
+
+		/** @brief Decode an octahedral unit vector, same as the GLSL decoding of packed vertex shaders */
+		inline void octDecode(const int16_t *encoded, float *n)
+		{
+			float x = fromSnorm16(encoded[0]);
+			float y = fromSnorm16(encoded[1]);
+			const float z = 1.0f - std::fabs(x) - std::fabs(y);
+			const float t = std::max(-z, 0.0f);
+			x += (x >= 0.0f) ? -t : t;
+			y += (y >= 0.0f) ? -t : t;
+			const float length = std::sqrt(x * x + y * y + z * z);
+			n[0] = x / length;
+			n[1] = y / length;
+			n[2] = z / length;
+		}
+	}
+}
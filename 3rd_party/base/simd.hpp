@@ -0,0 +1,117 @@
+/*
+* CPU feature detection and helpers for runtime dispatched SIMD kernels
+*
+* Kernels for instruction sets above the compiler's baseline are compiled with VKS_TARGET_AVX / VKS_TARGET_AVX2
+* (function level target attributes, no global compiler flags needed) and only called if the CPU supports them.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VKS_SIMD_X86 1
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(VKS_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VKS_TARGET_AVX __attribute__((target("avx")))
+#define VKS_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define VKS_TARGET_AVX
+#define VKS_TARGET_AVX2
+#endif
+
+namespace vks
+{
+	namespace simd
+	{
+		/** @brief Instruction set levels the kernels are dispatched on */
+		enum Level {
+			LEVEL_SCALAR = 0,
+			LEVEL_SSE = 1,
+			LEVEL_AVX = 2,
+			LEVEL_AVX2 = 3
+		};
+
+		inline const char* levelName(Level level)
+		{
+			switch (level) {
+			case LEVEL_SSE: return "SSE";
+			case LEVEL_AVX: return "AVX";
+			case LEVEL_AVX2: return "AVX2";
+			default: return "scalar";
+			}
+		}
+
+		namespace detail
+		{
+			inline Level detectLevel()
+			{
+#if defined(VKS_SIMD_X86)
+#if defined(_MSC_VER)
+				int info[4];
+				__cpuid(info, 0);
+				const int maxLeaf = info[0];
+				__cpuid(info, 1);
+				const bool osxsave = (info[2] & (1 << 27)) != 0;
+				const bool avx = (info[2] & (1 << 28)) != 0;
+				const bool fma = (info[2] & (1 << 12)) != 0;
+				// The OS has to save the upper halves of the ymm registers on context switches
+				const bool ymmEnabled = osxsave && ((_xgetbv(0) & 0x6) == 0x6);
+				if (!avx || !ymmEnabled) {
+					return LEVEL_SSE;
+				}
+				bool avx2 = false;
+				if (maxLeaf >= 7) {
+					__cpuidex(info, 7, 0);
+					avx2 = (info[1] & (1 << 5)) != 0;
+				}
+				return (avx2 && fma) ? LEVEL_AVX2 : LEVEL_AVX;
+#else
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+					return LEVEL_AVX2;
+				}
+				if (__builtin_cpu_supports("avx")) {
+					return LEVEL_AVX;
+				}
+				return LEVEL_SSE;
+#endif
+#else
+				return LEVEL_SCALAR;
+#endif
+			}
+		}
+
+		/** @brief Highest instruction set level supported by the CPU (detected once) */
+		inline Level supportedLevel()
+		{
+			static const Level level = detail::detectLevel();
+			return level;
+		}
+
+		/** @brief Index of the lowest set bit, value must not be zero */
+		inline uint32_t countTrailingZeros(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+		}
+
+		/** @brief Clamp a requested level to what the CPU supports */
+		inline Level selectLevel(Level requested)
+		{
+			return (requested < supportedLevel()) ? requested : supportedLevel();
+		}
+	}
+}
@@ -0,0 +1,375 @@
+/*
+* Structure of arrays transform store with SIMD matrix composition
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "simd.hpp"
+#include "jobsystem.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Translation, rotation (quaternion) and scale of many objects kept in structure of arrays layout
+	*
+	* Matrices are composed (translate * rotate * scale) by SSE/AVX kernels working on 4/8 objects at once, large
+	* counts are split across the job system and the column major results can be written straight into mapped GPU memory.
+	* Parents have to be added before their children, world matrices of hierarchies are resolved in one pass in index order.
+	*/
+	class TransformStore
+	{
+	public:
+		std::vector<float> positionX, positionY, positionZ;
+		/** @brief Unit quaternions */
+		std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+		std::vector<float> scaleX, scaleY, scaleZ;
+		/** @brief Index of the parent transform or -1 for roots */
+		std::vector<int32_t> parents;
+
+		/** @brief Highest instruction set used by the kernels (clamped to what the CPU supports) */
+		simd::Level level = simd::LEVEL_AVX2;
+		/** @brief Number of transforms composed by one job (multiple of 8 to keep the SIMD kernels busy) */
+		uint32_t grainSize = 16384;
+
+		/**
+		* Add a transform
+		*
+		* @param parent (Optional) Index of an already added parent transform
+		*
+		* @return Index of the new transform
+		*/
+		uint32_t add(const glm::vec3 &position, const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3 &scale = glm::vec3(1.0f), int32_t parent = -1)
+		{
+			const uint32_t index = size();
+			assert(parent < static_cast<int32_t>(index));
+			resize(index + 1);
+			setPosition(index, position);
+			setRotation(index, rotation);
+			setScale(index, scale);
+			parents[index] = parent;
+			if (parent >= 0) {
+				hierarchy = true;
+			}
+			return index;
+		}
+
+		/** @brief Resize the store, new transforms are identities without parent */
+		void resize(uint32_t count)
+		{
+			positionX.resize(count, 0.0f);
+			positionY.resize(count, 0.0f);
+			positionZ.resize(count, 0.0f);
+			rotationX.resize(count, 0.0f);
+			rotationY.resize(count, 0.0f);
+			rotationZ.resize(count, 0.0f);
+			rotationW.resize(count, 1.0f);
+			scaleX.resize(count, 1.0f);
+			scaleY.resize(count, 1.0f);
+			scaleZ.resize(count, 1.0f);
+			parents.resize(count, -1);
+		}
+
+		void clear()
+		{
+			resize(0);
+			matrices.clear();
+			hierarchy = false;
+		}
+
+		uint32_t size() const
+		{
+			return static_cast<uint32_t>(positionX.size());
+		}
+
+		void setPosition(uint32_t index, const glm::vec3 &position)
+		{
+			positionX[index] = position.x;
+			positionY[index] = position.y;
+			positionZ[index] = position.z;
+		}
+
+		void setRotation(uint32_t index, const glm::quat &rotation)
+		{
+			rotationX[index] = rotation.x;
+			rotationY[index] = rotation.y;
+			rotationZ[index] = rotation.z;
+			rotationW[index] = rotation.w;
+		}
+
+		void setScale(uint32_t index, const glm::vec3 &scale)
+		{
+			scaleX[index] = scale.x;
+			scaleY[index] = scale.y;
+			scaleZ[index] = scale.z;
+		}
+
+		/** @brief Set the parent of a transform (must have a lower index) */
+		void setParent(uint32_t index, int32_t parent)
+		{
+			assert(parent < static_cast<int32_t>(index));
+			parents[index] = parent;
+			if (parent >= 0) {
+				hierarchy = true;
+			}
+		}
+
+		glm::vec3 getPosition(uint32_t index) const
+		{
+			return glm::vec3(positionX[index], positionY[index], positionZ[index]);
+		}
+
+		glm::quat getRotation(uint32_t index) const
+		{
+			return glm::quat(rotationW[index], rotationX[index], rotationY[index], rotationZ[index]);
+		}
+
+		glm::vec3 getScale(uint32_t index) const
+		{
+			return glm::vec3(scaleX[index], scaleY[index], scaleZ[index]);
+		}
+
+		/**
+		* Compose the world matrices of all transforms
+		*
+		* @param dst (Optional) Destination of the matrices, e.g. a mapped (dynamic) uniform buffer, nullptr keeps them in the store only
+		* @param stride (Optional) Distance between two matrices in dst in bytes
+		* @param jobSystem (Optional) Job system to split the composition across, nullptr runs on the calling thread
+		*
+		* @note Without a hierarchy the matrices go straight to dst, getMatrices() is only updated if dst is nullptr or the store has a hierarchy
+		*/
+		void update(void *dst = nullptr, size_t stride = sizeof(glm::mat4), vks::JobSystem *jobSystem = nullptr)
+		{
+			const uint32_t count = size();
+			assert(stride >= sizeof(glm::mat4));
+			const simd::Level kernelLevel = simd::selectLevel(level);
+
+			if (dst && !hierarchy) {
+				forRanges(count, jobSystem, [&](uint32_t first, uint32_t last) {
+					compose(kernelLevel, first, last, static_cast<uint8_t*>(dst), stride, true);
+				});
+				return;
+			}
+
+			matrices.resize(count);
+			uint8_t *local = reinterpret_cast<uint8_t*>(matrices.data());
+			forRanges(count, jobSystem, [&](uint32_t first, uint32_t last) {
+				compose(kernelLevel, first, last, local, sizeof(glm::mat4), false);
+			});
+			if (hierarchy) {
+				// Parents always come first, so a single pass in index order resolves the whole hierarchy
+				for (uint32_t i = 0; i < count; i++) {
+					if (parents[i] >= 0) {
+						multiply(matrices[parents[i]], matrices[i], matrices[i]);
+					}
+				}
+			}
+			if (dst) {
+				forRanges(count, jobSystem, [&](uint32_t first, uint32_t last) {
+					for (uint32_t i = first; i < last; i++) {
+						memcpy(static_cast<uint8_t*>(dst) + i * stride, &matrices[i], sizeof(glm::mat4));
+					}
+				});
+			}
+		}
+
+		/** @brief World matrices of the last update (see update for when they are written) */
+		const std::vector<glm::mat4>& getMatrices() const
+		{
+			return matrices;
+		}
+
+		/**
+		* Compose the local matrices of a range of transforms with the kernel of the given instruction set level
+		*
+		* @param dst Destination of the matrix of transform 0, transform i is written to dst + i * stride
+		* @param streaming Use non-temporal stores (for write combined GPU memory that is not read back by the CPU)
+		*/
+		void compose(simd::Level kernelLevel, uint32_t first, uint32_t last, uint8_t *dst, size_t stride, bool streaming) const
+		{
+#if defined(VKS_SIMD_X86)
+			// Streaming stores need 16 byte aligned destinations
+			streaming = streaming && ((reinterpret_cast<uintptr_t>(dst) & 15) == 0) && ((stride & 15) == 0);
+			if (kernelLevel >= simd::LEVEL_AVX) {
+				first = composeAVX(first, last, dst, stride, streaming);
+			} else if (kernelLevel >= simd::LEVEL_SSE) {
+				first = composeSSE(first, last, dst, stride, streaming);
+			}
+			if (streaming) {
+				_mm_sfence();
+			}
+#endif
+			composeScalar(first, last, dst, stride);
+		}
+
+	private:
+		std::vector<glm::mat4> matrices;
+		bool hierarchy = false;
+
+		template<typename F>
+		void forRanges(uint32_t count, vks::JobSystem *jobSystem, const F &function) const
+		{
+			if (jobSystem && (count > grainSize)) {
+				jobSystem->parallel_for(count, (grainSize + 7) & ~7u, function);
+			} else {
+				function(0u, count);
+			}
+		}
+
+		void composeScalar(uint32_t first, uint32_t last, uint8_t *dst, size_t stride) const
+		{
+			for (uint32_t i = first; i < last; i++) {
+				const float x = rotationX[i], y = rotationY[i], z = rotationZ[i], w = rotationW[i];
+				const float x2 = x + x, y2 = y + y, z2 = z + z;
+				const float xx = x * x2, yy = y * y2, zz = z * z2;
+				const float xy = x * y2, xz = x * z2, yz = y * z2;
+				const float wx = w * x2, wy = w * y2, wz = w * z2;
+				const float sx = scaleX[i], sy = scaleY[i], sz = scaleZ[i];
+				const float m[16] = {
+					(1.0f - (yy + zz)) * sx, (xy + wz) * sx, (xz - wy) * sx, 0.0f,
+					(xy - wz) * sy, (1.0f - (xx + zz)) * sy, (yz + wx) * sy, 0.0f,
+					(xz + wy) * sz, (yz - wx) * sz, (1.0f - (xx + yy)) * sz, 0.0f,
+					positionX[i], positionY[i], positionZ[i], 1.0f
+				};
+				memcpy(dst + i * stride, m, sizeof(m));
+			}
+		}
+
+		static void multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &result)
+		{
+#if defined(VKS_SIMD_X86)
+			const float *pa = &a[0][0];
+			const float *pb = &b[0][0];
+			const __m128 a0 = _mm_loadu_ps(pa), a1 = _mm_loadu_ps(pa + 4), a2 = _mm_loadu_ps(pa + 8), a3 = _mm_loadu_ps(pa + 12);
+			__m128 columns[4];
+			for (uint32_t j = 0; j < 4; j++) {
+				__m128 column = _mm_mul_ps(a0, _mm_set1_ps(pb[j * 4 + 0]));
+				column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(pb[j * 4 + 1])));
+				column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(pb[j * 4 + 2])));
+				column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(pb[j * 4 + 3])));
+				columns[j] = column;
+			}
+			// Result may alias b
+			float *pr = &result[0][0];
+			for (uint32_t j = 0; j < 4; j++) {
+				_mm_storeu_ps(pr + j * 4, columns[j]);
+			}
+#else
+			result = a * b;
+#endif
+		}
+
+#if defined(VKS_SIMD_X86)
+		static inline void store(float *dst, __m128 value, bool streaming)
+		{
+			if (streaming) {
+				_mm_stream_ps(dst, value);
+			} else {
+				_mm_storeu_ps(dst, value);
+			}
+		}
+
+		/** @brief Composes blocks of 4 transforms, returns the index of the first transform left for the scalar tail */
+		uint32_t composeSSE(uint32_t first, uint32_t last, uint8_t *dst, size_t stride, bool streaming) const
+		{
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 zero = _mm_setzero_ps();
+			uint32_t i = first;
+			for (; i + 4 <= last; i += 4) {
+				const __m128 x = _mm_loadu_ps(&rotationX[i]), y = _mm_loadu_ps(&rotationY[i]), z = _mm_loadu_ps(&rotationZ[i]), w = _mm_loadu_ps(&rotationW[i]);
+				const __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+				const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+				const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+				const __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+				const __m128 sx = _mm_loadu_ps(&scaleX[i]), sy = _mm_loadu_ps(&scaleY[i]), sz = _mm_loadu_ps(&scaleZ[i]);
+
+				// One register per matrix element (row, column) holding it for all four objects
+				__m128 c[4][4] = {
+					{ _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_add_ps(xy, wz), sx), _mm_mul_ps(_mm_sub_ps(xz, wy), sx), zero },
+					{ _mm_mul_ps(_mm_sub_ps(xy, wz), sy), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy), _mm_mul_ps(_mm_add_ps(yz, wx), sy), zero },
+					{ _mm_mul_ps(_mm_add_ps(xz, wy), sz), _mm_mul_ps(_mm_sub_ps(yz, wx), sz), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), zero },
+					{ _mm_loadu_ps(&positionX[i]), _mm_loadu_ps(&positionY[i]), _mm_loadu_ps(&positionZ[i]), one }
+				};
+				// After the transpose c[column][k] is the column of object k
+				for (uint32_t column = 0; column < 4; column++) {
+					_MM_TRANSPOSE4_PS(c[column][0], c[column][1], c[column][2], c[column][3]);
+				}
+				// Matrices are written one after another so each one fills its cache lines in order (write combined memory)
+				for (uint32_t k = 0; k < 4; k++) {
+					float *matrix = reinterpret_cast<float*>(dst + (i + k) * stride);
+					for (uint32_t column = 0; column < 4; column++) {
+						store(matrix + column * 4, c[column][k], streaming);
+					}
+				}
+			}
+			return i;
+		}
+
+		VKS_TARGET_AVX static inline void store8(float *dst, __m128 value, bool streaming)
+		{
+			if (streaming) {
+				_mm_stream_ps(dst, value);
+			} else {
+				_mm_storeu_ps(dst, value);
+			}
+		}
+
+		/** @brief Composes blocks of 8 transforms, returns the index of the first transform left for the scalar tail */
+		VKS_TARGET_AVX uint32_t composeAVX(uint32_t first, uint32_t last, uint8_t *dst, size_t stride, bool streaming) const
+		{
+			const __m256 one = _mm256_set1_ps(1.0f);
+			const __m256 zero = _mm256_setzero_ps();
+			uint32_t i = first;
+			for (; i + 8 <= last; i += 8) {
+				const __m256 x = _mm256_loadu_ps(&rotationX[i]), y = _mm256_loadu_ps(&rotationY[i]), z = _mm256_loadu_ps(&rotationZ[i]), w = _mm256_loadu_ps(&rotationW[i]);
+				const __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+				const __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+				const __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+				const __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+				const __m256 sx = _mm256_loadu_ps(&scaleX[i]), sy = _mm256_loadu_ps(&scaleY[i]), sz = _mm256_loadu_ps(&scaleZ[i]);
+
+				__m256 c[4][4] = {
+					{ _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx), _mm256_mul_ps(_mm256_add_ps(xy, wz), sx), _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx), zero },
+					{ _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy), _mm256_mul_ps(_mm256_add_ps(yz, wx), sy), zero },
+					{ _mm256_mul_ps(_mm256_add_ps(xz, wy), sz), _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz), zero },
+					{ _mm256_loadu_ps(&positionX[i]), _mm256_loadu_ps(&positionY[i]), _mm256_loadu_ps(&positionZ[i]), one }
+				};
+				// Transpose within the 128 bit lanes, afterwards c[column][k] holds the column of object k (low half) and object k + 4 (high half)
+				for (uint32_t column = 0; column < 4; column++) {
+					const __m256 t0 = _mm256_unpacklo_ps(c[column][0], c[column][1]);
+					const __m256 t1 = _mm256_unpackhi_ps(c[column][0], c[column][1]);
+					const __m256 t2 = _mm256_unpacklo_ps(c[column][2], c[column][3]);
+					const __m256 t3 = _mm256_unpackhi_ps(c[column][2], c[column][3]);
+					c[column][0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+					c[column][1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+					c[column][2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+					c[column][3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+				}
+				for (uint32_t k = 0; k < 4; k++) {
+					float *matrix = reinterpret_cast<float*>(dst + (i + k) * stride);
+					for (uint32_t column = 0; column < 4; column++) {
+						store8(matrix + column * 4, _mm256_castps256_ps128(c[column][k]), streaming);
+					}
+				}
+				for (uint32_t k = 0; k < 4; k++) {
+					float *matrix = reinterpret_cast<float*>(dst + (i + k + 4) * stride);
+					for (uint32_t column = 0; column < 4; column++) {
+						store8(matrix + column * 4, _mm256_extractf128_ps(c[column][k], 1), streaming);
+					}
+				}
+			}
+			// Avoid AVX-SSE transition penalties in the code that follows
+			_mm256_zeroupper();
+			return i;
+		}
+#endif
+	};
+}
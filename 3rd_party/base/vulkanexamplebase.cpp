@@ -28,21 +28,24 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
 
 	// Enable surface extensions depending on os
+	// Headless mode only keeps the generic surface extension, which VK_KHR_swapchain (and with it the present image layout used by the render passes) depends on
+	if (!settings.headless) {
 #if defined(_WIN32)
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
-	instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
 #elif defined(_DIRECT2DISPLAY)
-	instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
-	instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
-	instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
 #endif
+	}
 
 	if (enabledInstanceExtensions.size() > 0) {
 		for (auto enabledExtension : enabledInstanceExtensions) {
@@ -172,11 +175,258 @@ void VulkanExampleBase::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueu
 	}
 }
 
+vks::JobSystem& VulkanExampleBase::getJobSystem()
+{
+	if (!jobSystem) {
+		jobSystem.reset(new vks::JobSystem(settings.workerThreads));
+	}
+	return *jobSystem;
+}
+
+void VulkanExampleBase::recordSecondaryCommandBuffers(VkCommandBuffer primary, uint32_t imageIndex, uint32_t itemCount, const std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)> &recordRange)
+{
+	vks::JobSystem &jobs = getJobSystem();
+
+	// Command pools for the ranges are created on first use
+	if (threadCommandData.empty()) {
+		threadCommandData.resize(jobs.getThreadCount() + 1);
+		for (auto& threadData : threadCommandData) {
+			VkCommandPoolCreateInfo cmdPoolInfo = {};
+			cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &threadData.commandPool));
+		}
+	}
+
+	// The swap chain image count may grow on resize
+	for (auto& threadData : threadCommandData) {
+		if (threadData.commandBuffers.size() < swapChain.imageCount) {
+			size_t first = threadData.commandBuffers.size();
+			threadData.commandBuffers.resize(swapChain.imageCount);
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(threadData.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, static_cast<uint32_t>(swapChain.imageCount - first));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &threadData.commandBuffers[first]));
+		}
+	}
+
+	// Secondary command buffers continue the render pass of the primary, dynamic state is not inherited and has to be set again
+	auto beginSecondary = [=](VkCommandBuffer commandBuffer) {
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = frameBuffers[imageIndex];
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	};
+
+	// Split the items into contiguous ranges, at most one per job system thread
+	const uint32_t workerCount = jobs.getThreadCount();
+	const uint32_t chunkCount = std::min(workerCount, std::max((itemCount + minItemsPerRecordingThread - 1) / minItemsPerRecordingThread, 1u));
+	const uint32_t chunkSize = (itemCount + chunkCount - 1) / chunkCount;
+
+	std::vector<VkCommandBuffer> secondaryCmdBuffers;
+	vks::JobCounter counter;
+	for (uint32_t t = 0; t < chunkCount; t++) {
+		const uint32_t first = std::min(t * chunkSize, itemCount);
+		const uint32_t count = std::min(chunkSize, itemCount - first);
+		VkCommandBuffer commandBuffer = threadCommandData[t].commandBuffers[imageIndex];
+		const auto *record = &recordRange;
+		const auto *begin = &beginSecondary;
+		jobs.run([=] {
+			(*begin)(commandBuffer);
+			(*record)(commandBuffer, first, count);
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		}, &counter);
+		secondaryCmdBuffers.push_back(commandBuffer);
+	}
+
+	// The UI overlay is recorded by the calling thread before it helps out with the ranges
+	if (settings.overlay) {
+		VkCommandBuffer commandBuffer = threadCommandData.back().commandBuffers[imageIndex];
+		beginSecondary(commandBuffer);
+		drawUI(commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		secondaryCmdBuffers.push_back(commandBuffer);
+	}
+
+	jobs.wait(counter);
+
+	vkCmdExecuteCommands(primary, static_cast<uint32_t>(secondaryCmdBuffers.size()), secondaryCmdBuffers.data());
+}
+
+void VulkanExampleBase::destroyThreadCommandData()
+{
+	// Secondary command buffers are freed along with their pools
+	for (auto& threadData : threadCommandData) {
+		vkDestroyCommandPool(device, threadData.commandPool, nullptr);
+	}
+	threadCommandData.clear();
+}
+
+// Header prepended to the pipeline cache data written to disk
+// The Vulkan cache header does not contain the driver version, so the file stores it alongside the ids and a checksum of the payload
+struct PipelineCacheFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	uint64_t dataHash;
+};
+
+static const uint32_t pipelineCacheFileMagic = 0x43504b56; // "VKPC"
+static const uint32_t pipelineCacheFileVersion = 1;
+
+// FNV-1a, only used to detect truncated or corrupted cache files
+static uint64_t pipelineCacheHash(const uint8_t *data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string VulkanExampleBase::getPipelineCachePath()
+{
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+	return std::string(androidApp->activity->internalDataPath) + "/" + name + ".pipelinecache";
+#else
+	return name + ".pipelinecache";
+#endif
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
+	std::vector<uint8_t> cacheData;
+
+	if (settings.pipelineCache) {
+		std::ifstream is(getPipelineCachePath(), std::ios::binary | std::ios::ate);
+		if (is.is_open()) {
+			size_t fileSize = (size_t)is.tellg();
+			is.seekg(0, std::ios::beg);
+			PipelineCacheFileHeader header{};
+			bool valid = (fileSize >= sizeof(header)) && is.read(reinterpret_cast<char*>(&header), sizeof(header));
+			// Discard the cache if it was written by a different device or driver
+			valid = valid &&
+				(header.magic == pipelineCacheFileMagic) &&
+				(header.version == pipelineCacheFileVersion) &&
+				(header.vendorID == deviceProperties.vendorID) &&
+				(header.deviceID == deviceProperties.deviceID) &&
+				(header.driverVersion == deviceProperties.driverVersion) &&
+				(memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0) &&
+				(header.dataSize == fileSize - sizeof(header));
+			if (valid) {
+				cacheData.resize((size_t)header.dataSize);
+				valid = is.read(reinterpret_cast<char*>(cacheData.data()), cacheData.size()) && (pipelineCacheHash(cacheData.data(), cacheData.size()) == header.dataHash);
+			}
+			// Also check the header of the Vulkan cache data itself (see "Pipeline Cache" in the spec)
+			if (valid) {
+				uint32_t vkHeader[4];
+				valid = cacheData.size() >= 16 + VK_UUID_SIZE;
+				if (valid) {
+					memcpy(vkHeader, cacheData.data(), sizeof(vkHeader));
+					valid = (vkHeader[0] >= 16 + VK_UUID_SIZE) &&
+						(vkHeader[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+						(vkHeader[2] == deviceProperties.vendorID) &&
+						(vkHeader[3] == deviceProperties.deviceID) &&
+						(memcmp(cacheData.data() + 16, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+				}
+			}
+			if (!valid) {
+				std::cout << "Discarding stale or invalid pipeline cache \"" << getPipelineCachePath() << "\"" << std::endl;
+				cacheData.clear();
+			}
+		}
+	}
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+	pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+	VkResult result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	if ((result != VK_SUCCESS) && !cacheData.empty()) {
+		// The implementation may still reject the data, start with an empty cache in that case
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		cacheData.clear();
+		result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	}
+	VK_CHECK_RESULT(result);
+
+	pipelineCacheStats.warm = !cacheData.empty();
+	pipelineCacheStats.loadedSize = cacheData.size();
+}
+
+void VulkanExampleBase::savePipelineCache()
+{
+	if (!settings.pipelineCache || (pipelineCache == VK_NULL_HANDLE)) {
+		return;
+	}
+
+	size_t dataSize = 0;
+	if ((vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS) || (dataSize == 0)) {
+		return;
+	}
+	std::vector<uint8_t> cacheData(dataSize);
+	if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS) {
+		return;
+	}
+	cacheData.resize(dataSize);
+
+	PipelineCacheFileHeader header{};
+	header.magic = pipelineCacheFileMagic;
+	header.version = pipelineCacheFileVersion;
+	header.vendorID = deviceProperties.vendorID;
+	header.deviceID = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = cacheData.size();
+	header.dataHash = pipelineCacheHash(cacheData.data(), cacheData.size());
+
+	// Write to a temporary file and move it over the old cache, so an interrupted write never leaves a corrupted cache behind
+	const std::string path = getPipelineCachePath();
+	const std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!os.is_open()) {
+			return;
+		}
+		os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		os.write(reinterpret_cast<const char*>(cacheData.data()), cacheData.size());
+		os.flush();
+		if (!os.good()) {
+			os.close();
+			std::remove(tmpPath.c_str());
+			return;
+		}
+	}
+#if defined(_WIN32)
+	bool moved = MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool moved = std::rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+	if (!moved) {
+		std::remove(tmpPath.c_str());
+	}
+}
+
+VkResult VulkanExampleBase::createGraphicsPipelines(uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines)
+{
+	auto tStart = std::chrono::high_resolution_clock::now();
+	VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, createInfoCount, pCreateInfos, nullptr, pPipelines);
+	pipelineCacheStats.creationTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	pipelineCacheStats.pipelineCount += createInfoCount;
+	return result;
 }
 
 void VulkanExampleBase::prepare()
@@ -193,6 +443,11 @@ void VulkanExampleBase::prepare()
 	setupRenderPass();
 	createPipelineCache();
 	setupFrameBuffer();
+	if (benchmark.active) {
+		setupFrameTimestamps();
+	}
+	// One query region per draw command buffer
+	gpuProfiler.prepare(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()), 64, vulkanDevice->enabledFeatures.pipelineStatisticsQuery);
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
@@ -255,7 +510,7 @@ void VulkanExampleBase::renderFrame()
 	{
 		lastFPS = static_cast<uint32_t>((float)frameCounter * (1000.0f / fpsTimer));
 #if defined(_WIN32)
-		if (!settings.overlay)	{
+		if (!settings.overlay && !settings.headless)	{
 			std::string windowTitle = getWindowTitle();
 			SetWindowText(window, windowTitle.c_str());
 		}
@@ -269,15 +524,34 @@ void VulkanExampleBase::renderFrame()
 
 void VulkanExampleBase::renderLoop()
 {
+	// Report pipeline creation time so cold (empty cache) and warm (cache loaded from disk) starts can be compared
+	std::cout << "Pipeline creation: " << pipelineCacheStats.pipelineCount << " pipelines in " << pipelineCacheStats.creationTime << " ms ("
+		<< (pipelineCacheStats.warm ? "warm cache, " + std::to_string(pipelineCacheStats.loadedSize) + " bytes loaded" : "cold cache") << ")" << std::endl;
+
 	if (benchmark.active) {
 		benchmark.run([=] { render(); }, vulkanDevice->properties);
 		vkDeviceWaitIdle(device);
+		// Collect the GPU times of the last frames in flight
+		for (uint32_t i = 0; i < frameTimestamps.benchmarkFrames.size(); i++) {
+			readFrameTimestamps(i);
+		}
+		benchmark.printResults();
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
 		return;
 	}
 
+	if (settings.headless) {
+		// There are no window system events to process, render the requested number of frames and exit
+		lastTimestamp = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < settings.headlessFrames; i++) {
+			renderFrame();
+		}
+		vkDeviceWaitIdle(device);
+		return;
+	}
+
 	destWidth = width;
 	destHeight = height;
 	lastTimestamp = std::chrono::high_resolution_clock::now();
@@ -585,6 +859,20 @@ void VulkanExampleBase::updateOverlay()
 #endif
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
+	if (!gpuProfiler.getResults().empty() && UIOverlay.header("GPU profiler")) {
+		for (auto& result : gpuProfiler.getResults()) {
+			ImGui::Indent(10.0f * (result.depth + 1));
+			UIOverlay.text("%s: %.3f ms", result.name.c_str(), result.averageTime);
+			if (result.hasStatistics) {
+				ImGui::Indent(10.0f);
+				for (uint32_t i = 0; i < vks::GpuProfiler::statisticsCount; i++) {
+					UIOverlay.text("%s: %llu", vks::GpuProfiler::statisticName(i), (unsigned long long)result.statistics[i]);
+				}
+				ImGui::Unindent(10.0f);
+			}
+			ImGui::Unindent(10.0f * (result.depth + 1));
+		}
+	}
 	ImGui::PopItemWidth();
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
@@ -594,6 +882,8 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PopStyleVar();
 	ImGui::Render();
 
+	// Overlay buffers and the draw command buffers may still be referenced by frames in flight
+	waitFramesInFlight();
 	if (UIOverlay.update() || UIOverlay.updated) {
 		buildCommandBuffers();
 		UIOverlay.updated = false;
@@ -614,14 +904,39 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
+		gpuProfiler.beginScope(commandBuffer, "UI overlay");
 		UIOverlay.draw(commandBuffer);
+		gpuProfiler.endScope(commandBuffer);
 	}
 }
 
 void VulkanExampleBase::prepareFrame()
 {
+	// Time spent blocking here is not counted as CPU time of the frame in benchmark mode
+	auto tWaitStart = std::chrono::high_resolution_clock::now();
+
+	// Only blocks if the CPU is more than settings.framesInFlight frames ahead of the GPU
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentFrame], VK_TRUE, UINT64_MAX));
+	// The fence is signaled again by submitFrame, so it has to be reset before anything can return early
+	VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentFrame]));
+
+	submitInfo.pWaitSemaphores = &semaphores.presentComplete[currentFrame];
+	submitInfo.pSignalSemaphores = &semaphores.renderComplete[currentFrame];
+
 	// Acquire the next image from the swap chain
-	VkResult err = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	VkResult err;
+	if (settings.headless) {
+		// Offscreen images are handed out round robin and are not owned by a presentation engine,
+		// so the semaphore the example's submission waits on is signaled right away
+		currentBuffer = headless.nextImage;
+		headless.nextImage = (headless.nextImage + 1) % swapChain.imageCount;
+		VkSubmitInfo signalSubmitInfo = vks::initializers::submitInfo();
+		signalSubmitInfo.signalSemaphoreCount = 1;
+		signalSubmitInfo.pSignalSemaphores = &semaphores.presentComplete[currentFrame];
+		err = vkQueueSubmit(queue, 1, &signalSubmitInfo, VK_NULL_HANDLE);
+	} else {
+		err = swapChain.acquireNextImage(semaphores.presentComplete[currentFrame], &currentBuffer);
+	}
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((err == VK_ERROR_OUT_OF_DATE_KHR) || (err == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -629,11 +944,85 @@ void VulkanExampleBase::prepareFrame()
 	else {
 		VK_CHECK_RESULT(err);
 	}
+
+	// Draw command buffers are recorded per swap chain image, so the one for the acquired image
+	// may still be executing for an older frame in flight
+	if (currentBuffer < imageFences.size()) {
+		VkFence imageFence = imageFences[currentBuffer];
+		if ((imageFence != VK_NULL_HANDLE) && (imageFence != waitFences[currentFrame])) {
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &imageFence, VK_TRUE, UINT64_MAX));
+		}
+		imageFences[currentBuffer] = waitFences[currentFrame];
+	}
+	benchmark.waitTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tWaitStart).count();
+
+	// The last submission of this image's command buffer has finished, so its profiler queries are available
+	if (gpuProfiler.collect(currentBuffer) && benchmark.active) {
+		// Nested scopes are reported with their full path (e.g. "scene/opaque")
+		std::vector<std::string> path;
+		for (auto& result : gpuProfiler.getResults()) {
+			path.resize(result.depth);
+			path.push_back(result.name);
+			std::string name = path[0];
+			for (size_t i = 1; i < path.size(); i++) {
+				name += "/" + path[i];
+			}
+			benchmark.addScopeTime(name, result.time);
+		}
+	}
+
+	// The previous use of this frame in flight has finished, so its timestamps can be read and the queries reused
+	if (frameTimestamps.queryPool != VK_NULL_HANDLE) {
+		readFrameTimestamps(currentFrame);
+		frameTimestamps.benchmarkFrames[currentFrame] = benchmark.currentFrameIndex();
+		// The begin timestamp waits for the acquired image (as a wait stage TOP_OF_PIPE blocks all commands of the submission),
+		// so the time spent waiting for it is not counted as GPU time, and the example's submission waits on the begin timestamp in turn
+		const VkPipelineStageFlags timestampWaitStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		VkSubmitInfo timestampSubmitInfo = vks::initializers::submitInfo();
+		timestampSubmitInfo.waitSemaphoreCount = 1;
+		timestampSubmitInfo.pWaitSemaphores = &semaphores.presentComplete[currentFrame];
+		timestampSubmitInfo.pWaitDstStageMask = &timestampWaitStageMask;
+		timestampSubmitInfo.commandBufferCount = 1;
+		timestampSubmitInfo.pCommandBuffers = &frameTimestamps.beginCmdBuffers[currentFrame];
+		timestampSubmitInfo.signalSemaphoreCount = 1;
+		timestampSubmitInfo.pSignalSemaphores = &frameTimestamps.beginComplete[currentFrame];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &timestampSubmitInfo, VK_NULL_HANDLE));
+		submitInfo.pWaitSemaphores = &frameTimestamps.beginComplete[currentFrame];
+	}
 }
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult res = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	// Empty submission that signals the frame's fence once all work previously submitted to the queue has completed
+	// This way examples can keep submitting their command buffers without a fence
+	// In benchmark mode this submission also writes the frame's end timestamp
+	VkSubmitInfo fenceSubmitInfo = vks::initializers::submitInfo();
+	if (frameTimestamps.queryPool != VK_NULL_HANDLE) {
+		fenceSubmitInfo.commandBufferCount = 1;
+		fenceSubmitInfo.pCommandBuffers = &frameTimestamps.endCmdBuffers[currentFrame];
+	}
+	// Nothing is presented in headless mode, so this submission consumes the example's render complete semaphore instead
+	const VkPipelineStageFlags headlessWaitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	if (settings.headless) {
+		fenceSubmitInfo.waitSemaphoreCount = 1;
+		fenceSubmitInfo.pWaitSemaphores = &semaphores.renderComplete[currentFrame];
+		fenceSubmitInfo.pWaitDstStageMask = &headlessWaitStageMask;
+	}
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &fenceSubmitInfo, waitFences[currentFrame]));
+	gpuProfiler.submitted(currentBuffer);
+
+	if (settings.headless) {
+		if (std::find(headless.readbackFrames.begin(), headless.readbackFrames.end(), headless.frameIndex) != headless.readbackFrames.end()) {
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentFrame], VK_TRUE, UINT64_MAX));
+			saveHeadlessImage(currentBuffer, name + "_frame" + std::to_string(headless.frameIndex) + ".ppm");
+		}
+		headless.frameIndex++;
+		currentFrame = (currentFrame + 1) % static_cast<uint32_t>(waitFences.size());
+		return;
+	}
+
+	VkResult res = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete[currentFrame]);
+	currentFrame = (currentFrame + 1) % static_cast<uint32_t>(waitFences.size());
 	if (!((res == VK_SUCCESS) || (res == VK_SUBOPTIMAL_KHR))) {
 		if (res == VK_ERROR_OUT_OF_DATE_KHR) {
 			// Swap chain is no longer compatible with the surface and needs to be recreated
@@ -643,7 +1032,71 @@ void VulkanExampleBase::submitFrame()
 			VK_CHECK_RESULT(res);
 		}
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+}
+
+void VulkanExampleBase::waitFramesInFlight()
+{
+	if (!waitFences.empty()) {
+		VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(waitFences.size()), waitFences.data(), VK_TRUE, UINT64_MAX));
+	}
+}
+
+void VulkanExampleBase::setupFrameTimestamps()
+{
+	// Timestamps are not supported on the graphics queue if no bits are valid
+	const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+	if (validBits == 0) {
+		std::cout << "Timestamp queries not supported, benchmark will not report GPU times" << std::endl;
+		return;
+	}
+	frameTimestamps.timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+	const uint32_t frameCount = static_cast<uint32_t>(waitFences.size());
+	VkQueryPoolCreateInfo queryPoolCI{};
+	queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCI.queryCount = frameCount * 2;
+	VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &frameTimestamps.queryPool));
+
+	frameTimestamps.beginCmdBuffers.resize(frameCount);
+	frameTimestamps.endCmdBuffers.resize(frameCount);
+	frameTimestamps.benchmarkFrames.assign(frameCount, std::numeric_limits<uint32_t>::max());
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, frameCount);
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, frameTimestamps.beginCmdBuffers.data()));
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, frameTimestamps.endCmdBuffers.data()));
+	frameTimestamps.beginComplete.resize(frameCount);
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	for (auto& semaphore : frameTimestamps.beginComplete) {
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+	}
+
+	// The command buffers are recorded once and resubmitted every frame
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	for (uint32_t i = 0; i < frameCount; i++) {
+		VK_CHECK_RESULT(vkBeginCommandBuffer(frameTimestamps.beginCmdBuffers[i], &cmdBufInfo));
+		vkCmdResetQueryPool(frameTimestamps.beginCmdBuffers[i], frameTimestamps.queryPool, i * 2, 2);
+		// Written once all previously submitted work (the tail of the previous frame) has completed, so frames don't overlap
+		vkCmdWriteTimestamp(frameTimestamps.beginCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameTimestamps.queryPool, i * 2);
+		VK_CHECK_RESULT(vkEndCommandBuffer(frameTimestamps.beginCmdBuffers[i]));
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(frameTimestamps.endCmdBuffers[i], &cmdBufInfo));
+		vkCmdWriteTimestamp(frameTimestamps.endCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameTimestamps.queryPool, i * 2 + 1);
+		VK_CHECK_RESULT(vkEndCommandBuffer(frameTimestamps.endCmdBuffers[i]));
+	}
+}
+
+void VulkanExampleBase::readFrameTimestamps(uint32_t frame)
+{
+	if ((frameTimestamps.queryPool == VK_NULL_HANDLE) || (frameTimestamps.benchmarkFrames[frame] == std::numeric_limits<uint32_t>::max())) {
+		return;
+	}
+	uint64_t timestamps[2];
+	if (vkGetQueryPoolResults(device, frameTimestamps.queryPool, frame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+		const uint64_t ticks = ((timestamps[1] & frameTimestamps.timestampMask) - (timestamps[0] & frameTimestamps.timestampMask)) & frameTimestamps.timestampMask;
+		const double ms = (double)ticks * (double)vulkanDevice->properties.limits.timestampPeriod / 1000000.0;
+		benchmark.setGpuTime(frameTimestamps.benchmarkFrames[frame], ms);
+	}
+	frameTimestamps.benchmarkFrames[frame] = std::numeric_limits<uint32_t>::max();
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -725,10 +1178,85 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 				}
 			}
 		}
+		// Number of frames to measure (instead of a fixed duration)
+		if ((args[i] == std::string("-bfc")) || (args[i] == std::string("--benchframes"))) {
+			if (args.size() > i + 1) {
+				uint32_t num = strtol(args[i + 1], &numConvPtr, 10);
+				if ((numConvPtr != args[i + 1]) && (num > 0)) {
+					benchmark.frameLimit = num;
+				} else {
+					std::cerr << "Number of benchmark frames must be a number greater than 0!" << std::endl;
+				}
+			}
+		}
 		// Output frame times to benchmark result file
 		if ((args[i] == std::string("-bt")) || (args[i] == std::string("--benchframetimes"))) {
 			benchmark.outputFrameTimes = true;
 		}
+		// Number of job system threads (including the main thread)
+		if ((args[i] == std::string("-wt")) || (args[i] == std::string("--workerthreads"))) {
+			if (args.size() > i + 1) {
+				uint32_t num = strtol(args[i + 1], &numConvPtr, 10);
+				if ((numConvPtr != args[i + 1]) && (num >= 1)) {
+					settings.workerThreads = num;
+				} else {
+					std::cerr << "Number of worker threads must be a number greater than 0!" << std::endl;
+				}
+			}
+		}
+		// Disable loading and storing the pipeline cache (forces a cold start)
+		if ((args[i] == std::string("-npc")) || (args[i] == std::string("--nopipelinecache"))) {
+			settings.pipelineCache = false;
+		}
+		// Render offscreen without a window (e.g. on machines without a display)
+		if (args[i] == std::string("--headless")) {
+			settings.headless = true;
+		}
+		// Number of frames rendered in headless mode
+		if ((args[i] == std::string("-hf")) || (args[i] == std::string("--headlessframes"))) {
+			if (args.size() > i + 1) {
+				uint32_t num = strtol(args[i + 1], &numConvPtr, 10);
+				if ((numConvPtr != args[i + 1]) && (num > 0)) {
+					settings.headlessFrames = num;
+				} else {
+					std::cerr << "Number of headless frames must be a number greater than 0!" << std::endl;
+				}
+			}
+		}
+		// Comma separated list of (headless) frames that are written to <name>_frame<index>.ppm
+		if ((args[i] == std::string("-rb")) || (args[i] == std::string("--readbackframes"))) {
+			if (args.size() > i + 1) {
+				const char* list = args[i + 1];
+				while (*list != '\0') {
+					uint32_t num = strtol(list, &numConvPtr, 10);
+					if (numConvPtr == list) {
+						std::cerr << "Readback frames must be a comma separated list of frame numbers!" << std::endl;
+						break;
+					}
+					headless.readbackFrames.push_back(num);
+					list = (*numConvPtr == ',') ? numConvPtr + 1 : numConvPtr;
+				}
+			}
+		}
+		// Number of frames in flight (1..3)
+		if ((args[i] == std::string("-fif")) || (args[i] == std::string("--framesinflight"))) {
+			if (args.size() > i + 1) {
+				uint32_t num = strtol(args[i + 1], &numConvPtr, 10);
+				if ((numConvPtr != args[i + 1]) && (num >= 1) && (num <= 3)) {
+					settings.framesInFlight = num;
+				} else {
+					std::cerr << "Number of frames in flight must be a number between 1 and 3!" << std::endl;
+				}
+			}
+		}
+	}
+
+	// Render enough headless frames to reach the last frame that is read back
+	for (auto frame : headless.readbackFrames) {
+		settings.headlessFrames = std::max(settings.headlessFrames, frame + 1);
+	}
+	if (!headless.readbackFrames.empty() && !settings.headless) {
+		std::cerr << "Frame readback is only supported in headless mode!" << std::endl;
 	}
 	
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -738,9 +1266,13 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	if (!settings.headless) {
+		initWaylandConnection();
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	initxcbConnection();
+	if (!settings.headless) {
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -758,6 +1290,7 @@ VulkanExampleBase::~VulkanExampleBase()
 {
 	// Clean up Vulkan resources
 	swapChain.cleanup();
+	destroyHeadlessImages();
 	if (descriptorPool != VK_NULL_HANDLE)
 	{
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
@@ -777,12 +1310,25 @@ VulkanExampleBase::~VulkanExampleBase()
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
 
+	savePipelineCache();
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
+	if (frameTimestamps.queryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(device, frameTimestamps.queryPool, nullptr);
+	}
+	for (auto& semaphore : frameTimestamps.beginComplete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	gpuProfiler.destroy();
 	vkDestroyCommandPool(device, cmdPool, nullptr);
+	destroyThreadCommandData();
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
+	for (auto& semaphore : semaphores.presentComplete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	for (auto& semaphore : semaphores.renderComplete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
 	for (auto& fence : waitFences) {
 		vkDestroyFence(device, fence, nullptr);
 	}
@@ -803,23 +1349,27 @@ VulkanExampleBase::~VulkanExampleBase()
 #if defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	xdg_toplevel_destroy(xdg_toplevel);
-	xdg_surface_destroy(xdg_surface);
-	wl_surface_destroy(surface);
-	if (keyboard)
-		wl_keyboard_destroy(keyboard);
-	if (pointer)
-		wl_pointer_destroy(pointer);
-	wl_seat_destroy(seat);
-	xdg_wm_base_destroy(shell);
-	wl_compositor_destroy(compositor);
-	wl_registry_destroy(registry);
-	wl_display_disconnect(display);
+	if (!settings.headless) {
+		xdg_toplevel_destroy(xdg_toplevel);
+		xdg_surface_destroy(xdg_surface);
+		wl_surface_destroy(surface);
+		if (keyboard)
+			wl_keyboard_destroy(keyboard);
+		if (pointer)
+			wl_pointer_destroy(pointer);
+		wl_seat_destroy(seat);
+		xdg_wm_base_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// todo : android cleanup (if required)
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!settings.headless) {
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #endif
 }
 
@@ -926,17 +1476,24 @@ bool VulkanExampleBase::initVulkan()
 
 	// Derived examples can override this to set actual features (based on above readings) to enable for logical device creation
 	getEnabledFeatures();
+	// Pipeline statistics of profiler scopes come at no cost unless requested, so enable them if available
+	if (deviceFeatures.pipelineStatisticsQuery) {
+		enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+	}
 
 	// Vulkan device creation
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vks::VulkanDevice(physicalDevice);
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions);
+	// Also request a transfer queue, if the implementation exposes a dedicated transfer family asset uploads run on it asynchronously
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, true, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
 	}
 	device = vulkanDevice->logicalDevice;
+	// Asset loaders process (e.g. convert) their data in parallel on the example's job system
+	vulkanDevice->jobSystem = &getJobSystem();
 
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
@@ -947,24 +1504,13 @@ bool VulkanExampleBase::initVulkan()
 
 	swapChain.connect(instance, physicalDevice, device);
 
-	// Create synchronization objects
-	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queu
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been sumbitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
-
 	// Set up submit info structure
-	// Semaphores will stay the same during application lifetime
+	// The semaphores are switched to the ones of the current frame in flight by prepareFrame
 	// Command buffer submission info is set by each example
 	submitInfo = vks::initializers::submitInfo();
 	submitInfo.pWaitDstStageMask = &submitPipelineStages;
 	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &semaphores.presentComplete;
 	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &semaphores.renderComplete;
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Get Android device name and manufacturer (to display along GPU name)
@@ -1018,6 +1564,10 @@ void VulkanExampleBase::setupDPIAwareness()
 HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 {
 	this->windowInstance = hinstance;
+	if (settings.headless) {
+		window = nullptr;
+		return window;
+	}
 
 	WNDCLASSEX wndClass;
 
@@ -1758,6 +2308,9 @@ static const struct xdg_toplevel_listener xdg_toplevel_listener = {
 
 struct xdg_surface *VulkanExampleBase::setupWindow()
 {
+	if (settings.headless) {
+		return nullptr;
+	}
 	surface = wl_compositor_create_surface(compositor);
 	xdg_surface = xdg_wm_base_get_xdg_surface(shell, surface);
 
@@ -1784,6 +2337,10 @@ xcb_window_t VulkanExampleBase::setupWindow()
 {
 	uint32_t value_mask, value_list[32];
 
+	if (settings.headless) {
+		return 0;
+	}
+
 	window = xcb_generate_id(connection);
 
 	value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
@@ -1989,12 +2546,26 @@ void VulkanExampleBase::buildCommandBuffers() {}
 
 void VulkanExampleBase::createSynchronizationPrimitives()
 {
-	// Wait fences to sync command buffer access
+	settings.framesInFlight = std::max(1u, std::min(settings.framesInFlight, 3u));
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	semaphores.presentComplete.resize(settings.framesInFlight);
+	semaphores.renderComplete.resize(settings.framesInFlight);
+	for (uint32_t i = 0; i < settings.framesInFlight; i++) {
+		// Ensures that the image is displayed before we start submitting new commands to the queue
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete[i]));
+		// Ensures that the image is not presented until all commands have been sumbitted and executed
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete[i]));
+	}
+
+	// Wait fences to sync command buffer access, created signaled so the first use of each frame doesn't block
 	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-	waitFences.resize(drawCmdBuffers.size());
+	waitFences.resize(settings.framesInFlight);
 	for (auto& fence : waitFences) {
 		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
 	}
+	imageFences.assign(swapChain.imageCount, VK_NULL_HANDLE);
+	currentFrame = 0;
 }
 
 void VulkanExampleBase::createCommandPool()
@@ -2017,7 +2588,7 @@ void VulkanExampleBase::setupDepthStencil()
 	imageCI.arrayLayers = 1;
 	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | depthStencilUsage;
 
 	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthStencil.image));
 	VkMemoryRequirements memReqs{};
@@ -2165,6 +2736,8 @@ void VulkanExampleBase::windowResize()
 	width = destWidth;
 	height = destHeight;
 	setupSwapChain();
+	// The image count may have changed and no image is in flight after the wait above
+	imageFences.assign(swapChain.imageCount, VK_NULL_HANDLE);
 
 	// Recreate the frame buffers
 	vkDestroyImageView(device, depthStencil.view, nullptr);
@@ -2186,6 +2759,8 @@ void VulkanExampleBase::windowResize()
 	// references to the recreated frame buffer
 	destroyCommandBuffers();
 	createCommandBuffers();
+	// Query regions follow the (possibly changed) number of draw command buffers
+	gpuProfiler.prepare(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()), 64, vulkanDevice->enabledFeatures.pipelineStatisticsQuery);
 	buildCommandBuffers();
 
 	vkDeviceWaitIdle(device);
@@ -2246,6 +2821,13 @@ void VulkanExampleBase::windowResized()
 
 void VulkanExampleBase::initSwapchain()
 {
+	if (settings.headless) {
+		// No surface, the offscreen images are rendered to (and read back) on the graphics queue
+		swapChain.queueNodeIndex = vulkanDevice->queueFamilyIndices.graphics;
+		swapChain.colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+		swapChain.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+		return;
+	}
 #if defined(_WIN32)
 	swapChain.initSurface(windowInstance, window);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)	
@@ -2263,7 +2845,115 @@ void VulkanExampleBase::initSwapchain()
 
 void VulkanExampleBase::setupSwapChain()
 {
+	if (settings.headless) {
+		createHeadlessImages();
+		return;
+	}
 	swapChain.create(&width, &height, settings.vsync);
 }
 
+void VulkanExampleBase::createHeadlessImages()
+{
+	destroyHeadlessImages();
+
+	// Same number of images as a triple buffered swap chain, examples keep their per image resources
+	swapChain.imageCount = 3;
+	swapChain.images.resize(swapChain.imageCount);
+	swapChain.buffers.resize(swapChain.imageCount);
+	headless.images.resize(swapChain.imageCount);
+	headless.memory.resize(swapChain.imageCount);
+	headless.nextImage = 0;
+
+	for (uint32_t i = 0; i < swapChain.imageCount; i++) {
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = swapChain.colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Same usage as the swap chain images (some examples blit to them) plus transfer source for readback
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &headless.images[i]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, headless.images[i], &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &headless.memory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, headless.images[i], headless.memory[i], 0));
+
+		VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+		imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCI.image = headless.images[i];
+		imageViewCI.format = swapChain.colorFormat;
+		imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		swapChain.images[i] = headless.images[i];
+		swapChain.buffers[i].image = headless.images[i];
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &swapChain.buffers[i].view));
+	}
+}
+
+void VulkanExampleBase::destroyHeadlessImages()
+{
+	for (size_t i = 0; i < headless.images.size(); i++) {
+		vkDestroyImageView(device, swapChain.buffers[i].view, nullptr);
+		vkDestroyImage(device, headless.images[i], nullptr);
+		vkFreeMemory(device, headless.memory[i], nullptr);
+	}
+	headless.images.clear();
+	headless.memory.clear();
+}
+
+void VulkanExampleBase::saveHeadlessImage(uint32_t imageIndex, const std::string &filename)
+{
+	vks::Buffer readback;
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readback, (VkDeviceSize)width * height * 4));
+
+	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vks::tools::insertImageMemoryBarrier(copyCmd, headless.images[imageIndex],
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		subresourceRange);
+	VkBufferImageCopy copyRegion{};
+	copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	copyRegion.imageExtent = { width, height, 1 };
+	vkCmdCopyImageToBuffer(copyCmd, headless.images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &copyRegion);
+	// Transition back, the image is expected in present layout by the render passes of the next frames using it
+	vks::tools::insertImageMemoryBarrier(copyCmd, headless.images[imageIndex],
+		VK_ACCESS_TRANSFER_READ_BIT, 0,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		subresourceRange);
+	vulkanDevice->flushCommandBuffer(copyCmd, queue);
+
+	std::ofstream file(filename, std::ios::out | std::ios::binary);
+	if (file.is_open()) {
+		VK_CHECK_RESULT(readback.map());
+		// Headless images are BGRA, PPM stores RGB
+		const uint8_t* pixels = static_cast<const uint8_t*>(readback.mapped);
+		std::vector<char> row(width * 3);
+		file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
+		for (uint32_t y = 0; y < height; y++) {
+			for (uint32_t x = 0; x < width; x++) {
+				const uint8_t* pixel = pixels + (y * width + x) * 4;
+				row[x * 3 + 0] = pixel[2];
+				row[x * 3 + 1] = pixel[1];
+				row[x * 3 + 2] = pixel[0];
+			}
+			file.write(row.data(), row.size());
+		}
+		readback.unmap();
+		std::cout << "Frame " << headless.frameIndex << " saved to " << filename << std::endl;
+	} else {
+		std::cerr << "Could not write frame readback to " << filename << std::endl;
+	}
+	readback.destroy();
+}
+
 void VulkanExampleBase::OnUpdateUIOverlay(vks::UIOverlay *overlay) {}
\ No newline at end of file
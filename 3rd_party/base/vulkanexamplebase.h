@@ -59,6 +59,8 @@
 #include "VulkanSwapChain.hpp"
 #include "camera.hpp"
 #include "benchmark.hpp"
+#include "VulkanGpuProfiler.hpp"
+#include "jobsystem.hpp"
 
 class VulkanExampleBase
 {
@@ -105,6 +107,8 @@ protected:
 	VkQueue queue;
 	// Depth buffer format (selected during Vulkan initialization)
 	VkFormat depthFormat;
+	/** @brief Additional usage flags of the depth stencil image, e.g. VK_IMAGE_USAGE_SAMPLED_BIT to read depth in shaders (must be set in the derived constructor) */
+	VkImageUsageFlags depthStencilUsage = 0;
 	// Command buffer pool
 	VkCommandPool cmdPool;
 	/** @brief Pipeline stages used to wait at for graphics queue submissions */
@@ -123,18 +127,72 @@ protected:
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 	// List of shader modules created (stored for cleanup)
 	std::vector<VkShaderModule> shaderModules;
-	// Pipeline cache object
-	VkPipelineCache pipelineCache;
+	// Pipeline cache object (loaded from and written back to disk, see createPipelineCache)
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	/** @brief Pipeline cache startup statistics, reported once the render loop starts */
+	struct {
+		/** @brief True if valid cache data from a previous run was loaded */
+		bool warm = false;
+		/** @brief Size of the cache data loaded from disk (in bytes) */
+		size_t loadedSize = 0;
+		/** @brief Number of pipelines created via createGraphicsPipelines */
+		uint32_t pipelineCount = 0;
+		/** @brief Accumulated time spent in createGraphicsPipelines (in ms) */
+		double creationTime = 0.0;
+	} pipelineCacheStats;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
-	// Synchronization semaphores
+	// Synchronization semaphores (one per frame in flight)
 	struct {
 		// Swap chain image presentation
-		VkSemaphore presentComplete;
+		std::vector<VkSemaphore> presentComplete;
 		// Command buffer submission and execution
-		VkSemaphore renderComplete;
+		std::vector<VkSemaphore> renderComplete;
 	} semaphores;
+	// Fences signaled once the GPU has finished all work submitted for a frame in flight
 	std::vector<VkFence> waitFences;
+	// Fence of the frame that last rendered to each swap chain image (guards reuse of its draw command buffer)
+	std::vector<VkFence> imageFences;
+	// Index of the frame in flight that is currently being prepared and submitted
+	uint32_t currentFrame = 0;
+	// GPU timestamps written at the start and the end of every frame in benchmark mode
+	struct {
+		// Two queries (begin, end) per frame in flight
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		// Pre-recorded command buffers writing the begin and end timestamps of each frame in flight
+		std::vector<VkCommandBuffer> beginCmdBuffers;
+		std::vector<VkCommandBuffer> endCmdBuffers;
+		// Signaled by the begin timestamp submission, which waits on presentComplete, the example's submission waits on this instead
+		std::vector<VkSemaphore> beginComplete;
+		// Valid bits of the graphics queue's timestamps
+		uint64_t timestampMask = 0;
+		// Benchmark frame measured by each frame in flight (UINT32_MAX if none)
+		std::vector<uint32_t> benchmarkFrames;
+	} frameTimestamps;
+	// Offscreen color images replacing the swap chain images in headless mode (views are stored in swapChain.buffers)
+	struct {
+		std::vector<VkImage> images;
+		std::vector<VkDeviceMemory> memory;
+		// Image handed out by the next prepareFrame, images are used round robin
+		uint32_t nextImage = 0;
+		// Number of frames submitted so far
+		uint32_t frameIndex = 0;
+		// Frames whose color image is read back and written to disk (see saveHeadlessImage)
+		std::vector<uint32_t> readbackFrames;
+	} headless;
+	// Work stealing job system shared by command buffer recording, asset loading and CPU side updates (created on first use, see getJobSystem)
+	std::unique_ptr<vks::JobSystem> jobSystem;
+	// Command pool and secondary command buffers for one range of a draw list recorded by recordSecondaryCommandBuffers
+	// Only one job records a range at a time, which gives the external synchronization command pools require
+	struct ThreadCommandData {
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		// One secondary command buffer per swap chain image
+		std::vector<VkCommandBuffer> commandBuffers;
+	};
+	// One entry per recorded range, the last entry is used by the calling (main) thread for the UI overlay
+	std::vector<ThreadCommandData> threadCommandData;
+	/** @brief Minimum number of items a worker thread records, smaller draw lists are split across fewer threads */
+	uint32_t minItemsPerRecordingThread = 64;
 public: 
 	bool prepared = false;
 	uint32_t width = 1280;
@@ -149,6 +207,9 @@ public:
 
 	vks::Benchmark benchmark;
 
+	/** @brief GPU timings of named scopes in the draw command buffers (see VulkanGpuProfiler.hpp), shown in the UI overlay and included in benchmark results */
+	vks::GpuProfiler gpuProfiler;
+
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
 
@@ -162,6 +223,16 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = false;
+		/** @brief Number of frames the CPU may record and submit ahead of the GPU (1..3) */
+		uint32_t framesInFlight = 2;
+		/** @brief Load the pipeline cache from disk at startup and write it back at shutdown */
+		bool pipelineCache = true;
+		/** @brief Number of threads executing jobs, including the main thread (0 = number of hardware threads) */
+		uint32_t workerThreads = 0;
+		/** @brief Render into offscreen images owned by the example instead of a window's swap chain (no display or window system required) */
+		bool headless = false;
+		/** @brief Number of frames rendered before the render loop exits in headless mode (not used for benchmarks) */
+		uint32_t headlessFrames = 1;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -383,8 +454,32 @@ public:
 	// Note : Waits for the queue to become idle
 	void flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free);
 
+	/** @brief Returns the example's job system, creates it on first use */
+	vks::JobSystem& getJobSystem();
+	/**
+	* Record a draw list into secondary command buffers on the worker threads and execute them from a primary command buffer
+	*
+	* @param primary Primary command buffer, must be inside a render pass instance begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	* @param imageIndex Index of the swap chain image (and frame buffer) the primary command buffer renders to
+	* @param itemCount Number of items (e.g. objects) in the draw list
+	* @param recordRange Called once per range (from any job system thread) to record the items [first, first + count) into the passed secondary command buffer
+	*
+	* @note Viewport and scissor are set to the full frame buffer for every secondary command buffer, pipelines and descriptors have to be bound by recordRange
+	* @note The UI overlay (if enabled) is recorded into an additional secondary command buffer executed last
+	*/
+	void recordSecondaryCommandBuffers(VkCommandBuffer primary, uint32_t imageIndex, uint32_t itemCount, const std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)> &recordRange);
+	// Destroy the per thread command pools used for secondary command buffer recording
+	void destroyThreadCommandData();
+
 	// Create a cache pool for rendering pipelines
+	// Initial data is loaded from disk if a cache file written for the same device and driver exists
 	void createPipelineCache();
+	// Write the contents of the pipeline cache to disk (replaces the cache file atomically)
+	void savePipelineCache();
+	/** @brief Returns the path of the on-disk pipeline cache for this example */
+	std::string getPipelineCachePath();
+	/** @brief Creates graphics pipelines using the example's pipeline cache and accumulates the time spent for the startup report */
+	VkResult createGraphicsPipelines(uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines);
 
 	// Prepare commonly used Vulkan functions
 	virtual void prepare();
@@ -402,13 +497,30 @@ public:
 	void drawUI(const VkCommandBuffer commandBuffer);
 
 	// Prepare the frame for workload submission
+	// - Waits until the GPU has finished the frame that last used the current frame in flight slot
 	// - Acquires the next image from the swap chain 
 	// - Sets the default wait and signal semaphores
 	void prepareFrame();
 
 	// Submit the frames' workload 
+	// - Signals the fence of the current frame in flight once all of its submissions have finished
+	// - Presents the image and advances to the next frame in flight
 	void submitFrame();
 
+	// Wait until the GPU has finished all frames currently in flight
+	void waitFramesInFlight();
+
+	// Create the offscreen color images used instead of swap chain images in headless mode
+	void createHeadlessImages();
+	void destroyHeadlessImages();
+	// Copy a headless color image to the host and write it to a binary PPM file, the image must be idle and in present layout
+	void saveHeadlessImage(uint32_t imageIndex, const std::string &filename);
+
+	// Create the query pool and command buffers for per frame GPU timestamps (benchmark mode only)
+	void setupFrameTimestamps();
+	// Pass the GPU time of the given frame in flight to the benchmark, the frame's fence must have been waited on
+	void readFrameTimestamps(uint32_t frame);
+
 	/** @brief (Virtual) Called when the UI overlay is updating, can be used to add custom elements to the overlay */
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay);
 };
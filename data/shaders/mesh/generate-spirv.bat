@@ -1,2 +1,3 @@
 glslangvalidator -V mesh.vert -o mesh.vert.spv
+glslangvalidator -V meshpacked.vert -o meshpacked.vert.spv
 glslangvalidator -V mesh.frag -o mesh.frag.spv
\ No newline at end of file
@@ -0,0 +1,57 @@
+#version 450
+
+// Packed vertices: snorm16 position, octahedral snorm16 normal, unorm16 uv, unorm8 color
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec2 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec4 inColor;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	vec4 lightPos;
+} ubo;
+
+// Dequantization of the drawn model part (vks::Model::Dequantization)
+layout (push_constant) uniform PushConstants
+{
+	vec4 positionOffset;
+	vec4 positionScale;
+	vec4 uvOffsetScale;
+} pushConstants;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main() 
+{
+	vec3 position = pushConstants.positionOffset.xyz + inPos.xyz * pushConstants.positionScale.xyz;
+	vec3 normal = octDecode(inNormal);
+	outColor = inColor.rgb;
+	outUV = pushConstants.uvOffsetScale.xy + inUV * pushConstants.uvOffsetScale.zw;
+	gl_Position = ubo.projection * ubo.model * vec4(position, 1.0);
+	
+	vec4 pos = ubo.model * vec4(position, 1.0);
+	outNormal = mat3(ubo.model) * normal;
+	vec3 lPos = mat3(ubo.model) * ubo.lightPos.xyz;
+	outLightVec = lPos - pos.xyz;
+	outViewVec = -pos.xyz;		
+}
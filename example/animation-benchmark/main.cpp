@@ -0,0 +1,311 @@
+//
+// Measures sampling a skeletal animation with many keyframes on a deep joint hierarchy: the linear keyframe scan and
+// per-joint parent walks vkglTF::Model::updateAnimation used to do against the cached keyframe cursors of vks::animation,
+// with dirty flags propagated through the node tree (the recursive baseline below) or through the flattened vks::animation::Hierarchy (as vkglTF now does)
+//
+// Usage: animation-benchmark [-chains <count>] [-depth <joints>] [-keys <keyframes>]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <animation.hpp>
+#include <jobsystem.hpp>
+#include <benchmark.hpp>
+
+// Same transform members as vkglTF::Node
+struct Joint {
+	Joint *parent = nullptr;
+	std::vector<Joint*> children;
+	glm::vec3 translation{};
+	glm::vec3 scale{ 1.0f };
+	glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+	bool dirty = true;
+	glm::mat4 worldMatrix = glm::mat4(1.0f);
+	uint32_t worldStamp = 0;
+	uint32_t hierarchyIndex = 0;
+
+	glm::mat4 localMatrix() {
+		return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+	}
+
+	glm::mat4 getMatrix() {
+		glm::mat4 m = localMatrix();
+		Joint *p = parent;
+		while (p) {
+			m = p->localMatrix() * m;
+			p = p->parent;
+		}
+		return m;
+	}
+};
+
+// Rotation channel with its own keyframe times, like a glTF sampler per joint
+struct Channel {
+	Joint *joint;
+	std::vector<float> inputs;
+	std::vector<glm::quat> outputs;
+	uint32_t cursor = 0;
+};
+
+struct Skeleton {
+	std::vector<std::unique_ptr<Joint>> joints;
+	std::vector<Joint*> roots;
+	std::vector<Channel> channels;
+	std::vector<glm::mat4> palette;
+	float duration = 0.0f;
+	uint32_t stamp = 0;
+	vks::animation::Hierarchy hierarchy;
+	std::vector<Joint*> hierarchyJoints;
+};
+
+static void setRotation(Channel &channel, uint32_t i, float time)
+{
+	const float span = channel.inputs[i + 1] - channel.inputs[i];
+	const float u = (span > 0.0f) ? std::max(0.0f, time - channel.inputs[i]) / span : 1.0f;
+	channel.joint->rotation = glm::normalize(glm::slerp(channel.outputs[i], channel.outputs[i + 1], u));
+	channel.joint->dirty = true;
+}
+
+// Keyframe scan and parent walk per joint as done by vkglTF::Model::updateAnimation and vkglTF::Node::update so far
+static void sampleLinear(Skeleton &skeleton, const std::vector<Channel*> &channels, float time)
+{
+	for (Channel *channel : channels) {
+		for (size_t i = 0; i < channel->inputs.size() - 1; i++) {
+			if ((time >= channel->inputs[i]) && (time <= channel->inputs[i + 1])) {
+				setRotation(*channel, static_cast<uint32_t>(i), time);
+			}
+		}
+	}
+	for (size_t i = 0; i < skeleton.joints.size(); i++) {
+		skeleton.palette[i] = skeleton.joints[i]->getMatrix();
+	}
+}
+
+// Dirty flags propagated through the node tree, world matrices are only recomputed below changed joints
+static void updateWorldMatrices(Joint *joint, uint32_t stamp, bool parentChanged = false)
+{
+	const bool changed = parentChanged || joint->dirty;
+	if (changed) {
+		joint->worldMatrix = joint->parent ? joint->parent->worldMatrix * joint->localMatrix() : joint->localMatrix();
+		joint->worldStamp = stamp;
+		joint->dirty = false;
+	}
+	for (Joint *child : joint->children) {
+		updateWorldMatrices(child, stamp, changed);
+	}
+}
+
+// Cached keyframe cursors and world matrices that are only recomputed below changed joints
+static void sampleCached(Skeleton &skeleton, const std::vector<Channel*> &channels, float time)
+{
+	for (Channel *channel : channels) {
+		if (vks::animation::findKeyframe(channel->inputs.data(), static_cast<uint32_t>(channel->inputs.size()), time, channel->cursor)) {
+			setRotation(*channel, channel->cursor, time);
+		}
+	}
+	skeleton.stamp++;
+	for (Joint *root : skeleton.roots) {
+		updateWorldMatrices(root, skeleton.stamp);
+	}
+	for (size_t i = 0; i < skeleton.joints.size(); i++) {
+		if (skeleton.joints[i]->worldStamp == skeleton.stamp) {
+			skeleton.palette[i] = skeleton.joints[i]->worldMatrix;
+		}
+	}
+}
+
+// Cached keyframe cursors and a single pass over the flattened hierarchy, joints are created in hierarchy order so the palette is one copy
+static void sampleFlat(Skeleton &skeleton, const std::vector<Channel*> &channels, float time, vks::JobSystem *jobSystem)
+{
+	for (Channel *channel : channels) {
+		if (vks::animation::findKeyframe(channel->inputs.data(), static_cast<uint32_t>(channel->inputs.size()), time, channel->cursor)) {
+			setRotation(*channel, channel->cursor, time);
+			skeleton.hierarchy.setLocalMatrix(channel->joint->hierarchyIndex, channel->joint->localMatrix());
+			channel->joint->dirty = false;
+		}
+	}
+	skeleton.hierarchy.update(jobSystem);
+	memcpy(skeleton.palette.data(), skeleton.hierarchy.worldMatrices.data(), skeleton.palette.size() * sizeof(glm::mat4));
+}
+
+// Chains of joints hanging off a common root, every joint has a rotation channel with irregularly spaced keyframes
+static void createSkeleton(Skeleton &skeleton, uint32_t chains, uint32_t depth, uint32_t keys)
+{
+	std::default_random_engine rndEngine(0);
+	std::uniform_real_distribution<float> rndStep(0.5f, 1.5f);
+	std::uniform_real_distribution<float> rndAngle(-0.5f, 0.5f);
+
+	skeleton.joints.emplace_back(new Joint());
+	skeleton.roots.push_back(skeleton.joints[0].get());
+	for (uint32_t c = 0; c < chains; c++) {
+		Joint *parent = skeleton.roots[0];
+		for (uint32_t d = 0; d < depth; d++) {
+			Joint *joint = new Joint();
+			joint->parent = parent;
+			joint->translation = (d == 0) ? glm::vec3(std::cos(c * 0.7f), 0.0f, std::sin(c * 0.7f)) : glm::vec3(0.0f, 0.1f, 0.0f);
+			parent->children.push_back(joint);
+			skeleton.joints.emplace_back(joint);
+			parent = joint;
+		}
+	}
+
+	const float frameTime = 1.0f / 30.0f;
+	for (auto &joint : skeleton.joints) {
+		Channel channel;
+		channel.joint = joint.get();
+		float time = 0.0f;
+		for (uint32_t k = 0; k < keys; k++) {
+			channel.inputs.push_back(time);
+			channel.outputs.push_back(glm::normalize(glm::angleAxis(rndAngle(rndEngine), glm::normalize(glm::vec3(rndAngle(rndEngine), 1.0f, rndAngle(rndEngine))))));
+			time += frameTime * rndStep(rndEngine);
+		}
+		skeleton.duration = std::max(skeleton.duration, channel.inputs.back());
+		skeleton.channels.push_back(std::move(channel));
+	}
+	skeleton.palette.resize(skeleton.joints.size(), glm::mat4(1.0f));
+
+	// Small grains split the skeleton into one subtree per chain for parallel updates
+	skeleton.hierarchy.grainSize = std::max(depth, 32u);
+	skeleton.hierarchyJoints = skeleton.hierarchy.build(skeleton.roots);
+	for (uint32_t i = 0; i < skeleton.hierarchy.size(); i++) {
+		assert(skeleton.hierarchyJoints[i] == skeleton.joints[i].get());
+		skeleton.hierarchyJoints[i]->hierarchyIndex = i;
+		skeleton.hierarchy.setLocalMatrix(i, skeleton.hierarchyJoints[i]->localMatrix());
+	}
+}
+
+// Largest absolute difference between two joint palettes
+static float maxError(const std::vector<glm::mat4> &a, const std::vector<glm::mat4> &b)
+{
+	float error = 0.0f;
+	for (size_t i = 0; i < a.size(); i++) {
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				error = std::max(error, std::fabs(a[i][c][r] - b[i][c][r]));
+			}
+		}
+	}
+	return error;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t chains = 8;
+	uint32_t depth = 32;
+	uint32_t keys = 10000;
+	for (int i = 1; i < argc - 1; i++) {
+		if (std::string(argv[i]) == "-chains") {
+			chains = std::max(1, std::atoi(argv[i + 1]));
+		}
+		if (std::string(argv[i]) == "-depth") {
+			depth = std::max(1, std::atoi(argv[i + 1]));
+		}
+		if (std::string(argv[i]) == "-keys") {
+			keys = std::max(2, std::atoi(argv[i + 1]));
+		}
+	}
+
+	vks::JobSystem jobSystem;
+	// One skeleton per path, so keyframe cursors and dirty flags don't carry over between them
+	enum { PATH_LINEAR, PATH_CACHED, PATH_FLAT, PATH_FLAT_JOBS, PATH_COUNT };
+	const std::string pathNames[PATH_COUNT] = { "linear", "tree", "flat", "flat jobs" };
+	Skeleton skeletons[PATH_COUNT];
+	std::vector<Channel*> allChannels[PATH_COUNT], limbChannels[PATH_COUNT];
+	// Only the last few joints of the first chain are animated (e.g. a hand while the rest of the body is at rest)
+	const uint32_t limbJoints = std::min(depth, 4u);
+	for (uint32_t p = 0; p < PATH_COUNT; p++) {
+		createSkeleton(skeletons[p], chains, depth, keys);
+		for (Channel &channel : skeletons[p].channels) {
+			allChannels[p].push_back(&channel);
+		}
+		for (uint32_t i = depth - limbJoints; i < depth; i++) {
+			limbChannels[p].push_back(&skeletons[p].channels[1 + i]);
+		}
+	}
+	Skeleton &linear = skeletons[PATH_LINEAR];
+
+	std::cout << std::fixed << std::setprecision(4);
+	std::cout << "joints : " << linear.joints.size() << " (" << chains << " chains of " << depth << ")" << std::endl;
+	std::cout << "keys   : " << keys << " per joint, " << linear.duration << " s" << std::endl;
+	std::cout << "threads: " << jobSystem.getThreadCount() << std::endl;
+	std::cout << "times  : ms per frame (median of 5), p90 in % above the median (largest of the row)" << std::endl << std::endl;
+
+	std::cout << std::left << std::setw(28) << "case" << std::right;
+	for (const std::string &name : pathNames) {
+		std::cout << std::setw(12) << name;
+	}
+	std::cout << std::setw(10) << "speedup" << std::setw(12) << "max error" << std::setw(8) << "p90" << std::endl;
+
+	const float frameStep = 1.0f / 60.0f;
+	const uint32_t frames = 64;
+	std::vector<float> seekTimes(frames);
+	std::default_random_engine rndEngine(1);
+	std::uniform_real_distribution<float> rndTime(0.0f, linear.duration);
+	for (float &time : seekTimes) {
+		time = rndTime(rndEngine);
+	}
+
+	struct Case {
+		std::string name;
+		bool limb;
+		bool seek;
+	};
+	const std::vector<Case> cases = {
+		{ "playback, all joints", false, false },
+		{ "random seeks, all joints", false, true },
+		{ "playback, one limb", true, false },
+	};
+
+	for (const Case &c : cases) {
+		const auto frameTime = [&](uint32_t frame) {
+			return c.seek ? seekTimes[frame % frames] : std::fmod(frame * frameStep, linear.duration);
+		};
+		const auto sample = [&](uint32_t path, float time) {
+			Skeleton &skeleton = skeletons[path];
+			const std::vector<Channel*> &channels = c.limb ? limbChannels[path] : allChannels[path];
+			switch (path) {
+			case PATH_LINEAR: sampleLinear(skeleton, channels, time); break;
+			case PATH_CACHED: sampleCached(skeleton, channels, time); break;
+			case PATH_FLAT: sampleFlat(skeleton, channels, time, nullptr); break;
+			default: sampleFlat(skeleton, channels, time, &jobSystem); break;
+			}
+		};
+		std::cout << std::left << std::setw(28) << c.name << std::right;
+		double times[PATH_COUNT];
+		double spread = 0.0;
+		uint32_t frame = 0;
+		for (uint32_t p = 0; p < PATH_COUNT; p++) {
+			// Every path samples the same sequence of frames
+			frame = 0;
+			const vks::Benchmark::Statistics stats = vks::Benchmark::measure(frames, [&] {
+				sample(p, frameTime(frame++));
+			});
+			times[p] = stats.p50;
+			spread = std::max(spread, stats.p90Spread());
+			std::cout << std::setw(12) << times[p];
+		}
+		// All sample the same time once more so the palettes can be compared
+		float error = 0.0f;
+		for (uint32_t p = 0; p < PATH_COUNT; p++) {
+			sample(p, frameTime(frame));
+			error = std::max(error, maxError(linear.palette, skeletons[p].palette));
+		}
+		const double best = *std::min_element(times + 1, times + PATH_COUNT);
+		std::cout << std::setw(9) << std::setprecision(1) << (times[PATH_LINEAR] / best) << "x" << std::setprecision(4);
+		std::cout << std::setw(12) << error << std::setw(7) << std::setprecision(0) << (spread * 100.0) << "%" << std::setprecision(4) << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,246 @@
+//
+// Compares two result files written by the benchmark mode (-b -bf <file>, CSV or JSON)
+// and tests the difference of each metric's mean for significance (Welch's t-test)
+//
+// Usage: benchmark-compare <baseline> <candidate> [-alpha 0.05] [-threshold <percent>]
+// Returns 1 if a metric got significantly slower by more than the threshold (for use in regression gates)
+//
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+struct MetricStats {
+	double count = 0.0;
+	double mean = 0.0;
+	double stddev = 0.0;
+	double p99 = 0.0;
+};
+
+typedef std::map<std::string, MetricStats> Results;
+
+// Continued fraction for the regularized incomplete beta function (modified Lentz's method)
+static double betaContinuedFraction(double a, double b, double x)
+{
+	const double tiny = 1.0e-30;
+	double c = 1.0;
+	double d = 1.0 - (a + b) * x / (a + 1.0);
+	d = 1.0 / ((std::fabs(d) < tiny) ? tiny : d);
+	double h = d;
+	for (int m = 1; m <= 300; m++) {
+		const double m2 = 2.0 * m;
+		double aa = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+		d = 1.0 + aa * d;
+		d = 1.0 / ((std::fabs(d) < tiny) ? tiny : d);
+		c = 1.0 + aa / c;
+		c = (std::fabs(c) < tiny) ? tiny : c;
+		h *= d * c;
+		aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+		d = 1.0 + aa * d;
+		d = 1.0 / ((std::fabs(d) < tiny) ? tiny : d);
+		c = 1.0 + aa / c;
+		c = (std::fabs(c) < tiny) ? tiny : c;
+		const double delta = d * c;
+		h *= delta;
+		if (std::fabs(delta - 1.0) < 1.0e-12) {
+			break;
+		}
+	}
+	return h;
+}
+
+static double incompleteBeta(double a, double b, double x)
+{
+	if (x <= 0.0) {
+		return 0.0;
+	}
+	if (x >= 1.0) {
+		return 1.0;
+	}
+	const double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1.0 - x));
+	if (x < (a + 1.0) / (a + b + 2.0)) {
+		return front * betaContinuedFraction(a, b, x) / a;
+	}
+	return 1.0 - front * betaContinuedFraction(b, a, 1.0 - x) / b;
+}
+
+// Two-sided p-value of Welch's t-test for the difference of two means
+static double welchTest(const MetricStats &a, const MetricStats &b)
+{
+	if ((a.count < 2.0) || (b.count < 2.0)) {
+		return 1.0;
+	}
+	const double va = a.stddev * a.stddev / a.count;
+	const double vb = b.stddev * b.stddev / b.count;
+	if (va + vb <= 0.0) {
+		return (a.mean == b.mean) ? 1.0 : 0.0;
+	}
+	const double t = (b.mean - a.mean) / std::sqrt(va + vb);
+	const double df = (va + vb) * (va + vb) / ((va * va) / (a.count - 1.0) + (vb * vb) / (b.count - 1.0));
+	return incompleteBeta(df / 2.0, 0.5, df / (df + t * t));
+}
+
+static std::vector<std::string> split(const std::string &line)
+{
+	std::vector<std::string> fields;
+	std::stringstream ss(line);
+	std::string field;
+	while (std::getline(ss, field, ',')) {
+		fields.push_back(field);
+	}
+	return fields;
+}
+
+// Reads the "metric,count,min,max,mean,stddev,p50,p90,p99,..." section of a CSV result file
+static bool readCsv(std::istream &is, Results &results)
+{
+	std::string line;
+	bool inMetrics = false;
+	while (std::getline(is, line)) {
+		if (line.compare(0, 7, "metric,") == 0) {
+			inMetrics = true;
+			continue;
+		}
+		if (inMetrics) {
+			std::vector<std::string> fields = split(line);
+			if (fields.size() < 9) {
+				break;
+			}
+			MetricStats stats;
+			stats.count = std::atof(fields[1].c_str());
+			stats.mean = std::atof(fields[4].c_str());
+			stats.stddev = std::atof(fields[5].c_str());
+			stats.p99 = std::atof(fields[8].c_str());
+			results[fields[0]] = stats;
+		}
+	}
+	return !results.empty();
+}
+
+// Returns the number following "key": inside the given object text
+static double jsonNumber(const std::string &object, const std::string &key)
+{
+	size_t pos = object.find("\"" + key + "\":");
+	if (pos == std::string::npos) {
+		return 0.0;
+	}
+	return std::atof(object.c_str() + pos + key.size() + 3);
+}
+
+// Reads the "metrics" object of a JSON result file (as written by vks::Benchmark, not a general JSON parser)
+static bool readJson(const std::string &text, Results &results)
+{
+	size_t pos = text.find("\"metrics\"");
+	if (pos == std::string::npos) {
+		return false;
+	}
+	pos = text.find('{', pos);
+	// Each metric is a flat object: "name": { "count": ..., ... }
+	while (pos != std::string::npos) {
+		const size_t nameBegin = text.find('"', pos + 1);
+		const size_t metricsEnd = text.find('}', pos + 1);
+		const size_t objectBegin = text.find('{', pos + 1);
+		if ((nameBegin == std::string::npos) || (objectBegin == std::string::npos) || (metricsEnd < objectBegin)) {
+			break;
+		}
+		const size_t nameEnd = text.find("\":", nameBegin + 1);
+		const size_t objectEnd = text.find('}', objectBegin);
+		if ((nameEnd == std::string::npos) || (objectEnd == std::string::npos)) {
+			break;
+		}
+		const std::string object = text.substr(objectBegin, objectEnd - objectBegin);
+		MetricStats stats;
+		stats.count = jsonNumber(object, "count");
+		stats.mean = jsonNumber(object, "mean");
+		stats.stddev = jsonNumber(object, "stddev");
+		stats.p99 = jsonNumber(object, "p99");
+		results[text.substr(nameBegin + 1, nameEnd - nameBegin - 1)] = stats;
+		pos = objectEnd;
+	}
+	return !results.empty();
+}
+
+static bool readResults(const std::string &filename, Results &results)
+{
+	std::ifstream is(filename);
+	if (!is.is_open()) {
+		std::cerr << "Could not open " << filename << std::endl;
+		return false;
+	}
+	std::stringstream buffer;
+	buffer << is.rdbuf();
+	const std::string text = buffer.str();
+	const size_t first = text.find_first_not_of(" \t\r\n");
+	bool valid = ((first != std::string::npos) && (text[first] == '{')) ? readJson(text, results) : readCsv(buffer, results);
+	if (!valid) {
+		std::cerr << "No benchmark statistics found in " << filename << std::endl;
+	}
+	return valid;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " <baseline> <candidate> [-alpha 0.05] [-threshold <percent>]" << std::endl;
+		return 2;
+	}
+	double alpha = 0.05;
+	double threshold = 0.0;
+	for (int i = 3; i < argc - 1; i++) {
+		if (std::string(argv[i]) == "-alpha") {
+			alpha = std::atof(argv[i + 1]);
+		}
+		if (std::string(argv[i]) == "-threshold") {
+			threshold = std::atof(argv[i + 1]);
+		}
+	}
+
+	Results baseline, candidate;
+	if (!readResults(argv[1], baseline) || !readResults(argv[2], candidate)) {
+		return 2;
+	}
+
+	std::cout << std::fixed << std::setprecision(4);
+	size_t nameWidth = 8;
+	for (auto& metric : baseline) {
+		nameWidth = std::max(nameWidth, metric.first.size() + 2);
+	}
+
+	std::cout << std::left << std::setw(nameWidth) << "metric" << std::right
+		<< std::setw(12) << "base mean" << std::setw(12) << "new mean" << std::setw(10) << "delta %"
+		<< std::setw(12) << "base p99" << std::setw(12) << "new p99" << std::setw(12) << "p-value" << "  result" << std::endl;
+
+	bool regression = false;
+	for (auto a = baseline.begin(); a != baseline.end(); ++a) {
+		const std::string &name = a->first;
+		auto b = candidate.find(name);
+		if ((b == candidate.end()) || (a->second.count == 0.0) || (b->second.count == 0.0)) {
+			continue;
+		}
+		const double delta = (a->second.mean > 0.0) ? (b->second.mean - a->second.mean) / a->second.mean * 100.0 : 0.0;
+		const double p = welchTest(a->second, b->second);
+		std::string result = "no significant change";
+		if (p < alpha) {
+			if (delta > threshold) {
+				result = "SLOWER";
+				regression = true;
+			} else if (delta < 0.0) {
+				result = "faster";
+			} else {
+				result = "slower (within threshold)";
+			}
+		}
+		std::cout << std::left << std::setw(nameWidth) << name << std::right
+			<< std::setw(12) << a->second.mean << std::setw(12) << b->second.mean << std::setw(10) << std::setprecision(2) << delta << std::setprecision(4)
+			<< std::setw(12) << a->second.p99 << std::setw(12) << b->second.p99 << std::setw(12) << p << "  " << result << std::endl;
+	}
+
+	return regression ? 1 : 0;
+}
@@ -0,0 +1,423 @@
+//
+// Frustum culling and level of detail selection of many objects in a compute shader, the visible objects are drawn
+// from the indirect commands written by the shader
+//
+// Usage: compute-cull [-objects <count per axis>] [-compact]
+// -compact writes the commands of visible objects to consecutive slots, drawn with the visible count as draw count if
+// VK_KHR_draw_indirect_count is supported
+// In benchmark mode (-b) the number of visible and culled objects is reported along with the timings
+//
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vulkan/vulkan.h>
+#include <vulkanexamplebase.h>
+#include <VulkanBuffer.hpp>
+#include <VulkanDevice.hpp>
+#include <VulkanModel.hpp>
+#include <VulkanFrameRingBuffer.hpp>
+#include <VulkanComputeCulling.hpp>
+#include <comm/CommTool.hpp>
+
+#define DEFAULT_OBJECTS_PER_AXIS 64
+
+class Example : public VulkanExampleBase {
+public:
+	Example() : VulkanExampleBase(true)
+	{
+		title = "compute-cull";
+		camera.type = Camera::CameraType::firstperson;
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
+		camera.setTranslation(glm::vec3(0.5f, 0.0f, 0.0f));
+		camera.movementSpeed = 5.0f;
+		settings.overlay = true;
+
+		for (size_t i = 0; i < args.size() - 1; i++) {
+			if (args[i] == std::string("-objects")) {
+				objectsPerAxis = std::max(static_cast<uint32_t>(strtoul(args[i + 1], nullptr, 10)), 1u);
+			}
+		}
+		for (size_t i = 0; i < args.size(); i++) {
+			if (args[i] == std::string("-compact")) {
+				culling.compact = true;
+			}
+		}
+	}
+
+	~Example()
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+		model.destroy();
+		culling.destroy();
+		uniformRing.destroy();
+	}
+
+	virtual void getEnabledFeatures() override
+	{
+		// Objects are selected via the first instance of their indirect command, all commands are drawn with one call if possible
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
+		// Compacted commands are drawn with the visible object count written by the culling pass if supported
+		if (culling.compact) {
+			uint32_t extensionCount = 0;
+			vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+			std::vector<VkExtensionProperties> extensions(extensionCount);
+			vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+			for (auto& extension : extensions) {
+				if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) {
+					enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+					culling.drawIndirectCount = true;
+				}
+			}
+		}
+	}
+
+	// Command buffers are recorded every frame for the acquired swap chain image only (see draw), so
+	// nothing is recorded here (this is also called for UI updates while other images may still be in flight)
+	virtual void buildCommandBuffers() override
+	{
+	}
+
+	void recordCommandBuffer(uint32_t imageIndex)
+	{
+		using namespace vks::initializers;
+
+		VkCommandBuffer cmd = drawCmdBuffers[imageIndex];
+		auto cmdBeginI = commandBufferBeginInfo();
+
+		VkClearValue clearVal[2];
+		clearVal[0].color = defaultClearColor;
+		clearVal[1].depthStencil = { 1.0f,0 };
+
+		auto renderPassBeginI = renderPassBeginInfo();
+		renderPassBeginI.clearValueCount = wws::arr_len_v<decltype(clearVal)>;
+		renderPassBeginI.pClearValues = clearVal;
+		renderPassBeginI.renderArea = { {0,0},{width,height} };
+		renderPassBeginI.renderPass = renderPass;
+		renderPassBeginI.framebuffer = frameBuffers[imageIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmd, &cmdBeginI));
+		gpuProfiler.beginCommandBuffer(cmd, imageIndex);
+
+		// Culling writes the draw commands consumed in the render pass
+		gpuProfiler.beginScope(cmd, "Culling");
+		culling.record(cmd, imageIndex);
+		gpuProfiler.endScope(cmd);
+
+		gpuProfiler.beginScope(cmd, "Render pass");
+		vkCmdBeginRenderPass(cmd, &renderPassBeginI, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport vp = viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmd, 0, 1, &vp);
+		VkRect2D scissor = rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &viewOffset);
+		model.bindBuffers(cmd, VERTEX_BUFFER_BIND_ID);
+		// Object positions and scales are read per instance, the first instance of each command is the object index
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(cmd, INSTANCE_BUFFER_BIND_ID, 1, &culling.objectBuffer.buffer, offsets);
+		culling.draw(cmd);
+
+		drawUI(cmd);
+		vkCmdEndRenderPass(cmd);
+		gpuProfiler.endScope(cmd);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmd));
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+
+		// prepareFrame waited for the last submission of this swap chain image, so its culling results can be read and its data rewritten
+		statistics = culling.getStatistics(currentBuffer);
+		if (benchmark.active) {
+			benchmark.addCount("visible", statistics.visibleCount);
+			benchmark.addCount("culled", statistics.culledCount);
+		}
+
+		uniformRing.beginFrame(currentBuffer);
+		uboView.projection = camera.matrices.perspective;
+		uboView.view = camera.matrices.view;
+		viewOffset = uniformRing.push(&uboView, sizeof(uboView)).offset;
+		VK_CHECK_RESULT(uniformRing.flush());
+
+		if (!freezeFrustum) {
+			cullingProjection = camera.matrices.perspective;
+			cullingView = camera.matrices.view;
+			cullingPosition = -camera.position;
+		}
+		culling.update(currentBuffer, cullingProjection, cullingView, cullingPosition);
+
+		recordCommandBuffer(currentBuffer);
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		VulkanExampleBase::submitFrame();
+	}
+
+	virtual void render() override
+	{
+		if (!prepared)
+			return;
+		draw();
+	}
+
+	void loadAssets()
+	{
+		// Each part of the model is one level of detail, from the most to the least detailed
+		vks::ModelCreateInfo createInfo(0.5f, 1.0f, 0.0f);
+		model.loadFromFile(getAssetPath() + "models/suzanne_lods.dae", vertexLayout, &createInfo, vulkanDevice, queue);
+	}
+
+	void prepareCulling()
+	{
+		if (!vulkanDevice->enabledFeatures.drawIndirectFirstInstance) {
+			vks::tools::exitFatal("Selected GPU does not support drawIndirectFirstInstance, which is required for GPU culling", VK_ERROR_FEATURE_NOT_PRESENT);
+			return;
+		}
+
+		// Objects on a grid centered around the origin
+		const float spacing = 2.5f;
+		const float center = (float)(objectsPerAxis - 1) * spacing * 0.5f;
+		std::vector<glm::vec4> objects;
+		objects.reserve(objectsPerAxis * objectsPerAxis * objectsPerAxis);
+		for (uint32_t x = 0; x < objectsPerAxis; x++) {
+			for (uint32_t y = 0; y < objectsPerAxis; y++) {
+				for (uint32_t z = 0; z < objectsPerAxis; z++) {
+					objects.push_back(glm::vec4(glm::vec3((float)x, (float)y, (float)z) * spacing - glm::vec3(center), 1.0f));
+				}
+			}
+		}
+
+		// Objects are culled with a sphere around the origin of the model that encloses all levels
+		// All levels are drawn with the index buffer range bound by bindBuffers, so they have to share the index type of the first one
+		culling.boundingRadius = 0.0f;
+		std::vector<vks::ComputeCulling::LodLevel> lods(model.parts.size());
+		for (size_t i = 0; i < model.parts.size(); i++) {
+			assert(model.parts[i].indexType == model.parts[0].indexType);
+			lods[i].firstIndex = model.parts[i].indexBase;
+			lods[i].indexCount = model.parts[i].indexCount;
+			lods[i].vertexOffset = static_cast<int32_t>(model.parts[i].vertexBase);
+			lods[i].distance = 5.0f + (float)i * 5.0f;
+			culling.boundingRadius = std::max(culling.boundingRadius, glm::length(model.parts[i].center) + model.parts[i].radius);
+		}
+
+		culling.prepare(vulkanDevice, queue, pipelineCache, loadShader(getAssetPath() + "shaders/computecullandlod/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			objects, lods, swapChain.imageCount);
+		uniformRing.prepare(vulkanDevice, sizeof(uboView), swapChain.imageCount);
+	}
+
+	void setupDescriptors()
+	{
+		using namespace vks::initializers;
+
+		VkDescriptorPoolSize poolSizes[] = {
+			descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
+		};
+		auto poolI = descriptorPoolCreateInfo(wws::arr_len_v<decltype(poolSizes)>, poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &poolI, nullptr, &descriptorPool));
+
+		VkDescriptorSetLayoutBinding binding = descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0);
+		auto layoutI = descriptorSetLayoutCreateInfo(&binding, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &layoutI, nullptr, &descriptorSetLayout));
+		auto pipelineLayoutI = pipelineLayoutCreateInfo(&descriptorSetLayout);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutI, nullptr, &pipelineLayout));
+
+		auto allocI = descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocI, &descriptorSet));
+		updateDescriptorSet();
+	}
+
+	void updateDescriptorSet()
+	{
+		VkDescriptorBufferInfo viewDescriptor = uniformRing.getDescriptor(sizeof(uboView));
+		VkWriteDescriptorSet write = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &viewDescriptor);
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		using namespace vks::initializers;
+
+		auto inputAssemblySCI = pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		auto rasterizationSCI = pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_CLOCKWISE);
+		auto colorBlendAttachment = pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		auto colorBlendSCI = pipelineColorBlendStateCreateInfo(1, &colorBlendAttachment);
+		auto depthStencilSCI = pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		auto vpSCI = pipelineViewportStateCreateInfo(1, 1);
+		auto multisampleSCI = pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+		VkDynamicState dynamicSs[] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
+		auto dynamicSCI = pipelineDynamicStateCreateInfo(dynamicSs, wws::arr_len_v<decltype(dynamicSs)>);
+
+		// Per-vertex position, normal and color, per-instance position and scale (vec4 of the culling object buffer)
+		VkVertexInputBindingDescription vertexInputBindings[] = {
+			vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, vertexLayout.stride(), VK_VERTEX_INPUT_RATE_VERTEX),
+			vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_INSTANCE)
+		};
+		VkVertexInputAttributeDescription vertexInputAttrs[] = {
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 1, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3),
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 2, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 6),
+			vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 4, VK_FORMAT_R32G32B32_SFLOAT, 0),
+			vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 5, VK_FORMAT_R32_SFLOAT, sizeof(float) * 3)
+		};
+		auto vertexInputSCI = pipelineVertexInputStateCreateInfo();
+		vertexInputSCI.vertexBindingDescriptionCount = wws::arr_len_v<decltype(vertexInputBindings)>;
+		vertexInputSCI.pVertexBindingDescriptions = vertexInputBindings;
+		vertexInputSCI.vertexAttributeDescriptionCount = wws::arr_len_v<decltype(vertexInputAttrs)>;
+		vertexInputSCI.pVertexAttributeDescriptions = vertexInputAttrs;
+
+		VkPipelineShaderStageCreateInfo shaderStages[2] = {
+			loadShader(getAssetPath() + "shaders/computecullandlod/indirectdraw.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getAssetPath() + "shaders/computecullandlod/indirectdraw.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+
+		auto pipelineCI = pipelineCreateInfo(pipelineLayout, renderPass);
+		pipelineCI.stageCount = wws::arr_len_v<decltype(shaderStages)>;
+		pipelineCI.pStages = shaderStages;
+		pipelineCI.pColorBlendState = &colorBlendSCI;
+		pipelineCI.pDepthStencilState = &depthStencilSCI;
+		pipelineCI.pDynamicState = &dynamicSCI;
+		pipelineCI.pInputAssemblyState = &inputAssemblySCI;
+		pipelineCI.pMultisampleState = &multisampleSCI;
+		pipelineCI.pRasterizationState = &rasterizationSCI;
+		pipelineCI.pViewportState = &vpSCI;
+		pipelineCI.pVertexInputState = &vertexInputSCI;
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineCI, &pipeline));
+	}
+
+	void prepare() override
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareCulling();
+		setupDescriptors();
+		preparePipelines();
+		prepared = true;
+	}
+
+	virtual void windowResized() override
+	{
+		// Culling results and view data have a region per swap chain image, the image count may change with the swap chain
+		if (uniformRing.getFrameSize() > 0 && uniformRing.buffer.size < uniformRing.getFrameSize() * swapChain.imageCount) {
+			culling.destroy();
+			prepareCulling();
+			updateDescriptorSet();
+		}
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay) override
+	{
+		if (overlay->header("Settings")) {
+			overlay->checkBox("Freeze frustum", &freezeFrustum);
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Objects: %u", statistics.objectCount);
+			overlay->text("Visible: %u", statistics.visibleCount);
+			overlay->text("Culled: %u", statistics.culledCount);
+			for (size_t i = 0; i < statistics.lodCounts.size(); i++) {
+				overlay->text("LOD %u: %u", (uint32_t)i, statistics.lodCounts[i]);
+			}
+			overlay->text("%s", culling.indirectDraws.isMultiDraw() ? "Multi-draw indirect" : "One indirect call per object (no multiDrawIndirect)");
+			if (culling.compact) {
+				overlay->text("%s", culling.isDrawCount() ? "Compacted, GPU draw count" : "Compacted, empty commands drawn (no VK_KHR_draw_indirect_count)");
+			}
+		}
+	}
+
+private:
+	static const uint32_t VERTEX_BUFFER_BIND_ID = 0;
+	static const uint32_t INSTANCE_BUFFER_BIND_ID = 1;
+
+	uint32_t objectsPerAxis = DEFAULT_OBJECTS_PER_AXIS;
+	bool freezeFrustum = false;
+
+	vks::VertexLayout vertexLayout = vks::VertexLayout({
+		vks::VERTEX_COMPONENT_POSITION,
+		vks::VERTEX_COMPONENT_NORMAL,
+		vks::VERTEX_COMPONENT_COLOR,
+	});
+	vks::Model model;
+
+	vks::ComputeCulling culling;
+	vks::ComputeCulling::Statistics statistics;
+	glm::mat4 cullingProjection;
+	glm::mat4 cullingView;
+	glm::vec3 cullingPosition;
+
+	struct {
+		glm::mat4 projection;
+		glm::mat4 view;
+	} uboView;
+	vks::FrameRingBuffer uniformRing;
+	uint32_t viewOffset = 0;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+};
+
+#if defined(_WIN32)
+
+Example *example;
+LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	if (example != NULL)
+	{
+		example->handleMessages(hWnd, uMsg, wParam, lParam);
+	}
+	return (DefWindowProc(hWnd, uMsg, wParam, lParam));
+}
+
+int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow)
+{
+	for (size_t i = 0; i < __argc; i++) { Example::args.push_back(__argv[i]); };
+	example = new Example();
+	example->initVulkan();
+	example->setupWindow(hInstance, WndProc);
+	example->prepare();
+	example->renderLoop();
+	delete example;
+	return 0;
+}
+
+#elif defined(__linux__)
+
+// Linux entry point
+Example *example;
+static void handleEvent(const xcb_generic_event_t *event)
+{
+	if (example != NULL)
+	{
+		example->handleEvent(event);
+	}
+}
+int main(const int argc, const char *argv[])
+{
+	for (size_t i = 0; i < argc; i++) { Example::args.push_back(argv[i]); };
+	example = new Example();
+	example->initVulkan();
+	example->setupWindow();
+	example->prepare();
+	example->renderLoop();
+	delete example;
+	return 0;
+}
+#endif
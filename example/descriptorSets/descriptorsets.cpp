@@ -73,14 +73,12 @@ public:
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &vp);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			VkDeviceSize offset = 0;
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.cube.vertices.buffer, &offset);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.cube.indices.buffer, 0,VK_INDEX_TYPE_UINT32);
+			models.cube.bindBuffers(drawCmdBuffers[i]);
 
 			for (auto &cube : cubes)
 			{
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &cube.descriptorSet, 0, NULL);
-				vkCmdDrawIndexed(drawCmdBuffers[i], models.cube.indexCount, 1, 0, 0, 0);
+				models.cube.draw(drawCmdBuffers[i]);
 			}
 
 			drawUI(drawCmdBuffers[i]);
@@ -200,7 +198,7 @@ public:
 		pipelineCI.stageCount = static_cast<uint32_t>(shaderModules.size());
 		pipelineCI.pStages = shaderModules.data();
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineCI, &pipeline));
 	}
 
 	void prepareUniformBuffers()
@@ -61,25 +61,23 @@ public:
 		{
 			renderPassBeginI.framebuffer = frameBuffers[i];
 			vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBeginI);
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginI, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginI, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-			auto vp = viewport(width, height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &vp);
-			auto scissor = rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-			vkCmdSetLineWidth(drawCmdBuffers[i], 2.0);
-
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-
-			for (int j = 0; j < vertexBuffers.size(); ++j)
+			// Vectors are split across the worker threads, each one records its range into a secondary command buffer
+			recordSecondaryCommandBuffers(drawCmdBuffers[i], i, static_cast<uint32_t>(vertexBuffers.size()), [this](VkCommandBuffer cmd, uint32_t first, uint32_t count)
 			{
-				vkCmdSetLineWidth(drawCmdBuffers[i], dvs[j].get_line_width());
-				VkDeviceSize offset[1] = { 0 };
-				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &vertexBuffers[j].buffer, offset);
-				vkCmdBindIndexBuffer(drawCmdBuffers[i], indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdDrawIndexed(drawCmdBuffers[i], indices.size(), 1, 0, 0, 0);
-			}
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+				for (uint32_t j = first; j < first + count; ++j)
+				{
+					vkCmdSetLineWidth(cmd, dvs[j].get_line_width());
+					VkDeviceSize offset[1] = { 0 };
+					vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffers[j].buffer, offset);
+					vkCmdBindIndexBuffer(cmd, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+					vkCmdDrawIndexed(cmd, indices.size(), 1, 0, 0, 0);
+				}
+			});
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 			vkEndCommandBuffer(drawCmdBuffers[i]);
@@ -256,7 +254,7 @@ public:
 		pipelineCI.pVertexInputState = &vertexInputState.state;
 		pipelineCI.pViewportState = &vpSCI;
 
-		vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline);
+		createGraphicsPipelines(1, &pipelineCI, &pipeline);
 	}
 
 	void prepareUniformBuffer()
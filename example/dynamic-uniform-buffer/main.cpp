@@ -3,10 +3,13 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <vulkan/vulkan.h>
 #include <vulkanexamplebase.h>
 #include <VulkanBuffer.hpp>
 #include <VulkanDevice.hpp>
+#include <VulkanFrameRingBuffer.hpp>
+#include <transforms.hpp>
 #include <comm/CommTool.hpp>
 #include <random>
 
@@ -24,8 +27,6 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (!paused)
-			updateDynamicUniformBuffers();
 	}
 	Example() : VulkanExampleBase(true)
 	{
@@ -37,9 +38,6 @@ public:
 	}
 	~Example()
 	{
-		if (dynamicData)
-			wws::aligned_free(dynamicData);
-
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
 		vkDestroyPipeline(device, pipeline, nullptr);
@@ -48,8 +46,7 @@ public:
 		vertexBuffer.destroy();
 		indexBuffer.destroy();
 
-		uniformBuffers.dynamic.destroy();
-		uniformBuffers.view.destroy();
+		uniformRing.destroy();
 	}
 
 	virtual void buildCommandBuffers() override
@@ -74,30 +71,37 @@ public:
 			renderPassBeginI.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBeginI));
+			gpuProfiler.beginCommandBuffer(drawCmdBuffers[i], i);
+			// Only secondary command buffers may be executed inside the render pass, so the scope has to enclose it
+			gpuProfiler.beginScope(drawCmdBuffers[i], "Render pass");
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginI, VK_SUBPASS_CONTENTS_INLINE);
-
-			auto vp = viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &vp);
-
-			auto scissor = rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginI, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,pipeline);
-			VkDeviceSize offset[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &vertexBuffer.buffer, offset);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+			// Each swap chain image reads the uniform data from its own region of the ring buffer
+			const uint32_t frameOffset = static_cast<uint32_t>(uniformRing.getFrameOffset(i));
 
-			for (int j = 0; j < OBJECT_INSTANCES; ++j)
+			// Objects are split across the worker threads, each one records its range into a secondary command buffer
+			recordSecondaryCommandBuffers(drawCmdBuffers[i], i, OBJECT_INSTANCES, [this, frameOffset](VkCommandBuffer cmd, uint32_t first, uint32_t count)
 			{
-				uint32_t dynamicOffset = static_cast<uint32_t>(dynamicAlignment) * j;
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
-				vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
-			}
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				VkDeviceSize offset[1] = { 0 };
+				vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer.buffer, offset);
+				vkCmdBindIndexBuffer(cmd, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-			drawUI(drawCmdBuffers[i]);
+				for (uint32_t j = first; j < first + count; ++j)
+				{
+					// Dynamic offsets are passed in binding order (view, model)
+					uint32_t dynamicOffsets[2] = {
+						frameOffset + viewOffset,
+						frameOffset + modelOffset + static_cast<uint32_t>(dynamicAlignment) * j
+					};
+					vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 2, dynamicOffsets);
+					vkCmdDrawIndexed(cmd, indexCount, 1, 0, 0, 0);
+				}
+			});
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -106,6 +110,12 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		// prepareFrame waited for the last submission of this swap chain image, so its region of the ring buffer is free again
+		uniformRing.beginFrame(currentBuffer);
+		updateUniformBuffers();
+		updateDynamicUniformBuffers();
+		VK_CHECK_RESULT(uniformRing.flush());
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -144,8 +154,7 @@ public:
 	void setupDescriptorPool()
 	{
 		VkDescriptorPoolSize poolSizes[] = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2)
 		};
 
 		auto poolI = vks::initializers::descriptorPoolCreateInfo(
@@ -158,7 +167,7 @@ public:
 	void setupDescriptorLayout()
 	{
 		VkDescriptorSetLayoutBinding setLayoutBings[] = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,VK_SHADER_STAGE_VERTEX_BIT,0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,VK_SHADER_STAGE_VERTEX_BIT,0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,VK_SHADER_STAGE_VERTEX_BIT,1)
 		};
 
@@ -182,9 +191,12 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocI, &descriptorSet));
 
+		// Both bindings point into the ring buffer, the ranges are selected by the dynamic offsets
+		VkDescriptorBufferInfo viewDescriptor = uniformRing.getDescriptor(sizeof(uboVS));
+		VkDescriptorBufferInfo modelDescriptor = uniformRing.getDescriptor(sizeof(glm::mat4));
 		VkWriteDescriptorSet writeDescriptorSets[] = {
-			vks::initializers::writeDescriptorSet(descriptorSet,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,0,&uniformBuffers.view.descriptor),
-			vks::initializers::writeDescriptorSet(descriptorSet,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,1,&uniformBuffers.dynamic.descriptor)
+			vks::initializers::writeDescriptorSet(descriptorSet,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,0,&viewDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,1,&modelDescriptor)
 		};
 
 		vkUpdateDescriptorSets(device, wws::arr_len_v<decltype(writeDescriptorSets)>, writeDescriptorSets, 0, nullptr);
@@ -236,7 +248,7 @@ public:
 		pipelineCI.pViewportState = &vpSCI;
 		pipelineCI.pVertexInputState = &vertexInputSCI;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineCI, &pipeline));
 	}
 	//min 4  need 8  4+8-1 = 11  4-1 = 3	|  min 4  need 3  4+3-1 = 6  4-1 = 3
 	// 11			0000 1011				|   6			0000 0110
@@ -252,19 +264,12 @@ public:
 			dynamicAlignment = (dynamicAlignment + minUBOAlignement - 1) & ~(minUBOAlignement - 1);
 		}
 
-		size_t bufferSize = OBJECT_INSTANCES * dynamicAlignment;
-
-		dynamicData = wws::aligned_alloc<glm::mat4>(dynamicAlignment, bufferSize);
-		assert(dynamicData);
 		std::cout << "minUniformBufferOffsetAlignment = " << minUBOAlignement << std::endl;
 		std::cout << "dynamicAlignment = " << dynamicAlignment << std::endl;
 
-		VK_CHECK_RESULT( vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &uniformBuffers.view, sizeof(uboVS)));
-
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &uniformBuffers.dynamic, bufferSize));
+		// One region per swap chain image holding the view matrices followed by the model matrices of all objects
+		VkDeviceSize frameSize = std::max<VkDeviceSize>(sizeof(uboVS), minUBOAlignement) + OBJECT_INSTANCES * dynamicAlignment;
+		uniformRing.prepare(vulkanDevice, frameSize, static_cast<uint32_t>(drawCmdBuffers.size()));
 
 		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
 		std::normal_distribution<float> rndDist(-1.0f, 1.0f);
@@ -273,76 +278,69 @@ public:
 			rotationSpeeds[i] = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
 		}
 
-		updateUniformBuffers();
-		updateDynamicUniformBuffers();
+		// Objects are placed on a grid, positions and scales don't change afterwards
+		uint32_t dim = static_cast<uint32_t>(std::round(pow(OBJECT_INSTANCES, (1.0f / 3.0f))));
+		glm::vec3 offset(5.0f);
+		auto offset_1_2 = 0.5f * offset;
+		auto first_pos = -(static_cast<float>(dim) * offset_1_2);
+		transforms.clear();
+		for (uint32_t index = 0; index < OBJECT_INSTANCES; index++)
+		{
+			const uint32_t x = index / (dim * dim);
+			const uint32_t y = (index / dim) % dim;
+			const uint32_t z = index % dim;
+			glm::vec3 pos = glm::vec3(	first_pos.x + offset_1_2.x + x * offset.x, 
+										first_pos.y + offset_1_2.y + y * offset.y,
+										first_pos.z + offset_1_2.z + z * offset.z
+			);
+			transforms.add(pos, eulerRotation(rotations[index]));
+		}
+
+		// Allocations are made in the same order every frame, so the offsets of the first frame are valid for all regions
+		uniformRing.beginFrame(0);
+		viewOffset = uniformRing.allocate(sizeof(uboVS)).offset;
+		modelOffset = uniformRing.allocate(OBJECT_INSTANCES * dynamicAlignment).offset;
 	}
 
 	void updateUniformBuffers()
 	{
-		VK_CHECK_RESULT(uniformBuffers.view.map());
+		vks::FrameRingBuffer::Allocation view = uniformRing.allocate(sizeof(uboVS));
+		assert(view.offset == uniformRing.getFrameOffset(currentBuffer) + viewOffset);
 
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.view = camera.matrices.view;
-
-		memcpy(uniformBuffers.view.mapped, &uboVS, sizeof(uboVS));
-
-		uniformBuffers.view.unmap();
+		memcpy(view.data, &uboVS, sizeof(uboVS));
 	}
 
-	void updateDynamicUniformBuffers(bool force = false)
+	void updateDynamicUniformBuffers()
 	{
-		animationTimer += frameTimer;
-		if ((animationTimer <= 1.0f / 60.0f) && (!force)) {
-			return;
-		}
+		// Every region has to be written each frame, the animation only advances while not paused
+		const float animationStep = paused ? 0.0f : frameTimer;
 
 		// Dynamic ubo with per-object model matrices indexed by offsets in the command buffer
-		uint32_t dim = static_cast<uint32_t>(pow(OBJECT_INSTANCES, (1.0f / 3.0f)));
-		//std::cout << "dim = "<< dim << std::endl;
-		glm::vec3 offset(5.0f);
-		auto offset_1_2 = 0.5f * offset;
-		auto first_pos = -(static_cast<float>(dim) * offset_1_2);
+		vks::FrameRingBuffer::Allocation models = uniformRing.allocate(OBJECT_INSTANCES * dynamicAlignment);
+		assert(models.offset == uniformRing.getFrameOffset(currentBuffer) + modelOffset);
 
-		for (uint32_t x = 0; x < dim; x++)
+		// Only the rotations change, the matrices are composed by the SIMD kernels of the transform store straight into the ring buffer
+		getJobSystem().parallel_for(OBJECT_INSTANCES, 1024, [&](uint32_t first, uint32_t last)
 		{
-			for (uint32_t y = 0; y < dim; y++)
+			for (uint32_t index = first; index < last; index++)
 			{
-				for (uint32_t z = 0; z < dim; z++)
-				{
-					uint32_t index = x * dim * dim + y * dim + z;
-
-					// Aligned offset
-					glm::mat4* modelMat = (glm::mat4*)(((uint64_t)dynamicData + (index * dynamicAlignment)));
-
-					// Update rotations
-					rotations[index] += animationTimer * rotationSpeeds[index];
-
-					// Update matrices
-					glm::vec3 pos = glm::vec3(	first_pos.x + offset_1_2.x + x * offset.x, 
-												first_pos.y + offset_1_2.y + y * offset.y,
-												first_pos.z + offset_1_2.z + z * offset.z
-					);
-					*modelMat = glm::translate(glm::mat4(1.0f), pos);
-					*modelMat = glm::rotate(*modelMat, rotations[index].x, glm::vec3(1.0f, 1.0f, 0.0f));
-					*modelMat = glm::rotate(*modelMat, rotations[index].y, glm::vec3(0.0f, 1.0f, 0.0f));
-					*modelMat = glm::rotate(*modelMat, rotations[index].z, glm::vec3(0.0f, 0.0f, 1.0f));
-				}
+				rotations[index] += animationStep * rotationSpeeds[index];
+				transforms.setRotation(index, eulerRotation(rotations[index]));
 			}
-		}
-
-		animationTimer = 0.0f;
-		VK_CHECK_RESULT(uniformBuffers.dynamic.map());
-
-		memcpy(uniformBuffers.dynamic.mapped, dynamicData, uniformBuffers.dynamic.size);
-		// Flush to make changes visible to the host 
-		VkMappedMemoryRange memoryRange = vks::initializers::mappedMemoryRange();
-		memoryRange.memory = uniformBuffers.dynamic.memory;
-		memoryRange.size = uniformBuffers.dynamic.size;
-		vkFlushMappedMemoryRanges(device, 1, &memoryRange);
-
-		uniformBuffers.dynamic.unmap();
+		});
+		transforms.update(models.data, dynamicAlignment, &getJobSystem());
+	}
 
+	// Same rotation order as rotating the model matrix about (1, 1, 0), y and z
+	static glm::quat eulerRotation(const glm::vec3 &angles)
+	{
+		return glm::angleAxis(angles.x, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)))
+			* glm::angleAxis(angles.y, glm::vec3(0.0f, 1.0f, 0.0f))
+			* glm::angleAxis(angles.z, glm::vec3(0.0f, 0.0f, 1.0f));
 	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
@@ -355,23 +353,17 @@ public:
 		buildCommandBuffers();
 		prepared = true;
 	}
-
-	virtual void viewChanged() override
-	{
-		updateUniformBuffers();
-	}
 private:
 
 	vks::Buffer vertexBuffer;
 	vks::Buffer indexBuffer;
 	uint32_t indexCount;
 
-	struct 
-	{
-		vks::Buffer view;
-		vks::Buffer dynamic;
-
-	} uniformBuffers;
+	// View and model matrices of all frames in flight, written each frame without mapping or copying
+	vks::FrameRingBuffer uniformRing;
+	// Offsets of the view and model matrices relative to the start of a frame's region
+	uint32_t viewOffset = 0;
+	uint32_t modelOffset = 0;
 
 	struct {
 		glm::mat4 projection;
@@ -380,16 +372,13 @@ private:
 
 	glm::vec3 rotations[OBJECT_INSTANCES];
 	glm::vec3 rotationSpeeds[OBJECT_INSTANCES];
-
-	glm::mat4 *dynamicData = nullptr;
+	vks::TransformStore transforms;
 
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSet descriptorSet;
 
-	float animationTimer = 0.0f;
-
 	size_t dynamicAlignment = 0;
 };
 
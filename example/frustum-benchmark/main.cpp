@@ -0,0 +1,167 @@
+//
+// Measures frustum culling of 1k to 1M bounding volumes: the per-object vks::Frustum::checkSphere loop against the
+// structure of arrays batch tests (scalar, SSE, AVX2) with bit mask, compacted index list and classification output
+//
+// Usage: frustum-benchmark [-max <count>]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <frustum.hpp>
+#include <benchmark.hpp>
+
+// Number of objects whose bit differs between two visibility masks
+static uint32_t maskMismatches(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b)
+{
+	uint32_t mismatches = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		for (uint32_t bits = a[i] ^ b[i]; bits != 0; bits &= bits - 1) {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t maxCount = 1000000;
+	for (int i = 1; i < argc - 1; i++) {
+		if (std::string(argv[i]) == "-max") {
+			maxCount = static_cast<uint32_t>(std::atoi(argv[i + 1]));
+		}
+	}
+
+	const vks::simd::Level supported = vks::simd::supportedLevel();
+
+	// Camera in the center of the volume looking down the negative z axis, roughly a sixth of the objects are visible
+	vks::Frustum frustum;
+	const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 256.0f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	frustum.update(projection * view);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "simd   : " << vks::simd::levelName(supported) << std::endl;
+	std::cout << "times  : ms per pass (median of 5), p90 in % above the median (largest of the row)" << std::endl << std::endl;
+
+	struct Path {
+		std::string name;
+		vks::simd::Level level;
+	};
+	std::vector<Path> paths = {
+		{ "SoA scalar", vks::simd::LEVEL_SCALAR },
+		{ "SoA SSE", vks::simd::LEVEL_SSE },
+		{ "SoA AVX2", vks::simd::LEVEL_AVX2 },
+	};
+	paths.erase(std::remove_if(paths.begin(), paths.end(), [supported](const Path &path) { return path.level > supported; }), paths.end());
+	const vks::simd::Level best = paths.back().level;
+
+	std::cout << std::setw(10) << "objects" << std::setw(10) << "visible" << std::setw(14) << "checkSphere";
+	for (auto& path : paths) {
+		std::cout << std::setw(14) << path.name;
+	}
+	std::cout << std::setw(14) << "compact" << std::setw(14) << "classify" << std::setw(14) << "boxes" << std::setw(10) << "speedup" << std::setw(8) << "p90" << std::endl;
+
+	for (uint32_t count = 1000; count <= maxCount; count *= 10) {
+		// Random spheres in a cube around the camera, the boxes enclose them
+		std::default_random_engine rndEngine(0);
+		std::uniform_real_distribution<float> rndPos(-128.0f, 128.0f);
+		std::uniform_real_distribution<float> rndRadius(0.5f, 4.0f);
+		std::vector<glm::vec4> spheres(count);
+		std::vector<float> centerX(count), centerY(count), centerZ(count), radius(count);
+		std::vector<float> minX(count), minY(count), minZ(count), maxX(count), maxY(count), maxZ(count);
+		for (uint32_t i = 0; i < count; i++) {
+			spheres[i] = glm::vec4(rndPos(rndEngine), rndPos(rndEngine), rndPos(rndEngine), rndRadius(rndEngine));
+			centerX[i] = spheres[i].x;
+			centerY[i] = spheres[i].y;
+			centerZ[i] = spheres[i].z;
+			radius[i] = spheres[i].w;
+			minX[i] = spheres[i].x - spheres[i].w;
+			minY[i] = spheres[i].y - spheres[i].w;
+			minZ[i] = spheres[i].z - spheres[i].w;
+			maxX[i] = spheres[i].x + spheres[i].w;
+			maxY[i] = spheres[i].y + spheres[i].w;
+			maxZ[i] = spheres[i].z + spheres[i].w;
+		}
+		const vks::Frustum::SphereArrays sphereArrays = { centerX.data(), centerY.data(), centerZ.data(), radius.data() };
+		const vks::Frustum::BoxArrays boxArrays = { minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data() };
+
+		std::vector<uint32_t> reference((count + 31) / 32), mask((count + 31) / 32);
+		std::vector<uint32_t> indices(count);
+		std::vector<vks::Frustum::Visibility> classes(count);
+
+		// Small counts are repeated to get above the timer resolution
+		const uint32_t repeat = std::max(1u, 1000000u / count);
+		double spread = 0.0;
+		const auto median = [&spread](const vks::Benchmark::Statistics &stats) {
+			spread = std::max(spread, stats.p90Spread());
+			return stats.p50;
+		};
+
+		// Current per-object path: one call per sphere with early out, visible indices collected in a list
+		uint32_t visibleCount = 0;
+		const double checkSphere = median(vks::Benchmark::measure(repeat, [&] {
+			visibleCount = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				if (frustum.checkSphere(glm::vec3(spheres[i].x, spheres[i].y, spheres[i].z), spheres[i].w)) {
+					indices[visibleCount++] = i;
+				}
+			}
+		}));
+		std::fill(reference.begin(), reference.end(), 0u);
+		for (uint32_t i = 0; i < visibleCount; i++) {
+			reference[indices[i] >> 5] |= 1u << (indices[i] & 31);
+		}
+
+		std::cout << std::setw(10) << count << std::setw(10) << visibleCount << std::setw(14) << checkSphere;
+		std::string errors;
+		double fastest = checkSphere;
+		for (auto& path : paths) {
+			frustum.level = path.level;
+			const double time = median(vks::Benchmark::measure(repeat, [&] {
+				frustum.cullSpheres(sphereArrays, count, mask.data());
+			}));
+			fastest = std::min(fastest, time);
+			std::cout << std::setw(14) << time;
+			const uint32_t mismatches = maskMismatches(reference, mask);
+			if (mismatches > 0) {
+				errors += "  " + path.name + " differs for " + std::to_string(mismatches) + " objects";
+			}
+		}
+
+		frustum.level = best;
+		uint32_t compactedCount = 0;
+		const double compact = median(vks::Benchmark::measure(repeat, [&] {
+			compactedCount = frustum.compactSpheres(sphereArrays, count, indices.data());
+		}));
+		if (compactedCount != visibleCount) {
+			errors += "  compact returned " + std::to_string(compactedCount) + " objects";
+		}
+		const double classify = median(vks::Benchmark::measure(repeat, [&] {
+			frustum.classifySpheres(sphereArrays, count, classes.data());
+		}));
+		for (uint32_t i = 0; i < count; i++) {
+			const bool visible = ((reference[i >> 5] >> (i & 31)) & 1) != 0;
+			if (visible != (classes[i] != vks::Frustum::VISIBILITY_OUTSIDE)) {
+				errors += "  classify differs at " + std::to_string(i);
+				break;
+			}
+		}
+		const double boxes = median(vks::Benchmark::measure(repeat, [&] {
+			frustum.cullBoxes(boxArrays, count, mask.data());
+		}));
+
+		std::cout << std::setw(14) << compact << std::setw(14) << classify << std::setw(14) << boxes;
+		std::cout << std::setw(9) << std::setprecision(1) << (checkSphere / fastest) << "x" << std::setw(7) << std::setprecision(0) << (spread * 100.0) << "%" << std::setprecision(3) << errors << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+//
+// Measures vkglTF::Model::loadFromFile for text (.gltf) and binary (.glb) glTF files: parsing, decoding the accessors
+// into staging memory and the whole load (including textures and the upload) as reported by vkglTF::Model::loadTimes
+// for the glTF files in data/models (or the files passed on the command line)
+//
+// Usage: gltf-load-benchmark [-runs <count>] [glTF files...]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+#include <VulkanglTFModel.hpp>
+#include <jobsystem.hpp>
+#include <benchmark.hpp>
+
+int main(int argc, char *argv[])
+{
+	namespace fs = std::filesystem;
+
+	uint32_t runs = 5;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++) {
+		if ((std::string(argv[i]) == "-runs") && (i + 1 < argc)) {
+			runs = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+		} else {
+			files.push_back(argv[i]);
+		}
+	}
+	if (files.empty()) {
+		const std::vector<std::string> extensions = { ".gltf", ".glb" };
+		for (auto& entry : fs::recursive_directory_iterator(std::string(VK_EXAMPLE_DATA_DIR) + "models")) {
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+			if (entry.is_regular_file() && (std::find(extensions.begin(), extensions.end(), extension) != extensions.end())) {
+				files.push_back(entry.path().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+	}
+	if (files.empty()) {
+		std::cout << "No glTF files found in " << VK_EXAMPLE_DATA_DIR << "models, pass them on the command line" << std::endl;
+		return 1;
+	}
+
+	// The loader only needs a device with a graphics queue, so no surface or swap chain extensions are enabled
+	VkApplicationInfo appInfo = {};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = "gltf-load-benchmark";
+	appInfo.pEngineName = "gltf-load-benchmark";
+	appInfo.apiVersion = VK_API_VERSION_1_0;
+	VkInstanceCreateInfo instanceCreateInfo = {};
+	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instanceCreateInfo.pApplicationInfo = &appInfo;
+	VkInstance instance;
+	VK_CHECK_RESULT(vkCreateInstance(&instanceCreateInfo, nullptr, &instance));
+	uint32_t gpuCount = 0;
+	VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &gpuCount, nullptr));
+	if (gpuCount == 0) {
+		std::cout << "No Vulkan device found" << std::endl;
+		vkDestroyInstance(instance, nullptr);
+		return 1;
+	}
+	std::vector<VkPhysicalDevice> physicalDevices(gpuCount);
+	VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &gpuCount, physicalDevices.data()));
+
+	vks::JobSystem jobSystem;
+	{
+		vks::VulkanDevice vulkanDevice(physicalDevices[0]);
+		VK_CHECK_RESULT(vulkanDevice.createLogicalDevice(VkPhysicalDeviceFeatures{}, {}, false, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT));
+		vulkanDevice.jobSystem = &jobSystem;
+		VkQueue queue;
+		vkGetDeviceQueue(vulkanDevice.logicalDevice, vulkanDevice.queueFamilyIndices.graphics, 0, &queue);
+
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "device : " << vulkanDevice.properties.deviceName << std::endl;
+		std::cout << "threads: " << jobSystem.getThreadCount() << std::endl;
+		std::cout << "runs   : " << runs << " (median, after one unmeasured load)" << std::endl << std::endl;
+		std::cout << std::left << std::setw(40) << "model" << std::right << std::setw(8) << "format" << std::setw(12) << "parse ms"
+			<< std::setw(12) << "decode ms" << std::setw(12) << "total ms" << std::setw(12) << "total p90" << std::setw(10) << "stddev" << std::endl;
+
+		for (auto& file : files) {
+			std::string name = fs::relative(fs::path(file), fs::path(std::string(VK_EXAMPLE_DATA_DIR) + "models")).string();
+			if (name.empty() || (name.compare(0, 2, "..") == 0)) {
+				name = fs::path(file).filename().string();
+			}
+			std::string extension = fs::path(file).extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+			const std::string format = (extension == ".glb") ? "glb" : "gltf";
+			if (!fs::is_regular_file(file)) {
+				std::cout << std::left << std::setw(40) << name << "  file not found" << std::endl;
+				continue;
+			}
+
+			std::vector<double> parseTimes, decodeTimes, totalTimes;
+			bool loaded = true;
+			// The first load fills the file system cache and is not measured
+			for (uint32_t r = 0; (r <= runs) && loaded; r++) {
+				vkglTF::Model model;
+				model.loadFromFile(file, &vulkanDevice, queue);
+				// Only successful loads set the total time
+				loaded = model.loadTimes.total > 0.0;
+				if (loaded && (r > 0)) {
+					parseTimes.push_back(model.loadTimes.parse);
+					decodeTimes.push_back(model.loadTimes.decode);
+					totalTimes.push_back(model.loadTimes.total);
+				}
+				// Uploads of the model have to be finished before it's destroyed
+				vkDeviceWaitIdle(vulkanDevice.logicalDevice);
+			}
+			if (!loaded) {
+				std::cout << std::left << std::setw(40) << name << "  could not be loaded" << std::endl;
+				continue;
+			}
+
+			const vks::Benchmark::Statistics parse = vks::Benchmark::computeStatistics(parseTimes);
+			const vks::Benchmark::Statistics decode = vks::Benchmark::computeStatistics(decodeTimes);
+			const vks::Benchmark::Statistics total = vks::Benchmark::computeStatistics(totalTimes);
+			std::cout << std::left << std::setw(40) << name << std::right << std::setw(8) << format << std::setw(12) << parse.p50
+				<< std::setw(12) << decode.p50 << std::setw(12) << total.p50 << std::setw(12) << total.p90 << std::setw(10) << total.stddev << std::endl;
+		}
+	}
+
+	vkDestroyInstance(instance, nullptr);
+	return 0;
+}
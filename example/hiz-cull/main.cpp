@@ -0,0 +1,536 @@
+//
+// Occlusion culling of the parts of an interior scene against a hierarchical depth pyramid in two compute passes:
+// objects visible in the previous frame's pyramid are drawn first, the pyramid is rebuilt from their depth and the
+// remaining objects are tested again, so disoccluded objects are drawn in the same frame
+//
+// Usage: hiz-cull [-grid <rooms per axis>] [-nohiz]
+// -nohiz starts with frustum culling only, in benchmark mode (-b) the visible, occluded and disoccluded counts are reported
+//
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vulkan/vulkan.h>
+#include <vulkanexamplebase.h>
+#include <VulkanBuffer.hpp>
+#include <VulkanDevice.hpp>
+#include <VulkanModel.hpp>
+#include <VulkanFrameRingBuffer.hpp>
+#include <VulkanHiZCulling.hpp>
+#include <comm/CommTool.hpp>
+
+#define DEFAULT_ROOMS_PER_AXIS 4
+
+class Example : public VulkanExampleBase {
+public:
+	Example() : VulkanExampleBase(true)
+	{
+		title = "hiz-cull";
+		camera.type = Camera::CameraType::firstperson;
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
+		camera.movementSpeed = 5.0f;
+		settings.overlay = true;
+		// The depth pyramid is built from the depth attachment
+		depthStencilUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		for (size_t i = 0; i < args.size(); i++) {
+			if ((args[i] == std::string("-grid")) && (i + 1 < args.size())) {
+				roomsPerAxis = std::max(static_cast<uint32_t>(strtoul(args[i + 1], nullptr, 10)), 1u);
+			}
+			if (args[i] == std::string("-nohiz")) {
+				occlusionCulling = false;
+			}
+		}
+	}
+
+	~Example()
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyRenderPass(device, loadRenderPass, nullptr);
+
+		model.destroy();
+		culling.destroy();
+		instanceBuffer.destroy();
+		uniformRing.destroy();
+	}
+
+	virtual void getEnabledFeatures() override
+	{
+		// Objects are selected via the first instance of their indirect command, all commands are drawn with one call if possible
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
+	}
+
+	// Command buffers are recorded every frame for the acquired swap chain image only (see draw), so
+	// nothing is recorded here (this is also called for UI updates while other images may still be in flight)
+	virtual void buildCommandBuffers() override
+	{
+	}
+
+	void drawObjects(VkCommandBuffer cmd, bool late)
+	{
+		using namespace vks::initializers;
+
+		VkViewport vp = viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmd, 0, 1, &vp);
+		VkRect2D scissor = rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &viewOffset);
+		model.bindBuffers(cmd, VERTEX_BUFFER_BIND_ID);
+		// Room offsets are read per instance, the first instance of each command is the object index
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(cmd, INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+		if (late) {
+			culling.drawLate(cmd);
+		} else {
+			culling.drawEarly(cmd);
+		}
+	}
+
+	void recordCommandBuffer(uint32_t imageIndex)
+	{
+		using namespace vks::initializers;
+
+		VkCommandBuffer cmd = drawCmdBuffers[imageIndex];
+		auto cmdBeginI = commandBufferBeginInfo();
+
+		VkClearValue clearVal[2];
+		clearVal[0].color = defaultClearColor;
+		clearVal[1].depthStencil = { 1.0f,0 };
+
+		auto renderPassBeginI = renderPassBeginInfo();
+		renderPassBeginI.clearValueCount = wws::arr_len_v<decltype(clearVal)>;
+		renderPassBeginI.pClearValues = clearVal;
+		renderPassBeginI.renderArea = { {0,0},{width,height} };
+		renderPassBeginI.renderPass = renderPass;
+		renderPassBeginI.framebuffer = frameBuffers[imageIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmd, &cmdBeginI));
+		gpuProfiler.beginCommandBuffer(cmd, imageIndex);
+
+		gpuProfiler.beginScope(cmd, "Early culling");
+		culling.recordEarly(cmd, imageIndex);
+		gpuProfiler.endScope(cmd);
+
+		gpuProfiler.beginScope(cmd, "Early render pass");
+		vkCmdBeginRenderPass(cmd, &renderPassBeginI, VK_SUBPASS_CONTENTS_INLINE);
+		drawObjects(cmd, false);
+		// Without occlusion culling everything visible was drawn by the early pass
+		if (!culling.isOcclusionFrame()) {
+			drawUI(cmd);
+		}
+		vkCmdEndRenderPass(cmd);
+		gpuProfiler.endScope(cmd);
+
+		// Builds the pyramid from the early pass depth and tests the objects it occluded (only copies statistics without occlusion culling)
+		gpuProfiler.beginScope(cmd, "Depth pyramid and late culling");
+		culling.recordLate(cmd, imageIndex);
+		gpuProfiler.endScope(cmd);
+
+		if (culling.isOcclusionFrame()) {
+			// Continues on the color and depth of the early pass
+			gpuProfiler.beginScope(cmd, "Late render pass");
+			renderPassBeginI.renderPass = loadRenderPass;
+			renderPassBeginI.clearValueCount = 0;
+			renderPassBeginI.pClearValues = nullptr;
+			vkCmdBeginRenderPass(cmd, &renderPassBeginI, VK_SUBPASS_CONTENTS_INLINE);
+			drawObjects(cmd, true);
+			drawUI(cmd);
+			vkCmdEndRenderPass(cmd);
+			gpuProfiler.endScope(cmd);
+		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmd));
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+
+		// prepareFrame waited for the last submission of this swap chain image, so its culling results can be read and its data rewritten
+		statistics = culling.getStatistics(currentBuffer);
+		if (benchmark.active) {
+			benchmark.addCount("visible", statistics.visibleCount());
+			benchmark.addCount("frustum culled", statistics.frustumCulledCount);
+			benchmark.addCount("occluded", statistics.occludedCount);
+			benchmark.addCount("disoccluded", statistics.lateVisibleCount);
+		}
+
+		uniformRing.beginFrame(currentBuffer);
+		uboView.projection = camera.matrices.perspective;
+		uboView.view = camera.matrices.view;
+		viewOffset = uniformRing.push(&uboView, sizeof(uboView)).offset;
+		VK_CHECK_RESULT(uniformRing.flush());
+
+		culling.occlusionCulling = occlusionCulling;
+		culling.update(currentBuffer, camera.matrices.perspective, camera.matrices.view);
+
+		recordCommandBuffer(currentBuffer);
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		VulkanExampleBase::submitFrame();
+	}
+
+	virtual void render() override
+	{
+		if (!prepared)
+			return;
+		draw();
+	}
+
+	// Loads the scene and computes the bounds of each part from the converted vertices
+	void loadAssets()
+	{
+		vks::ModelCreateInfo createInfo(0.25f, 1.0f, 0.0f);
+		vks::Model::Data data;
+		if (!vks::Model::loadData(getAssetPath() + "models/sampleroom.dae", vertexLayout, &createInfo, vks::Model::defaultFlags, vulkanDevice->jobSystem, data)) {
+			vks::tools::exitFatal("Could not load \"sampleroom.dae\": " + data.error, -1);
+			return;
+		}
+		model.loadFromData(data, vulkanDevice, queue);
+
+		// Position is the first component of the vertex layout
+		const uint32_t stride = vertexLayout.stride() / sizeof(float);
+		partBounds.resize(data.parts.size());
+		sceneMin = glm::vec3(FLT_MAX);
+		sceneMax = glm::vec3(-FLT_MAX);
+		for (size_t i = 0; i < data.parts.size(); i++) {
+			glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+			for (uint32_t v = data.parts[i].vertexBase; v < data.parts[i].vertexBase + data.parts[i].vertexCount; v++) {
+				const float *position = data.vertices + (size_t)v * stride;
+				min = glm::min(min, glm::vec3(position[0], position[1], position[2]));
+				max = glm::max(max, glm::vec3(position[0], position[1], position[2]));
+			}
+			partBounds[i] = glm::vec4((min + max) * 0.5f, glm::distance(min, max) * 0.5f);
+			sceneMin = glm::min(sceneMin, min);
+			sceneMax = glm::max(sceneMax, max);
+		}
+
+		// Start at the center of the first room
+		camera.setTranslation(-(sceneMin + sceneMax) * 0.5f);
+	}
+
+	void prepareCulling()
+	{
+		if (!vulkanDevice->enabledFeatures.drawIndirectFirstInstance) {
+			vks::tools::exitFatal("Selected GPU does not support drawIndirectFirstInstance, which is required for GPU culling", VK_ERROR_FEATURE_NOT_PRESENT);
+			return;
+		}
+
+		// Copies of the room on a grid in the xz plane, every part of every copy is one object
+		const glm::vec3 roomSize = sceneMax - sceneMin;
+		std::vector<glm::vec4> objects;
+		std::vector<glm::vec4> instances;
+		std::vector<VkDrawIndexedIndirectCommand> draws;
+		for (uint32_t x = 0; x < roomsPerAxis; x++) {
+			for (uint32_t z = 0; z < roomsPerAxis; z++) {
+				const glm::vec3 offset = glm::vec3((float)x * roomSize.x, 0.0f, (float)z * roomSize.z);
+				for (size_t i = 0; i < model.parts.size(); i++) {
+					// All commands are drawn with the index buffer range bound by bindBuffers
+					assert(model.parts[i].indexType == model.parts[0].indexType);
+					VkDrawIndexedIndirectCommand command{};
+					command.indexCount = model.parts[i].indexCount;
+					command.instanceCount = 1;
+					command.firstIndex = model.parts[i].indexBase;
+					command.vertexOffset = static_cast<int32_t>(model.parts[i].vertexBase);
+					command.firstInstance = static_cast<uint32_t>(draws.size());
+					draws.push_back(command);
+					objects.push_back(glm::vec4(glm::vec3(partBounds[i]) + offset, partBounds[i].w));
+					instances.push_back(glm::vec4(offset, 1.0f));
+				}
+			}
+		}
+
+		culling.prepare(vulkanDevice, queue, pipelineCache,
+			loadShader(getAssetPath() + "shaders/hizcull/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			loadShader(getAssetPath() + "shaders/hizcull/depthreduce.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			objects, draws, swapChain.imageCount);
+		culling.setDepthAttachment(depthStencil.image, depthFormat, width, height);
+		uniformRing.prepare(vulkanDevice, sizeof(uboView), swapChain.imageCount);
+
+		if (instanceBuffer.buffer == VK_NULL_HANDLE) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &instanceBuffer, instances.size() * sizeof(glm::vec4)));
+			vks::UploadQueue *uploadQueue = vks::UploadQueue::getShared(vulkanDevice, queue);
+			uploadQueue->uploadBuffer(instanceBuffer.buffer, instances.data(), instanceBuffer.size, 0,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+			uploadQueue->flush();
+		}
+	}
+
+	// Same attachments as the default render pass, but continues on the color and depth written by the early pass
+	void setupLoadRenderPass()
+	{
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		attachments[0].format = swapChain.colorFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments[1].format = depthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		// Color written by the early pass is loaded, the depth attachment was returned from the pyramid reduction by the culling barriers
+		std::array<VkSubpassDependency, 2> dependencies;
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &loadRenderPass));
+	}
+
+	void setupDescriptors()
+	{
+		using namespace vks::initializers;
+
+		VkDescriptorPoolSize poolSizes[] = {
+			descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
+		};
+		auto poolI = descriptorPoolCreateInfo(wws::arr_len_v<decltype(poolSizes)>, poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &poolI, nullptr, &descriptorPool));
+
+		VkDescriptorSetLayoutBinding binding = descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0);
+		auto layoutI = descriptorSetLayoutCreateInfo(&binding, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &layoutI, nullptr, &descriptorSetLayout));
+		auto pipelineLayoutI = pipelineLayoutCreateInfo(&descriptorSetLayout);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutI, nullptr, &pipelineLayout));
+
+		auto allocI = descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocI, &descriptorSet));
+		updateDescriptorSet();
+	}
+
+	void updateDescriptorSet()
+	{
+		VkDescriptorBufferInfo viewDescriptor = uniformRing.getDescriptor(sizeof(uboView));
+		VkWriteDescriptorSet write = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &viewDescriptor);
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		using namespace vks::initializers;
+
+		auto inputAssemblySCI = pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		auto rasterizationSCI = pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_CLOCKWISE);
+		auto colorBlendAttachment = pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		auto colorBlendSCI = pipelineColorBlendStateCreateInfo(1, &colorBlendAttachment);
+		auto depthStencilSCI = pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		auto vpSCI = pipelineViewportStateCreateInfo(1, 1);
+		auto multisampleSCI = pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+		VkDynamicState dynamicSs[] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
+		auto dynamicSCI = pipelineDynamicStateCreateInfo(dynamicSs, wws::arr_len_v<decltype(dynamicSs)>);
+
+		// Per-vertex position, normal and color, per-instance room offset and scale
+		VkVertexInputBindingDescription vertexInputBindings[] = {
+			vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, vertexLayout.stride(), VK_VERTEX_INPUT_RATE_VERTEX),
+			vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_INSTANCE)
+		};
+		VkVertexInputAttributeDescription vertexInputAttrs[] = {
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 1, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3),
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 2, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 6),
+			vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 4, VK_FORMAT_R32G32B32_SFLOAT, 0),
+			vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 5, VK_FORMAT_R32_SFLOAT, sizeof(float) * 3)
+		};
+		auto vertexInputSCI = pipelineVertexInputStateCreateInfo();
+		vertexInputSCI.vertexBindingDescriptionCount = wws::arr_len_v<decltype(vertexInputBindings)>;
+		vertexInputSCI.pVertexBindingDescriptions = vertexInputBindings;
+		vertexInputSCI.vertexAttributeDescriptionCount = wws::arr_len_v<decltype(vertexInputAttrs)>;
+		vertexInputSCI.pVertexAttributeDescriptions = vertexInputAttrs;
+
+		VkPipelineShaderStageCreateInfo shaderStages[2] = {
+			loadShader(getAssetPath() + "shaders/computecullandlod/indirectdraw.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getAssetPath() + "shaders/computecullandlod/indirectdraw.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+
+		// Also used in the late render pass, which is compatible with the default one
+		auto pipelineCI = pipelineCreateInfo(pipelineLayout, renderPass);
+		pipelineCI.stageCount = wws::arr_len_v<decltype(shaderStages)>;
+		pipelineCI.pStages = shaderStages;
+		pipelineCI.pColorBlendState = &colorBlendSCI;
+		pipelineCI.pDepthStencilState = &depthStencilSCI;
+		pipelineCI.pDynamicState = &dynamicSCI;
+		pipelineCI.pInputAssemblyState = &inputAssemblySCI;
+		pipelineCI.pMultisampleState = &multisampleSCI;
+		pipelineCI.pRasterizationState = &rasterizationSCI;
+		pipelineCI.pViewportState = &vpSCI;
+		pipelineCI.pVertexInputState = &vertexInputSCI;
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineCI, &pipeline));
+	}
+
+	void prepare() override
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareCulling();
+		setupLoadRenderPass();
+		setupDescriptors();
+		preparePipelines();
+		prepared = true;
+	}
+
+	virtual void windowResized() override
+	{
+		// Culling results and view data have a region per swap chain image, the image count may change with the swap chain
+		if (uniformRing.getFrameSize() > 0 && uniformRing.buffer.size < uniformRing.getFrameSize() * swapChain.imageCount) {
+			culling.destroy();
+			prepareCulling();
+			updateDescriptorSet();
+		} else {
+			// The depth attachment has been recreated with the new size
+			culling.setDepthAttachment(depthStencil.image, depthFormat, width, height);
+		}
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay) override
+	{
+		if (overlay->header("Settings")) {
+			overlay->checkBox("Occlusion culling", &occlusionCulling);
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Objects: %u", statistics.objectCount);
+			overlay->text("Frustum culled: %u", statistics.frustumCulledCount);
+			overlay->text("Occluded: %u", statistics.occludedCount);
+			overlay->text("Visible: %u", statistics.visibleCount());
+			overlay->text("  early pass: %u", statistics.earlyVisibleCount);
+			overlay->text("  disoccluded: %u", statistics.lateVisibleCount);
+		}
+	}
+
+private:
+	static const uint32_t VERTEX_BUFFER_BIND_ID = 0;
+	static const uint32_t INSTANCE_BUFFER_BIND_ID = 1;
+
+	uint32_t roomsPerAxis = DEFAULT_ROOMS_PER_AXIS;
+	bool occlusionCulling = true;
+
+	vks::VertexLayout vertexLayout = vks::VertexLayout({
+		vks::VERTEX_COMPONENT_POSITION,
+		vks::VERTEX_COMPONENT_NORMAL,
+		vks::VERTEX_COMPONENT_COLOR,
+	});
+	vks::Model model;
+	/** @brief Bounding sphere of each model part */
+	std::vector<glm::vec4> partBounds;
+	glm::vec3 sceneMin;
+	glm::vec3 sceneMax;
+	/** @brief Room offset (xyz) and scale (w) of each object */
+	vks::Buffer instanceBuffer;
+
+	vks::HiZCulling culling;
+	vks::HiZCulling::Statistics statistics;
+
+	struct {
+		glm::mat4 projection;
+		glm::mat4 view;
+	} uboView;
+	vks::FrameRingBuffer uniformRing;
+	uint32_t viewOffset = 0;
+
+	VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+};
+
+#if defined(_WIN32)
+
+Example *example;
+LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	if (example != NULL)
+	{
+		example->handleMessages(hWnd, uMsg, wParam, lParam);
+	}
+	return (DefWindowProc(hWnd, uMsg, wParam, lParam));
+}
+
+int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow)
+{
+	for (size_t i = 0; i < __argc; i++) { Example::args.push_back(__argv[i]); };
+	example = new Example();
+	example->initVulkan();
+	example->setupWindow(hInstance, WndProc);
+	example->prepare();
+	example->renderLoop();
+	delete example;
+	return 0;
+}
+
+#elif defined(__linux__)
+
+// Linux entry point
+Example *example;
+static void handleEvent(const xcb_generic_event_t *event)
+{
+	if (example != NULL)
+	{
+		example->handleEvent(event);
+	}
+}
+int main(const int argc, const char *argv[])
+{
+	for (size_t i = 0; i < argc; i++) { Example::args.push_back(argv[i]); };
+	example = new Example();
+	example->initVulkan();
+	example->setupWindow();
+	example->prepare();
+	example->renderLoop();
+	delete example;
+	return 0;
+}
+#endif
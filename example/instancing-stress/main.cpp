@@ -0,0 +1,658 @@
+//
+// Draws the same model 100k+ times with three different paths:
+// per-object (push constants and one draw per object), dynamic-offset (one descriptor set bind and draw per object),
+// instanced (per-instance vertex binding and a single draw per model part) and indirect (one indirect command per
+// object and part, all submitted with a single multi-draw)
+//
+// Usage: instancing-stress [-instances <count>] [-drawpath per-object|dynamic-offset|instanced|indirect] [-lod]
+// In benchmark mode (-b) all paths are drawn round robin unless -drawpath is set, each reports its own metrics
+// -lod draws a detailed model with generated levels of detail, the per-object paths select a level per object from its
+// projected error (vks::Model::drawLod). In benchmark mode the camera then also steps through several distances and the
+// triangle counts and frame times are reported per distance
+//
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vulkan/vulkan.h>
+#include <vulkanexamplebase.h>
+#include <VulkanBuffer.hpp>
+#include <VulkanDevice.hpp>
+#include <VulkanModel.hpp>
+#include <VulkanFrameRingBuffer.hpp>
+#include <VulkanIndirectDraw.hpp>
+#include <VulkanUploadQueue.hpp>
+#include <comm/CommTool.hpp>
+#include <random>
+#include <chrono>
+#include <atomic>
+
+#define DEFAULT_INSTANCE_COUNT 100000
+
+class Example : public VulkanExampleBase {
+public:
+	enum DrawPath {
+		DRAW_PATH_PER_OBJECT = 0,
+		DRAW_PATH_DYNAMIC_OFFSET = 1,
+		DRAW_PATH_INSTANCED = 2,
+		DRAW_PATH_INDIRECT = 3,
+		DRAW_PATH_COUNT = 4
+	};
+
+	Example() : VulkanExampleBase(true)
+	{
+		title = "instancing-stress";
+		camera.type = Camera::CameraType::lookat;
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 1024.0f);
+		camera.setRotation(glm::vec3(-20.0f, 30.0f, 0.0f));
+		settings.overlay = true;
+
+		bool pathSelected = false;
+		for (size_t i = 0; i < args.size(); i++) {
+			if ((args[i] == std::string("-instances")) && (i + 1 < args.size())) {
+				instanceCount = std::max(static_cast<uint32_t>(strtoul(args[i + 1], nullptr, 10)), 1u);
+			}
+			if (args[i] == std::string("-lod")) {
+				lodEnabled = true;
+			}
+			if ((args[i] == std::string("-drawpath")) && (i + 1 < args.size())) {
+				for (int32_t path = 0; path < DRAW_PATH_COUNT; path++) {
+					if (pathNames[path] == args[i + 1]) {
+						drawPath = path;
+						pathSelected = true;
+					}
+				}
+			}
+		}
+		// Compare all paths within one benchmark run
+		cyclePaths = benchmark.active && !pathSelected;
+		cycleDistances = benchmark.active && lodEnabled;
+
+		camera.setTranslation(glm::vec3(0.0f, 0.0f, -gridSize() * 1.5f));
+	}
+
+	~Example()
+	{
+		vkDestroyPipeline(device, pipelines.perObject, nullptr);
+		vkDestroyPipeline(device, pipelines.dynamicOffset, nullptr);
+		vkDestroyPipeline(device, pipelines.instanced, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.perObject, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.dynamicOffset, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.instanced, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.dynamicOffset, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.instanced, nullptr);
+
+		model.destroy();
+		instanceBuffer.destroy();
+		indirectDraws.destroy();
+		modelMatrixBuffer.destroy();
+		uniformRing.destroy();
+	}
+
+	virtual void getEnabledFeatures() override
+	{
+		// Submit all indirect commands with one call, per-object data is selected via the first instance of each command
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+	}
+
+	// Command buffers are recorded every frame for the acquired swap chain image only (see draw), so
+	// nothing is recorded here (this is also called for UI updates while other images may still be in flight)
+	virtual void buildCommandBuffers() override
+	{
+	}
+
+	void recordCommandBuffer(uint32_t imageIndex)
+	{
+		using namespace vks::initializers;
+
+		VkCommandBuffer cmd = drawCmdBuffers[imageIndex];
+		auto cmdBeginI = commandBufferBeginInfo();
+
+		VkClearValue clearVal[2];
+		clearVal[0].color = defaultClearColor;
+		clearVal[1].depthStencil = { 1.0f,0 };
+
+		auto renderPassBeginI = renderPassBeginInfo();
+		renderPassBeginI.clearValueCount = wws::arr_len_v<decltype(clearVal)>;
+		renderPassBeginI.pClearValues = clearVal;
+		renderPassBeginI.renderArea = { {0,0},{width,height} };
+		renderPassBeginI.renderPass = renderPass;
+		renderPassBeginI.framebuffer = frameBuffers[imageIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmd, &cmdBeginI));
+		gpuProfiler.beginCommandBuffer(cmd, imageIndex);
+		gpuProfiler.beginScope(cmd, pathNames[drawPath]);
+
+		if ((drawPath == DRAW_PATH_INSTANCED) || (drawPath == DRAW_PATH_INDIRECT))
+		{
+			vkCmdBeginRenderPass(cmd, &renderPassBeginI, VK_SUBPASS_CONTENTS_INLINE);
+			VkViewport vp = viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(cmd, 0, 1, &vp);
+			VkRect2D scissor = rect2D(width, height, 0, 0);
+			vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+			// Object positions come from the instance rate binding
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.instanced);
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.instanced, 0, 1, &descriptorSets.instanced, 1, &viewOffset);
+			model.bindBuffers(cmd, VERTEX_BUFFER_BIND_ID);
+			VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(cmd, INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+			if (drawPath == DRAW_PATH_INDIRECT) {
+				// Each object has its own commands with the object index as first instance, recorded with one call per index type
+				if (indirectDraws16 > 0) {
+					model.bindIndexBuffer(cmd, VK_INDEX_TYPE_UINT16);
+					indirectDraws.draw(cmd, 0, indirectDraws16);
+				}
+				if (indirectDraws.size() > indirectDraws16) {
+					model.bindIndexBuffer(cmd, VK_INDEX_TYPE_UINT32);
+					indirectDraws.draw(cmd, indirectDraws16);
+				}
+			} else {
+				// A single draw per model part covers all instances
+				model.draw(cmd, instanceCount);
+			}
+			// Commands are shared by all instances or recorded once, so these paths always draw the full detail level
+			triangleCount = (uint64_t)modelTriangleCount * instanceCount;
+
+			drawUI(cmd);
+			vkCmdEndRenderPass(cmd);
+		}
+		else
+		{
+			vkCmdBeginRenderPass(cmd, &renderPassBeginI, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+			// Per-object paths record one draw per object, split across the worker threads
+			const glm::mat4 viewProjection = camera.matrices.perspective * camera.matrices.view;
+			const glm::vec3 viewPosition = glm::vec3(glm::inverse(camera.matrices.view)[3]);
+			// Pixels per world unit at distance 1 (see vks::mesh::lodScreenScale), the projection's y scale is 1 / tan(fovY / 2)
+			const float screenScale = 0.5f * (float)height * std::abs(camera.matrices.perspective[1][1]);
+			std::atomic<uint64_t> drawnTriangles(0);
+			recordSecondaryCommandBuffers(cmd, imageIndex, instanceCount, [&](VkCommandBuffer cmd, uint32_t first, uint32_t count)
+			{
+				// Levels are selected with the viewer in the object's model space, which accounts for its scale
+				auto drawObject = [&](const InstanceData &instance) -> uint32_t {
+					if (!lodEnabled) {
+						model.draw(cmd);
+						return modelTriangleCount;
+					}
+					return model.drawLod(cmd, (viewPosition - instance.pos) / instance.scale, screenScale, lodPixelThreshold);
+				};
+				uint64_t triangles = 0;
+				model.bindBuffers(cmd, VERTEX_BUFFER_BIND_ID);
+				if (drawPath == DRAW_PATH_PER_OBJECT)
+				{
+					vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.perObject);
+					PushConstants pushConstants;
+					pushConstants.color = glm::vec3(1.0f);
+					for (uint32_t j = first; j < first + count; ++j)
+					{
+						const InstanceData &instance = instances[j];
+						pushConstants.mvp = viewProjection * glm::scale(glm::translate(glm::mat4(1.0f), instance.pos), glm::vec3(instance.scale));
+						vkCmdPushConstants(cmd, pipelineLayouts.perObject, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
+						triangles += drawObject(instance);
+					}
+				}
+				else
+				{
+					vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.dynamicOffset);
+					for (uint32_t j = first; j < first + count; ++j)
+					{
+						// Dynamic offsets are passed in binding order (view, model)
+						uint32_t dynamicOffsets[2] = { viewOffset, static_cast<uint32_t>(dynamicAlignment) * j };
+						vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.dynamicOffset, 0, 1, &descriptorSets.dynamicOffset, 2, dynamicOffsets);
+						triangles += drawObject(instances[j]);
+					}
+				}
+				drawnTriangles += triangles;
+			});
+			triangleCount = drawnTriangles;
+
+			vkCmdEndRenderPass(cmd);
+		}
+
+		gpuProfiler.endScope(cmd);
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmd));
+	}
+
+	void draw()
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		VulkanExampleBase::prepareFrame();
+
+		if (cyclePaths) {
+			drawPath = (drawPath + 1) % static_cast<int32_t>(pathNames.size());
+		}
+		if (cycleDistances && (!cyclePaths || (drawPath == 0))) {
+			// All paths are drawn at one distance before moving on to the next one
+			distanceIndex = (distanceIndex + 1) % static_cast<uint32_t>(wws::arr_len_v<decltype(benchmarkDistances)>);
+			camera.setTranslation(glm::vec3(0.0f, 0.0f, -gridSize() * benchmarkDistances[distanceIndex]));
+		}
+
+		// prepareFrame waited for the last submission of this swap chain image, so its uniform data and command buffer can be rewritten
+		uniformRing.beginFrame(currentBuffer);
+		uboView.projection = camera.matrices.perspective;
+		uboView.view = camera.matrices.view;
+		viewOffset = uniformRing.push(&uboView, sizeof(uboView)).offset;
+		VK_CHECK_RESULT(uniformRing.flush());
+
+		auto tRecord = std::chrono::high_resolution_clock::now();
+		recordCommandBuffer(currentBuffer);
+		recordTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tRecord).count();
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		VulkanExampleBase::submitFrame();
+
+		if (benchmark.active) {
+			// CPU time of the frame without waiting on fences and the swap chain, per draw path
+			const double frameTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			benchmark.addTime(pathNames[drawPath] + ":cpu", std::max(frameTime - benchmark.waitTime, 0.0));
+			benchmark.addTime(pathNames[drawPath] + ":record", recordTime);
+			if (cycleDistances) {
+				// Distance from the camera to the grid center in grid sizes
+				char distance[16];
+				snprintf(distance, sizeof(distance), "@%.2f", benchmarkDistances[distanceIndex]);
+				const std::string metric = pathNames[drawPath] + distance;
+				benchmark.addCount(metric + ":triangles", (double)triangleCount);
+				benchmark.addTime(metric + ":frame", frameTime);
+			}
+		}
+	}
+
+	virtual void render() override
+	{
+		if (!prepared)
+			return;
+		draw();
+	}
+
+	void loadAssets()
+	{
+		vks::ModelCreateInfo createInfo(1.0f, 1.0f, 0.0f);
+		if (lodEnabled) {
+			vks::Model::lodSettings.levelCount = 5;
+			model.loadFromFile(getAssetPath() + "models/torus.obj", vertexLayout, &createInfo, vulkanDevice, queue);
+		} else {
+			model.loadFromFile(getAssetPath() + "models/cube.obj", vertexLayout, &createInfo, vulkanDevice, queue);
+		}
+		modelTriangleCount = 0;
+		for (const vks::ModelPart &part : model.parts) {
+			modelTriangleCount += part.indexCount / 3;
+		}
+	}
+
+	void prepareInstanceData()
+	{
+		// Instances are placed on a grid with random scales
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndScale(0.25f, 0.75f);
+		const uint32_t dim = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<float>(instanceCount))));
+		const float center = (float)(dim - 1) * spacing * 0.5f;
+		instances.resize(instanceCount);
+		for (uint32_t i = 0; i < instanceCount; i++) {
+			instances[i].pos = glm::vec3(float(i / (dim * dim)), float((i / dim) % dim), float(i % dim)) * spacing - glm::vec3(center);
+			instances[i].scale = rndScale(rndEngine);
+		}
+
+		// Model matrices for the dynamic-offset path, each one aligned to the minimum uniform buffer offset alignment
+		size_t minUBOAlignment = vulkanDevice->properties.limits.minUniformBufferOffsetAlignment;
+		dynamicAlignment = sizeof(glm::mat4);
+		if (minUBOAlignment > 0) {
+			dynamicAlignment = (dynamicAlignment + minUBOAlignment - 1) & ~(minUBOAlignment - 1);
+		}
+		std::vector<uint8_t> modelMatrices(instanceCount * dynamicAlignment);
+		for (uint32_t i = 0; i < instanceCount; i++) {
+			glm::mat4 modelMatrix = glm::scale(glm::translate(glm::mat4(1.0f), instances[i].pos), glm::vec3(instances[i].scale));
+			memcpy(modelMatrices.data() + i * dynamicAlignment, &modelMatrix, sizeof(glm::mat4));
+		}
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &instanceBuffer, instances.size() * sizeof(InstanceData)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &modelMatrixBuffer, modelMatrices.size()));
+
+		vks::UploadQueue *uploadQueue = vks::UploadQueue::getShared(vulkanDevice, queue);
+		uploadQueue->uploadBuffer(instanceBuffer.buffer, instances.data(), instances.size() * sizeof(InstanceData));
+		uploadQueue->uploadBuffer(modelMatrixBuffer.buffer, modelMatrices.data(), modelMatrices.size(), 0, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT);
+		uploadQueue->flush();
+
+		// Commands of the indirect path, only available if commands may start at a non-zero instance
+		if (vulkanDevice->enabledFeatures.drawIndirectFirstInstance) {
+			// Commands are grouped by the index type of their part, each group is drawn with its index buffer range bound
+			for (VkIndexType indexType : { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 }) {
+				for (uint32_t i = 0; i < instanceCount; i++) {
+					model.appendDrawCommands(indirectDraws, 1, i, indexType);
+				}
+				if (indexType == VK_INDEX_TYPE_UINT16) {
+					indirectDraws16 = indirectDraws.size();
+				}
+			}
+			indirectDraws.upload(vulkanDevice, queue);
+		} else {
+			std::cout << "drawIndirectFirstInstance not supported, indirect draw path disabled" << std::endl;
+			pathNames.pop_back();
+			if (drawPath == DRAW_PATH_INDIRECT) {
+				drawPath = DRAW_PATH_INSTANCED;
+			}
+		}
+
+		// View matrices are written to the region of the acquired swap chain image every frame
+		uniformRing.prepare(vulkanDevice, sizeof(uboView), swapChain.imageCount);
+	}
+
+	void setupDescriptors()
+	{
+		using namespace vks::initializers;
+
+		VkDescriptorPoolSize poolSizes[] = {
+			descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 3)
+		};
+		auto poolI = descriptorPoolCreateInfo(wws::arr_len_v<decltype(poolSizes)>, poolSizes, 2);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &poolI, nullptr, &descriptorPool));
+
+		// Dynamic-offset path: view and model matrices (dynamicuniformbuffer shaders)
+		VkDescriptorSetLayoutBinding dynamicBindings[] = {
+			descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0),
+			descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 1)
+		};
+		auto dynamicLayoutI = descriptorSetLayoutCreateInfo(dynamicBindings, wws::arr_len_v<decltype(dynamicBindings)>);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &dynamicLayoutI, nullptr, &descriptorSetLayouts.dynamicOffset));
+
+		// Instanced path: view matrices only (computecullandlod shaders)
+		VkDescriptorSetLayoutBinding instancedBinding = descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0);
+		auto instancedLayoutI = descriptorSetLayoutCreateInfo(&instancedBinding, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &instancedLayoutI, nullptr, &descriptorSetLayouts.instanced));
+
+		auto dynamicPipelineLayoutI = pipelineLayoutCreateInfo(&descriptorSetLayouts.dynamicOffset);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &dynamicPipelineLayoutI, nullptr, &pipelineLayouts.dynamicOffset));
+		auto instancedPipelineLayoutI = pipelineLayoutCreateInfo(&descriptorSetLayouts.instanced);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &instancedPipelineLayoutI, nullptr, &pipelineLayouts.instanced));
+
+		// Per-object path: the model view projection matrix is passed as push constant (multithreading shaders)
+		VkPushConstantRange pushConstant = pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(PushConstants), 0);
+		auto perObjectPipelineLayoutI = pipelineLayoutCreateInfo(nullptr, 0);
+		perObjectPipelineLayoutI.pushConstantRangeCount = 1;
+		perObjectPipelineLayoutI.pPushConstantRanges = &pushConstant;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &perObjectPipelineLayoutI, nullptr, &pipelineLayouts.perObject));
+
+		auto dynamicAllocI = descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.dynamicOffset, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &dynamicAllocI, &descriptorSets.dynamicOffset));
+		auto instancedAllocI = descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.instanced, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &instancedAllocI, &descriptorSets.instanced));
+		updateDescriptorSets();
+	}
+
+	void updateDescriptorSets()
+	{
+		using namespace vks::initializers;
+		VkDescriptorBufferInfo viewDescriptor = uniformRing.getDescriptor(sizeof(uboView));
+		VkDescriptorBufferInfo modelDescriptor = { modelMatrixBuffer.buffer, 0, sizeof(glm::mat4) };
+		VkWriteDescriptorSet writeDescriptorSets[] = {
+			writeDescriptorSet(descriptorSets.dynamicOffset, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &viewDescriptor),
+			writeDescriptorSet(descriptorSets.dynamicOffset, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &modelDescriptor),
+			writeDescriptorSet(descriptorSets.instanced, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &viewDescriptor)
+		};
+		vkUpdateDescriptorSets(device, wws::arr_len_v<decltype(writeDescriptorSets)>, writeDescriptorSets, 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		using namespace vks::initializers;
+
+		auto inputAssemblySCI = pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		auto rasterizationSCI = pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_CLOCKWISE);
+		auto colorBlendAttachment = pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		auto colorBlendSCI = pipelineColorBlendStateCreateInfo(1, &colorBlendAttachment);
+		auto depthStencilSCI = pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		auto vpSCI = pipelineViewportStateCreateInfo(1, 1);
+		auto multisampleSCI = pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+		VkDynamicState dynamicSs[] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
+		auto dynamicSCI = pipelineDynamicStateCreateInfo(dynamicSs, wws::arr_len_v<decltype(dynamicSs)>);
+		VkPipelineShaderStageCreateInfo shaderStages[2];
+
+		// Vertex layout: position (0), normal (12), color (24)
+		VkVertexInputBindingDescription vertexInputBindings[] = {
+			vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, vertexLayout.stride(), VK_VERTEX_INPUT_RATE_VERTEX),
+			vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE)
+		};
+		auto vertexInputSCI = pipelineVertexInputStateCreateInfo();
+		vertexInputSCI.pVertexBindingDescriptions = vertexInputBindings;
+
+		auto pipelineCI = pipelineCreateInfo(pipelineLayouts.perObject, renderPass);
+		pipelineCI.stageCount = wws::arr_len_v<decltype(shaderStages)>;
+		pipelineCI.pStages = shaderStages;
+		pipelineCI.pColorBlendState = &colorBlendSCI;
+		pipelineCI.pDepthStencilState = &depthStencilSCI;
+		pipelineCI.pDynamicState = &dynamicSCI;
+		pipelineCI.pInputAssemblyState = &inputAssemblySCI;
+		pipelineCI.pMultisampleState = &multisampleSCI;
+		pipelineCI.pRasterizationState = &rasterizationSCI;
+		pipelineCI.pViewportState = &vpSCI;
+		pipelineCI.pVertexInputState = &vertexInputSCI;
+
+		// Per-object: position, normal, color
+		VkVertexInputAttributeDescription perObjectAttrs[] = {
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 1, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3),
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 2, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 6)
+		};
+		vertexInputSCI.vertexBindingDescriptionCount = 1;
+		vertexInputSCI.vertexAttributeDescriptionCount = wws::arr_len_v<decltype(perObjectAttrs)>;
+		vertexInputSCI.pVertexAttributeDescriptions = perObjectAttrs;
+		shaderStages[0] = loadShader(getAssetPath() + "shaders/multithreading/phong.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getAssetPath() + "shaders/multithreading/phong.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineCI, &pipelines.perObject));
+
+		// Dynamic-offset: position, color
+		VkVertexInputAttributeDescription dynamicOffsetAttrs[] = {
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 1, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 6)
+		};
+		vertexInputSCI.vertexAttributeDescriptionCount = wws::arr_len_v<decltype(dynamicOffsetAttrs)>;
+		vertexInputSCI.pVertexAttributeDescriptions = dynamicOffsetAttrs;
+		pipelineCI.layout = pipelineLayouts.dynamicOffset;
+		shaderStages[0] = loadShader(getAssetPath() + "shaders/dynamicuniformbuffer/base.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getAssetPath() + "shaders/dynamicuniformbuffer/base.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineCI, &pipelines.dynamicOffset));
+
+		// Instanced: position, normal, color and the per-instance position and scale
+		VkVertexInputAttributeDescription instancedAttrs[] = {
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 1, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3),
+			vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 2, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 6),
+			vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 4, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, pos)),
+			vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 5, VK_FORMAT_R32_SFLOAT, offsetof(InstanceData, scale))
+		};
+		vertexInputSCI.vertexBindingDescriptionCount = wws::arr_len_v<decltype(vertexInputBindings)>;
+		vertexInputSCI.vertexAttributeDescriptionCount = wws::arr_len_v<decltype(instancedAttrs)>;
+		vertexInputSCI.pVertexAttributeDescriptions = instancedAttrs;
+		pipelineCI.layout = pipelineLayouts.instanced;
+		shaderStages[0] = loadShader(getAssetPath() + "shaders/computecullandlod/indirectdraw.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getAssetPath() + "shaders/computecullandlod/indirectdraw.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineCI, &pipelines.instanced));
+	}
+
+	void prepare() override
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareInstanceData();
+		setupDescriptors();
+		preparePipelines();
+		prepared = true;
+	}
+
+	virtual void windowResized() override
+	{
+		// The ring buffer needs a region per swap chain image, the image count may change with the swap chain
+		if (uniformRing.getFrameSize() > 0 && uniformRing.buffer.size < uniformRing.getFrameSize() * swapChain.imageCount) {
+			uniformRing.prepare(vulkanDevice, sizeof(uboView), swapChain.imageCount);
+			updateDescriptorSets();
+		}
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay) override
+	{
+		if (overlay->header("Settings")) {
+			overlay->comboBox("Draw path", &drawPath, pathNames);
+			overlay->text("%u instances", instanceCount);
+			overlay->text("%u draws per frame", (drawPath == DRAW_PATH_INSTANCED) ? (uint32_t)model.parts.size() : (uint32_t)model.parts.size() * instanceCount);
+			if (drawPath == DRAW_PATH_INDIRECT) {
+				overlay->text("%s", indirectDraws.isMultiDraw() ? "Multi-draw indirect" : "One indirect call per draw (no multiDrawIndirect)");
+			}
+			overlay->text("%.1f M triangles per frame", (double)triangleCount / 1000000.0);
+			if (lodEnabled) {
+				overlay->sliderFloat("LOD pixel error", &lodPixelThreshold, 0.25f, 8.0f);
+				if ((drawPath == DRAW_PATH_INSTANCED) || (drawPath == DRAW_PATH_INDIRECT)) {
+					overlay->text("Levels of detail are selected by the per-object paths only");
+				}
+			}
+			overlay->text("Recording: %.2f ms", recordTime);
+		}
+	}
+
+private:
+	static const uint32_t VERTEX_BUFFER_BIND_ID = 0;
+	static const uint32_t INSTANCE_BUFFER_BIND_ID = 1;
+
+	std::vector<std::string> pathNames = { "per-object", "dynamic-offset", "instanced", "indirect" };
+	int32_t drawPath = DRAW_PATH_INSTANCED;
+	bool cyclePaths = false;
+	uint32_t instanceCount = DEFAULT_INSTANCE_COUNT;
+	const float spacing = 2.5f;
+	double recordTime = 0.0;
+
+	bool lodEnabled = false;
+	float lodPixelThreshold = 1.0f;
+	uint32_t modelTriangleCount = 0;
+	// Triangles submitted by the last recorded frame
+	uint64_t triangleCount = 0;
+	// Camera distances to the grid center (in grid sizes) stepped through in benchmark mode with -lod
+	static constexpr float benchmarkDistances[] = { 0.75f, 1.5f, 3.0f, 6.0f };
+	bool cycleDistances = false;
+	uint32_t distanceIndex = 0;
+
+	// Edge length of the instance grid
+	float gridSize() const
+	{
+		const uint32_t dim = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<float>(instanceCount))));
+		return (float)dim * spacing;
+	}
+
+	vks::VertexLayout vertexLayout = vks::VertexLayout({
+		vks::VERTEX_COMPONENT_POSITION,
+		vks::VERTEX_COMPONENT_NORMAL,
+		vks::VERTEX_COMPONENT_COLOR,
+	});
+	vks::Model model;
+
+	// Per-instance data as read by the computecullandlod vertex shader (locations 4 and 5)
+	struct InstanceData {
+		glm::vec3 pos;
+		float scale;
+	};
+	std::vector<InstanceData> instances;
+	vks::Buffer instanceBuffer;
+	vks::IndirectDrawBuffer indirectDraws;
+	// Number of commands of parts with 16 bit indices, they come first
+	uint32_t indirectDraws16 = 0;
+
+	// Model matrices of all instances at dynamicAlignment stride for the dynamic-offset path
+	vks::Buffer modelMatrixBuffer;
+	size_t dynamicAlignment = 0;
+
+	// Push constant block of the multithreading vertex shader
+	struct PushConstants {
+		glm::mat4 mvp;
+		glm::vec3 color;
+	};
+
+	struct {
+		glm::mat4 projection;
+		glm::mat4 view;
+	} uboView;
+	vks::FrameRingBuffer uniformRing;
+	uint32_t viewOffset = 0;
+
+	struct {
+		VkPipeline perObject = VK_NULL_HANDLE;
+		VkPipeline dynamicOffset = VK_NULL_HANDLE;
+		VkPipeline instanced = VK_NULL_HANDLE;
+	} pipelines;
+
+	struct {
+		VkPipelineLayout perObject = VK_NULL_HANDLE;
+		VkPipelineLayout dynamicOffset = VK_NULL_HANDLE;
+		VkPipelineLayout instanced = VK_NULL_HANDLE;
+	} pipelineLayouts;
+
+	struct {
+		VkDescriptorSetLayout dynamicOffset = VK_NULL_HANDLE;
+		VkDescriptorSetLayout instanced = VK_NULL_HANDLE;
+	} descriptorSetLayouts;
+
+	struct {
+		VkDescriptorSet dynamicOffset = VK_NULL_HANDLE;
+		VkDescriptorSet instanced = VK_NULL_HANDLE;
+	} descriptorSets;
+};
+
+#if defined(_WIN32)
+
+Example *example;
+LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	if (example != NULL)
+	{
+		example->handleMessages(hWnd, uMsg, wParam, lParam);
+	}
+	return (DefWindowProc(hWnd, uMsg, wParam, lParam));
+}
+
+int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow)
+{
+	for (size_t i = 0; i < __argc; i++) { Example::args.push_back(__argv[i]); };
+	example = new Example();
+	example->initVulkan();
+	example->setupWindow(hInstance, WndProc);
+	example->prepare();
+	example->renderLoop();
+	delete example;
+	return 0;
+}
+
+#elif defined(__linux__)
+
+// Linux entry point
+Example *example;
+static void handleEvent(const xcb_generic_event_t *event)
+{
+	if (example != NULL)
+	{
+		example->handleEvent(event);
+	}
+}
+int main(const int argc, const char *argv[])
+{
+	for (size_t i = 0; i < argc; i++) { Example::args.push_back(argv[i]); };
+	example = new Example();
+	example->initVulkan();
+	example->setupWindow();
+	example->prepare();
+	example->renderLoop();
+	delete example;
+	return 0;
+}
+#endif
@@ -0,0 +1,108 @@
+//
+// Microbenchmark comparing the work stealing vks::JobSystem with the per-thread FIFO vks::ThreadPool
+// on empty and tiny jobs (scheduling overhead dominates in both cases)
+//
+// Usage: jobsystem-benchmark [job count] [thread count]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <threadpool.hpp>
+#include <jobsystem.hpp>
+#include <benchmark.hpp>
+
+static const uint32_t runs = 5;
+
+// Times the function (median of runs) and prints the time per job
+static void report(const std::string &name, uint32_t jobCount, const std::function<void()> &function)
+{
+	const vks::Benchmark::Statistics stats = vks::Benchmark::measure(1, function, runs);
+	std::cout << std::left << std::setw(36) << name << std::right << std::setw(10) << stats.p50 << " ms " << std::setw(10) << (stats.p50 * 1000000.0 / jobCount) << " ns/job"
+		<< std::setw(10) << stats.p90 << " ms p90 " << std::setw(8) << stats.stddev << " ms stddev" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t jobCount = (argc > 1) ? (uint32_t)strtoul(argv[1], nullptr, 10) : 100000;
+	uint32_t threadCount = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 10) : std::max(std::thread::hardware_concurrency(), 1u);
+	jobCount = std::max(jobCount, 1u);
+	threadCount = std::max(threadCount, 1u);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "jobs   : " << jobCount << std::endl;
+	std::cout << "threads: " << threadCount << std::endl;
+	std::cout << "runs   : " << runs << " (median)" << std::endl << std::endl;
+
+	// Tiny job: a few flops on its own element
+	std::vector<float> data(jobCount, 1.0f);
+	auto tinyJob = [&data](uint32_t i) {
+		float v = data[i];
+		for (uint32_t j = 0; j < 16; j++) {
+			v = v * 1.0001f + 0.5f;
+		}
+		data[i] = v;
+	};
+
+	// Jobs are distributed round-robin, as callers have to pick a thread
+	{
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(threadCount);
+		report("ThreadPool empty", jobCount, [&] {
+			for (uint32_t i = 0; i < jobCount; i++) {
+				threadPool.threads[i % threadCount]->addJob([] {});
+			}
+			threadPool.wait();
+		});
+		report("ThreadPool tiny", jobCount, [&] {
+			for (uint32_t i = 0; i < jobCount; i++) {
+				threadPool.threads[i % threadCount]->addJob([&tinyJob, i] { tinyJob(i); });
+			}
+			threadPool.wait();
+		});
+	}
+
+	{
+		vks::JobSystem jobSystem(threadCount);
+		report("JobSystem empty", jobCount, [&] {
+			vks::JobCounter counter;
+			for (uint32_t i = 0; i < jobCount; i++) {
+				jobSystem.run([] {}, &counter);
+			}
+			jobSystem.wait(counter);
+		});
+		report("JobSystem tiny", jobCount, [&] {
+			vks::JobCounter counter;
+			for (uint32_t i = 0; i < jobCount; i++) {
+				jobSystem.run([&tinyJob, i] { tinyJob(i); }, &counter);
+			}
+			jobSystem.wait(counter);
+		});
+		// Fork-join: a few parent jobs each spawn their share of child jobs into the same counter
+		report("JobSystem tiny (nested)", jobCount, [&] {
+			vks::JobCounter counter;
+			const uint32_t parents = threadCount * 4;
+			for (uint32_t p = 0; p < parents; p++) {
+				jobSystem.run([&, p] {
+					for (uint32_t i = p; i < jobCount; i += parents) {
+						jobSystem.run([&tinyJob, i] { tinyJob(i); }, &counter);
+					}
+				}, &counter);
+			}
+			jobSystem.wait(counter);
+		});
+		report("JobSystem tiny (parallel_for 256)", jobCount, [&] {
+			jobSystem.parallel_for(jobCount, 256, [&tinyJob](uint32_t first, uint32_t last) {
+				for (uint32_t i = first; i < last; i++) {
+					tinyJob(i);
+				}
+			});
+		});
+	}
+
+	return 0;
+}
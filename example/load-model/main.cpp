@@ -5,21 +5,19 @@
 #include <vulkanexamplebase.h>
 #include <VulkanBuffer.hpp>
 #include <VulkanDevice.hpp>
+#include <VulkanModel.hpp>
 #include <comm/CommTool.hpp>
 #include <comm/dbg.hpp>
 #include "comm/macro.h"
 
-#include <assimp/cimport.h>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
 #include <VulkanTexture.hpp>
 
 class Example : public VulkanExampleBase
 {
 private:
 	bool wireframe = false;
+	// Packed 20 byte vertices instead of 44 byte float vertices (-packed)
+	bool packed = false;
 
 	struct {
 		vks::Texture2D colorMap;
@@ -32,36 +30,15 @@ private:
 		std::vector<VkVertexInputAttributeDescription> attrs;
 	} inputState;
 
-	struct Vertex
-	{
-		glm::vec3 pos;
-		glm::vec3 normal;
-		glm::vec2 uv;
-		glm::vec3 color;
-	};
-
-	struct Model
-	{
-		struct {
-			VkBuffer buf;
-			VkDeviceMemory mem;
-		}vertices;
-
-		struct {
-			int count;
-			VkBuffer buf;
-			VkDeviceMemory mem;
-		}indeices;
-
-		void destroy(VkDevice device)
-		{
-			vkDestroyBuffer(device, vertices.buf, nullptr);
-			vkFreeMemory(device, vertices.mem,nullptr);
+	// Packed layouts store snorm16 positions (dequantized in the vertex shader per model part), octahedral snorm16 normals, unorm16 uvs and unorm8 colors
+	vks::VertexLayout vertexLayout = vks::VertexLayout({
+		vks::VERTEX_COMPONENT_POSITION,
+		vks::VERTEX_COMPONENT_NORMAL,
+		vks::VERTEX_COMPONENT_UV,
+		vks::VERTEX_COMPONENT_COLOR,
+	});
 
-			vkDestroyBuffer(device, indeices.buf, nullptr);
-			vkFreeMemory(device, indeices.mem, nullptr);
-		}
-	} model;
+	vks::Model model;
 
 	struct {
 		vks::Buffer scene;
@@ -94,6 +71,12 @@ public:
 		cameraPos = { 0.1f, 1.1f, 0.0f };
 		title = "Model rendering";
 		settings.overlay = true;
+		for (size_t i = 0; i < args.size(); i++) {
+			if (args[i] == std::string("-packed")) {
+				packed = true;
+			}
+		}
+		vertexLayout.packed = packed;
 	}
 	~Example()
 	{
@@ -104,7 +87,7 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		model.destroy(device);
+		model.destroy();
 		textures.colorMap.destroy();
 		uniformBufs.scene.destroy();
 	}
@@ -135,6 +118,7 @@ public:
 			renderPassBI.framebuffer = frameBuffers[i];
 
 			vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBeginInfo);
+			gpuProfiler.beginCommandBuffer(drawCmdBuffers[i], i);
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBI, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -147,13 +131,13 @@ public:
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
 
-			VkDeviceSize offset[1] = { 0 };
-
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &model.vertices.buf, offset);
+			gpuProfiler.beginScope(drawCmdBuffers[i], "Model", true);
 
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], model.indeices.buf, 0, VK_INDEX_TYPE_UINT32);
+			// Packed models push the dequantization of each part before drawing it
+			model.bindBuffers(drawCmdBuffers[i]);
+			model.draw(drawCmdBuffers[i]);
 
-			vkCmdDrawIndexed(drawCmdBuffers[i], model.indeices.count, 1, 0, 0, 0);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -165,94 +149,24 @@ public:
 
 	void loadModel(std::string&& path)
 	{
-		const aiScene* scene;
-		Assimp::Importer importer;
-
 		constexpr  uint32_t load_flags = aiProcess_FlipWindingOrder |
 			aiProcess_Triangulate |
 			aiProcess_PreTransformVertices;
 
-		scene = importer.ReadFile(path.c_str(), load_flags);
-
-		float scale = 1.f;
-		std::vector<Vertex> vertices;
-
-		for (uint32_t m = 0; m < scene->mNumMeshes; ++m)
+		// Parts are reordered for post transform cache reuse, less overdraw and linear vertex fetches at import (see vks::Model::optimizeMeshes)
+		vks::ModelCreateInfo createInfo(1.0f, 1.0f, 0.0f);
+		vks::Model::Data data;
+		if (!vks::Model::loadData(path, vertexLayout, &createInfo, load_flags, vulkanDevice->jobSystem, data))
 		{
-			auto curr_mesh = scene->mMeshes[m];
-			for (uint32_t i = 0; i < curr_mesh->mNumVertices; ++i)
-			{
-				Vertex v;
-				v.pos = glm::make_vec3(&curr_mesh->mVertices[i].x) * scale;
-				v.normal = glm::make_vec3(&curr_mesh->mNormals[i].x);
-
-				v.uv = glm::make_vec2(&curr_mesh->mTextureCoords[0][i].x);
-				v.color = curr_mesh->HasVertexColors(0) ? glm::make_vec3(&curr_mesh->mColors[0]->r) : glm::vec3(1.f);
-
-				// Vulkan uses a right-handed NDC (contrary to OpenGL), so simply flip Y-Axis
-				v.pos.y *= -1.0f;
-				vertices.push_back(v);
-			}
-		}
-
-		size_t vertexBufferSize = sizeof(Vertex) * vertices.size();
-
-		std::vector<uint32_t> indexBuffer;
-		for (uint32_t m = 0; m < scene->mNumMeshes; ++m)
-		{
-			auto curr_mesh = scene->mMeshes[m];
-			uint32_t indexBase = static_cast<uint32_t>(indexBuffer.size());
-			for (uint32_t f = 0; f < curr_mesh->mNumFaces; ++f)
-			{
-				//We assume that all faces are triangulated
-				for (uint32_t i = 0; i < 3; ++i)
-				{
-					indexBuffer.push_back(curr_mesh->mFaces[f].mIndices[i] + indexBase);
-				}
-			}
+			vks::tools::exitFatal("Could not load \"" + path + "\": " + data.error, -1);
+			return;
 		}
+		model.loadFromData(data, vulkanDevice, queue);
 
-		size_t indexBufferSize = sizeof(uint32_t) * static_cast<uint32_t>(indexBuffer.size());
-
-		model.indeices.count = static_cast<uint32_t>(indexBuffer.size());
-
-		struct {
-			VkBuffer buf;
-			VkDeviceMemory mem;
-		} vbuf,ibuf;
-
-		vulkanDevice->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBufferSize, &vbuf.buf,&vbuf.mem,vertices.data());
-
-		vulkanDevice->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indexBufferSize, &ibuf.buf, &ibuf.mem, indexBuffer.data());
-
-		vulkanDevice->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-		, vertexBufferSize, &model.vertices.buf, &model.vertices.mem);
-		
-		vulkanDevice->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			indexBufferSize, &model.indeices.buf, &model.indeices.mem);
-
-		
-		VkCommandBuffer copyCmd = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		VkBufferCopy copyRegion = {};
-		
-		copyRegion.size = vertexBufferSize;
-
-		vkCmdCopyBuffer(copyCmd, vbuf.buf, model.vertices.buf, 1, &copyRegion);
-
-		copyRegion.size = indexBufferSize;
-
-		vkCmdCopyBuffer(copyCmd, ibuf.buf, model.indeices.buf, 1, &copyRegion);
-
-		flushCommandBuffer(copyCmd, queue, true);
-
-		vkDestroyBuffer(device,vbuf.buf,nullptr);
-		vkFreeMemory(device, vbuf.mem, nullptr);
-
-		vkDestroyBuffer(device, ibuf.buf, nullptr);
-		vkFreeMemory(device, ibuf.mem, nullptr);
+		printf("%s in %.2f ms, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", data.cached ? "Mapped from mesh cache" : "Imported", data.loadTime,
+			data.efficiencyBefore.acmr, data.efficiencyAfter.acmr, data.efficiencyBefore.atvr, data.efficiencyAfter.atvr);
+		printf("Vertex buffer %.1f KB (%u bytes per vertex), index buffer %.1f KB (%u of %u indices 16 bit)\n", data.vertexDataSize / 1024.0f,
+			vertexLayout.stride(), data.indexBufferSize() / 1024.0f, data.index16Count, data.indexCount + data.lodIndexCount);
 	}
 
 	void loadAssets()
@@ -267,15 +181,10 @@ public:
 		using namespace vks::initializers;
 
 		std::vector<VkVertexInputBindingDescription> binds = {
-			vertexInputBindingDescription(0,sizeof(Vertex),VK_VERTEX_INPUT_RATE_VERTEX)
+			vertexInputBindingDescription(0,vertexLayout.stride(),VK_VERTEX_INPUT_RATE_VERTEX)
 		};
 
-		std::vector<VkVertexInputAttributeDescription> attrs = {
-			vertexInputAttributeDescription(0,0,VK_FORMAT_R32G32B32_SFLOAT,0),
-			vertexInputAttributeDescription(0,1,VK_FORMAT_R32G32B32_SFLOAT,sizeof(float) * 3),
-			vertexInputAttributeDescription(0,2,VK_FORMAT_R32G32_SFLOAT,sizeof(float) * 6),
-			vertexInputAttributeDescription(0,3,VK_FORMAT_R32G32B32_SFLOAT,sizeof(float) * 8)
-		};
+		std::vector<VkVertexInputAttributeDescription> attrs = vertexLayout.attributeDescriptions(0);
 
 		inputState.info = {};
 
@@ -315,7 +224,19 @@ public:
 
 		VkPipelineLayoutCreateInfo pipelineCI = pipelineLayoutCreateInfo(&descriptorSetLayout);
 
+		// Dequantization of the drawn part for the packed vertex shader
+		VkPushConstantRange pushConstantsRange = pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(vks::Model::Dequantization), 0);
+		if (packed)
+		{
+			pipelineCI.pushConstantRangeCount = 1;
+			pipelineCI.pPushConstantRanges = &pushConstantsRange;
+		}
+
 		vkCreatePipelineLayout(device, &pipelineCI, nullptr, &pipelineLayout);
+		if (packed)
+		{
+			model.dequantizationPush.layout = pipelineLayout;
+		}
 	}
 
 	void setupDescriptorSet()
@@ -363,7 +284,7 @@ public:
 
 		
 		VkPipelineShaderStageCreateInfo stages[] = {
-			loadShader(getAssetPath() + "shaders/mesh/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getAssetPath() + (packed ? "shaders/mesh/meshpacked.vert.spv" : "shaders/mesh/mesh.vert.spv"), VK_SHADER_STAGE_VERTEX_BIT),
 			loadShader(getAssetPath() + "shaders/mesh/mesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
 		};
 
@@ -379,13 +300,13 @@ public:
 		pipelineCI.pStages = stages;
 		pipelineCI.stageCount = wws::arrLen(stages);
 
-		vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid);
+		createGraphicsPipelines(1, &pipelineCI, &pipelines.solid);
 
 		if (deviceFeatures.fillModeNonSolid)
 		{
 			rasterizationSCI.polygonMode = VK_POLYGON_MODE_LINE;
 			rasterizationSCI.lineWidth = 1.0f;
-			vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe);
+			createGraphicsPipelines(1, &pipelineCI, &pipelines.wireframe);
 		}
 	}
 
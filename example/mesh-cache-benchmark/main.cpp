@@ -0,0 +1,133 @@
+//
+// Compares cold (ASSIMP import and conversion) and warm (memory mapped mesh cache) loads of vks::Model
+// for the models in data/models (or the model files passed on the command line)
+//
+// Usage: mesh-cache-benchmark [model files...]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+#include <VulkanModel.hpp>
+#include <jobsystem.hpp>
+#include <benchmark.hpp>
+
+static const uint32_t runs = 3;
+
+// Layout most of the examples use
+static const vks::VertexLayout vertexLayout({
+	vks::VERTEX_COMPONENT_POSITION,
+	vks::VERTEX_COMPONENT_NORMAL,
+	vks::VERTEX_COMPONENT_UV,
+	vks::VERTEX_COMPONENT_COLOR,
+});
+
+// Reads all vertex and index data like the staging copy of Model::loadFromFile does (pages of the mapped cache are only loaded on access)
+static void stage(const vks::Model::Data &data, std::vector<uint8_t> &staging)
+{
+	const size_t indexDataSize = ((size_t)data.indexCount + data.lodIndexCount) * sizeof(uint32_t);
+	staging.resize(data.vertexDataSize + indexDataSize);
+	memcpy(staging.data(), data.vertices, data.vertexDataSize);
+	memcpy(staging.data() + data.vertexDataSize, data.indices, indexDataSize);
+}
+
+int main(int argc, char *argv[])
+{
+	namespace fs = std::filesystem;
+
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++) {
+		files.push_back(argv[i]);
+	}
+	if (files.empty()) {
+		const std::vector<std::string> extensions = { ".dae", ".obj", ".fbx", ".3ds", ".x" };
+		for (auto& entry : fs::recursive_directory_iterator(std::string(VK_EXAMPLE_DATA_DIR) + "models")) {
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+			if (entry.is_regular_file() && (std::find(extensions.begin(), extensions.end(), extension) != extensions.end())) {
+				files.push_back(entry.path().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+	}
+
+	// Cache files of this run are written to a separate directory that is removed afterwards
+	const fs::path cacheDir = fs::temp_directory_path() / "mesh-cache-benchmark";
+	fs::create_directories(cacheDir);
+	vks::Model::cacheDirectory = cacheDir.string() + "/";
+	auto clearCache = [&cacheDir] {
+		for (auto& entry : fs::directory_iterator(cacheDir)) {
+			fs::remove(entry.path());
+		}
+	};
+
+	vks::JobSystem jobSystem;
+	vks::ModelCreateInfo createInfo(1.0f, 1.0f, 0.0f);
+	std::vector<uint8_t> staging;
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "threads: " << jobSystem.getThreadCount() << std::endl;
+	std::cout << "runs   : " << runs << " (median), p90 in % above the median (largest of the row)" << std::endl << std::endl;
+	std::cout << std::left << std::setw(40) << "model" << std::right << std::setw(10) << "vertices" << std::setw(10) << "indices"
+		<< std::setw(14) << "serial ms" << std::setw(14) << "cold ms" << std::setw(14) << "warm ms" << std::setw(10) << "speedup" << std::setw(8) << "p90" << std::endl;
+
+	double totalSerial = 0.0, totalCold = 0.0, totalWarm = 0.0;
+	for (auto& file : files) {
+		vks::Model::Data info;
+		vks::Model::useCache = false;
+		if (!vks::Model::loadData(file, vertexLayout, &createInfo, vks::Model::defaultFlags, nullptr, info)) {
+			std::cout << std::left << std::setw(40) << fs::path(file).filename().string() << "  " << info.error << std::endl;
+			continue;
+		}
+
+		double spread = 0.0;
+		const auto median = [&spread](const vks::Benchmark::Statistics &stats) {
+			spread = std::max(spread, stats.p90Spread());
+			return stats.p50;
+		};
+
+		// Serial conversion without cache (ASSIMP import and single threaded conversion)
+		const double serial = median(vks::Benchmark::measure(1, [&] {
+			vks::Model::Data data;
+			vks::Model::loadData(file, vertexLayout, &createInfo, vks::Model::defaultFlags, nullptr, data);
+			stage(data, staging);
+		}, runs));
+
+		// Cold load: parallel conversion and writing the cache file
+		vks::Model::useCache = true;
+		const double cold = median(vks::Benchmark::measure(1, [&] {
+			vks::Model::Data data;
+			vks::Model::loadData(file, vertexLayout, &createInfo, vks::Model::defaultFlags, &jobSystem, data);
+			stage(data, staging);
+		}, runs, clearCache));
+
+		// Warm load: hashing the source file and mapping the cache file written by the last cold load
+		bool cached = true;
+		const double warm = median(vks::Benchmark::measure(1, [&] {
+			vks::Model::Data data;
+			vks::Model::loadData(file, vertexLayout, &createInfo, vks::Model::defaultFlags, &jobSystem, data);
+			stage(data, staging);
+			cached = cached && data.cached;
+		}, runs));
+
+		std::string name = fs::relative(fs::path(file), fs::path(std::string(VK_EXAMPLE_DATA_DIR) + "models")).string();
+		if (name.empty() || (name.compare(0, 2, "..") == 0)) {
+			name = fs::path(file).filename().string();
+		}
+		std::cout << std::left << std::setw(40) << name << std::right << std::setw(10) << info.vertexCount << std::setw(10) << info.indexCount
+			<< std::setw(14) << serial << std::setw(14) << cold << std::setw(14) << warm << std::setw(9) << (serial / warm) << "x"
+			<< std::setw(7) << std::setprecision(0) << (spread * 100.0) << "%" << std::setprecision(2) << (cached ? "" : "  (cache miss!)") << std::endl;
+		totalSerial += serial;
+		totalCold += cold;
+		totalWarm += warm;
+	}
+
+	std::cout << std::left << std::setw(60) << "total" << std::right << std::setw(14) << totalSerial << std::setw(14) << totalCold << std::setw(14) << totalWarm
+		<< std::setw(9) << (totalWarm > 0.0 ? totalSerial / totalWarm : 0.0) << "x" << std::endl;
+
+	fs::remove_all(cacheDir);
+	return 0;
+}
@@ -0,0 +1,110 @@
+//
+// Generates level of detail chains for the models in data/models (or the model files passed on the command line)
+// and reports the triangles vks::Model::drawLod submits per model depending on the viewer distance
+//
+// Usage: mesh-lod-benchmark [model files...]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iterator>
+#include <filesystem>
+#include <VulkanModel.hpp>
+#include <jobsystem.hpp>
+
+// Layout most of the examples use
+static const vks::VertexLayout vertexLayout({
+	vks::VERTEX_COMPONENT_POSITION,
+	vks::VERTEX_COMPONENT_NORMAL,
+	vks::VERTEX_COMPONENT_UV,
+	vks::VERTEX_COMPONENT_COLOR,
+});
+
+// 1080p with a 60 degree vertical field of view, levels may be off by at most one pixel
+static const float viewportHeight = 1080.0f;
+static const float fovY = glm::radians(60.0f);
+static const float pixelThreshold = 1.0f;
+
+// Viewer distances in multiples of the model's bounding radius
+static const float distances[] = { 1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 32.0f, 64.0f, 128.0f };
+
+int main(int argc, char *argv[])
+{
+	namespace fs = std::filesystem;
+
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++) {
+		files.push_back(argv[i]);
+	}
+	if (files.empty()) {
+		const std::vector<std::string> extensions = { ".dae", ".obj", ".fbx", ".3ds", ".x" };
+		for (auto& entry : fs::recursive_directory_iterator(std::string(VK_EXAMPLE_DATA_DIR) + "models")) {
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+			if (entry.is_regular_file() && (std::find(extensions.begin(), extensions.end(), extension) != extensions.end())) {
+				files.push_back(entry.path().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+	}
+
+	vks::JobSystem jobSystem;
+	vks::ModelCreateInfo createInfo(1.0f, 1.0f, 0.0f);
+	vks::Model::useCache = false;
+	vks::Model::lodSettings.levelCount = 6;
+	const float screenScale = vks::mesh::lodScreenScale(fovY, viewportHeight);
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "threads  : " << jobSystem.getThreadCount() << std::endl;
+	std::cout << "levels   : " << vks::Model::lodSettings.levelCount << " (reduction " << vks::Model::lodSettings.reduction << ", error bound " << vks::Model::lodSettings.maxError << " x part radius)" << std::endl;
+	std::cout << "viewport : " << viewportHeight << " px, " << glm::degrees(fovY) << " deg, " << pixelThreshold << " px threshold" << std::endl << std::endl;
+
+	std::cout << std::left << std::setw(36) << "model" << std::right << std::setw(10) << "triangles" << std::setw(10) << "lod ms";
+	for (float distance : distances) {
+		std::cout << std::setw(9) << ("d=" + std::to_string((int)distance) + "r");
+	}
+	std::cout << std::endl;
+
+	std::vector<double> totals(std::size(distances), 0.0);
+	double totalTriangles = 0.0;
+	for (auto& file : files) {
+		vks::Model::Data data;
+		std::string name = fs::relative(fs::path(file), fs::path(std::string(VK_EXAMPLE_DATA_DIR) + "models")).string();
+		if (name.empty() || (name.compare(0, 2, "..") == 0)) {
+			name = fs::path(file).filename().string();
+		}
+		if (!vks::Model::loadData(file, vertexLayout, &createInfo, vks::Model::defaultFlags, &jobSystem, data)) {
+			std::cout << std::left << std::setw(36) << name << "  " << data.error << std::endl;
+			continue;
+		}
+
+		// The viewer moves away from the model center along the z axis
+		const glm::vec3 center = (data.dim.min + data.dim.max) * 0.5f;
+		const float radius = std::max(glm::length(data.dim.size) * 0.5f, 1e-6f);
+		const uint32_t triangleCount = data.indexCount / 3;
+		std::cout << std::left << std::setw(36) << name << std::right << std::setw(10) << triangleCount << std::setw(10) << data.lodTime;
+		for (size_t i = 0; i < std::size(distances); i++) {
+			const glm::vec3 viewPosition = center + glm::vec3(0.0f, 0.0f, distances[i] * radius);
+			uint32_t drawn = 0;
+			for (const vks::Model::ModelPart &part : data.parts) {
+				drawn += vks::Model::selectLod(part, viewPosition, screenScale, pixelThreshold).indexCount / 3;
+			}
+			// Share of the full resolution triangles that are submitted
+			const double share = (triangleCount > 0) ? 100.0 * drawn / triangleCount : 100.0;
+			std::cout << std::setw(8) << share << "%";
+			totals[i] += drawn;
+		}
+		std::cout << std::endl;
+		totalTriangles += triangleCount;
+	}
+
+	std::cout << std::left << std::setw(36) << "total" << std::right << std::setw(10) << (uint64_t)totalTriangles << std::setw(10) << "";
+	for (double total : totals) {
+		std::cout << std::setw(8) << (totalTriangles > 0.0 ? 100.0 * total / totalTriangles : 100.0) << "%";
+	}
+	std::cout << std::endl;
+	return 0;
+}
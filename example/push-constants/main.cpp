@@ -96,10 +96,8 @@ public:
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
-			VkDeviceSize offset[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.sence.vertices.buffer, offset);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.sence.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(drawCmdBuffers[i], models.sence.indexCount, 1, 0, 0, 0);
+			models.sence.bindBuffers(drawCmdBuffers[i]);
+			models.sence.draw(drawCmdBuffers[i]);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -203,7 +201,7 @@ public:
 		pipelineCI.stageCount = wws::arr_len_v<decltype(shaderStage)>;
 		pipelineCI.pStages = shaderStage;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineCI, &pipelines.solid));
 	}
 
 	void prepareUniformBuffers()
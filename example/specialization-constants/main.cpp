@@ -81,24 +81,21 @@ public:
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-			VkDeviceSize offsets[] = { 0 };
-
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.cube.vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.cube.indices.buffer, 0 ,VK_INDEX_TYPE_UINT32);
+			models.cube.bindBuffers(drawCmdBuffers[i]);
 
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &vp);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
-			vkCmdDrawIndexed(drawCmdBuffers[i], models.cube.indexCount, 1, 0, 0, 0);
+			models.cube.draw(drawCmdBuffers[i]);
 
 			vp.x += width_1_3;
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &vp);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.tong);
-			vkCmdDrawIndexed(drawCmdBuffers[i], models.cube.indexCount, 1, 0, 0, 0);
+			models.cube.draw(drawCmdBuffers[i]);
 
 			vp.x += width_1_3;
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &vp);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.textured);
-			vkCmdDrawIndexed(drawCmdBuffers[i], models.cube.indexCount, 1, 0, 0, 0);
+			models.cube.draw(drawCmdBuffers[i]);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -223,13 +220,13 @@ public:
 		shaderStages[1].pSpecializationInfo = &specializationI;
 
 		specializationData.lightingMode = 0;
-		vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong);
+		createGraphicsPipelines(1, &pipelineCI, &pipelines.phong);
 
 		specializationData.lightingMode = 1;
-		vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.tong);
+		createGraphicsPipelines(1, &pipelineCI, &pipelines.tong);
 
 		specializationData.lightingMode = 2;
-		vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.textured);
+		createGraphicsPipelines(1, &pipelineCI, &pipelines.textured);
 	}
 
 	void prepareUniformBuffers()
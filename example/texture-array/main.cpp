@@ -7,6 +7,7 @@
 #include <vulkanexamplebase.h>
 #include <VulkanBuffer.hpp>
 #include <VulkanDevice.hpp>
+#include <VulkanFrameRingBuffer.hpp>
 #include <comm/CommTool.hpp>
 #include <comm/dbg.hpp>
 #include <VulkanTexture.hpp>
@@ -26,6 +27,13 @@ public:
     void draw()
     {
         VulkanExampleBase::prepareFrame();
+        // The last submission of this swap chain image has finished, so its region of the ring buffer can be rewritten
+        uniformRing.beginFrame(currentBuffer);
+        vks::FrameRingBuffer::Allocation ubo = uniformRing.allocate(uniformDataSize());
+        memcpy(ubo.data, &uboVS, sizeof(uboVS));
+        memcpy(static_cast<uint8_t*>(ubo.data) + sizeof(uboVS), instance_ptr, sizeof(UboInstanceData) * layer_count);
+        VK_CHECK_RESULT(uniformRing.flush());
+
         submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
         submitInfo.commandBufferCount = 1;
         vkQueueSubmit(queue,1,&submitInfo,VK_NULL_HANDLE);
@@ -42,13 +50,13 @@ public:
         vkDestroyImageView(device,texture.view, nullptr);
         vkDestroyImage(device,texture.image, nullptr);
         vkDestroySampler(device,texture.sampler, nullptr);
-        vkFreeMemory(device,texture.deviceMemory, nullptr);
+        texture.allocation.free();
 
         vkDestroyPipeline(device,pipeline, nullptr);
         vkDestroyPipelineLayout(device,pipelineLayout, nullptr);
         vkDestroyDescriptorSetLayout(device,descriptorSetLayout, nullptr);
 
-        uniformBuffer.destroy();
+        uniformRing.destroy();
         vertexBuffer.destroy();
         indexBuffer.destroy();
 
@@ -80,11 +88,10 @@ public:
 
         using namespace vks::initializers;
 
-        VkMemoryAllocateInfo memAllocI = memoryAllocateInfo();
         VkMemoryRequirements memReq;
 
         VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMem;
+        vks::Allocation stagingMem;
 
         VkBufferCreateInfo bufferCI = bufferCreateInfo();
         bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
@@ -94,16 +101,12 @@ public:
         vkCreateBuffer(device,&bufferCI, nullptr,&stagingBuffer);
         vkGetBufferMemoryRequirements(device,stagingBuffer,&memReq);
 
-        memAllocI.allocationSize = memReq.size;
-        memAllocI.memoryTypeIndex = vulkanDevice->getMemoryType(memReq.memoryTypeBits,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        vkAllocateMemory(device,&memAllocI, nullptr,&stagingMem);
-        vkBindBufferMemory(device,stagingBuffer,stagingMem,0);
+        VK_CHECK_RESULT(vulkanDevice->memoryAllocator->allocate(memReq,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,&stagingMem,
+                vks::ALLOCATION_RESOURCE_LINEAR,vks::ALLOCATION_STRATEGY_LINEAR));
+        vkBindBufferMemory(device,stagingBuffer,stagingMem.memory,stagingMem.offset);
 
-        void *data;
-        vkMapMemory(device,stagingMem,0,memReq.size,0,&data);
-        memcpy(data,tex2DArray.data(),tex2DArray.size());
-        vkUnmapMemory(device,stagingMem);
+        memcpy(stagingMem.mapped,tex2DArray.data(),tex2DArray.size());
 
         std::vector<VkBufferImageCopy> bufferCopyRegions;
         uint32_t offset = 0;
@@ -139,13 +142,10 @@ public:
         vkCreateImage(device,&imageCI, nullptr,&texture.image);
 
         vkGetImageMemoryRequirements(device,texture.image,&memReq);
-        memAllocI.allocationSize = memReq.size;
-        memAllocI.memoryTypeIndex = vulkanDevice->getMemoryType(memReq.memoryTypeBits,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-        vkAllocateMemory(device,&memAllocI, nullptr,&texture.deviceMemory);
+        VK_CHECK_RESULT(vulkanDevice->memoryAllocator->allocate(memReq,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,&texture.allocation,vks::ALLOCATION_RESOURCE_OPTIMAL));
 
-        vkBindImageMemory(device,texture.image,texture.deviceMemory,0);
+        vkBindImageMemory(device,texture.image,texture.allocation.memory,texture.allocation.offset);
 
         auto copyCmd = VulkanExampleBase::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY,true);
 
@@ -200,7 +200,7 @@ public:
 
         vkCreateImageView(device,&viewCI, nullptr,&texture.view);
 
-        vkFreeMemory(device,stagingMem, nullptr);
+        stagingMem.free();
         vkDestroyBuffer(device,stagingBuffer, nullptr);
     }
 
@@ -251,8 +251,9 @@ public:
             VkRect2D scissor = rect2D(width,height,0,0);
             vkCmdSetScissor(drawCmdBuffers[i],0,1,&scissor);
 
-            vkCmdBindDescriptorSets(drawCmdBuffers[i],VK_PIPELINE_BIND_POINT_GRAPHICS,pipelineLayout,0,1,&descriptorSet,0,
-                                    nullptr);
+            uint32_t dynamicOffset = static_cast<uint32_t>(uniformRing.getFrameOffset(i));
+            vkCmdBindDescriptorSets(drawCmdBuffers[i],VK_PIPELINE_BIND_POINT_GRAPHICS,pipelineLayout,0,1,&descriptorSet,1,
+                                    &dynamicOffset);
             vkCmdBindPipeline(drawCmdBuffers[i],VK_PIPELINE_BIND_POINT_GRAPHICS,pipeline);
             VkDeviceSize offset[] = {0};
             vkCmdBindVertexBuffers(drawCmdBuffers[i],0,1,&vertexBuffer.buffer,offset);
@@ -313,7 +314,7 @@ public:
     {
         using namespace vks::initializers;
         VkDescriptorPoolSize sizes[] = {
-             descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,1),
+             descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,1),
              descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,1)
         };
         VkDescriptorPoolCreateInfo poolCI = descriptorPoolCreateInfo(wws::arrLen(sizes),sizes,2);
@@ -324,7 +325,7 @@ public:
     {
         using namespace vks::initializers;
         VkDescriptorSetLayoutBinding binding[] = {
-                descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,VK_SHADER_STAGE_VERTEX_BIT,0),
+                descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,VK_SHADER_STAGE_VERTEX_BIT,0),
                 descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_FRAGMENT_BIT,1)
         };
 
@@ -346,8 +347,10 @@ public:
 		descriptor.imageView = texture.view;
 		descriptor.sampler = texture.sampler;
 
+        VkDescriptorBufferInfo uboDescriptor = uniformRing.getDescriptor(uniformDataSize());
+
         VkWriteDescriptorSet ws[] = {
-                writeDescriptorSet(descriptorSet,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,0,&uniformBuffer.descriptor),
+                writeDescriptorSet(descriptorSet,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,0,&uboDescriptor),
                 writeDescriptorSet(descriptorSet,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,1,&descriptor)
         };
         vkUpdateDescriptorSets(device,wws::arrLen(ws),ws,0, nullptr);
@@ -387,17 +390,15 @@ public:
         pipelineCI.pInputAssemblyState = &inputAssemblySCI;
         pipelineCI.pColorBlendState = &colorSCI;
 
-        vkCreateGraphicsPipelines(device,pipelineCache,1,&pipelineCI, nullptr,&pipeline);
+        createGraphicsPipelines(1, &pipelineCI, &pipeline);
     }
 
     void prepareUniformBuffers()
     {
         instance_ptr = new UboInstanceData[layer_count];
 
-        VkDeviceSize size = sizeof(uboVS) + sizeof(UboInstanceData) * layer_count;
-        vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &uniformBuffer, size);
+        // Matrices and instance data are written to the region of the current swap chain image each frame
+        uniformRing.prepare(vulkanDevice, uniformDataSize(), static_cast<uint32_t>(drawCmdBuffers.size()));
         float offset = 1.5f;
         float begin = (layer_count * offset) / -2.0f;
 
@@ -409,10 +410,6 @@ public:
             model = glm::rotate(model,glm::radians(60.0f),glm::vec3(1.0f,0.0f,0.0f));
             instance_ptr[i].model = model;
         }
-		void* data;
-		vkMapMemory(device, uniformBuffer.memory, sizeof(uboVS), size, 0, &data);
-        memcpy(data,instance_ptr, sizeof(UboInstanceData) * layer_count);
-		vkUnmapMemory(device, uniformBuffer.memory);
 
         updateUniformBuffer_matrix();
     }
@@ -427,10 +424,11 @@ public:
         view = glm::rotate(view,rotation.z,glm::vec3(0.0f,0.0f,1.0f));
 
 		uboVS.view = view;
+    }
 
-        uniformBuffer.map(sizeof(uboVS));
-        memcpy(uniformBuffer.mapped,&uboVS, sizeof(uboVS));
-        uniformBuffer.unmap();
+    VkDeviceSize uniformDataSize() const
+    {
+        return sizeof(uboVS) + sizeof(UboInstanceData) * layer_count;
     }
 
     void viewChanged() override {
@@ -463,7 +461,7 @@ private:
 
     vks::Buffer vertexBuffer;
     vks::Buffer indexBuffer;
-    vks::Buffer uniformBuffer;
+    vks::FrameRingBuffer uniformRing;
     uint32_t index_count;
 
     struct UboInstanceData
@@ -41,7 +41,7 @@ public:
         vkDestroyImage(device,cubeMap.image, nullptr);
         vkDestroyImageView(device,cubeMap.view, nullptr);
         vkDestroySampler(device,cubeMap.sampler, nullptr);
-        vkFreeMemory(device,cubeMap.deviceMemory, nullptr);
+        cubeMap.allocation.free();
 
         vkDestroyPipeline(device,pipelines.skybox, nullptr);
         vkDestroyPipeline(device,pipelines.reflect, nullptr);
@@ -102,11 +102,10 @@ public:
 
         using namespace vks::initializers;
 
-        VkMemoryAllocateInfo memAllocateInfo = memoryAllocateInfo();
         VkMemoryRequirements requirements;
 
         VkBuffer stagingBuffer;
-        VkDeviceMemory  stagingMem;
+        vks::Allocation stagingMem;
 
         VkBufferCreateInfo bufferCI = bufferCreateInfo();
         bufferCI.size = texCube.size();
@@ -116,17 +115,13 @@ public:
         vkCreateBuffer(device,&bufferCI,nullptr,&stagingBuffer);
 
         vkGetBufferMemoryRequirements(device,stagingBuffer,&requirements);
-        memAllocateInfo.allocationSize = requirements.size;
-        memAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(requirements.memoryTypeBits,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        vkAllocateMemory(device,&memAllocateInfo, nullptr,&stagingMem);
-        vkBindBufferMemory(device,stagingBuffer,stagingMem,0);
-
-        //copy to staging buffer
-        void *data;
-        vkMapMemory(device,stagingMem,0,requirements.size,0,&data);
-        memcpy(data,texCube.data(),texCube.size());
-        vkUnmapMemory(device,stagingMem);
+        VK_CHECK_RESULT(vulkanDevice->memoryAllocator->allocate(requirements,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingMem,
+                vks::ALLOCATION_RESOURCE_LINEAR, vks::ALLOCATION_STRATEGY_LINEAR));
+        vkBindBufferMemory(device,stagingBuffer,stagingMem.memory,stagingMem.offset);
+
+        //copy to staging buffer (persistently mapped by the allocator)
+        memcpy(stagingMem.mapped,texCube.data(),texCube.size());
 
 		VkImageCreateInfo imageCI = imageCreateInfo();
 		imageCI.format = format;
@@ -145,12 +140,10 @@ public:
 		vkCreateImage(device, &imageCI, nullptr, &cubeMap.image);
 
 		vkGetImageMemoryRequirements(device, cubeMap.image, &requirements);
-		memAllocateInfo.allocationSize = requirements.size;
-		memAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(requirements.memoryTypeBits,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		vkAllocateMemory(device, &memAllocateInfo, nullptr, &cubeMap.deviceMemory);
+		VK_CHECK_RESULT(vulkanDevice->memoryAllocator->allocate(requirements,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cubeMap.allocation, vks::ALLOCATION_RESOURCE_OPTIMAL));
 
-		vkBindImageMemory(device, cubeMap.image, cubeMap.deviceMemory,0);
+		vkBindImageMemory(device, cubeMap.image, cubeMap.allocation.memory, cubeMap.allocation.offset);
 
 		VkCommandBuffer copyCmd = VulkanExampleBase::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
@@ -237,7 +230,7 @@ public:
 
 		vkCreateImageView(device, &ivCI, nullptr, &cubeMap.view);
 
-		vkFreeMemory(device,stagingMem, nullptr);
+		stagingMem.free();
 		vkDestroyBuffer(device,stagingBuffer, nullptr);
     }
 
@@ -294,21 +287,18 @@ public:
 			VkRect2D scrssor = rect2D(width, height, 0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scrssor);
 
-			VkDeviceSize offset[] = { 0 };
 			if (displaySkybox)
 			{
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.skybox, 0, nullptr);
-				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.skybox.vertices.buffer, offset);
-				vkCmdBindIndexBuffer(drawCmdBuffers[i], models.skybox.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+				models.skybox.bindBuffers(drawCmdBuffers[i]);
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skybox);
-				vkCmdDrawIndexed(drawCmdBuffers[i], models.skybox.indexCount, 1, 0, 0, 0);
+				models.skybox.draw(drawCmdBuffers[i]);
 			}
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.object, 0, nullptr);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.objects[models.object_index].vertices.buffer, offset);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.objects[models.object_index].indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			models.objects[models.object_index].bindBuffers(drawCmdBuffers[i]);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.reflect);
-			vkCmdDrawIndexed(drawCmdBuffers[i], models.objects[models.object_index].indexCount, 1, 0, 0, 0);
+			models.objects[models.object_index].draw(drawCmdBuffers[i]);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -457,7 +447,7 @@ public:
         shaders[0] = loadShader(getAssetPath() + "shaders/texturecubemap/skybox.vert.spv",VK_SHADER_STAGE_VERTEX_BIT);
         shaders[1] = loadShader(getAssetPath() + "shaders/texturecubemap/skybox.frag.spv",VK_SHADER_STAGE_FRAGMENT_BIT);
 
-        vkCreateGraphicsPipelines(device,pipelineCache,1,&pipelineCI, nullptr,&pipelines.skybox);
+        createGraphicsPipelines(1, &pipelineCI, &pipelines.skybox);
 
         shaders[0] = loadShader(getAssetPath() + "shaders/texturecubemap/reflect.vert.spv",VK_SHADER_STAGE_VERTEX_BIT);
         shaders[1] = loadShader(getAssetPath() + "shaders/texturecubemap/reflect.frag.spv",VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -466,7 +456,7 @@ public:
         depthStencilStateCI.depthWriteEnable = VK_TRUE;
         rasterizationStateCI.cullMode = VK_CULL_MODE_FRONT_BIT;
 
-        vkCreateGraphicsPipelines(device,pipelineCache,1,&pipelineCI, nullptr,&pipelines.reflect);
+        createGraphicsPipelines(1, &pipelineCI, &pipelines.reflect);
     }
 
     void prepareUniformBuffers()
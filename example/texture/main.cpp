@@ -22,7 +22,7 @@ private:
 		VkSampler sampler;
 		VkImage image;
 		VkImageLayout imageLayout;
-		VkDeviceMemory memory;
+		vks::Allocation memory;
 		VkImageView imageView;
 		uint32_t width, height, mipLevels;
 	} texture;
@@ -88,7 +88,7 @@ public:
 		vkDestroyImageView(device, texture.imageView,nullptr);
 		vkDestroyImage(device,texture.image,nullptr);
 		vkDestroySampler(device, texture.sampler, nullptr);
-		vkFreeMemory(device, texture.memory, nullptr);
+		texture.memory.free();
 	}
 
 	void getEnabledFeatures() override
@@ -138,13 +138,12 @@ public:
 
 		using namespace vks::initializers;
 
-		VkMemoryAllocateInfo memAllocInfo = memoryAllocateInfo();
 		VkMemoryRequirements memRequirments;
 
 		if (useStaging)
 		{
 			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMem;
+			vks::Allocation stagingMem;
 
 			VkBufferCreateInfo bufferCI = bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, tex2D.size());
 			bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -152,17 +151,12 @@ public:
 
 			vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirments);
 
-			memAllocInfo.allocationSize = memRequirments.size;
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memRequirments.memoryTypeBits,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			VK_CHECK_RESULT(vulkanDevice->memoryAllocator->allocate(memRequirments,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingMem,
+				vks::ALLOCATION_RESOURCE_LINEAR, vks::ALLOCATION_STRATEGY_LINEAR));
+			vkBindBufferMemory(device, stagingBuffer, stagingMem.memory, stagingMem.offset);
 
-			vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMem);
-			vkBindBufferMemory(device, stagingBuffer, stagingMem, 0);
-
-			void* data;
-			vkMapMemory(device, stagingMem, 0, memRequirments.size, 0, &data);
-			memcpy(data, tex2D.data(), tex2D.size());
-			vkUnmapMemory(device, stagingMem);
+			memcpy(stagingMem.mapped, tex2D.data(), tex2D.size());
 
 			std::vector<VkBufferImageCopy> bufferCopyRegions;
 
@@ -203,12 +197,10 @@ public:
 
 			vkGetImageMemoryRequirements(device, texture.image, &memRequirments);
 
-			memAllocInfo.allocationSize = memRequirments.size;
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memRequirments.memoryTypeBits,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			vkAllocateMemory(device, &memAllocInfo, nullptr, &texture.memory);
+			VK_CHECK_RESULT(vulkanDevice->memoryAllocator->allocate(memRequirments,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture.memory, vks::ALLOCATION_RESOURCE_OPTIMAL));
 
-			vkBindImageMemory(device, texture.image, texture.memory,0);
+			vkBindImageMemory(device, texture.image, texture.memory.memory, texture.memory.offset);
 
 			VkCommandBuffer copyCmd = VulkanExampleBase::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
@@ -262,12 +254,12 @@ public:
 
 			VulkanExampleBase::flushCommandBuffer(copyCmd, queue, true);
 
-			vkFreeMemory(device, stagingMem, nullptr);
+			stagingMem.free();
 			vkDestroyBuffer(device, stagingBuffer, nullptr);
 		}
 		else {
 			VkImage mappableImage;
-			VkDeviceMemory mappableMem;
+			vks::Allocation mappableMem;
 
 			VkImageCreateInfo imageCI = imageCreateInfo();
 			imageCI.imageType = VK_IMAGE_TYPE_2D;
@@ -285,20 +277,11 @@ public:
 
 			vkGetImageMemoryRequirements(device, mappableImage, &memRequirments);
 
-			memAllocInfo.allocationSize = memRequirments.size;
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memRequirments.memoryTypeBits,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			
-			vkAllocateMemory(device, &memAllocInfo, nullptr, &mappableMem);
-			vkBindImageMemory(device, mappableImage, mappableMem,0);
-
-			void *data;
-
-			vkMapMemory(device, mappableMem, 0, memRequirments.size, 0,&data);
-
-			memcpy(data, tex2D[0].data(), tex2D[0].size());
+			VK_CHECK_RESULT(vulkanDevice->memoryAllocator->allocate(memRequirments,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &mappableMem));
+			vkBindImageMemory(device, mappableImage, mappableMem.memory, mappableMem.offset);
 
-			vkUnmapMemory(device, mappableMem);
+			memcpy(mappableMem.mapped, tex2D[0].data(), tex2D[0].size());
 
 			texture.image = mappableImage;
 			texture.memory = mappableMem;
@@ -540,7 +523,7 @@ public:
 		pipelineCI.pDynamicState = &dynamicSCI;
 		pipelineCI.pStages = shaderStages;
 		pipelineCI.pVertexInputState = &vertexInputState.info;
-		VK_CHECK_RESULT( vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.soild) );
+		VK_CHECK_RESULT( createGraphicsPipelines(1, &pipelineCI, &pipelines.soild) );
 	}
 
 	void prepareUniformBuffers()
@@ -603,7 +603,7 @@ public:
 		pipelineCI.pMultisampleState = &multisamplerSCI;
 		pipelineCI.pVertexInputState = &visci.sci;
 
-		vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.soild);
+		createGraphicsPipelines(1, &pipelineCI, &pipelines.soild);
 	}
 
 	void prepare()
@@ -0,0 +1,160 @@
+//
+// Measures composing model matrices for 125 to 1M objects: the per-object glm code of the dynamic-uniform-buffer example
+// against the structure of arrays vks::TransformStore kernels (scalar, SSE, AVX) and the job system
+//
+// Usage: transform-benchmark [-max <count>] [-stride <bytes>]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <transforms.hpp>
+#include <jobsystem.hpp>
+#include <benchmark.hpp>
+
+// Largest absolute difference between the matrices in two destination buffers
+static float maxError(const uint8_t *a, const uint8_t *b, uint32_t count, size_t stride)
+{
+	float error = 0.0f;
+	for (uint32_t i = 0; i < count; i++) {
+		const float *ma = reinterpret_cast<const float*>(a + i * stride);
+		const float *mb = reinterpret_cast<const float*>(b + i * stride);
+		for (uint32_t j = 0; j < 16; j++) {
+			error = std::max(error, std::fabs(ma[j] - mb[j]));
+		}
+	}
+	return error;
+}
+
+// Destination buffer aligned like a mapped uniform buffer
+struct Destination {
+	std::unique_ptr<uint8_t[]> storage;
+	uint8_t *data;
+
+	Destination(uint32_t count, size_t stride) : storage(new uint8_t[count * stride + 256])
+	{
+		data = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(storage.get()) + 255) & ~uintptr_t(255));
+		memset(data, 0, count * stride);
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	uint32_t maxCount = 1000000;
+	size_t stride = sizeof(glm::mat4);
+	for (int i = 1; i < argc - 1; i++) {
+		if (std::string(argv[i]) == "-max") {
+			maxCount = static_cast<uint32_t>(std::atoi(argv[i + 1]));
+		}
+		if (std::string(argv[i]) == "-stride") {
+			stride = std::max(sizeof(glm::mat4), static_cast<size_t>(std::atoi(argv[i + 1])) & ~size_t(15));
+		}
+	}
+
+	vks::JobSystem jobSystem;
+	const vks::simd::Level supported = vks::simd::supportedLevel();
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "threads: " << jobSystem.getThreadCount() << std::endl;
+	std::cout << "simd   : " << vks::simd::levelName(supported) << std::endl;
+	std::cout << "stride : " << stride << " bytes" << std::endl;
+	std::cout << "times  : ms per update (median of 5), p90 in % above the median (largest of the row)" << std::endl << std::endl;
+
+	struct Path {
+		std::string name;
+		vks::simd::Level level;
+		bool parallel;
+	};
+	std::vector<Path> paths = {
+		{ "SoA scalar", vks::simd::LEVEL_SCALAR, false },
+		{ "SoA SSE", vks::simd::LEVEL_SSE, false },
+		{ "SoA AVX", vks::simd::LEVEL_AVX, false },
+		{ "SoA AVX jobs", vks::simd::LEVEL_AVX, true },
+	};
+	paths.erase(std::remove_if(paths.begin(), paths.end(), [supported](const Path &path) { return path.level > supported; }), paths.end());
+
+	std::cout << std::setw(10) << "objects" << std::setw(16) << "glm rotate x3" << std::setw(16) << "glm TRS";
+	for (auto& path : paths) {
+		std::cout << std::setw(16) << path.name;
+	}
+	std::cout << std::setw(10) << "speedup" << std::setw(8) << "p90" << std::endl;
+
+	for (uint32_t count = 125; count <= maxCount; count *= (count == 125) ? 8 : 10) {
+		// Same setup as the dynamic-uniform-buffer example: objects on a grid with random rotations
+		std::default_random_engine rndEngine(0);
+		std::normal_distribution<float> rndDist(-1.0f, 1.0f);
+		std::vector<glm::vec3> positions(count), rotations(count);
+		vks::TransformStore store;
+		const uint32_t dim = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<float>(count))));
+		for (uint32_t i = 0; i < count; i++) {
+			positions[i] = glm::vec3(float(i / (dim * dim)), float((i / dim) % dim), float(i % dim)) * 5.0f;
+			rotations[i] = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine)) * 2.0f * 3.14159265359f;
+			const glm::quat rotation = glm::angleAxis(rotations[i].x, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)))
+				* glm::angleAxis(rotations[i].y, glm::vec3(0.0f, 1.0f, 0.0f))
+				* glm::angleAxis(rotations[i].z, glm::vec3(0.0f, 0.0f, 1.0f));
+			store.add(positions[i], rotation);
+		}
+
+		Destination reference(count, stride), result(count, stride);
+
+		// Small counts are repeated to get above the timer resolution
+		const uint32_t repeat = std::max(1u, 1000000u / count);
+		double spread = 0.0;
+		const auto median = [&spread](const vks::Benchmark::Statistics &stats) {
+			spread = std::max(spread, stats.p90Spread());
+			return stats.p50;
+		};
+
+		// Per-object matrix functions on AoS data as in the original example (rebuilds the rotations from angles)
+		const double glmRotate = median(vks::Benchmark::measure(repeat, [&] {
+			for (uint32_t i = 0; i < count; i++) {
+				glm::mat4 *modelMat = reinterpret_cast<glm::mat4*>(result.data + i * stride);
+				*modelMat = glm::translate(glm::mat4(1.0f), positions[i]);
+				*modelMat = glm::rotate(*modelMat, rotations[i].x, glm::vec3(1.0f, 1.0f, 0.0f));
+				*modelMat = glm::rotate(*modelMat, rotations[i].y, glm::vec3(0.0f, 1.0f, 0.0f));
+				*modelMat = glm::rotate(*modelMat, rotations[i].z, glm::vec3(0.0f, 0.0f, 1.0f));
+			}
+		}));
+		// Per-object translate * rotate * scale from the same quaternions the store uses, serves as reference result
+		const double glmTRS = median(vks::Benchmark::measure(repeat, [&] {
+			for (uint32_t i = 0; i < count; i++) {
+				glm::mat4 *modelMat = reinterpret_cast<glm::mat4*>(reference.data + i * stride);
+				*modelMat = glm::translate(glm::mat4(1.0f), store.getPosition(i)) * glm::mat4_cast(store.getRotation(i)) * glm::scale(glm::mat4(1.0f), store.getScale(i));
+			}
+		}));
+		const float rotateError = maxError(result.data, reference.data, count, stride);
+
+		std::cout << std::setw(10) << count << std::setw(16) << glmRotate << std::setw(16) << glmTRS;
+		double best = glmRotate;
+		std::string errors;
+		for (auto& path : paths) {
+			store.level = path.level;
+			vks::JobSystem *jobs = path.parallel ? &jobSystem : nullptr;
+			const double time = median(vks::Benchmark::measure(repeat, [&] {
+				store.update(result.data, stride, jobs);
+			}));
+			best = std::min(best, time);
+			std::cout << std::setw(16) << time;
+			const float error = maxError(result.data, reference.data, count, stride);
+			if (error > 1.0e-3f) {
+				errors += "  " + path.name + " differs by " + std::to_string(error);
+			}
+		}
+		std::cout << std::setw(9) << std::setprecision(1) << (glmRotate / best) << "x" << std::setw(7) << std::setprecision(0) << (spread * 100.0) << "%" << std::setprecision(3);
+		if (rotateError > 1.0e-3f) {
+			errors += "  glm rotate x3 differs by " + std::to_string(rotateError);
+		}
+		std::cout << errors << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+//
+// Loads the models in data/models (or the model files passed on the command line) with a float and a packed vertex layout
+// and reports the vertex and index memory of both, along with the precision lost by quantization and the size of the packed
+// position only stream used by depth passes
+//
+// Usage: vertex-packing-benchmark [model files...]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <VulkanModel.hpp>
+#include <jobsystem.hpp>
+
+// Layout most of the examples use
+static const std::vector<vks::Component> components = {
+	vks::VERTEX_COMPONENT_POSITION,
+	vks::VERTEX_COMPONENT_NORMAL,
+	vks::VERTEX_COMPONENT_UV,
+	vks::VERTEX_COMPONENT_COLOR,
+};
+static const vks::VertexLayout floatLayout(components);
+static const vks::VertexLayout packedLayout(components, true);
+
+// Index type column, vks::Model switches to 16 bit indices for parts below 65537 vertices
+static const char *indexTypeName(const vks::Model::Data &data)
+{
+	const uint32_t totalIndexCount = data.indexCount + data.lodIndexCount;
+	if (data.index16Count == totalIndexCount) {
+		return "uint16";
+	}
+	return (data.index16Count == 0) ? "uint32" : "mixed";
+}
+
+int main(int argc, char *argv[])
+{
+	namespace fs = std::filesystem;
+
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++) {
+		files.push_back(argv[i]);
+	}
+	if (files.empty()) {
+		const std::vector<std::string> extensions = { ".dae", ".obj", ".fbx", ".3ds", ".x" };
+		for (auto& entry : fs::recursive_directory_iterator(std::string(VK_EXAMPLE_DATA_DIR) + "models")) {
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+			if (entry.is_regular_file() && (std::find(extensions.begin(), extensions.end(), extension) != extensions.end())) {
+				files.push_back(entry.path().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+	}
+
+	vks::JobSystem jobSystem;
+	vks::ModelCreateInfo createInfo(1.0f, 1.0f, 0.0f);
+	vks::Model::useCache = false;
+
+	const uint32_t floatStride = floatLayout.stride();
+	const uint32_t packedStride = packedLayout.stride();
+	const int32_t packedNormalOffset = packedLayout.offset(vks::VERTEX_COMPONENT_NORMAL);
+	const int32_t floatNormalOffset = floatLayout.offset(vks::VERTEX_COMPONENT_NORMAL);
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "vertex   : " << floatStride << " bytes float, " << packedStride << " bytes packed" << std::endl << std::endl;
+
+	std::cout << std::left << std::setw(36) << "model" << std::right << std::setw(10) << "vertices" << std::setw(12) << "float KB" << std::setw(12) << "packed KB"
+		<< std::setw(8) << "ratio" << std::setw(10) << "index" << std::setw(12) << "pos err" << std::setw(12) << "normal deg"
+		<< std::setw(11) << "positions" << std::setw(12) << "depth KB" << std::endl;
+
+	size_t totalFloat = 0, totalPacked = 0, totalDepth = 0;
+	for (auto& file : files) {
+		vks::Model::Data floatData, packedData;
+		std::string name = fs::relative(fs::path(file), fs::path(std::string(VK_EXAMPLE_DATA_DIR) + "models")).string();
+		if (name.empty() || (name.compare(0, 2, "..") == 0)) {
+			name = fs::path(file).filename().string();
+		}
+		vks::Model::positionStream = false;
+		const bool floatLoaded = vks::Model::loadData(file, floatLayout, &createInfo, vks::Model::defaultFlags, &jobSystem, floatData);
+		vks::Model::positionStream = true;
+		if (!floatLoaded || !vks::Model::loadData(file, packedLayout, &createInfo, vks::Model::defaultFlags, &jobSystem, packedData)) {
+			std::cout << std::left << std::setw(36) << name << "  " << floatData.error << packedData.error << std::endl;
+			continue;
+		}
+		if (floatData.vertexCount != packedData.vertexCount) {
+			std::cout << std::left << std::setw(36) << name << "  vertex count mismatch" << std::endl;
+			continue;
+		}
+
+		// Both loads run the same conversion and optimization, so vertices can be compared one by one
+		// Positions are quantized to the range of their part
+		const float radius = std::max(glm::length(floatData.dim.size) * 0.5f, 1e-6f);
+		float maxPositionError = 0.0f, maxNormalError = 0.0f;
+		for (const vks::Model::ModelPart &part : packedData.parts) {
+			const vks::Model::Dequantization &dq = part.dequantization;
+			for (uint32_t v = part.vertexBase; v < part.vertexBase + part.vertexCount; v++) {
+				const float *src = floatData.vertices + (size_t)v * floatStride / sizeof(float);
+				const uint8_t *packed = reinterpret_cast<const uint8_t*>(packedData.vertices) + (size_t)v * packedStride;
+				int16_t position[4], octNormal[2];
+				memcpy(position, packed, sizeof(position));
+				memcpy(octNormal, packed + packedNormalOffset, sizeof(octNormal));
+				glm::vec3 decoded;
+				for (int c = 0; c < 3; c++) {
+					decoded[c] = dq.positionOffset[c] + dq.positionScale[c] * vks::quantize::fromSnorm16(position[c]);
+				}
+				maxPositionError = std::max(maxPositionError, glm::distance(decoded, glm::make_vec3(src)));
+
+				const glm::vec3 normal = glm::make_vec3(src + floatNormalOffset / sizeof(float));
+				if (glm::length(normal) > 0.0f) {
+					glm::vec3 decodedNormal;
+					vks::quantize::octDecode(octNormal, &decodedNormal.x);
+					const float cosAngle = glm::clamp(glm::dot(glm::normalize(normal), decodedNormal), -1.0f, 1.0f);
+					maxNormalError = std::max(maxNormalError, glm::degrees(std::acos(cosAngle)));
+				}
+			}
+		}
+
+		// The float baseline keeps 32 bit indices for all parts
+		const size_t floatBytes = floatData.vertexDataSize + ((size_t)floatData.indexCount + floatData.lodIndexCount) * sizeof(uint32_t);
+		const size_t packedBytes = packedData.vertexDataSize + packedData.indexBufferSize();
+		// Depth passes bound to the position only stream fetch neither normals, UVs nor colors
+		const size_t depthBytes = packedData.positionDataSize + packedData.indexBufferSize();
+		totalFloat += floatBytes;
+		totalPacked += packedBytes;
+		totalDepth += depthBytes;
+		std::cout << std::left << std::setw(36) << name << std::right << std::setw(10) << floatData.vertexCount
+			<< std::setw(12) << floatBytes / 1024.0 << std::setw(12) << packedBytes / 1024.0
+			<< std::setw(7) << (packedBytes > 0 ? (double)floatBytes / packedBytes : 1.0) << "x"
+			<< std::setw(10) << indexTypeName(packedData)
+			<< std::setprecision(5) << std::setw(12) << maxPositionError / radius << std::setw(12) << maxNormalError << std::setprecision(2)
+			<< std::setw(11) << packedData.positionCount << std::setw(12) << depthBytes / 1024.0 << std::endl;
+	}
+
+	// Position error is given relative to the bounding radius of the model
+	std::cout << std::left << std::setw(36) << "total" << std::right << std::setw(10) << "" << std::setw(12) << totalFloat / 1024.0 << std::setw(12) << totalPacked / 1024.0
+		<< std::setw(7) << (totalPacked > 0 ? (double)totalFloat / totalPacked : 1.0) << "x" << std::setw(10 + 12 + 12 + 11) << "" << std::setw(12) << totalDepth / 1024.0 << std::endl;
+	return 0;
+}
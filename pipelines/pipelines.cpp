@@ -271,7 +271,7 @@ private:
 		shaderStageInfos[0] = loadShader(getAssetPath() + "shaders/pipelines/phong.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStageInfos[1] = loadShader(getAssetPath() + "shaders/pipelines/phong.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipelines.phong));
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineInfo, &pipelines.phong));
 		// All pipelines created after the base pipeline will be derivatives
 		pipelineInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
 		// Base pipeline will be our first created pipeline
@@ -284,7 +284,7 @@ private:
 		shaderStageInfos[0] = loadShader(getAssetPath() + "shaders/pipelines/toon.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStageInfos[1] = loadShader(getAssetPath() + "shaders/pipelines/toon.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipelines.toon));
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineInfo, &pipelines.toon));
 		// Pipeline for wire frame rendering
 		// Non solid rendering is not a mandatory Vulkan feature
 		if (deviceFeatures.fillModeNonSolid)
@@ -292,7 +292,7 @@ private:
 			rasterizationStateInfo.polygonMode = VK_POLYGON_MODE_LINE;
 			shaderStageInfos[0] = loadShader(getAssetPath() + "shaders/pipelines/wireframe.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 			shaderStageInfos[1] = loadShader(getAssetPath() + "shaders/pipelines/wireframe.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipelines.wireframe));
+			VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineInfo, &pipelines.wireframe));
 		}
 	}
 
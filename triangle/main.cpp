@@ -734,7 +734,7 @@ private:
 		pipelineCreateInfo.renderPass = renderPass;
 		pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		VK_CHECK_RESULT(createGraphicsPipelines(1, &pipelineCreateInfo, &pipeline));
 
 		vkDestroyShaderModule(device, shaderStageCreateInfos[0].module, nullptr);
 		vkDestroyShaderModule(device, shaderStageCreateInfos[1].module, nullptr);